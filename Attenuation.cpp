@@ -0,0 +1,320 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Attenuation.h"
+#include <xmmintrin.h>	// SSE
+#include <emmintrin.h>	// SSE2
+#include <math.h>
+#include <string.h>
+#include <float.h>
+
+namespace S3D
+{
+
+	//////
+	// Lookup tables
+	//
+
+#pragma region LUT
+
+	namespace LUT
+	{
+		static const int TableSize = 256; // segments per table, every table has TableSize+1 points
+
+		static float AcosTable[TableSize + 1];	// acos(x) / sqrt(1 - x) for x in [0, 1], smooth enough to lerp
+		static float Log2Table[TableSize + 1];	// log2(1 + i/TableSize), the mantissa part of log2
+		static float Exp2Table[TableSize + 1];	// 2^(i/TableSize), the fractional part of exp2
+
+		static struct TableInit
+		{
+			TableInit()
+			{
+				for (int i = 0; i <= TableSize; ++i)
+				{
+					double x = double(i) / TableSize;
+					AcosTable[i] = i == TableSize ? float(sqrt(2.0)) : float(acos(x) / sqrt(1.0 - x));
+					Log2Table[i] = float(log(1.0 + x) / log(2.0));
+					Exp2Table[i] = float(pow(2.0, x));
+				}
+			}
+		} xTableInit;
+
+		static inline float Lookup(const float* table, float x) // x in [0, TableSize]
+		{
+			int i = int(x);
+			if (i >= TableSize) i = TableSize - 1;
+			float f = x - float(i);
+			return table[i] + (table[i + 1] - table[i]) * f;
+		}
+
+		/**
+		 * @return acos(x) in radians, x is clamped to [-1, 1]. Max error ~0.000001 rad.
+		 */
+		float Acos(float x)
+		{
+			if (x < -1.0f) x = -1.0f;
+			else if (x > 1.0f) x = 1.0f;
+			float a = x < 0.0f ? -x : x;
+			float r = Lookup(AcosTable, a * TableSize) * sqrtf(1.0f - a);
+			return x < 0.0f ? 3.14159265f - r : r;
+		}
+
+		/**
+		 * @return log2(x) for x > 0. Max error ~0.000004.
+		 */
+		float Log2(float x)
+		{
+			unsigned bits;
+			memcpy(&bits, &x, sizeof(bits));
+			int exponent = int((bits >> 23) & 0xFF) - 127;
+			float mantissa = float(bits & 0x7FFFFF) * (float(TableSize) / float(1 << 23));
+			return float(exponent) + Lookup(Log2Table, mantissa);
+		}
+
+		/**
+		 * @return 2^x, x is clamped to [-126, 127]. Max relative error ~0.000002.
+		 */
+		float Exp2(float x)
+		{
+			if (x < -126.0f) x = -126.0f;
+			else if (x > 127.0f) x = 127.0f;
+			float fi = floorf(x);
+			unsigned bits = unsigned(int(fi) + 127) << 23;
+			float scale;
+			memcpy(&scale, &bits, sizeof(scale));
+			return scale * Lookup(Exp2Table, (x - fi) * TableSize);
+		}
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// Attenuation impl
+	//
+
+#pragma region Attenuation
+
+	/**
+	 * Creates inverse distance attenuation with ReferenceDistance 1, RolloffFactor 1,
+	 * unlimited MaxDistance and an omnidirectional cone
+	 */
+	Attenuation::Attenuation()
+		: model(INVERSE_DISTANCE), refDistance(1.0f), rolloff(1.0f), maxDistance(FLT_MAX),
+		coneInner(360.0f), coneOuter(360.0f), coneOuterGain(1.0f)
+	{
+		Update();
+	}
+
+	void Attenuation::Model(AttenuationModel value)
+	{
+		model = value;
+	}
+
+	void Attenuation::ReferenceDistance(float refdist)
+	{
+		refDistance = refdist < 0.0f ? 0.0f : refdist;
+		Update();
+	}
+
+	void Attenuation::RolloffFactor(float value)
+	{
+		rolloff = value < 0.0f ? 0.0f : value;
+		Update();
+	}
+
+	void Attenuation::MaxDistance(float maxdist)
+	{
+		maxDistance = maxdist < 0.0f ? 0.0f : maxdist;
+		Update();
+	}
+
+	void Attenuation::ConeInnerAngle(float degrees)
+	{
+		coneInner = degrees < 0.0f ? 0.0f : (degrees > 360.0f ? 360.0f : degrees);
+		if (coneOuter < coneInner) coneOuter = coneInner;
+		Update();
+	}
+
+	void Attenuation::ConeOuterAngle(float degrees)
+	{
+		coneOuter = degrees < coneInner ? coneInner : (degrees > 360.0f ? 360.0f : degrees);
+		Update();
+	}
+
+	void Attenuation::ConeOuterGain(float gain)
+	{
+		coneOuterGain = gain < 0.0f ? 0.0f : (gain > 1.0f ? 1.0f : gain);
+	}
+
+	/**
+	 * [internal] Recalculates the derived values after a parameter change
+	 */
+	void Attenuation::Update()
+	{
+		linearScale = maxDistance > refDistance && maxDistance != FLT_MAX ? rolloff / (maxDistance - refDistance) : 0.0f;
+
+		const float degToHalfRad = 3.14159265f / 360.0f;
+		halfInner = coneInner * degToHalfRad;
+		float halfOuter = coneOuter * degToHalfRad;
+		cosInner = coneInner >= 360.0f ? -1.0f : cosf(halfInner);
+		cosOuter = coneOuter >= 360.0f ? -1.0f : cosf(halfOuter);
+		invConeSpan = halfOuter > halfInner ? 1.0f / (halfOuter - halfInner) : 0.0f;
+	}
+
+	/**
+	 * @param distance Distance between the emitter and the listener
+	 * @return Distance attenuation gain [0.0 - 1.0]
+	 */
+	float Attenuation::DistanceGain(float distance) const
+	{
+		if (distance < refDistance) distance = refDistance;
+		if (distance > maxDistance) distance = maxDistance;
+
+		switch (model)
+		{
+		case INVERSE_DISTANCE:
+			{
+				float denom = refDistance + rolloff * (distance - refDistance);
+				return denom > 0.0f ? refDistance / denom : 1.0f;
+			}
+		case LINEAR_DISTANCE:
+			{
+				float gain = 1.0f - linearScale * (distance - refDistance);
+				return gain > 0.0f ? gain : 0.0f;
+			}
+		case EXPONENT_DISTANCE:
+			return refDistance > 0.0f ? LUT::Pow(distance / refDistance, -rolloff) : 1.0f;
+		default:
+			return 1.0f;
+		}
+	}
+
+	/**
+	 * @param cosAngle Cosine of the angle between the emitter front and the direction to the listener
+	 * @return Cone attenuation gain
+	 */
+	float Attenuation::ConeGain(float cosAngle) const
+	{
+		if (cosAngle >= cosInner) return 1.0f;
+		if (cosAngle <= cosOuter) return coneOuterGain;
+		float t = (LUT::Acos(cosAngle) - halfInner) * invConeSpan; // gain is linear in angle between the cones
+		return 1.0f + (coneOuterGain - 1.0f) * t;
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// FalloffCurve impl
+	//
+
+#pragma region FalloffCurve
+
+	/**
+	 * Bakes a new curve
+	 * @param points Curve points, sorted by distance. The first point's value holds before it.
+	 * @param count Number of points, at least 1
+	 */
+	FalloffCurve::FalloffCurve(const CurvePoint* points, int count)
+	{
+		float end = count > 0 ? points[count - 1].distance : 0.0f;
+		scale = end > 0.0f ? Resolution / end : 0.0f;
+
+		int p = 0;
+		for (int i = 0; i <= Resolution; ++i)
+		{
+			if (count <= 0) { table[i] = 1.0f; continue; }
+
+			float d = end * i / Resolution;
+			while (p < count - 1 && points[p + 1].distance <= d)
+				++p;
+			if (p == count - 1 || d <= points[p].distance)
+				table[i] = points[p].value;
+			else
+			{
+				const CurvePoint& a = points[p];
+				const CurvePoint& b = points[p + 1];
+				table[i] = a.value + (b.value - a.value) * (d - a.distance) / (b.distance - a.distance);
+			}
+		}
+		table[Resolution + 1] = table[Resolution];
+	}
+
+	/**
+	 * @param distance Distance from the listener
+	 * @return Curve value at the specified distance
+	 */
+	float FalloffCurve::Evaluate(float distance) const
+	{
+		float x = distance * scale;
+		if (x > float(Resolution)) x = float(Resolution);
+		if (x < 0.0f) x = 0.0f;
+		int i = int(x);
+		return table[i] + (table[i + 1] - table[i]) * (x - float(i));
+	}
+
+	static const FalloffCurve xFlatCurve(nullptr, 0); // evaluates to 1.0 everywhere
+
+	/**
+	 * Evaluates the curves of many emitters at once, 4 emitters per SSE register.
+	 * Only the table reads are scalar.
+	 * @param curves [count] Curve of each emitter, NULL curves evaluate to 1.0
+	 * @param distances [count] Distance of each emitter from the listener
+	 * @param out [count] Receives the curve values
+	 * @param count Number of emitters
+	 */
+	void FalloffCurve::EvaluateBatch(const FalloffCurve* const* curves, const float* distances, float* out, int count)
+	{
+		const __m128 zero = _mm_setzero_ps();
+		const __m128 limit = _mm_set1_ps(float(Resolution));
+
+		int n = 0;
+		for (; n + 4 <= count; n += 4)
+		{
+			const FalloffCurve* c0 = curves[n + 0] ? curves[n + 0] : &xFlatCurve;
+			const FalloffCurve* c1 = curves[n + 1] ? curves[n + 1] : &xFlatCurve;
+			const FalloffCurve* c2 = curves[n + 2] ? curves[n + 2] : &xFlatCurve;
+			const FalloffCurve* c3 = curves[n + 3] ? curves[n + 3] : &xFlatCurve;
+
+			// table position of each emitter: clamp(distance * scale, 0, Resolution)
+			__m128 x = _mm_mul_ps(_mm_loadu_ps(distances + n), _mm_setr_ps(c0->scale, c1->scale, c2->scale, c3->scale));
+			x = _mm_min_ps(_mm_max_ps(x, zero), limit);
+			__m128i i = _mm_cvttps_epi32(x);
+			__m128 f = _mm_sub_ps(x, _mm_cvtepi32_ps(i));
+
+			__declspec(align(16)) int idx[4];
+			_mm_store_si128((__m128i*)idx, i);
+			__m128 a = _mm_setr_ps(c0->table[idx[0]],     c1->table[idx[1]],     c2->table[idx[2]],     c3->table[idx[3]]);
+			__m128 b = _mm_setr_ps(c0->table[idx[0] + 1], c1->table[idx[1] + 1], c2->table[idx[2] + 1], c3->table[idx[3] + 1]);
+
+			_mm_storeu_ps(out + n, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), f)));
+		}
+		for (; n < count; ++n)
+			out[n] = curves[n] ? curves[n]->Evaluate(distances[n]) : 1.0f;
+	}
+
+#pragma endregion
+
+} // namespace S3D
@@ -0,0 +1,200 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+namespace S3D {
+
+/**
+ * Distance attenuation models, clamped like their OpenAL counterparts:
+ * the distance is clamped to [ReferenceDistance, MaxDistance] before evaluation.
+ */
+enum AttenuationModel 
+{ 
+	NO_ATTENUATION,		// gain is always 1.0
+	INVERSE_DISTANCE,	// ref / (ref + rolloff * (d - ref))
+	LINEAR_DISTANCE,	// 1 - rolloff * (d - ref) / (max - ref)
+	EXPONENT_DISTANCE,	// (d / ref) ^ -rolloff
+};
+
+
+
+
+/**
+ * Fast table based approximations. The tables are generated once at load time.
+ */
+namespace LUT {
+
+	/**
+	 * @return acos(x) in radians, x is clamped to [-1, 1]. Max error ~0.000001 rad.
+	 */
+	float Acos(float x);
+
+	/**
+	 * @return log2(x) for x > 0. Max error ~0.000004.
+	 */
+	float Log2(float x);
+
+	/**
+	 * @return 2^x, x is clamped to [-126, 127]. Max relative error ~0.000002.
+	 */
+	float Exp2(float x);
+
+	/**
+	 * @return base^exponent for base > 0
+	 */
+	inline float Pow(float base, float exponent) { return Exp2(exponent * Log2(base)); }
+
+} // namespace LUT
+
+
+
+
+/**
+ * Distance and cone attenuation parameters of an emitter (OpenAL semantics).
+ * Setters precompute all derived values, so evaluation is a few
+ * multiplies and at most one table lookup per emitter.
+ */
+class Attenuation
+{
+protected:
+	AttenuationModel model;	// distance model
+	float refDistance;		// distance where gain is 1.0
+	float rolloff;			// rolloff factor
+	float maxDistance;		// distance after which there is no more attenuation
+	float coneInner;		// inner cone angle in degrees
+	float coneOuter;		// outer cone angle in degrees
+	float coneOuterGain;	// gain outside the outer cone
+
+	float linearScale;		// rolloff / (max - ref)
+	float cosInner;			// cos(inner / 2), no cone attenuation above this
+	float cosOuter;			// cos(outer / 2), full outer gain below this
+	float halfInner;		// inner / 2 in radians
+	float invConeSpan;		// 1 / (outer/2 - inner/2) in radians
+
+public:
+
+	/**
+	 * Creates inverse distance attenuation with ReferenceDistance 1, RolloffFactor 1,
+	 * unlimited MaxDistance and an omnidirectional cone
+	 */
+	Attenuation();
+
+	void Model(AttenuationModel model);
+	inline AttenuationModel Model() const { return model; }
+
+	void ReferenceDistance(float refdist);
+	inline float ReferenceDistance() const { return refDistance; }
+
+	void RolloffFactor(float rolloff);
+	inline float RolloffFactor() const { return rolloff; }
+
+	void MaxDistance(float maxdist);
+	inline float MaxDistance() const { return maxDistance; }
+
+	void ConeInnerAngle(float degrees);
+	inline float ConeInnerAngle() const { return coneInner; }
+
+	void ConeOuterAngle(float degrees);
+	inline float ConeOuterAngle() const { return coneOuter; }
+
+	void ConeOuterGain(float gain);
+	inline float ConeOuterGain() const { return coneOuterGain; }
+
+	/**
+	 * @return TRUE if the cone is not omnidirectional
+	 */
+	inline bool HasCone() const { return cosInner > -1.0f && coneOuterGain != 1.0f; }
+
+	/**
+	 * @param distance Distance between the emitter and the listener
+	 * @return Distance attenuation gain [0.0 - 1.0]
+	 */
+	float DistanceGain(float distance) const;
+
+	/**
+	 * @param cosAngle Cosine of the angle between the emitter front and the direction to the listener
+	 * @return Cone attenuation gain
+	 */
+	float ConeGain(float cosAngle) const;
+
+protected:
+
+	/**
+	 * [internal] Recalculates the derived values after a parameter change
+	 */
+	void Update();
+};
+
+
+
+
+
+/**
+ * A point of a piecewise-linear falloff curve
+ */
+struct CurvePoint
+{
+	float distance;		// distance from the listener in world units
+	float value;		// curve value at this distance
+};
+
+/**
+ * Piecewise-linear curve over distance, similar to X3DAUDIO_DISTANCE_CURVE but in world units.
+ * The points are baked into a fixed resolution table on creation, so evaluating
+ * a curve costs the same no matter how many points the designer used.
+ * Beyond the last point the last value holds.
+ */
+class FalloffCurve
+{
+public:
+	enum { Resolution = 64 };	// number of table segments
+
+protected:
+	float scale;					// Resolution / distance of the last point
+	float table[Resolution + 2];	// baked values, +1 end point, +1 padding for lerping at the end
+
+public:
+
+	/**
+	 * Bakes a new curve
+	 * @param points Curve points, sorted by distance. The first point's value holds before it.
+	 * @param count Number of points, at least 1
+	 */
+	FalloffCurve(const CurvePoint* points, int count);
+
+	/**
+	 * @param distance Distance from the listener
+	 * @return Curve value at the specified distance
+	 */
+	float Evaluate(float distance) const;
+
+	/**
+	 * Evaluates the curves of many emitters at once, 4 emitters per SSE register.
+	 * Only the table reads are scalar.
+	 * @param curves [count] Curve of each emitter, NULL curves evaluate to 1.0
+	 * @param distances [count] Distance of each emitter from the listener
+	 * @param out [count] Receives the curve values
+	 * @param count Number of emitters
+	 */
+	static void EvaluateBatch(const FalloffCurve* const* curves, const float* distances, float* out, int count);
+};
+
+} // namespace S3D
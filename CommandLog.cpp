@@ -0,0 +1,557 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Sound3D.h"
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <map>
+
+#ifdef _DEBUG
+	#define indebug(x) x
+#else
+	#define indebug(x) // do nothing in release
+#endif
+
+namespace S3D
+{
+
+	// Recording file layout: "S3DR" u32 version, then one record per call:
+	// [varint64 microseconds since the previous record][u8 op][varint object][varint target]
+	// [varint zigzag value][u8 numArgs][numArgs * f32][load and curve commands: varint length, path or points]
+	// Version 1 wrote the time as a 32-bit varint, which reads the same as a varint64.
+	static const char RecordingMagic[4] = { 'S', '3', 'D', 'R' };
+	static const unsigned RecordingVersion = 2;
+	static const int MaxArgs = 6;
+
+	/**
+	 * @return TRUE if the record of this call carries a path or curve points
+	 */
+	static inline bool HasData(CommandOp op)
+	{
+		return op == COMMAND_BUFFER_LOAD || op == COMMAND_BUFFER_CURVE;
+	}
+
+
+	static inline void PutVarint(std::vector<unsigned char>& out, unsigned value)
+	{
+		for (; value >= 0x80; value >>= 7)
+			out.push_back((unsigned char)(value | 0x80));
+		out.push_back((unsigned char)value);
+	}
+
+	static inline bool GetVarint(const unsigned char*& p, const unsigned char* end, unsigned& value)
+	{
+		value = 0;
+		for (int shift = 0; p < end && shift < 35; shift += 7)
+		{
+			const unsigned char c = *p++;
+			value |= unsigned(c & 0x7F) << shift;
+			if (!(c & 0x80)) return true;
+		}
+		return false;
+	}
+
+	// time deltas are 64-bit, an idle session can go longer than 71 minutes between two calls
+	static inline void PutVarint64(std::vector<unsigned char>& out, unsigned long long value)
+	{
+		for (; value >= 0x80; value >>= 7)
+			out.push_back((unsigned char)(value | 0x80));
+		out.push_back((unsigned char)value);
+	}
+
+	static inline bool GetVarint64(const unsigned char*& p, const unsigned char* end, unsigned long long& value)
+	{
+		value = 0;
+		for (int shift = 0; p < end && shift < 70; shift += 7)
+		{
+			const unsigned char c = *p++;
+			value |= (unsigned long long)(c & 0x7F) << shift;
+			if (!(c & 0x80)) return true;
+		}
+		return false;
+	}
+
+
+#pragma region CommandRecorder
+
+	/**
+	 * Recording state, shared by all threads that call the API
+	 */
+	static struct RecorderState
+	{
+		CRITICAL_SECTION cs;
+		FILE* file;									// open recording, NULL if not recording
+		std::vector<unsigned char> buffer;			// records not yet written to the file
+		std::map<const void*, unsigned> ids;		// replay ids of the recorded objects
+		unsigned nextId;							// next replay id, 0 is the Listener / none
+		LONGLONG lastTicks;							// QPC time of the previous record
+		LONGLONG ticksPerSecond;
+		volatile bool recording;
+
+		RecorderState() : file(nullptr), nextId(1), lastTicks(0), ticksPerSecond(1), recording(false)
+		{
+			InitializeCriticalSection(&cs);
+		}
+		~RecorderState()
+		{
+			CommandRecorder::Stop(); // flush the recording of a program that never stopped it
+			DeleteCriticalSection(&cs);
+		}
+
+		void Flush()
+		{
+			if (file && !buffer.empty())
+				fwrite(buffer.data(), 1, buffer.size(), file);
+			buffer.clear();
+		}
+	} xRecorder;
+
+
+	/**
+	 * Starts recording into the specified file, an existing recording is stopped first
+	 * @param file Path of the recording, usually *.s3dr
+	 * @return FALSE if the file can't be created
+	 */
+	bool CommandRecorder::Start(const char* file)
+	{
+		Stop();
+		FILE* f = fopen(file, "wb");
+		if (!f)
+			return false;
+		fwrite(RecordingMagic, 1, 4, f);
+		fwrite(&RecordingVersion, 4, 1, f);
+
+		EnterCriticalSection(&xRecorder.cs);
+		LARGE_INTEGER t;
+		QueryPerformanceFrequency(&t);
+		xRecorder.ticksPerSecond = t.QuadPart;
+		QueryPerformanceCounter(&t);
+		xRecorder.lastTicks = t.QuadPart;
+		xRecorder.file = f;
+		xRecorder.nextId = 1;
+		xRecorder.ids.clear();
+		xRecorder.buffer.reserve(64 * 1024);
+		xRecorder.recording = true;
+		LeaveCriticalSection(&xRecorder.cs);
+		indebug(printf("CommandRecorder: recording to %s\n", file));
+		return true;
+	}
+
+	/**
+	 * Stops recording and closes the file
+	 */
+	void CommandRecorder::Stop()
+	{
+		EnterCriticalSection(&xRecorder.cs);
+		if (xRecorder.file)
+		{
+			xRecorder.recording = false;
+			xRecorder.buffer.push_back(0); // dt
+			xRecorder.buffer.push_back(COMMAND_END);
+			xRecorder.Flush();
+			fclose(xRecorder.file);
+			xRecorder.file = nullptr;
+			xRecorder.ids.clear();
+		}
+		LeaveCriticalSection(&xRecorder.cs);
+	}
+
+	/**
+	 * @return TRUE while recording
+	 */
+	bool CommandRecorder::IsRecording()
+	{
+		return xRecorder.recording;
+	}
+
+
+	/**
+	 * [internal] Records a public API call, if the CommandRecorder is running.
+	 * Create and load commands give the object a replay id, destroy commands release it.
+	 * @param op Recorded call
+	 * @param object Object of the call, NULL for the Listener and global calls
+	 * @param target [optional] SoundBuffer argument, NULL for none
+	 * @param value [optional] Integer argument
+	 * @param args [optional] Float arguments
+	 * @param numArgs [optional] Number of float arguments, up to 6
+	 * @param data [optional] File path of a load command, CurvePoints of a curve command
+	 * @param dataSize [optional] Size of the data in bytes
+	 */
+	void RecordCommand(CommandOp op, const void* object, const SoundBuffer* target, int value, 
+					   const float* args, int numArgs, const void* data, int dataSize)
+	{
+		if (!xRecorder.recording)
+			return;
+		EnterCriticalSection(&xRecorder.cs);
+		if (!xRecorder.file)
+		{
+			LeaveCriticalSection(&xRecorder.cs);
+			return;
+		}
+
+		std::map<const void*, unsigned>& ids = xRecorder.ids;
+		const bool creates = op == COMMAND_BUFFER_LOAD || op == COMMAND_CREATE_SOUND || 
+							 op == COMMAND_CREATE_SOUND3D || op == COMMAND_ZONE_CREATE;
+		unsigned objectId = 0, targetId = 0;
+		bool known = true;
+		if (object)
+		{
+			std::map<const void*, unsigned>::iterator it = ids.find(object);
+			if (it != ids.end())
+				objectId = it->second;
+			else if (creates)
+				objectId = ids[object] = xRecorder.nextId++;
+			else
+				known = false; // created before the recording started, it can't be replayed
+		}
+		if (target)
+		{
+			std::map<const void*, unsigned>::iterator it = ids.find(target);
+			if (it != ids.end()) targetId = it->second;
+			else known = false;
+		}
+
+		if (known)
+		{
+			LARGE_INTEGER t;
+			QueryPerformanceCounter(&t);
+			const LONGLONG ticks = t.QuadPart - xRecorder.lastTicks, tps = xRecorder.ticksPerSecond;
+			const LONGLONG micros = ticks / tps * 1000000 + ticks % tps * 1000000 / tps; // no overflow on long gaps
+			xRecorder.lastTicks += micros / 1000000 * tps + micros % 1000000 * tps / 1000000; // keep the remainder
+			if (numArgs > MaxArgs) numArgs = MaxArgs;
+
+			std::vector<unsigned char>& out = xRecorder.buffer;
+			PutVarint64(out, (unsigned long long)micros);
+			out.push_back((unsigned char)op);
+			PutVarint(out, objectId);
+			PutVarint(out, targetId);
+			PutVarint(out, unsigned(value << 1) ^ unsigned(value >> 31)); // zigzag, small negatives stay small
+			out.push_back((unsigned char)numArgs);
+			const unsigned char* a = (const unsigned char*)args;
+			out.insert(out.end(), a, a + numArgs * sizeof(float));
+			if (HasData(op))
+			{
+				const unsigned length = data && dataSize > 0 ? (unsigned)dataSize : 0;
+				PutVarint(out, length);
+				out.insert(out.end(), (const unsigned char*)data, (const unsigned char*)data + length);
+			}
+			if (out.size() >= 60 * 1024)
+				xRecorder.Flush();
+		}
+		if (object && (op == COMMAND_DESTROY || op == COMMAND_BUFFER_DESTROY || op == COMMAND_ZONE_DESTROY))
+			ids.erase(object); // the address may be reused by a new object
+		LeaveCriticalSection(&xRecorder.cs);
+	}
+
+#pragma endregion
+
+
+
+
+#pragma region CommandReplay
+
+	/**
+	 * A decoded record
+	 */
+	struct ReplayCommand
+	{
+		double time;				// recording time in seconds
+		CommandOp op;
+		unsigned object;			// replay id of the object
+		unsigned target;			// replay id of the SoundBuffer argument
+		int value;
+		int numArgs;
+		float args[MaxArgs];
+		std::string data;			// path of a load command, CurvePoints of a curve command
+	};
+
+	/**
+	 * Recording data and replayed objects of a CommandReplay
+	 */
+	struct ReplayState
+	{
+		std::vector<ReplayCommand> commands;
+		size_t next;								// index of the next command
+		std::map<unsigned, SoundBuffer*> buffers;
+		std::map<unsigned, Sound*> sounds;
+		std::map<unsigned, Sound3D*> sounds3D;
+		std::map<unsigned, ReverbZone*> zones;
+
+		ReplayState() : next(0) {}
+		~ReplayState()
+		{
+			for (auto& it : sounds)   delete it.second; // objects before the buffers they play
+			for (auto& it : sounds3D) delete it.second;
+			for (auto& it : zones)    delete it.second;
+			for (auto& it : buffers)  delete it.second;
+		}
+
+		SoundObject* Object(unsigned id)
+		{
+			std::map<unsigned, Sound*>::iterator s = sounds.find(id);
+			if (s != sounds.end()) return s->second;
+			std::map<unsigned, Sound3D*>::iterator s3 = sounds3D.find(id);
+			return s3 != sounds3D.end() ? s3->second : nullptr;
+		}
+
+		template<class T> static T* Find(std::map<unsigned, T*>& objects, unsigned id)
+		{
+			typename std::map<unsigned, T*>::iterator it = objects.find(id);
+			return it != objects.end() ? it->second : nullptr;
+		}
+
+		template<class T> static void Destroy(std::map<unsigned, T*>& objects, unsigned id)
+		{
+			typename std::map<unsigned, T*>::iterator it = objects.find(id);
+			if (it != objects.end()) delete it->second, objects.erase(it);
+		}
+
+		void Execute(const ReplayCommand& c);
+	};
+
+
+	void ReplayState::Execute(const ReplayCommand& c)
+	{
+		SoundObject* obj = Object(c.object);
+		Sound3D* obj3D = Find(sounds3D, c.object);
+		ReverbZone* zone = Find(zones, c.object);
+		SoundBuffer* target = Find(buffers, c.target);
+		const float* a = c.args;
+		switch (c.op)
+		{
+		case COMMAND_BUFFER_LOAD:
+			{
+				SoundBuffer*& buffer = buffers[c.object];
+				if (!buffer) buffer = c.value ? new SoundStream() : new SoundBuffer();
+				if (c.numArgs < 4)
+					buffer->Load(c.data.c_str());
+				else
+					buffer->Load(c.data.c_str(), QualityProfile(int(a[0]), int(a[1]), int(a[2]), SampleCodec(int(a[3]))));
+				break;
+			}
+		case COMMAND_BUFFER_UNLOAD:  if (SoundBuffer* b = Find(buffers, c.object)) b->Unload(); break;
+		case COMMAND_BUFFER_DESTROY: Destroy(buffers, c.object); break;
+		case COMMAND_CREATE_SOUND:
+			Destroy(sounds, c.object), Destroy(sounds3D, c.object);
+			sounds[c.object] = new Sound(target, (c.value & 1) != 0, (c.value & 2) != 0);
+			break;
+		case COMMAND_CREATE_SOUND3D:
+			Destroy(sounds, c.object), Destroy(sounds3D, c.object);
+			sounds3D[c.object] = new Sound3D(target, (c.value & 1) != 0, (c.value & 2) != 0);
+			break;
+		case COMMAND_DESTROY:	Destroy(sounds, c.object), Destroy(sounds3D, c.object); break;
+		case COMMAND_SET_SOUND:	if (obj) obj->SetSound(target, c.value != 0); break;
+		case COMMAND_PLAY:		if (obj) obj->Play(); break;
+		case COMMAND_STOP:		if (obj) obj->Stop(); break;
+		case COMMAND_PAUSE:		if (obj) obj->Pause(); break;
+		case COMMAND_REWIND:	if (obj) obj->Rewind(); break;
+		case COMMAND_LOOPING:	if (obj) obj->Looping(c.value != 0); break;
+		case COMMAND_VOLUME:	if (obj && c.numArgs >= 1) obj->Volume(a[0]); break;
+		case COMMAND_SEEK:		if (obj) obj->PlaybackPos(c.value); break;
+		case COMMAND_POSITION:	if (obj3D && c.numArgs >= 3) obj3D->Position(a[0], a[1], a[2]); break;
+		case COMMAND_DIRECTION:	if (obj3D && c.numArgs >= 3) obj3D->Direction(a[0], a[1], a[2]); break;
+		case COMMAND_VELOCITY:	if (obj3D && c.numArgs >= 3) obj3D->Velocity(a[0], a[1], a[2]); break;
+		case COMMAND_RELATIVE:	if (obj3D) obj3D->Relative(c.value != 0); break;
+		case COMMAND_LISTENER_VOLUME:	if (c.numArgs >= 1) Listener::Volume(a[0]); break;
+		case COMMAND_LISTENER_POSITION:	if (c.numArgs >= 3) Listener::Position(a[0], a[1], a[2]); break;
+		case COMMAND_LISTENER_VELOCITY:	if (c.numArgs >= 3) Listener::Velocity(a[0], a[1], a[2]); break;
+		case COMMAND_LISTENER_LOOKAT:	if (c.numArgs >= 6) Listener::LookAt(a[0], a[1], a[2], a[3], a[4], a[5]); break;
+		case COMMAND_ZONE_CREATE:		Destroy(zones, c.object); zones[c.object] = new ReverbZone(c.value); break;
+		case COMMAND_ZONE_DESTROY:		Destroy(zones, c.object); break;
+		case COMMAND_ZONE_POSITION:		if (zone && c.numArgs >= 3) zone->Position(a[0], a[1], a[2]); break;
+		case COMMAND_ZONE_RADIUS:		if (zone && c.numArgs >= 1) zone->Radius(a[0]); break;
+		case COMMAND_UPDATE:			Update(); break;
+		case COMMAND_BUFFER_CURVE:
+			if (SoundBuffer* b = Find(buffers, c.object))
+			{
+				const int count = int(c.data.size() / sizeof(CurvePoint));
+				const CurvePoint* points = count ? (const CurvePoint*)c.data.data() : nullptr;
+				if (c.value == 0)      b->VolumeCurve(points, count);
+				else if (c.value == 1) b->LowpassCurve(points, count);
+				else if (c.value == 2) b->ReverbCurve(points, count);
+			}
+			break;
+		case COMMAND_LISTENER_INTERPOLATION:	if (c.numArgs >= 1) Listener::Interpolation(a[0]); break;
+		case COMMAND_LISTENER_SPEED_OF_SOUND:	if (c.numArgs >= 1) Listener::SpeedOfSound(a[0]); break;
+		case COMMAND_LISTENER_PROPAGATION:		if (c.numArgs >= 1) Listener::PropagationBudget(a[0]); break;
+		case COMMAND_LISTENER_VIRTUAL:			if (c.numArgs >= 1) Listener::VirtualThreshold(a[0]); break;
+		case COMMAND_GOVERNOR_BUDGET:			if (c.numArgs >= 1) Governor::Budget(a[0]); break;
+		case COMMAND_PROPAGATION_DELAY:	if (obj3D) obj3D->PropagationDelay(c.value != 0); break;
+		case COMMAND_DISTANCE_MODEL:	if (obj3D) obj3D->DistanceModel(AttenuationModel(c.value)); break;
+		case COMMAND_MAX_DISTANCE:		if (obj3D && c.numArgs >= 1) obj3D->MaxDistance(a[0]); break;
+		case COMMAND_ROLLOFF_FACTOR:	if (obj3D && c.numArgs >= 1) obj3D->RolloffFactor(a[0]); break;
+		case COMMAND_REFERENCE_DISTANCE: if (obj3D && c.numArgs >= 1) obj3D->ReferenceDistance(a[0]); break;
+		case COMMAND_CONE_INNER_ANGLE:	if (obj3D && c.numArgs >= 1) obj3D->ConeInnerAngle(a[0]); break;
+		case COMMAND_CONE_OUTER_ANGLE:	if (obj3D && c.numArgs >= 1) obj3D->ConeOuterAngle(a[0]); break;
+		case COMMAND_CONE_OUTER_GAIN:	if (obj3D && c.numArgs >= 1) obj3D->ConeOuterGain(a[0]); break;
+		case COMMAND_ZONE_FALLOFF:		if (zone && c.numArgs >= 1) zone->Falloff(a[0]); break;
+		case COMMAND_ZONE_SEND_LEVEL:	if (zone && c.numArgs >= 1) zone->SendLevel(a[0]); break;
+		case COMMAND_STREAM_UNDERRUN:
+			if (SoundBuffer* b = Find(buffers, c.object))
+				if (b->IsStream() && c.numArgs >= 1) ((SoundStream*)b)->UnderrunProbability(a[0]);
+			break;
+		default: break;
+		}
+	}
+
+
+	CommandReplay::CommandReplay() : state(nullptr)
+	{
+	}
+
+	/**
+	 * Destroys all replayed objects
+	 */
+	CommandReplay::~CommandReplay()
+	{
+		Close();
+	}
+
+	/**
+	 * Loads a recording, any previous replay is closed
+	 * @param file Recording made by the CommandRecorder
+	 * @return FALSE if the file can't be read or isn't a recording
+	 */
+	bool CommandReplay::Open(const char* file)
+	{
+		Close();
+		FILE* f = fopen(file, "rb");
+		if (!f)
+			return false;
+		std::vector<unsigned char> data;
+		unsigned char chunk[64 * 1024];
+		for (size_t n; (n = fread(chunk, 1, sizeof(chunk), f)) > 0; )
+			data.insert(data.end(), chunk, chunk + n);
+		fclose(f);
+
+		unsigned version = 0;
+		if (data.size() < 8 || memcmp(data.data(), RecordingMagic, 4) || 
+			(memcpy(&version, &data[4], 4), (version != 1 && version != RecordingVersion)))
+			return false;
+
+		state = new ReplayState();
+		const unsigned char* p = data.data() + 8;
+		const unsigned char* end = data.data() + data.size();
+		double time = 0.0;
+		while (p < end)
+		{
+			ReplayCommand c;
+			unsigned long long micros;
+			unsigned op, value, length = 0;
+			if (!GetVarint64(p, end, micros) || p >= end)
+				break;
+			op = *p++;
+			if (op == COMMAND_END || op >= COMMAND_COUNT)
+				break;
+			if (!GetVarint(p, end, c.object) || !GetVarint(p, end, c.target) || !GetVarint(p, end, value) || p >= end)
+				break;
+			c.numArgs = *p++;
+			if (c.numArgs > MaxArgs || end - p < ptrdiff_t(c.numArgs * sizeof(float)))
+				break;
+			memcpy(c.args, p, c.numArgs * sizeof(float));
+			p += c.numArgs * sizeof(float);
+			if (HasData(CommandOp(op)))
+			{
+				if (!GetVarint(p, end, length) || unsigned(end - p) < length)
+					break;
+				c.data.assign((const char*)p, length);
+				p += length;
+			}
+			time += double(micros) * 0.000001;
+			c.time = time;
+			c.op = CommandOp(op);
+			c.value = int(value >> 1) ^ -int(value & 1);
+			state->commands.push_back(c);
+		}
+		indebug(printf("CommandReplay: %d commands, %.2fs in %s\n", (int)state->commands.size(), Duration(), file));
+		return true; // a truncated recording (the recording process crashed) replays up to the damage
+	}
+
+	/**
+	 * Destroys all replayed objects and frees the recording
+	 */
+	void CommandReplay::Close()
+	{
+		delete state;
+		state = nullptr;
+	}
+
+	/**
+	 * @return TRUE if all commands were executed, or nothing was opened
+	 */
+	bool CommandReplay::IsDone() const
+	{
+		return !state || state->next >= state->commands.size();
+	}
+
+	/**
+	 * @return Recording time of the next command in seconds
+	 */
+	double CommandReplay::NextTime() const
+	{
+		return IsDone() ? Duration() : state->commands[state->next].time;
+	}
+
+	/**
+	 * @return Recording time of the last command in seconds
+	 */
+	double CommandReplay::Duration() const
+	{
+		return state && !state->commands.empty() ? state->commands.back().time : 0.0;
+	}
+
+	/**
+	 * @return Number of commands executed so far
+	 */
+	int CommandReplay::Executed() const
+	{
+		return state ? (int)state->next : 0;
+	}
+
+	/**
+	 * Executes the next command
+	 * @return FALSE if the replay is done
+	 */
+	bool CommandReplay::Step()
+	{
+		if (IsDone())
+			return false;
+		state->Execute(state->commands[state->next++]);
+		return true;
+	}
+
+	/**
+	 * Executes all commands recorded up to the specified time
+	 * @param time Recording time in seconds
+	 * @return Number of executed commands
+	 */
+	int CommandReplay::Advance(double time)
+	{
+		int count = 0;
+		while (!IsDone() && state->commands[state->next].time <= time)
+			Step(), ++count;
+		return count;
+	}
+
+#pragma endregion
+
+} // namespace S3D
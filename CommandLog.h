@@ -0,0 +1,208 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+namespace S3D {
+
+class SoundBuffer;
+
+/**
+ * Public API calls recorded by the CommandRecorder
+ */
+enum CommandOp
+{
+	COMMAND_END,				// end of the recording
+	COMMAND_BUFFER_LOAD,		// SoundBuffer::Load, value: 1 for a SoundStream, args: QualityProfile
+	COMMAND_BUFFER_UNLOAD,		// SoundBuffer::Unload
+	COMMAND_BUFFER_DESTROY,		// SoundBuffer destructor
+	COMMAND_CREATE_SOUND,		// Sound constructor, target: SoundBuffer, value: 1 loop | 2 play
+	COMMAND_CREATE_SOUND3D,		// Sound3D constructor, target: SoundBuffer, value: 1 loop | 2 play
+	COMMAND_DESTROY,			// SoundObject destructor
+	COMMAND_SET_SOUND,			// SoundObject::SetSound, target: SoundBuffer, value: loop
+	COMMAND_PLAY,				// SoundObject::Play
+	COMMAND_STOP,				// SoundObject::Stop
+	COMMAND_PAUSE,				// SoundObject::Pause
+	COMMAND_REWIND,				// SoundObject::Rewind
+	COMMAND_LOOPING,			// SoundObject::Looping, value: looping
+	COMMAND_VOLUME,				// SoundObject::Volume, args: gain
+	COMMAND_SEEK,				// SoundObject::PlaybackPos, value: sample position
+	COMMAND_POSITION,			// Sound3D::Position, args: x y z
+	COMMAND_DIRECTION,			// Sound3D::Direction, args: x y z
+	COMMAND_VELOCITY,			// Sound3D::Velocity, args: x y z
+	COMMAND_RELATIVE,			// Sound3D::Relative, value: relative
+	COMMAND_LISTENER_VOLUME,	// Listener::Volume, args: gain
+	COMMAND_LISTENER_POSITION,	// Listener::Position, args: x y z
+	COMMAND_LISTENER_VELOCITY,	// Listener::Velocity, args: x y z
+	COMMAND_LISTENER_LOOKAT,	// Listener::LookAt, args: target xyz, up xyz
+	COMMAND_ZONE_CREATE,		// ReverbZone constructor, value: number of lines
+	COMMAND_ZONE_DESTROY,		// ReverbZone destructor
+	COMMAND_ZONE_POSITION,		// ReverbZone::Position, args: x y z
+	COMMAND_ZONE_RADIUS,		// ReverbZone::Radius, args: radius
+	COMMAND_UPDATE,				// Update()
+	COMMAND_BUFFER_CURVE,		// SoundBuffer::VolumeCurve, LowpassCurve, ReverbCurve, value: 0 volume | 1 lowpass | 2 reverb, data: points
+	COMMAND_LISTENER_INTERPOLATION,	// Listener::Interpolation, args: delay
+	COMMAND_LISTENER_SPEED_OF_SOUND,// Listener::SpeedOfSound, args: units per second
+	COMMAND_LISTENER_PROPAGATION,	// Listener::PropagationBudget, args: seconds
+	COMMAND_LISTENER_VIRTUAL,		// Listener::VirtualThreshold, args: gain
+	COMMAND_GOVERNOR_BUDGET,		// Governor::Budget, args: milliseconds
+	COMMAND_PROPAGATION_DELAY,	// Sound3D::PropagationDelay, value: enable
+	COMMAND_DISTANCE_MODEL,		// Sound3D::DistanceModel, value: AttenuationModel
+	COMMAND_MAX_DISTANCE,		// Sound3D::MaxDistance, args: distance
+	COMMAND_ROLLOFF_FACTOR,		// Sound3D::RolloffFactor, args: rolloff
+	COMMAND_REFERENCE_DISTANCE,	// Sound3D::ReferenceDistance, args: distance
+	COMMAND_CONE_INNER_ANGLE,	// Sound3D::ConeInnerAngle, args: degrees
+	COMMAND_CONE_OUTER_ANGLE,	// Sound3D::ConeOuterAngle, args: degrees
+	COMMAND_CONE_OUTER_GAIN,	// Sound3D::ConeOuterGain, args: gain
+	COMMAND_ZONE_FALLOFF,		// ReverbZone::Falloff, args: distance
+	COMMAND_ZONE_SEND_LEVEL,	// ReverbZone::SendLevel, args: level
+	COMMAND_STREAM_UNDERRUN,	// SoundStream::UnderrunProbability, args: probability
+	COMMAND_COUNT,
+};
+
+
+
+
+/**
+ * Records the public API calls listed in CommandOp with a timestamp into a compact binary file,
+ * so a field capture can be replayed (CommandReplay, Render tool) and profiled under identical load.
+ *
+ * Objects are given replay ids when they are created or loaded while recording, calls on
+ * objects that existed before Start() are not recorded. Start recording before loading.
+ * SoundBuffer::DefaultQuality is captured by the profile of each recorded load. Listener::Effects
+ * and EffectChains are not recorded: the effects are host code, set them up again before replaying.
+ * The process settings AudioThreads, SoundBuffer::CacheDirectory, SharedMemory and ResidentMemory
+ * are not recorded either, they belong to the machine that replays.
+ * Calls made from inside other API calls (Play rewinding a playing sound) are not recorded,
+ * the replayed outer call makes them again.
+ */
+class CommandRecorder
+{
+public:
+	/**
+	 * Starts recording into the specified file, an existing recording is stopped first
+	 * @param file Path of the recording, usually *.s3dr
+	 * @return FALSE if the file can't be created
+	 */
+	static bool Start(const char* file);
+
+	/**
+	 * Stops recording and closes the file
+	 */
+	static void Stop();
+
+	/**
+	 * @return TRUE while recording
+	 */
+	static bool IsRecording();
+};
+
+
+
+
+/**
+ * Recording data and replayed objects of a CommandReplay
+ */
+struct ReplayState;
+
+/**
+ * Replays a CommandRecorder recording in the current Engine. All recorded objects
+ * are created by the replay and destroyed when it's closed.
+ */
+class CommandReplay
+{
+	ReplayState* state;					// the recording and the replayed objects
+
+	CommandReplay(const CommandReplay&);	// not copyable
+	CommandReplay& operator=(const CommandReplay&);
+public:
+
+	CommandReplay();
+
+	/**
+	 * Destroys all replayed objects
+	 */
+	~CommandReplay();
+
+	/**
+	 * Loads a recording, any previous replay is closed
+	 * @param file Recording made by the CommandRecorder
+	 * @return FALSE if the file can't be read or isn't a recording
+	 */
+	bool Open(const char* file);
+
+	/**
+	 * Destroys all replayed objects and frees the recording
+	 */
+	void Close();
+
+	/**
+	 * @return TRUE if all commands were executed, or nothing was opened
+	 */
+	bool IsDone() const;
+
+	/**
+	 * @return Recording time of the next command in seconds
+	 */
+	double NextTime() const;
+
+	/**
+	 * @return Recording time of the last command in seconds
+	 */
+	double Duration() const;
+
+	/**
+	 * @return Number of commands executed so far
+	 */
+	int Executed() const;
+
+	/**
+	 * Executes the next command
+	 * @return FALSE if the replay is done
+	 */
+	bool Step();
+
+	/**
+	 * Executes all commands recorded up to the specified time
+	 * @param time Recording time in seconds
+	 * @return Number of executed commands
+	 */
+	int Advance(double time);
+};
+
+
+
+
+/**
+ * [internal] Records a public API call, if the CommandRecorder is running.
+ * Create and load commands give the object a replay id, destroy commands release it.
+ * @param op Recorded call
+ * @param object Object of the call, NULL for the Listener and global calls
+ * @param target [optional] SoundBuffer argument, NULL for none
+ * @param value [optional] Integer argument
+ * @param args [optional] Float arguments
+ * @param numArgs [optional] Number of float arguments, up to 6
+ * @param data [optional] File path of a load command, CurvePoints of a curve command
+ * @param dataSize [optional] Size of the data in bytes
+ */
+void RecordCommand(CommandOp op, const void* object, const SoundBuffer* target = nullptr, int value = 0, 
+				   const float* args = nullptr, int numArgs = 0, const void* data = nullptr, int dataSize = 0);
+
+} // namespace S3D
@@ -0,0 +1,816 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "PCMCache.h"
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>	// CreateFile, GetFileTime
+#include <intrin.h>		// _BitScanReverse
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef _DEBUG
+	#define indebug(x) x
+#else
+	#define indebug(x) // do nothing in release
+#endif
+
+namespace S3D
+{
+
+	static const int BlockFrames = 4096;	// frames per block, LPC coefficients are chosen per block
+	static const int PartitionSize = 256;	// samples per Rice parameter
+	static const int MaxOrder = 8;			// max LPC order, also the history kept between blocks
+	static const int CoefBits = 11;			// signed LPC coefficient precision, keeps 17-bit * coef * 8 in 32 bits
+	static const int EscapeZeros = 24;		// unary prefix length that escapes to a raw 32-bit value
+
+
+	//////
+	// Bit I/O
+	//
+
+#pragma region BitIO
+
+	/**
+	 * MSB first bit writer
+	 */
+	struct BitWriter
+	{
+		unsigned char* out;
+		unsigned char* end;
+		unsigned long long acc;	// pending bits in the low end
+		int bits;				// number of pending bits
+
+		inline BitWriter(void* dst, int size) : out((unsigned char*)dst), end((unsigned char*)dst + size), acc(0), bits(0) {}
+
+		/**
+		 * Writes the low n bits of value (n <= 32)
+		 */
+		inline void Put(unsigned value, int n)
+		{
+			acc = (acc << n) | value;
+			bits += n;
+			while (bits >= 8) {
+				bits -= 8;
+				if (out < end) *out = (unsigned char)(acc >> bits);
+				++out; // overflow is detected in Flush()
+			}
+		}
+
+		/**
+		 * Writes an unsigned Rice code with parameter k
+		 */
+		inline void Rice(unsigned u, int k)
+		{
+			unsigned q = u >> k;
+			if (q < (unsigned)EscapeZeros) {
+				Put(1, q + 1); // q zeros and a stop bit
+				if (k) Put(u & ((1u << k) - 1), k);
+			} else {
+				Put(0, EscapeZeros);
+				Put(u, 32);
+			}
+		}
+
+		/**
+		 * Pads the last byte with zeros
+		 * @return Number of bytes written, 0 if the destination overflowed
+		 */
+		inline int Flush(unsigned char* start)
+		{
+			if (bits) Put(0, 8 - bits);
+			return out <= end ? int(out - start) : 0;
+		}
+	};
+
+	/**
+	 * MSB first bit reader, reads zeros past the end of the data
+	 */
+	struct BitReader
+	{
+		const unsigned char* in;
+		const unsigned char* end;
+		unsigned long long acc;	// next bits, aligned to the top
+		int bits;				// number of valid bits in acc
+
+		inline BitReader(const void* src, int size) : in((const unsigned char*)src), end((const unsigned char*)src + size), acc(0), bits(0) {}
+
+		/**
+		 * Tops up the bit buffer to at least 56 bits
+		 */
+		inline void Refill()
+		{
+			if (in + 8 <= end) { // branchless 8 byte refill, bytes past the new count are read again next time
+				acc |= _byteswap_uint64(*(const unsigned long long*)in) >> bits;
+				in += (63 - bits) >> 3;
+				bits |= 56;
+				return;
+			}
+			while (bits < 56) {
+				unsigned long long b = in < end ? *in : 0;
+				++in;
+				acc |= b << (56 - bits);
+				bits += 8;
+			}
+		}
+
+		/**
+		 * Reads n bits (1 <= n <= 32) without refilling
+		 */
+		inline unsigned Take(int n)
+		{
+			unsigned v = unsigned(acc >> (64 - n));
+			acc <<= n;
+			bits -= n;
+			return v;
+		}
+
+		inline unsigned Get(int n)
+		{
+			Refill();
+			return Take(n);
+		}
+
+		/**
+		 * Reads an unsigned Rice code with parameter k
+		 */
+		inline unsigned Rice(int k)
+		{
+			Refill();
+			unsigned long top;
+			_BitScanReverse(&top, unsigned(acc >> 32) | (1u << (31 - EscapeZeros))); // caps the count at EscapeZeros
+			int zeros = 31 - int(top);
+			if (zeros < EscapeZeros) {
+				Take(zeros + 1);
+				return k ? (unsigned(zeros) << k) | Take(k) : unsigned(zeros);
+			}
+			Take(EscapeZeros);
+			return Take(32);
+		}
+
+		/**
+		 * @return TRUE if the reader went past the end of the data
+		 */
+		inline bool Overrun() const { return in - (bits >> 3) > end; }
+	};
+
+	static inline unsigned ZigZag(int v) { return unsigned(v << 1) ^ unsigned(v >> 31); }
+	static inline int UnZigZag(unsigned u) { return int(u >> 1) ^ -int(u & 1); }
+
+#pragma endregion
+
+
+
+
+	//////
+	// Linear prediction
+	//
+
+#pragma region LPC
+
+	/**
+	 * Predictor of a single channel in a single block
+	 */
+	struct Predictor
+	{
+		int order;				// 0 (no prediction) to MaxOrder
+		int shift;				// fixed point shift of the coefficients
+		int coef[MaxOrder];		// coef[j] weights sample n - 1 - j
+	};
+
+	/**
+	 * Computes the residual of a block
+	 * @param x Samples of the block, with MaxOrder samples of history before x[0]
+	 */
+	static void Residual(const int* x, int n, const Predictor& p, int* res)
+	{
+		for (int i = 0; i < n; ++i)
+		{
+			int sum = 0;
+			for (int j = 0; j < p.order; ++j)
+				sum += p.coef[j] * x[i - 1 - j];
+			res[i] = x[i] - (sum >> p.shift);
+		}
+	}
+
+	/**
+	 * Quantizes LPC coefficients to CoefBits signed integers
+	 */
+	static void Quantize(const double* lpc, int order, Predictor& p)
+	{
+		double cmax = 0.0;
+		for (int j = 0; j < order; ++j)
+			if (fabs(lpc[j]) > cmax) cmax = fabs(lpc[j]);
+		const int qmax = (1 << (CoefBits - 1)) - 1;
+		int shift = 15;
+		while (shift > 0 && cmax * (1 << shift) > qmax)
+			--shift;
+		p.order = order;
+		p.shift = shift;
+		for (int j = 0; j < order; ++j)
+		{
+			int q = int(floor(lpc[j] * (1 << shift) + 0.5));
+			p.coef[j] = q < -qmax - 1 ? -qmax - 1 : q > qmax ? qmax : q;
+		}
+	}
+
+	/**
+	 * Finds the predictor with the smallest residual for a block
+	 * @param x Samples of the block, with MaxOrder samples of history before x[0]
+	 * @param res [n] scratch for the residual
+	 */
+	static void ChoosePredictor(const int* x, int n, int* res, Predictor& best)
+	{
+		// autocorrelation of the Welch windowed block
+		double r[MaxOrder + 1] = { 0 };
+		double* w = (double*)malloc(n * sizeof(double));
+		for (int i = 0; i < n; ++i)
+		{
+			double t = (2.0 * i - (n - 1)) / (n + 1);
+			w[i] = x[i] * (1.0 - t * t);
+		}
+		for (int lag = 0; lag <= MaxOrder; ++lag)
+			for (int i = lag; i < n; ++i)
+				r[lag] += w[i] * w[i - lag];
+		free(w);
+
+		best.order = 0;
+		best.shift = 0;
+		long long bestCost = 0;
+		for (int i = 0; i < n; ++i)
+			bestCost += abs(x[i]);
+		if (r[0] <= 0.0)
+			return; // silence
+
+		// Levinson-Durbin, keeping the candidate orders 1, 2, 4 and 8
+		double lpc[MaxOrder] = { 0 }, tmp[MaxOrder];
+		double err = r[0] * (1.0 + 1e-9); // tiny lag window against ill conditioned blocks
+		for (int m = 0; m < MaxOrder; ++m)
+		{
+			double acc = r[m + 1];
+			for (int j = 0; j < m; ++j)
+				acc -= lpc[j] * r[m - j];
+			double k = acc / err;
+			for (int j = 0; j < m; ++j)
+				tmp[j] = lpc[j] - k * lpc[m - 1 - j];
+			for (int j = 0; j < m; ++j)
+				lpc[j] = tmp[j];
+			lpc[m] = k;
+			err *= (1.0 - k * k);
+			if (err <= 0.0)
+				break;
+
+			const int order = m + 1;
+			if (order == 1 || order == 2 || order == 4 || order == 8)
+			{
+				Predictor p;
+				Quantize(lpc, order, p);
+				Residual(x, n, p, res);
+				long long cost = 0;
+				for (int i = 0; i < n; ++i)
+					cost += abs(res[i]);
+				if (cost < bestCost)
+					best = p, bestCost = cost;
+			}
+		}
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// Codec
+	//
+
+#pragma region Codec
+
+	/**
+	 * Reads sample i of channel c as a signed integer. Stereo is stored as mid/side.
+	 */
+	static inline int Sample(const void* pcm, const PCMFormat& fmt, int i, int c)
+	{
+		return fmt.bitsPerSample == 16 ? ((const short*)pcm)[i * fmt.channels + c]
+									   : ((const unsigned char*)pcm)[i * fmt.channels + c] - 128;
+	}
+
+	/**
+	 * @param frames Number of sample frames in pcm
+	 * @param fmt Format of the PCM data
+	 * @param dst Destination buffer
+	 * @param dstBytes Size of the destination buffer
+	 * @return Number of bytes written to dst, 0 if the result did not fit (incompressible data)
+	 */
+	int EncodeLossless(const void* pcm, int frames, const PCMFormat& fmt, void* dst, int dstBytes)
+	{
+		const int channels = fmt.channels;
+		if ((fmt.bitsPerSample != 8 && fmt.bitsPerSample != 16) || channels < 1 || channels > 8)
+			return 0;
+		const bool midSide = channels == 2;
+
+		// every channel keeps MaxOrder samples of history in front of the block
+		const int stride = MaxOrder + BlockFrames;
+		int* planes = (int*)calloc(channels * stride + BlockFrames, sizeof(int));
+		if (!planes) return 0;
+		int* res = planes + channels * stride;
+
+		BitWriter bw(dst, dstBytes);
+		for (int start = 0; start < frames; start += BlockFrames)
+		{
+			const int n = frames - start < BlockFrames ? frames - start : BlockFrames;
+			for (int c = 0; c < channels; ++c) // history of the previous block
+				memmove(planes + c * stride, planes + c * stride + BlockFrames, MaxOrder * sizeof(int));
+			for (int i = 0; i < n; ++i)
+			{
+				int* x = planes + MaxOrder + i;
+				if (midSide)
+				{
+					int l = Sample(pcm, fmt, start + i, 0), r = Sample(pcm, fmt, start + i, 1);
+					x[0] = (l + r) >> 1;	// mid
+					x[stride] = l - r;		// side
+				}
+				else for (int c = 0; c < channels; ++c)
+					x[c * stride] = Sample(pcm, fmt, start + i, c);
+			}
+
+			for (int c = 0; c < channels; ++c)
+			{
+				const int* x = planes + c * stride + MaxOrder;
+				Predictor p;
+				ChoosePredictor(x, n, res, p);
+				Residual(x, n, p, res);
+
+				bw.Put(p.order, 4);
+				if (p.order) {
+					bw.Put(p.shift, 4);
+					for (int j = 0; j < p.order; ++j)
+						bw.Put(p.coef[j] & ((1 << CoefBits) - 1), CoefBits);
+				}
+				for (int part = 0; part < n; part += PartitionSize)
+				{
+					const int count = n - part < PartitionSize ? n - part : PartitionSize;
+					unsigned long long sum = 0;
+					for (int i = 0; i < count; ++i)
+						sum += ZigZag(res[part + i]);
+					int k = 0; // 2^k close to the mean
+					while (k < 30 && ((unsigned long long)count << (k + 1)) < sum)
+						++k;
+					bw.Put(k, 5);
+					for (int i = 0; i < count; ++i)
+						bw.Rice(ZigZag(res[part + i]), k);
+				}
+			}
+			if (bw.out > bw.end)
+				break; // incompressible, no point in finishing
+		}
+		free(planes);
+		return bw.Flush((unsigned char*)dst);
+	}
+
+	/**
+	 * @param srcBytes Size of the encoded data
+	 * @param frames Number of sample frames to decode
+	 * @param fmt Format of the PCM data
+	 * @param dst Destination for interleaved samples, frames * fmt.BlockAlign() bytes
+	 * @return FALSE if the data is corrupt
+	 */
+	bool DecodeLossless(const void* src, int srcBytes, int frames, const PCMFormat& fmt, void* dst)
+	{
+		const int channels = fmt.channels;
+		if ((fmt.bitsPerSample != 8 && fmt.bitsPerSample != 16) || channels < 1 || channels > 8)
+			return false;
+		const bool midSide = channels == 2;
+		const int stride = MaxOrder + BlockFrames;
+		int* planes = (int*)calloc(channels * stride, sizeof(int));
+		if (!planes) return false;
+
+		BitReader br(src, srcBytes);
+		for (int start = 0; start < frames; start += BlockFrames)
+		{
+			const int n = frames - start < BlockFrames ? frames - start : BlockFrames;
+			for (int c = 0; c < channels; ++c)
+			{
+				int* x = planes + c * stride;
+				memmove(x, x + BlockFrames, MaxOrder * sizeof(int)); // history of the previous block
+				x += MaxOrder;
+
+				Predictor p;
+				p.order = br.Get(4);
+				p.shift = 0;
+				if (p.order > MaxOrder) { free(planes); return false; }
+				if (p.order) {
+					p.shift = br.Get(4);
+					for (int j = 0; j < p.order; ++j) // sign extend
+						p.coef[j] = int(br.Get(CoefBits) << (32 - CoefBits)) >> (32 - CoefBits);
+				}
+				for (int part = 0; part < n; part += PartitionSize)
+				{
+					const int count = n - part < PartitionSize ? n - part : PartitionSize;
+					const int k = br.Get(5);
+					int* y = x + part;
+					switch (p.order) // the common orders get unrolled loops
+					{
+					case 0:
+						for (int i = 0; i < count; ++i)
+							y[i] = UnZigZag(br.Rice(k));
+						break;
+					case 2:
+						for (int i = 0; i < count; ++i)
+							y[i] = UnZigZag(br.Rice(k)) + ((p.coef[0]*y[i-1] + p.coef[1]*y[i-2]) >> p.shift);
+						break;
+					case 8:
+						for (int i = 0; i < count; ++i)
+							y[i] = UnZigZag(br.Rice(k)) + ((p.coef[0]*y[i-1] + p.coef[1]*y[i-2] + p.coef[2]*y[i-3] + 
+															p.coef[3]*y[i-4] + p.coef[4]*y[i-5] + p.coef[5]*y[i-6] + 
+															p.coef[6]*y[i-7] + p.coef[7]*y[i-8]) >> p.shift);
+						break;
+					default:
+						for (int i = 0; i < count; ++i)
+						{
+							int sum = 0;
+							for (int j = 0; j < p.order; ++j)
+								sum += p.coef[j] * y[i - 1 - j];
+							y[i] = UnZigZag(br.Rice(k)) + (sum >> p.shift);
+						}
+					}
+				}
+			}
+
+			// interleave the block
+			const int* x0 = planes + MaxOrder;
+			if (fmt.bitsPerSample == 16)
+			{
+				short* out = (short*)dst + start * channels;
+				if (midSide) for (int i = 0; i < n; ++i)
+				{
+					int side = x0[stride + i];
+					int mid = (x0[i] << 1) | (side & 1);
+					out[i*2]     = short((mid + side) >> 1);
+					out[i*2 + 1] = short((mid - side) >> 1);
+				}
+				else for (int c = 0; c < channels; ++c)
+					for (int i = 0; i < n; ++i)
+						out[i * channels + c] = short(x0[c * stride + i]);
+			}
+			else
+			{
+				unsigned char* out = (unsigned char*)dst + start * channels;
+				if (midSide) for (int i = 0; i < n; ++i)
+				{
+					int side = x0[stride + i];
+					int mid = (x0[i] << 1) | (side & 1);
+					out[i*2]     = (unsigned char)(((mid + side) >> 1) + 128);
+					out[i*2 + 1] = (unsigned char)(((mid - side) >> 1) + 128);
+				}
+				else for (int c = 0; c < channels; ++c)
+					for (int i = 0; i < n; ++i)
+						out[i * channels + c] = (unsigned char)(x0[c * stride + i] + 128);
+			}
+			if (br.Overrun()) { free(planes); return false; }
+		}
+		free(planes);
+		return true;
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// Disk cache
+	//
+
+#pragma region Cache
+
+	/**
+	 * Header of a cache file, followed by the encoded data
+	 */
+	struct CacheHeader
+	{
+		char magic[4];					// "S3DC"
+		int version;					// CacheVersion
+		int sampleRate;
+		int bitsPerSample;
+		int channels;
+		int frames;
+		int encodedBytes;				// size of the data after the header, 0 if it's stored as raw PCM
+		int reserved;
+		unsigned long long sourceSize;	// size of the source file when the cache was written
+		unsigned long long sourceTime;	// last write time of the source file when the cache was written
+	};
+
+	static const int CacheVersion = 1;
+
+	/**
+	 * @return FNV-1a hash of a file path, case insensitive like the file system
+	 */
+	static unsigned long long PathHash(const char* file)
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for (const char* s = file; *s; ++s) {
+			char ch = (*s >= 'A' && *s <= 'Z') ? *s + 32 : *s == '/' ? '\\' : *s;
+			hash = (hash ^ (unsigned char)ch) * 1099511628211ULL;
+		}
+		return hash;
+	}
+
+	/**
+	 * Builds the cache file path: a hash of the source path in the cache directory
+	 */
+	static void CachePath(const char* dir, const char* file, char* path, int maxPath)
+	{
+		unsigned long long hash = PathHash(file);
+		_snprintf(path, maxPath, "%s\\%08x%08x.s3dc", dir, unsigned(hash >> 32), unsigned(hash));
+		path[maxPath - 1] = '\0';
+	}
+
+	/**
+	 * Gets the size and last write time of a file
+	 */
+	static bool SourceStamp(const char* file, unsigned long long* size, unsigned long long* time)
+	{
+		HANDLE fh = CreateFileA(file, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (fh == INVALID_HANDLE_VALUE) return false;
+		DWORD high = 0;
+		DWORD low = GetFileSize(fh, &high);
+		FILETIME written;
+		bool ok = GetFileTime(fh, NULL, NULL, &written) != 0;
+		CloseHandle(fh);
+		*size = ((unsigned long long)high << 32) | low;
+		*time = ((unsigned long long)written.dwHighDateTime << 32) | written.dwLowDateTime;
+		return ok;
+	}
+
+	/**
+	 * @param file Source sound file
+	 * @param headerBytes Number of bytes to reserve in front of the PCM data
+	 * @param fmt Receives the format of the PCM data
+	 * @param bytes Receives the size of the PCM data
+	 * @return malloc()-ed block of headerBytes + PCM data, NULL if the file is not cached or out of date
+	 */
+	void* LoadPCMCache(const char* dir, const char* file, int headerBytes, PCMFormat* fmt, int* bytes)
+	{
+		unsigned long long size, time;
+		if (!dir || !*dir || !SourceStamp(file, &size, &time))
+			return nullptr;
+
+		char path[MAX_PATH];
+		CachePath(dir, file, path, sizeof(path));
+		HANDLE fh = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (fh == INVALID_HANDLE_VALUE) return nullptr; // not cached yet
+
+		CacheHeader hdr;
+		DWORD read = 0;
+		void* result = nullptr;
+		if (ReadFile(fh, &hdr, sizeof(hdr), &read, NULL) && read == sizeof(hdr) && 
+			!memcmp(hdr.magic, "S3DC", 4) && hdr.version == CacheVersion &&
+			hdr.sourceSize == size && hdr.sourceTime == time)
+		{
+			PCMFormat f(hdr.sampleRate, hdr.bitsPerSample, hdr.channels);
+			int pcmBytes = hdr.frames * f.BlockAlign();
+			int dataBytes = hdr.encodedBytes ? hdr.encodedBytes : pcmBytes;
+			char* block = (char*)malloc(headerBytes + pcmBytes);
+			void* data = hdr.encodedBytes ? malloc(dataBytes) : block + headerBytes;
+			if (block && data && ReadFile(fh, data, dataBytes, &read, NULL) && int(read) == dataBytes &&
+				(!hdr.encodedBytes || DecodeLossless(data, dataBytes, hdr.frames, f, block + headerBytes)))
+			{
+				*fmt = f;
+				*bytes = pcmBytes;
+				result = block;
+			}
+			else
+			{
+				indebug(printf("LoadPCMCache() corrupt cache entry %s for %s\n", path, file));
+				free(block);
+			}
+			if (hdr.encodedBytes) free(data);
+		}
+		CloseHandle(fh);
+		return result;
+	}
+
+	/**
+	 * @param file Source sound file
+	 * @param pcm Interleaved PCM data
+	 * @param bytes Size of the PCM data
+	 * @param fmt Format of the PCM data
+	 * @return TRUE if the cache entry was written
+	 */
+	bool StorePCMCache(const char* dir, const char* file, const void* pcm, int bytes, const PCMFormat& fmt)
+	{
+		CacheHeader hdr;
+		if (!dir || !*dir || !SourceStamp(file, &hdr.sourceSize, &hdr.sourceTime))
+			return false;
+		memcpy(hdr.magic, "S3DC", 4);
+		hdr.version = CacheVersion;
+		hdr.sampleRate = fmt.sampleRate;
+		hdr.bitsPerSample = fmt.bitsPerSample;
+		hdr.channels = fmt.channels;
+		hdr.frames = bytes / fmt.BlockAlign();
+		hdr.reserved = 0;
+
+		int bound = LosslessBound(hdr.frames, fmt);
+		void* encoded = malloc(bound);
+		hdr.encodedBytes = encoded ? EncodeLossless(pcm, hdr.frames, fmt, encoded, bound) : 0;
+		const void* data = hdr.encodedBytes ? encoded : pcm; // incompressible data is stored raw
+		int dataBytes = hdr.encodedBytes ? hdr.encodedBytes : hdr.frames * fmt.BlockAlign();
+
+		// write to a temporary file and rename, so a reader never sees a partial entry
+		char path[MAX_PATH], temp[MAX_PATH + 8];
+		CachePath(dir, file, path, sizeof(path));
+		_snprintf(temp, sizeof(temp), "%s.%u", path, unsigned(GetCurrentThreadId()));
+		temp[sizeof(temp) - 1] = '\0';
+
+		bool ok = false;
+		HANDLE fh = CreateFileA(temp, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (fh != INVALID_HANDLE_VALUE)
+		{
+			DWORD written = 0, written2 = 0;
+			ok = WriteFile(fh, &hdr, sizeof(hdr), &written, NULL) && written == sizeof(hdr) &&
+				 WriteFile(fh, data, dataBytes, &written2, NULL) && int(written2) == dataBytes;
+			CloseHandle(fh);
+			ok = ok && MoveFileExA(temp, path, MOVEFILE_REPLACE_EXISTING);
+			if (!ok) DeleteFileA(temp);
+		}
+		indebug(if (ok) printf("StorePCMCache() %s: %d -> %d bytes\n", file, bytes, dataBytes));
+		free(encoded);
+		return ok;
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// Shared memory
+	//
+
+#pragma region SharedPCM
+
+	/**
+	 * Header at the start of a shared PCM mapping, followed by the meta block and the data
+	 */
+	struct SharedHeader
+	{
+		char magic[4];				// "S3DS"
+		volatile LONG ready;		// set by the publisher after all data is written
+		int metaBytes;
+		int dataBytes;
+	};
+
+	/**
+	 * Builds the name of the shared mapping from the source path, its stamp and the variant.
+	 * Local\ keeps the mapping in the session, so no special privileges are needed.
+	 */
+	static bool SharedName(const char* file, unsigned variant, char* name, int maxName)
+	{
+		unsigned long long size, time;
+		if (!SourceStamp(file, &size, &time))
+			return false;
+		unsigned long long hash = PathHash(file);
+		hash = (hash ^ size) * 1099511628211ULL;
+		hash = (hash ^ time) * 1099511628211ULL;
+		hash = (hash ^ variant) * 1099511628211ULL;
+		_snprintf(name, maxName, "Local\\S3D.PCM.%08x%08x", unsigned(hash >> 32), unsigned(hash));
+		name[maxName - 1] = '\0';
+		return true;
+	}
+
+	SharedPCM::SharedPCM() : mapping(nullptr), view(nullptr)
+	{
+	}
+
+	SharedPCM::~SharedPCM()
+	{
+		Close();
+	}
+
+	/**
+	 * Maps a published entry read-only
+	 * @param file Source sound file
+	 * @param variant Hash of everything else that changes the data, ex. the quality profile
+	 * @return FALSE if nothing is published yet, or it's still being written
+	 */
+	bool SharedPCM::Open(const char* file, unsigned variant)
+	{
+		Close();
+		char name[64];
+		if (!SharedName(file, variant, name, sizeof(name)))
+			return false;
+		if (!(mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name)))
+			return false;
+		view = (char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		const SharedHeader* hdr = (const SharedHeader*)view;
+		if (!view || memcmp(hdr->magic, "S3DS", 4) || !hdr->ready) {
+			Close(); // a publisher that is still writing (or died while writing), decode privately
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Publishes decoded data for other processes. The entry is a named file mapping, the
+	 * kernel keeps it alive while any process has it open, so it's removed automatically
+	 * after the last user exits or crashes.
+	 * @param file Source sound file
+	 * @param variant Hash of everything else that changes the data, ex. the quality profile
+	 * @param meta Description of the data, ex. its wave format
+	 * @param metaBytes Size of the meta block
+	 * @param data Data to publish
+	 * @param dataBytes Size of the data
+	 * @return FALSE if the entry already exists or couldn't be created. The object stays closed.
+	 */
+	bool SharedPCM::Publish(const char* file, unsigned variant, const void* meta, int metaBytes, const void* data, int dataBytes)
+	{
+		Close();
+		char name[64];
+		if (!SharedName(file, variant, name, sizeof(name)))
+			return false;
+		DWORD size = sizeof(SharedHeader) + metaBytes + dataBytes;
+		if (!(mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, size, name)))
+			return false;
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			Close(); // another process got there first, keep our private copy
+			return false;
+		}
+		if (!(view = (char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0))) {
+			Close();
+			return false;
+		}
+		SharedHeader* hdr = (SharedHeader*)view;
+		memcpy(hdr->magic, "S3DS", 4);
+		hdr->metaBytes = metaBytes;
+		hdr->dataBytes = dataBytes;
+		memcpy(view + sizeof(SharedHeader), meta, metaBytes);
+		memcpy(view + sizeof(SharedHeader) + metaBytes, data, dataBytes);
+		InterlockedExchange(&hdr->ready, 1); // full barrier, readers see the data before the flag
+		return true;
+	}
+
+	/**
+	 * Unmaps the entry. It's destroyed when no process has it mapped anymore.
+	 */
+	void SharedPCM::Close()
+	{
+		if (view) UnmapViewOfFile(view), view = nullptr;
+		if (mapping) CloseHandle(mapping), mapping = nullptr;
+	}
+
+	/**
+	 * @return Meta block of the mapped entry
+	 */
+	const void* SharedPCM::Meta() const
+	{
+		return view + sizeof(SharedHeader);
+	}
+
+	/**
+	 * @return Size of the meta block
+	 */
+	int SharedPCM::MetaBytes() const
+	{
+		return ((const SharedHeader*)view)->metaBytes;
+	}
+
+	/**
+	 * @return Shared data of the mapped entry, read-only
+	 */
+	const void* SharedPCM::Data() const
+	{
+		return view + sizeof(SharedHeader) + MetaBytes();
+	}
+
+	/**
+	 * @return Size of the shared data
+	 */
+	int SharedPCM::DataBytes() const
+	{
+		return ((const SharedHeader*)view)->dataBytes;
+	}
+
+#pragma endregion
+
+} // namespace S3D
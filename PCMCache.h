@@ -0,0 +1,170 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "PCMConvert.h"
+
+namespace S3D {
+
+/**
+ * Lossless codec for the decoded PCM cache. Samples are predicted with LPC
+ * (up to order 8, 11-bit coefficients, stereo as mid/side) and the residual
+ * is Rice coded in partitions of 256 samples, like FLAC. Decoding is a single
+ * pass of integer math per sample, so a warm cache loads almost as fast as raw PCM.
+ */
+
+/**
+ * @param frames Number of sample frames
+ * @param fmt Format of the PCM data
+ * @return Size of the raw PCM data, encoding fails if the result would not fit
+ */
+inline int LosslessBound(int frames, const PCMFormat& fmt) { return frames * fmt.BlockAlign(); }
+
+/**
+ * Encodes interleaved 8 or 16-bit PCM losslessly
+ * @param pcm Interleaved samples
+ * @param frames Number of sample frames in pcm
+ * @param fmt Format of the PCM data
+ * @param dst Destination buffer
+ * @param dstBytes Size of the destination buffer
+ * @return Number of bytes written to dst, 0 if the result did not fit (incompressible data)
+ */
+int EncodeLossless(const void* pcm, int frames, const PCMFormat& fmt, void* dst, int dstBytes);
+
+/**
+ * Decodes data created by EncodeLossless
+ * @param src Encoded data
+ * @param srcBytes Size of the encoded data
+ * @param frames Number of sample frames to decode
+ * @param fmt Format of the PCM data
+ * @param dst Destination for interleaved samples, frames * fmt.BlockAlign() bytes
+ * @return FALSE if the data is corrupt
+ */
+bool DecodeLossless(const void* src, int srcBytes, int frames, const PCMFormat& fmt, void* dst);
+
+
+
+
+/**
+ * Decoded PCM disk cache. Compressed sound files (MP3, OGG) are decoded once and
+ * stored in the cache directory, losslessly compressed. A cache entry is only used
+ * while the size and modification time of the source file are unchanged.
+ */
+
+/**
+ * Loads the cached PCM of a sound file
+ * @param dir Cache directory
+ * @param file Source sound file
+ * @param headerBytes Number of bytes to reserve in front of the PCM data
+ * @param fmt Receives the format of the PCM data
+ * @param bytes Receives the size of the PCM data
+ * @return malloc()-ed block of headerBytes + PCM data, NULL if the file is not cached or out of date
+ */
+void* LoadPCMCache(const char* dir, const char* file, int headerBytes, PCMFormat* fmt, int* bytes);
+
+/**
+ * Stores the decoded PCM of a sound file in the cache
+ * @param dir Cache directory, must exist
+ * @param file Source sound file
+ * @param pcm Interleaved PCM data
+ * @param bytes Size of the PCM data
+ * @param fmt Format of the PCM data
+ * @return TRUE if the cache entry was written
+ */
+bool StorePCMCache(const char* dir, const char* file, const void* pcm, int bytes, const PCMFormat& fmt);
+
+
+
+
+
+/**
+ * Decoded data shared between processes of the same game running on one host.
+ * The first process publishes it in a named, pagefile backed file mapping; the
+ * others map it read-only instead of decoding it again. Mappings are refcounted
+ * by the kernel, so they disappear when the last process using them exits or crashes.
+ */
+class SharedPCM
+{
+protected:
+	void* mapping;	// file mapping handle
+	char* view;		// mapped view: header, meta block, data
+
+public:
+
+	SharedPCM();
+
+	/**
+	 * Unmaps the entry
+	 */
+	~SharedPCM();
+
+	/**
+	 * Maps a published entry read-only
+	 * @param file Source sound file
+	 * @param variant Hash of everything else that changes the data, ex. the quality profile
+	 * @return FALSE if nothing is published yet, or it's still being written
+	 */
+	bool Open(const char* file, unsigned variant);
+
+	/**
+	 * Publishes decoded data for other processes and keeps it mapped
+	 * @param file Source sound file
+	 * @param variant Hash of everything else that changes the data, ex. the quality profile
+	 * @param meta Description of the data, ex. its wave format
+	 * @param metaBytes Size of the meta block
+	 * @param data Data to publish
+	 * @param dataBytes Size of the data
+	 * @return FALSE if the entry already exists or couldn't be created. The object stays closed.
+	 */
+	bool Publish(const char* file, unsigned variant, const void* meta, int metaBytes, const void* data, int dataBytes);
+
+	/**
+	 * Unmaps the entry. It's destroyed when no process has it mapped anymore.
+	 */
+	void Close();
+
+	/**
+	 * @return TRUE if an entry is mapped
+	 */
+	inline bool IsOpen() const { return view != nullptr; }
+
+	/**
+	 * @return Meta block of the mapped entry
+	 */
+	const void* Meta() const;
+
+	/**
+	 * @return Size of the meta block
+	 */
+	int MetaBytes() const;
+
+	/**
+	 * @return Shared data of the mapped entry, read-only
+	 */
+	const void* Data() const;
+
+	/**
+	 * @return Size of the shared data
+	 */
+	int DataBytes() const;
+};
+
+} // namespace S3D
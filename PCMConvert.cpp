@@ -0,0 +1,822 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "PCMConvert.h"
+#include <xmmintrin.h>	// SSE
+#include <emmintrin.h>	// SSE2
+#include <malloc.h>		// _aligned_malloc
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+namespace S3D
+{
+
+	//////
+	// Sample conversion
+	//
+
+#pragma region Samples
+
+	/**
+	 * Converts interleaved 8 or 16-bit samples into planar float channels [-1.0 - 1.0].
+	 * Downmixing to mono averages all channels.
+	 * @param planes [outChannels] destination planes, each holding 'frames' samples
+	 * @return FALSE if the interleaved scratch buffer can't be allocated
+	 */
+	static bool ToPlanar(const void* src, const PCMFormat& fmt, int frames, float** planes, int outChannels)
+	{
+		const int channels = fmt.channels;
+		const int count = frames * channels;
+		float* flat = outChannels == channels && channels == 1 ? planes[0] : 
+			(float*)_aligned_malloc(count * sizeof(float) + 16, 16);
+		if (!flat) return false;
+
+		// int -> float, 8 samples per iteration
+		const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+		int i = 0;
+		if (fmt.bitsPerSample == 16)
+		{
+			const short* s = (const short*)src;
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+				__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); // sign extend
+				__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+				_mm_storeu_ps(flat + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+				_mm_storeu_ps(flat + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+			}
+			for (; i < count; ++i)
+				flat[i] = s[i] * (1.0f / 32768.0f);
+		}
+		else // 8-bit PCM is unsigned
+		{
+			const unsigned char* s = (const unsigned char*)src;
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i bias = _mm_set1_epi16(128);
+			for (; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_loadl_epi64((const __m128i*)(s + i));
+				v = _mm_slli_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(v, zero), bias), 8); // to 16-bit range
+				__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+				__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+				_mm_storeu_ps(flat + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+				_mm_storeu_ps(flat + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+			}
+			for (; i < count; ++i)
+				flat[i] = (s[i] - 128) * (1.0f / 128.0f);
+		}
+		if (flat == planes[0])
+			return true;
+
+		// deinterleave / downmix
+		if (channels == 2)
+		{
+			const __m128 half = _mm_set1_ps(0.5f);
+			int f = 0;
+			for (; f + 4 <= frames; f += 4)
+			{
+				__m128 a = _mm_loadu_ps(flat + f*2);		// L0 R0 L1 R1
+				__m128 b = _mm_loadu_ps(flat + f*2 + 4);	// L2 R2 L3 R3
+				__m128 left  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+				__m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+				if (outChannels == 1)
+					_mm_storeu_ps(planes[0] + f, _mm_mul_ps(_mm_add_ps(left, right), half));
+				else
+				{
+					_mm_storeu_ps(planes[0] + f, left);
+					_mm_storeu_ps(planes[1] + f, right);
+				}
+			}
+			for (; f < frames; ++f)
+			{
+				if (outChannels == 1)
+					planes[0][f] = (flat[f*2] + flat[f*2 + 1]) * 0.5f;
+				else
+					planes[0][f] = flat[f*2], planes[1][f] = flat[f*2 + 1];
+			}
+		}
+		else
+		{
+			const float norm = 1.0f / channels;
+			for (int f = 0; f < frames; ++f)
+			{
+				const float* frame = flat + f * channels;
+				if (outChannels == 1)
+				{
+					float sum = 0.0f;
+					for (int c = 0; c < channels; ++c) sum += frame[c];
+					planes[0][f] = sum * norm;
+				}
+				else for (int c = 0; c < channels; ++c)
+					planes[c][f] = frame[c];
+			}
+		}
+		_aligned_free(flat);
+		return true;
+	}
+
+	/**
+	 * Interleaves planar float channels and quantizes them to 8 or 16-bit samples, with saturation
+	 */
+	static void FromPlanar(float* const* planes, int channels, int frames, void* dst, int bitsPerSample)
+	{
+		const __m128 scale = _mm_set1_ps(bitsPerSample == 16 ? 32767.0f : 127.0f);
+		const __m128 bias = _mm_set1_ps(bitsPerSample == 16 ? 0.0f : 128.0f);
+		int f = 0;
+		if (channels <= 2)
+		{
+			// 8 samples per iteration: 8 mono frames or 4 stereo frames
+			const int step = 8 / channels;
+			for (; f + step <= frames; f += step)
+			{
+				__m128 a, b;
+				if (channels == 1)
+				{
+					a = _mm_loadu_ps(planes[0] + f);
+					b = _mm_loadu_ps(planes[0] + f + 4);
+				}
+				else
+				{
+					__m128 l = _mm_loadu_ps(planes[0] + f);
+					__m128 r = _mm_loadu_ps(planes[1] + f);
+					a = _mm_unpacklo_ps(l, r); // L0 R0 L1 R1
+					b = _mm_unpackhi_ps(l, r); // L2 R2 L3 R3
+				}
+				__m128i lo = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(a, scale), bias)); // rounds to nearest
+				__m128i hi = _mm_cvtps_epi32(_mm_add_ps(_mm_mul_ps(b, scale), bias));
+				__m128i packed = _mm_packs_epi32(lo, hi); // saturates to 16-bit
+				if (bitsPerSample == 16)
+					_mm_storeu_si128((__m128i*)((short*)dst + f * channels), packed);
+				else
+					_mm_storel_epi64((__m128i*)((unsigned char*)dst + f * channels), _mm_packus_epi16(packed, packed));
+			}
+		}
+		for (; f < frames; ++f)
+		{
+			for (int c = 0; c < channels; ++c)
+			{
+				float v = planes[c][f];
+				v = v < -1.0f ? -1.0f : v > 1.0f ? 1.0f : v;
+				if (bitsPerSample == 16)
+					((short*)dst)[f * channels + c] = (short)lrintf(v * 32767.0f);
+				else
+					((unsigned char*)dst)[f * channels + c] = (unsigned char)lrintf(v * 127.0f + 128.0f);
+			}
+		}
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// Resampling
+	//
+
+#pragma region Resampler
+
+	static const int Taps = 32;			// kernel length in source samples
+	static const int HalfTaps = Taps / 2;
+	static const int Phases = 256;		// fractional positions between two source samples
+
+	/**
+	 * Builds the windowed sinc kernel for every phase. Row p holds the weights of source
+	 * samples [i - HalfTaps + 1, i + HalfTaps] for an output at position i + p / Phases.
+	 * @param cutoff Lowpass cutoff in cycles per source sample (0.5 is the source Nyquist)
+	 * @param kernel [Phases * Taps] 16-byte aligned destination
+	 */
+	static void BuildKernel(double cutoff, float* kernel)
+	{
+		const double pi = 3.14159265358979323846;
+		for (int p = 0; p < Phases; ++p)
+		{
+			float* row = kernel + p * Taps;
+			double frac = double(p) / Phases;
+			double sum = 0.0;
+			for (int j = 0; j < Taps; ++j)
+			{
+				double x = (j - HalfTaps + 1) - frac;			// distance from the output position
+				double y = 2.0 * cutoff * x;
+				double sinc = y == 0.0 ? 1.0 : sin(pi * y) / (pi * y);
+				double n = (x + HalfTaps) / Taps;				// [0 - 1] over the kernel span
+				double window = 0.42 - 0.5 * cos(2.0*pi*n) + 0.08 * cos(4.0*pi*n); // Blackman
+				row[j] = float(sinc * window);
+				sum += row[j];
+			}
+			for (int j = 0; j < Taps; ++j) // unity gain at DC for every phase
+				row[j] = float(row[j] / sum);
+		}
+	}
+
+	/**
+	 * Resamples a single padded plane. The source must have HalfTaps readable samples
+	 * of silence before its start and after its end.
+	 */
+	static void ResamplePlane(const float* src, float* dst, int dstFrames, unsigned long long step, const float* kernel)
+	{
+		unsigned long long pos = 0; // 32.32 fixed point position in the source
+		for (int i = 0; i < dstFrames; ++i, pos += step)
+		{
+			const float* s = src + int(pos >> 32) - HalfTaps + 1;
+			const float* k = kernel + int((pos >> 24) & (Phases - 1)) * Taps;
+			__m128 acc = _mm_mul_ps(_mm_loadu_ps(s), _mm_load_ps(k));
+			for (int j = 4; j < Taps; j += 4)
+				acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(s + j), _mm_load_ps(k + j)));
+			acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+			acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+			dst[i] = _mm_cvtss_f32(acc);
+		}
+	}
+
+#pragma endregion
+
+
+
+
+	/**
+	 * @param srcBytes Size of the source data in bytes
+	 * @param src Format of the source data
+	 * @param dst Format to convert to
+	 * @return Size of the converted data in bytes
+	 */
+	int ConvertedSize(int srcBytes, const PCMFormat& src, const PCMFormat& dst)
+	{
+		long long frames = srcBytes / src.BlockAlign();
+		if (dst.sampleRate != src.sampleRate)
+			frames = frames * dst.sampleRate / src.sampleRate;
+		return int(frames * dst.BlockAlign());
+	}
+
+	/**
+	 * Converts interleaved PCM to another sample rate, bit depth and channel count.
+	 * Samples are converted in SSE2 registers; the sample rate is reduced with a 32 tap
+	 * windowed sinc (256 phases) that also filters out everything above the new Nyquist rate.
+	 * Channels can only be kept or downmixed to mono.
+	 * @param srcData Source samples
+	 * @param srcBytes Size of the source data in bytes
+	 * @param src Format of the source data
+	 * @param dstData Destination buffer, at least ConvertedSize() bytes
+	 * @param dst Format to convert to
+	 * @return Number of bytes written to dstData, 0 if the conversion is not supported
+	 */
+	int ConvertPCM(const void* srcData, int srcBytes, const PCMFormat& src, void* dstData, const PCMFormat& dst)
+	{
+		if (dst.channels != src.channels && dst.channels != 1)
+			return 0; // only downmixing to mono
+		if ((src.bitsPerSample != 8 && src.bitsPerSample != 16) || (dst.bitsPerSample != 8 && dst.bitsPerSample != 16))
+			return 0;
+		if (src.sampleRate <= 0 || dst.sampleRate <= 0 || dst.channels > 8)
+			return 0;
+
+		const int channels = dst.channels;
+		const int srcFrames = srcBytes / src.BlockAlign();
+		const bool resample = dst.sampleRate != src.sampleRate;
+		const int dstFrames = resample ? int((long long)srcFrames * dst.sampleRate / src.sampleRate) : srcFrames;
+		const int padded = srcFrames + 2 * HalfTaps + 4; // silence around the plane for the kernel
+
+		// planar float channels, padded with silence for the resampler
+		float* planes[8];
+		float* memory = (float*)_aligned_malloc((channels * padded + (resample ? channels * dstFrames : 0)) * sizeof(float) + 16, 16);
+		if (!memory) return 0;
+		memset(memory, 0, channels * padded * sizeof(float));
+		for (int c = 0; c < channels; ++c)
+			planes[c] = memory + c * padded + HalfTaps;
+		if (!ToPlanar(srcData, src, srcFrames, planes, channels))
+		{
+			_aligned_free(memory);
+			return 0;
+		}
+
+		if (resample)
+		{
+			// downsampling cuts at 90% of the new Nyquist rate, upsampling only interpolates
+			double ratio = double(dst.sampleRate) / src.sampleRate;
+			double cutoff = 0.5 * (ratio < 1.0 ? ratio : 1.0) * 0.9;
+			float* kernel = (float*)_aligned_malloc(Phases * Taps * sizeof(float), 16);
+			if (!kernel) { _aligned_free(memory); return 0; }
+			BuildKernel(cutoff, kernel);
+
+			unsigned long long step = ((unsigned long long)src.sampleRate << 32) / dst.sampleRate;
+			float* out = memory + channels * padded;
+			for (int c = 0; c < channels; ++c)
+			{
+				ResamplePlane(planes[c], out + c * dstFrames, dstFrames, step, kernel);
+				planes[c] = out + c * dstFrames;
+			}
+			_aligned_free(kernel);
+		}
+
+		FromPlanar(planes, channels, dstFrames, dstData, dst.bitsPerSample);
+		_aligned_free(memory);
+		return dstFrames * dst.BlockAlign();
+	}
+
+
+
+
+
+	//////
+	// Silence detection
+	//
+
+#pragma region Silence
+
+	/**
+	 * @return Peak sample magnitude of 16-bit samples [0 - 32768]
+	 */
+	static int Peak16(const short* s, int count)
+	{
+		int i = 0;
+		__m128i peak = _mm_setzero_si128();
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 8 <= count; i += 8)
+		{
+			__m128i v = _mm_loadu_si128((const __m128i*)(s + i));
+			peak = _mm_max_epi16(peak, _mm_max_epi16(v, _mm_subs_epi16(zero, v))); // |v|, -32768 saturates
+		}
+		peak = _mm_max_epi16(peak, _mm_srli_si128(peak, 8));
+		peak = _mm_max_epi16(peak, _mm_srli_si128(peak, 4));
+		peak = _mm_max_epi16(peak, _mm_srli_si128(peak, 2));
+		int result = _mm_extract_epi16(peak, 0);
+		for (; i < count; ++i)
+		{
+			int a = s[i] < 0 ? -s[i] : s[i];
+			if (a > result) result = a;
+		}
+		return result;
+	}
+
+	/**
+	 * @return Peak sample magnitude of unsigned 8-bit samples, in 16-bit steps [0 - 32768]
+	 */
+	static int Peak8(const unsigned char* s, int count)
+	{
+		int result = 0;
+		for (int i = 0; i < count; ++i)
+		{
+			int a = s[i] < 128 ? 128 - s[i] : s[i] - 128;
+			if (a > result) result = a;
+		}
+		return result << 8;
+	}
+
+	/**
+	 * @return Peak sample magnitude in 16-bit steps [0 - 32768], -1 if the format is not supported
+	 */
+	static int PeakSamples(const void* data, int offset, int count, int bitsPerSample)
+	{
+		if (bitsPerSample == 16) return Peak16((const short*)data + offset, count);
+		if (bitsPerSample == 8)  return Peak8((const unsigned char*)data + offset, count);
+		return -1;
+	}
+
+#pragma endregion
+
+
+
+
+	/**
+	 * Finds the peak level of interleaved PCM. 16-bit data is scanned 8 samples at a time in SSE2 registers.
+	 * @param data Interleaved 8-bit (unsigned) or 16-bit (signed) samples
+	 * @param frames Number of sample frames in data
+	 * @param fmt Format of the data
+	 * @return Peak level of all channels [0.0 - 1.0], 1.0 if the format is not supported
+	 */
+	float PeakPCM(const void* data, int frames, const PCMFormat& fmt)
+	{
+		int peak = PeakSamples(data, 0, frames * fmt.channels, fmt.bitsPerSample);
+		return peak < 0 ? 1.0f : peak / 32768.0f;
+	}
+
+	/**
+	 * Finds where the audible part of PCM data ends, scanning back from the end in blocks of SilenceBlockFrames
+	 * @param data Interleaved 8-bit (unsigned) or 16-bit (signed) samples
+	 * @param frames Number of sample frames in data
+	 * @param fmt Format of the data
+	 * @param threshold Peak level at or below which a block is silent
+	 * @return Number of frames up to the end of the last block above the threshold, 0 if the data is all silent
+	 */
+	int AudibleFrames(const void* data, int frames, const PCMFormat& fmt, float threshold)
+	{
+		const int limit = int(threshold * 32768.0f);
+		for (int end = frames; end > 0; )
+		{
+			int begin = (end - 1) / SilenceBlockFrames * SilenceBlockFrames;
+			int peak = PeakSamples(data, begin * fmt.channels, (end - begin) * fmt.channels, fmt.bitsPerSample);
+			if (peak < 0 || peak > limit)
+				return end; // unsupported formats are all audible
+			end = begin;
+		}
+		return 0;
+	}
+
+
+
+
+
+	//////
+	// Output stage
+	//
+
+#pragma region OutputStage
+
+	static const int OutputBlock = 1024; // samples quantized per block on the stack
+
+	// 3 tap F-weighted error feedback: noise transfer 1 - 1.623z^-1 + 0.982z^-2 - 0.109z^-3 (Wannamaker)
+	static const float xShaping[3] = { 1.623f, -0.982f, 0.109f };
+
+	static const int xMaskBits[16] = { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4 }; // set bits of a 4 bit mask
+
+	static inline __m128i NextRandom(__m128i& x) // xorshift32 in 4 lanes
+	{
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+		x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+		x = _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+		return x;
+	}
+
+	static inline unsigned NextRandom(unsigned& x)
+	{
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return x;
+	}
+
+#pragma endregion
+
+
+
+
+	/**
+	 * @param bitsPerSample Output sample size, 16 or 24 (others are treated as 16)
+	 * @param dither Dither of the quantization
+	 */
+	OutputStage::OutputStage(int bitsPerSample, DitherMode dither) 
+		: bits(bitsPerSample == 24 ? 24 : 16), dither(dither)
+	{
+		rng[0] = 0x9E3779B9, rng[1] = 0x7F4A7C15, rng[2] = 0x85EBCA6B, rng[3] = 0xC2B2AE35;
+		Reset();
+	}
+
+	/**
+	 * Clears the noise shaping history and the clip counter
+	 */
+	void OutputStage::Reset()
+	{
+		memset(errors, 0, sizeof(errors));
+		clipped = 0;
+	}
+
+	/**
+	 * [internal] Saturates, dithers and rounds a block that starts at the first channel of a frame
+	 * @param src Interleaved float samples
+	 * @param count Number of samples, a multiple of channels
+	 * @param channels Number of interleaved channels
+	 * @param dst Receives the integer sample values
+	 */
+	void OutputStage::QuantizeBlock(const float* src, int count, int channels, int* dst)
+	{
+		const float fullScale = bits == 24 ? 8388608.0f : 32768.0f;
+		const float lo = -fullScale, hi = fullScale - 1.0f;
+		const float unit = 1.0f / 8388608.0f; // 23 random bits -> [0.0 - 1.0)
+		int i = 0;
+		if (dither != DITHER_SHAPED) // no feedback, 4 samples at a time
+		{
+			const __m128 scale = _mm_set1_ps(fullScale);
+			const __m128 vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+			const __m128 vunit = _mm_set1_ps(unit);
+			__m128i state = _mm_loadu_si128((const __m128i*)rng);
+			for (; i + 4 <= count; i += 4)
+			{
+				__m128 v = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+				clipped += xMaskBits[_mm_movemask_ps(_mm_or_ps(_mm_cmpgt_ps(v, vhi), _mm_cmplt_ps(v, vlo)))];
+				if (dither == DITHER_TPDF) // difference of two uniform values: triangular [-1, 1] LSB
+				{
+					__m128 r1 = _mm_cvtepi32_ps(_mm_srli_epi32(NextRandom(state), 9));
+					__m128 r2 = _mm_cvtepi32_ps(_mm_srli_epi32(NextRandom(state), 9));
+					v = _mm_add_ps(v, _mm_mul_ps(_mm_sub_ps(r1, r2), vunit));
+				}
+				v = _mm_min_ps(_mm_max_ps(v, vlo), vhi);
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_cvtps_epi32(v)); // rounds to nearest
+			}
+			_mm_storeu_si128((__m128i*)rng, state);
+		}
+
+		for (int c = i % channels; i < count; ++i, c = c + 1 == channels ? 0 : c + 1) // noise shaping and the tail
+		{
+			float v = src[i] * fullScale;
+			if (v > hi || v < lo) ++clipped;
+			float* e = errors[c];
+			if (dither == DITHER_SHAPED)
+				v -= xShaping[0] * e[0] + xShaping[1] * e[1] + xShaping[2] * e[2];
+			float d = v;
+			if (dither != DITHER_NONE)
+				d += (float(NextRandom(rng[0]) >> 9) - float(NextRandom(rng[0]) >> 9)) * unit;
+			d = d < lo ? lo : d > hi ? hi : d;
+			const int q = _mm_cvtss_si32(_mm_set_ss(d)); // rounds to nearest, like the SSE path
+			if (dither == DITHER_SHAPED)
+			{
+				float err = float(q) - v; // saturation would feed back a huge error, keep the filter stable
+				e[2] = e[1], e[1] = e[0], e[0] = err < -4.0f ? -4.0f : err > 4.0f ? 4.0f : err;
+			}
+			dst[i] = q;
+		}
+	}
+
+	/**
+	 * Converts float samples [-1.0 - 1.0] to integer PCM
+	 * @param src Interleaved float samples
+	 * @param frames Number of sample frames
+	 * @param channels Number of interleaved channels, up to MaxChannels
+	 * @param dst Destination for frames * channels * BitsPerSample() / 8 bytes of little endian PCM
+	 * @return Number of bytes written to dst, 0 if the channel count is not supported
+	 */
+	int OutputStage::Convert(const float* src, int frames, int channels, void* dst)
+	{
+		if (channels < 1 || channels > MaxChannels)
+			return 0;
+		int q[OutputBlock];
+		const int block = OutputBlock / channels * channels;
+		const int count = frames * channels;
+		for (int i = 0; i < count; i += block)
+		{
+			const int n = count - i < block ? count - i : block;
+			QuantizeBlock(src + i, n, channels, q);
+			if (bits == 16)
+			{
+				short* out = (short*)dst + i;
+				int j = 0;
+				for (; j + 8 <= n; j += 8) // all values are in range, the saturating pack is exact
+					_mm_storeu_si128((__m128i*)(out + j), _mm_packs_epi32(
+						_mm_loadu_si128((const __m128i*)(q + j)), _mm_loadu_si128((const __m128i*)(q + j + 4))));
+				for (; j < n; ++j)
+					out[j] = short(q[j]);
+			}
+			else
+			{
+				unsigned char* out = (unsigned char*)dst + i * 3;
+				for (int j = 0; j < n; ++j, out += 3)
+					out[0] = (unsigned char)q[j], out[1] = (unsigned char)(q[j] >> 8), out[2] = (unsigned char)(q[j] >> 16);
+			}
+		}
+		return count * bits / 8;
+	}
+
+	/**
+	 * Quantizes float samples in place to the levels of the integer format,
+	 * so a later conversion to that format (such as the device's) is exact
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames
+	 * @param channels Number of interleaved channels, up to MaxChannels
+	 */
+	void OutputStage::Quantize(float* buffer, int frames, int channels)
+	{
+		if (channels < 1 || channels > MaxChannels)
+			return;
+		int q[OutputBlock];
+		const int block = OutputBlock / channels * channels;
+		const int count = frames * channels;
+		const __m128 scale = _mm_set1_ps(bits == 24 ? 1.0f / 8388608.0f : 1.0f / 32768.0f);
+		for (int i = 0; i < count; i += block)
+		{
+			const int n = count - i < block ? count - i : block;
+			float* out = buffer + i;
+			QuantizeBlock(out, n, channels, q);
+			int j = 0;
+			for (; j + 4 <= n; j += 4)
+				_mm_storeu_ps(out + j, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i*)(q + j))), scale));
+			for (; j < n; ++j)
+				out[j] = float(q[j]) * _mm_cvtss_f32(scale);
+		}
+	}
+
+
+
+
+	//////
+	// MS ADPCM
+	//
+
+#pragma region ADPCM
+
+	const short ADPCMCoefficients[ADPCMNumCoef][2] = {
+		{ 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 },
+	};
+
+	static const int xAdaptation[16] = { // step size scale by nibble, 8.8 fixed point
+		230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230,
+	};
+
+	static inline int Clamp16(int s) { return s < -32768 ? -32768 : s > 32767 ? 32767 : s; }
+
+	/**
+	 * Encodes a single channel of a block
+	 * @param src First sample of the channel in the block, interleaved
+	 * @param frames Number of valid frames, the rest of the block is silence
+	 * @param nibbles [ADPCMSamplesPerBlock - 2] receives the encoded nibbles, NULL to only measure
+	 * @return Sum of squared errors of the encoded samples
+	 */
+	static double EncodeChannel(const short* src, int frames, int channels, int predictor, int delta, 
+								unsigned char* nibbles)
+	{
+		const int c1 = ADPCMCoefficients[predictor][0], c2 = ADPCMCoefficients[predictor][1];
+		int s2 = frames > 0 ? src[0] : 0;
+		int s1 = frames > 1 ? src[channels] : 0;
+		double error = 0.0;
+		for (int i = 2; i < ADPCMSamplesPerBlock; ++i)
+		{
+			int x = i < frames ? src[i * channels] : 0;
+			int pred = (s1 * c1 + s2 * c2) >> 8;
+			int diff = x - pred;
+			int nib = (diff >= 0 ? diff + delta / 2 : diff - delta / 2) / delta; // round to nearest step
+			nib = nib < -8 ? -8 : nib > 7 ? 7 : nib;
+			int s = Clamp16(pred + nib * delta);
+			error += double(x - s) * (x - s);
+			s2 = s1, s1 = s;
+			delta = (xAdaptation[nib & 15] * delta) >> 8;
+			if (delta < 16) delta = 16;
+			if (nibbles) nibbles[i - 2] = (unsigned char)(nib & 15);
+		}
+		return error;
+	}
+
+	/**
+	 * @param frames Number of sample frames to encode
+	 * @param channels Number of interleaved channels (1 or 2)
+	 * @param dst Destination buffer, at least ADPCMEncodedSize() bytes
+	 * @return Number of bytes written to dst, 0 if the channel count is not supported
+	 */
+	int EncodeADPCM(const short* src, int frames, int channels, void* dst)
+	{
+		if (channels != 1 && channels != 2)
+			return 0;
+		const int blockAlign = ADPCMBlockAlign(channels);
+		unsigned char nibbles[2][ADPCMSamplesPerBlock];
+		unsigned char* out = (unsigned char*)dst;
+		for (int start = 0; start < frames; start += ADPCMSamplesPerBlock, out += blockAlign)
+		{
+			const short* block = src + start * channels;
+			const int valid = frames - start;
+			for (int c = 0; c < channels; ++c)
+			{
+				// initial step size from the average slope at the start of the block
+				int slope = 0;
+				for (int i = 1; i < 5 && i < valid; ++i)
+					slope += abs(block[i * channels + c] - block[(i-1) * channels + c]);
+				int delta = slope / 16;
+				if (delta < 16) delta = 16;
+
+				int best = 0;
+				double bestError = -1.0;
+				for (int p = 0; p < ADPCMNumCoef; ++p)
+				{
+					double error = EncodeChannel(block + c, valid, channels, p, delta, nullptr);
+					if (bestError < 0.0 || error < bestError)
+						best = p, bestError = error;
+				}
+				EncodeChannel(block + c, valid, channels, best, delta, nibbles[c]);
+
+				// header: predictors, deltas, second samples, first samples
+				short s2 = valid > 0 ? block[c] : 0;
+				short s1 = valid > 1 ? block[channels + c] : 0;
+				out[c] = (unsigned char)best;
+				*(short*)(out + channels + c*2) = (short)delta;
+				*(short*)(out + channels*3 + c*2) = s1;
+				*(short*)(out + channels*5 + c*2) = s2;
+			}
+			unsigned char* data = out + 7 * channels;
+			if (channels == 1)
+			{
+				for (int i = 0; i < ADPCMSamplesPerBlock - 2; i += 2)
+					*data++ = (nibbles[0][i] << 4) | nibbles[0][i + 1];
+			}
+			else for (int i = 0; i < ADPCMSamplesPerBlock - 2; ++i)
+				*data++ = (nibbles[0][i] << 4) | nibbles[1][i];
+		}
+		return int(out - (unsigned char*)dst);
+	}
+
+	/**
+	 * Low 32 bits of a signed 32-bit multiply, SSE2 has no pmulld
+	 */
+	static inline __m128i MulLo32(__m128i a, __m128i b)
+	{
+		__m128i even = _mm_mul_epu32(a, b);
+		__m128i odd  = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+		return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0,0,2,0)), 
+								  _mm_shuffle_epi32(odd,  _MM_SHUFFLE(0,0,2,0)));
+	}
+
+	/**
+	 * @param srcBytes Size of the source data in bytes, a multiple of ADPCMBlockAlign()
+	 * @param channels Number of interleaved channels (1 or 2)
+	 * @param dst Destination for interleaved 16-bit samples
+	 * @param maxFrames Maximum number of frames to write, the padding of the last block is dropped
+	 * @return Number of sample frames written to dst
+	 */
+	int DecodeADPCM(const void* src, int srcBytes, int channels, short* dst, int maxFrames)
+	{
+		if (channels != 1 && channels != 2)
+			return 0;
+		const int blockAlign = ADPCMBlockAlign(channels);
+		const int numBlocks = srcBytes / blockAlign;
+		int frames = numBlocks * ADPCMSamplesPerBlock;
+		if (frames > maxFrames) frames = maxFrames;
+		const int numLanes = numBlocks * channels; // every channel of every block decodes independently
+
+		__declspec(align(16)) int out[4];
+		const unsigned char* data[4];	// first nibble byte of each lane
+		short* dest[4];					// first output sample of each lane
+		int limit[4];					// number of samples to write for each lane
+		int chan[4];					// channel of each lane
+
+		for (int lane = 0; lane < numLanes; lane += 4)
+		{
+			int coef[4], s1[4], s2[4], delta[4];
+			for (int i = 0; i < 4; ++i)
+			{
+				int l = lane + i < numLanes ? lane + i : lane; // spare lanes repeat the first one
+				int b = l / channels, c = l % channels;
+				const unsigned char* block = (const unsigned char*)src + b * blockAlign;
+				int predictor = block[c] < ADPCMNumCoef ? block[c] : 0;
+				coef[i] = (ADPCMCoefficients[predictor][0] & 0xFFFF) | (ADPCMCoefficients[predictor][1] << 16);
+				delta[i] = *(const short*)(block + channels + c*2);
+				s1[i] = *(const short*)(block + channels*3 + c*2);
+				s2[i] = *(const short*)(block + channels*5 + c*2);
+				data[i] = block + 7 * channels;
+				chan[i] = c;
+				dest[i] = dst + b * ADPCMSamplesPerBlock * channels + c;
+				limit[i] = lane + i < numLanes ? frames - b * ADPCMSamplesPerBlock : 0;
+				if (limit[i] > ADPCMSamplesPerBlock) limit[i] = ADPCMSamplesPerBlock;
+				if (limit[i] > 0) dest[i][0] = (short)s2[i];
+				if (limit[i] > 1) dest[i][channels] = (short)s1[i];
+			}
+			if (limit[0] <= 2) continue; // lanes are in block order, nothing left to write
+
+			__m128i vcoef  = _mm_loadu_si128((const __m128i*)coef);		// c1 | c2 << 16
+			__m128i vs1    = _mm_loadu_si128((const __m128i*)s1);
+			__m128i vs2    = _mm_loadu_si128((const __m128i*)s2);
+			__m128i vdelta = _mm_loadu_si128((const __m128i*)delta);
+			const __m128i minDelta = _mm_set1_epi32(16);
+
+			const int n = limit[0]; // the first lane always has the most samples to write
+			for (int i = 2; i < n; ++i)
+			{
+				// gather the nibble and step scale of every lane
+				const int k = (i - 2) * channels;
+				int nib[4], adapt[4];
+				for (int j = 0; j < 4; ++j)
+				{
+					int idx = k + chan[j]; // stereo: high nibble is the left channel
+					int v = (data[j][idx >> 1] >> ((idx & 1) ? 0 : 4)) & 15;
+					adapt[j] = xAdaptation[v];
+					nib[j] = (v ^ 8) - 8; // sign extend
+				}
+				__m128i vnib = _mm_loadu_si128((const __m128i*)nib);
+
+				// pred = (s1 * c1 + s2 * c2) >> 8
+				__m128i pair = _mm_or_si128(_mm_and_si128(vs1, _mm_set1_epi32(0xFFFF)), _mm_slli_epi32(vs2, 16));
+				__m128i pred = _mm_srai_epi32(_mm_madd_epi16(pair, vcoef), 8);
+
+				// s = clamp16(pred + nib * delta)
+				__m128i s = _mm_add_epi32(pred, MulLo32(vnib, vdelta));
+				s = _mm_packs_epi32(s, s);
+				s = _mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16);
+				vs2 = vs1, vs1 = s;
+
+				// delta = max(16, (adapt * delta) >> 8)
+				vdelta = _mm_srai_epi32(MulLo32(_mm_loadu_si128((const __m128i*)adapt), vdelta), 8);
+				__m128i big = _mm_cmpgt_epi32(vdelta, minDelta);
+				vdelta = _mm_or_si128(_mm_and_si128(big, vdelta), _mm_andnot_si128(big, minDelta));
+
+				_mm_store_si128((__m128i*)out, s);
+				for (int j = 0; j < 4; ++j)
+					if (i < limit[j]) dest[j][i * channels] = (short)out[j];
+			}
+		}
+		return frames;
+	}
+
+#pragma endregion
+
+} // namespace S3D
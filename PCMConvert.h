@@ -0,0 +1,241 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+namespace S3D {
+
+/**
+ * Layout of interleaved integer PCM data
+ */
+struct PCMFormat
+{
+	int sampleRate;		// frames per second
+	int bitsPerSample;	// 8 (unsigned) or 16 (signed)
+	int channels;		// interleaved channels per frame
+
+	inline PCMFormat() : sampleRate(0), bitsPerSample(0), channels(0) {}
+	inline PCMFormat(int rate, int bits, int channels) : sampleRate(rate), bitsPerSample(bits), channels(channels) {}
+
+	/**
+	 * @return Size of a single frame in bytes
+	 */
+	inline int BlockAlign() const { return channels * bitsPerSample / 8; }
+};
+
+/**
+ * @param srcBytes Size of the source data in bytes
+ * @param src Format of the source data
+ * @param dst Format to convert to
+ * @return Size of the converted data in bytes
+ */
+int ConvertedSize(int srcBytes, const PCMFormat& src, const PCMFormat& dst);
+
+/**
+ * Converts interleaved PCM to another sample rate, bit depth and channel count.
+ * Samples are converted in SSE2 registers; the sample rate is reduced with a 32 tap
+ * windowed sinc (256 phases) that also filters out everything above the new Nyquist rate.
+ * Channels can only be kept or downmixed to mono.
+ * @param srcData Source samples
+ * @param srcBytes Size of the source data in bytes
+ * @param src Format of the source data
+ * @param dstData Destination buffer, at least ConvertedSize() bytes
+ * @param dst Format to convert to
+ * @return Number of bytes written to dstData, 0 if the conversion is not supported
+ */
+int ConvertPCM(const void* srcData, int srcBytes, const PCMFormat& src, void* dstData, const PCMFormat& dst);
+
+
+
+
+/**
+ * Peak level at which PCM data counts as silent: -72dB, a few steps of 16-bit dither noise
+ */
+const float SilencePeak = 0.00025f;
+
+/**
+ * Frames in a single block of the silence scan, the resolution of AudibleFrames()
+ */
+enum { SilenceBlockFrames = 256 };
+
+/**
+ * Finds the peak level of interleaved PCM. 16-bit data is scanned 8 samples at a time in SSE2 registers.
+ * @param data Interleaved 8-bit (unsigned) or 16-bit (signed) samples
+ * @param frames Number of sample frames in data
+ * @param fmt Format of the data
+ * @return Peak level of all channels [0.0 - 1.0], 1.0 if the format is not supported
+ */
+float PeakPCM(const void* data, int frames, const PCMFormat& fmt);
+
+/**
+ * Finds where the audible part of PCM data ends, scanning back from the end in blocks of SilenceBlockFrames
+ * @param data Interleaved 8-bit (unsigned) or 16-bit (signed) samples
+ * @param frames Number of sample frames in data
+ * @param fmt Format of the data
+ * @param threshold Peak level at or below which a block is silent
+ * @return Number of frames up to the end of the last block above the threshold, 0 if the data is all silent
+ */
+int AudibleFrames(const void* data, int frames, const PCMFormat& fmt, float threshold = SilencePeak);
+
+
+
+
+/**
+ * Dither added when a float mix is quantized to integer PCM
+ */
+enum DitherMode
+{
+	DITHER_NONE,	// round to nearest, quiet signals turn into truncation distortion
+	DITHER_TPDF,	// triangular dither of +-1 LSB, the quantization error becomes flat white noise
+	DITHER_SHAPED,	// TPDF with 3 tap F-weighted noise shaping, the noise moves where hearing is least sensitive
+};
+
+/**
+ * Final stage of a float mix: saturates, dithers and quantizes it to 16 or 24-bit PCM.
+ * Rounding and TPDF dither run 4 samples at a time in SSE2 registers, noise shaping feeds
+ * the error of every sample back into its channel, so it runs one sample at a time.
+ * The dither generator and the shaping filters carry over between blocks of the same stream.
+ */
+class OutputStage
+{
+public:
+	enum { MaxChannels = 8 };
+
+protected:
+	int bits;							// 16 or 24
+	DitherMode dither;					// dither of the quantization
+	unsigned rng[4];					// xorshift state of the 4 dither lanes
+	float errors[MaxChannels][3];		// noise shaping error history of each channel
+	unsigned clipped;					// samples saturated since the last Reset()
+
+public:
+
+	/**
+	 * @param bitsPerSample Output sample size, 16 or 24 (others are treated as 16)
+	 * @param dither Dither of the quantization
+	 */
+	OutputStage(int bitsPerSample = 16, DitherMode dither = DITHER_TPDF);
+
+	/**
+	 * Clears the noise shaping history and the clip counter
+	 */
+	void Reset();
+
+	/**
+	 * @return Output sample size in bits, 16 or 24
+	 */
+	inline int BitsPerSample() const { return bits; }
+
+	/**
+	 * @return Dither of the quantization
+	 */
+	inline DitherMode Dither() const { return dither; }
+
+	/**
+	 * @return Number of samples saturated at full scale since the last Reset()
+	 */
+	inline unsigned Clipped() const { return clipped; }
+
+	/**
+	 * Converts float samples [-1.0 - 1.0] to integer PCM
+	 * @param src Interleaved float samples
+	 * @param frames Number of sample frames
+	 * @param channels Number of interleaved channels, up to MaxChannels
+	 * @param dst Destination for frames * channels * BitsPerSample() / 8 bytes of little endian PCM
+	 * @return Number of bytes written to dst, 0 if the channel count is not supported
+	 */
+	int Convert(const float* src, int frames, int channels, void* dst);
+
+	/**
+	 * Quantizes float samples in place to the levels of the integer format,
+	 * so a later conversion to that format (such as the device's) is exact
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames
+	 * @param channels Number of interleaved channels, up to MaxChannels
+	 */
+	void Quantize(float* buffer, int frames, int channels);
+
+protected:
+
+	/**
+	 * [internal] Saturates, dithers and rounds a block that starts at the first channel of a frame
+	 * @param src Interleaved float samples
+	 * @param count Number of samples, a multiple of channels
+	 * @param channels Number of interleaved channels
+	 * @param dst Receives the integer sample values
+	 */
+	void QuantizeBlock(const float* src, int count, int channels, int* dst);
+};
+
+
+
+
+/**
+ * Microsoft ADPCM, 4 bits per sample. XAudio2 plays it natively.
+ * Every block starts with a 7 byte header per channel, followed by the
+ * nibbles of all channels interleaved (high nibble first).
+ */
+enum { ADPCMSamplesPerBlock = 512, ADPCMNumCoef = 7 };
+
+/**
+ * The standard MS ADPCM predictor coefficient pairs, required by XAudio2
+ */
+extern const short ADPCMCoefficients[ADPCMNumCoef][2];
+
+/**
+ * @param channels Number of interleaved channels
+ * @return Size of a single ADPCM block in bytes
+ */
+inline int ADPCMBlockAlign(int channels) { return (7 + (ADPCMSamplesPerBlock - 2) / 2) * channels; }
+
+/**
+ * @param frames Number of sample frames to encode
+ * @param channels Number of interleaved channels
+ * @return Size of the encoded data in bytes, the last block is padded with silence
+ */
+inline int ADPCMEncodedSize(int frames, int channels)
+{
+	return (frames + ADPCMSamplesPerBlock - 1) / ADPCMSamplesPerBlock * ADPCMBlockAlign(channels);
+}
+
+/**
+ * Encodes 16-bit PCM to MS ADPCM. For every block and channel all 7 predictors are
+ * tried and the one with the least error is kept, so this is meant for load time.
+ * @param src Interleaved 16-bit samples
+ * @param frames Number of sample frames in src
+ * @param channels Number of interleaved channels (1 or 2)
+ * @param dst Destination buffer, at least ADPCMEncodedSize() bytes
+ * @return Number of bytes written to dst, 0 if the channel count is not supported
+ */
+int EncodeADPCM(const short* src, int frames, int channels, void* dst);
+
+/**
+ * Decodes MS ADPCM to 16-bit PCM. Blocks are independent, so 4 block channels
+ * are decoded at once in the lanes of SSE2 registers.
+ * @param src ADPCM blocks
+ * @param srcBytes Size of the source data in bytes, a multiple of ADPCMBlockAlign()
+ * @param channels Number of interleaved channels (1 or 2)
+ * @param dst Destination for interleaved 16-bit samples
+ * @param maxFrames Maximum number of frames to write, the padding of the last block is dropped
+ * @return Number of sample frames written to dst
+ */
+int DecodeADPCM(const void* src, int srcBytes, int channels, short* dst, int maxFrames);
+
+} // namespace S3D
@@ -0,0 +1,511 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "RealtimeCheck.h"
+#include <Windows.h>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+#if S3D_RTCHECK
+#include <Psapi.h>		// EnumProcessModules
+#include <DbgHelp.h>	// SymFromAddr
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "dbghelp.lib")
+#endif
+
+#ifdef _DEBUG
+	#define indebug(x) x
+#else
+	#define indebug(x) // do nothing in release
+#endif
+
+namespace S3D
+{
+
+#if S3D_RTCHECK
+
+	//////
+	// Interceptors
+	//
+
+#pragma region Interceptors
+
+	enum RealtimeHook
+	{
+		HOOK_HEAP_ALLOC, HOOK_HEAP_REALLOC, HOOK_HEAP_FREE, HOOK_VIRTUAL_ALLOC, HOOK_VIRTUAL_FREE,
+		HOOK_ENTER_CRITICAL_SECTION, HOOK_ACQUIRE_SRW_EXCLUSIVE, HOOK_ACQUIRE_SRW_SHARED,
+		HOOK_WAIT_FOR_SINGLE_OBJECT, HOOK_WAIT_FOR_SINGLE_OBJECT_EX, HOOK_WAIT_FOR_MULTIPLE_OBJECTS,
+		HOOK_SLEEP, HOOK_SLEEP_EX,
+		HOOK_CREATE_FILE_A, HOOK_CREATE_FILE_W, HOOK_READ_FILE, HOOK_WRITE_FILE, 
+		HOOK_SET_FILE_POINTER, HOOK_SET_FILE_POINTER_EX, HOOK_CLOSE_HANDLE,
+		HOOK_COUNT,
+	};
+
+	struct HookEntry
+	{
+		const char* name;	// name of the import
+		int kind;			// RealtimeViolation
+		void* original;		// the imported function, set when the first import is patched
+	};
+
+	static HookEntry xHooks[HOOK_COUNT] = {
+		{ "HeapAlloc",               RT_ALLOCATION },
+		{ "HeapReAlloc",             RT_ALLOCATION },
+		{ "HeapFree",                RT_ALLOCATION },
+		{ "VirtualAlloc",            RT_ALLOCATION },
+		{ "VirtualFree",             RT_ALLOCATION },
+		{ "EnterCriticalSection",    RT_LOCK },
+		{ "AcquireSRWLockExclusive", RT_LOCK },
+		{ "AcquireSRWLockShared",    RT_LOCK },
+		{ "WaitForSingleObject",     RT_WAIT },
+		{ "WaitForSingleObjectEx",   RT_WAIT },
+		{ "WaitForMultipleObjects",  RT_WAIT },
+		{ "Sleep",                   RT_WAIT },
+		{ "SleepEx",                 RT_WAIT },
+		{ "CreateFileA",             RT_FILE_IO },
+		{ "CreateFileW",             RT_FILE_IO },
+		{ "ReadFile",                RT_FILE_IO },
+		{ "WriteFile",               RT_FILE_IO },
+		{ "SetFilePointer",          RT_FILE_IO },
+		{ "SetFilePointerEx",        RT_FILE_IO },
+		{ "CloseHandle",             RT_FILE_IO },
+	};
+
+	// one recorded call site, slots are claimed by hash and never freed until Clear()
+	struct ViolationSite
+	{
+		volatile LONG hash;		// stack hash, 0 for a free slot
+		volatile LONG ready;	// the stack is written
+		volatile LONG count;
+		int hook;
+		int frames;
+		void* stack[RealtimeReport::MaxFrames];
+	};
+
+	enum { MaxSites = 256 }; // power of 2
+
+	static ViolationSite xSites[MaxSites];	// static, recording must not allocate
+	static volatile LONG xCounts[RT_VIOLATION_KINDS];
+	static volatile LONG xEnabled;
+	static __declspec(thread) int xRealtimeDepth;		// RealtimeScope nesting of this thread
+	static __declspec(thread) bool xRecording;			// calls made while recording are ours
+	static __declspec(thread) unsigned xThreadCounts[RT_VIOLATION_KINDS];
+
+	/**
+	 * Counts a call of a hooked function and records its stack, if the thread is real-time.
+	 * Never inlined, the stack capture skips exactly this frame and the interceptor.
+	 */
+	static __declspec(noinline) void Violation(int hook)
+	{
+		if (!xRealtimeDepth || xRecording)
+			return;
+		xRecording = true;
+		const int kind = xHooks[hook].kind;
+		++xThreadCounts[kind];
+		InterlockedIncrement(&xCounts[kind]);
+
+		void* stack[RealtimeReport::MaxFrames];
+		ULONG hash;
+		const int frames = CaptureStackBackTrace(2, RealtimeReport::MaxFrames, stack, &hash); // skip Violation and the hook
+		const LONG key = LONG(((hash ^ unsigned(hook)) * 2654435761u) | 1); // 0 marks a free slot
+		for (unsigned i = 0; i < MaxSites; ++i)
+		{
+			ViolationSite& site = xSites[(unsigned(key) + i) & (MaxSites - 1)];
+			const LONG prev = InterlockedCompareExchange(&site.hash, key, 0);
+			if (prev == 0) // claimed a new site
+			{
+				site.hook = hook;
+				site.frames = frames;
+				memcpy(site.stack, stack, frames * sizeof(void*));
+				InterlockedExchange(&site.ready, 1);
+				char message[96]; // OutputDebugString doesn't allocate
+				sprintf_s(message, "S3D: %s on the audio thread! (RealtimeCheck::Print)\n", xHooks[hook].name);
+				OutputDebugStringA(message);
+			}
+			else if (prev != key)
+				continue; // someone else's stack
+			InterlockedIncrement(&site.count);
+			break;
+		}
+		xRecording = false;
+	}
+
+	template<class Fn> static inline Fn Original(int hook) { return (Fn)xHooks[hook].original; }
+
+	static LPVOID WINAPI HookHeapAlloc(HANDLE heap, DWORD flags, SIZE_T bytes)
+	{
+		Violation(HOOK_HEAP_ALLOC);
+		return Original<decltype(&HeapAlloc)>(HOOK_HEAP_ALLOC)(heap, flags, bytes);
+	}
+	static LPVOID WINAPI HookHeapReAlloc(HANDLE heap, DWORD flags, LPVOID mem, SIZE_T bytes)
+	{
+		Violation(HOOK_HEAP_REALLOC);
+		return Original<decltype(&HeapReAlloc)>(HOOK_HEAP_REALLOC)(heap, flags, mem, bytes);
+	}
+	static BOOL WINAPI HookHeapFree(HANDLE heap, DWORD flags, LPVOID mem)
+	{
+		Violation(HOOK_HEAP_FREE);
+		return Original<decltype(&HeapFree)>(HOOK_HEAP_FREE)(heap, flags, mem);
+	}
+	static LPVOID WINAPI HookVirtualAlloc(LPVOID address, SIZE_T bytes, DWORD type, DWORD protect)
+	{
+		Violation(HOOK_VIRTUAL_ALLOC);
+		return Original<decltype(&VirtualAlloc)>(HOOK_VIRTUAL_ALLOC)(address, bytes, type, protect);
+	}
+	static BOOL WINAPI HookVirtualFree(LPVOID address, SIZE_T bytes, DWORD type)
+	{
+		Violation(HOOK_VIRTUAL_FREE);
+		return Original<decltype(&VirtualFree)>(HOOK_VIRTUAL_FREE)(address, bytes, type);
+	}
+	static void WINAPI HookEnterCriticalSection(LPCRITICAL_SECTION cs)
+	{
+		Violation(HOOK_ENTER_CRITICAL_SECTION);
+		Original<decltype(&EnterCriticalSection)>(HOOK_ENTER_CRITICAL_SECTION)(cs);
+	}
+	static void WINAPI HookAcquireSRWLockExclusive(PSRWLOCK lock)
+	{
+		Violation(HOOK_ACQUIRE_SRW_EXCLUSIVE);
+		Original<decltype(&AcquireSRWLockExclusive)>(HOOK_ACQUIRE_SRW_EXCLUSIVE)(lock);
+	}
+	static void WINAPI HookAcquireSRWLockShared(PSRWLOCK lock)
+	{
+		Violation(HOOK_ACQUIRE_SRW_SHARED);
+		Original<decltype(&AcquireSRWLockShared)>(HOOK_ACQUIRE_SRW_SHARED)(lock);
+	}
+	static DWORD WINAPI HookWaitForSingleObject(HANDLE handle, DWORD millis)
+	{
+		Violation(HOOK_WAIT_FOR_SINGLE_OBJECT);
+		return Original<decltype(&WaitForSingleObject)>(HOOK_WAIT_FOR_SINGLE_OBJECT)(handle, millis);
+	}
+	static DWORD WINAPI HookWaitForSingleObjectEx(HANDLE handle, DWORD millis, BOOL alertable)
+	{
+		Violation(HOOK_WAIT_FOR_SINGLE_OBJECT_EX);
+		return Original<decltype(&WaitForSingleObjectEx)>(HOOK_WAIT_FOR_SINGLE_OBJECT_EX)(handle, millis, alertable);
+	}
+	static DWORD WINAPI HookWaitForMultipleObjects(DWORD count, const HANDLE* handles, BOOL all, DWORD millis)
+	{
+		Violation(HOOK_WAIT_FOR_MULTIPLE_OBJECTS);
+		return Original<decltype(&WaitForMultipleObjects)>(HOOK_WAIT_FOR_MULTIPLE_OBJECTS)(count, handles, all, millis);
+	}
+	static void WINAPI HookSleep(DWORD millis)
+	{
+		Violation(HOOK_SLEEP);
+		Original<decltype(&Sleep)>(HOOK_SLEEP)(millis);
+	}
+	static DWORD WINAPI HookSleepEx(DWORD millis, BOOL alertable)
+	{
+		Violation(HOOK_SLEEP_EX);
+		return Original<decltype(&SleepEx)>(HOOK_SLEEP_EX)(millis, alertable);
+	}
+	static HANDLE WINAPI HookCreateFileA(LPCSTR file, DWORD access, DWORD share, LPSECURITY_ATTRIBUTES security, 
+										 DWORD disposition, DWORD flags, HANDLE templ)
+	{
+		Violation(HOOK_CREATE_FILE_A);
+		return Original<decltype(&CreateFileA)>(HOOK_CREATE_FILE_A)(file, access, share, security, disposition, flags, templ);
+	}
+	static HANDLE WINAPI HookCreateFileW(LPCWSTR file, DWORD access, DWORD share, LPSECURITY_ATTRIBUTES security, 
+										 DWORD disposition, DWORD flags, HANDLE templ)
+	{
+		Violation(HOOK_CREATE_FILE_W);
+		return Original<decltype(&CreateFileW)>(HOOK_CREATE_FILE_W)(file, access, share, security, disposition, flags, templ);
+	}
+	static BOOL WINAPI HookReadFile(HANDLE file, LPVOID buffer, DWORD bytes, LPDWORD read, LPOVERLAPPED overlapped)
+	{
+		Violation(HOOK_READ_FILE);
+		return Original<decltype(&ReadFile)>(HOOK_READ_FILE)(file, buffer, bytes, read, overlapped);
+	}
+	static BOOL WINAPI HookWriteFile(HANDLE file, LPCVOID buffer, DWORD bytes, LPDWORD written, LPOVERLAPPED overlapped)
+	{
+		Violation(HOOK_WRITE_FILE);
+		return Original<decltype(&WriteFile)>(HOOK_WRITE_FILE)(file, buffer, bytes, written, overlapped);
+	}
+	static DWORD WINAPI HookSetFilePointer(HANDLE file, LONG distance, PLONG distanceHigh, DWORD method)
+	{
+		Violation(HOOK_SET_FILE_POINTER);
+		return Original<decltype(&SetFilePointer)>(HOOK_SET_FILE_POINTER)(file, distance, distanceHigh, method);
+	}
+	static BOOL WINAPI HookSetFilePointerEx(HANDLE file, LARGE_INTEGER distance, PLARGE_INTEGER newPos, DWORD method)
+	{
+		Violation(HOOK_SET_FILE_POINTER_EX);
+		return Original<decltype(&SetFilePointerEx)>(HOOK_SET_FILE_POINTER_EX)(file, distance, newPos, method);
+	}
+	static BOOL WINAPI HookCloseHandle(HANDLE handle)
+	{
+		Violation(HOOK_CLOSE_HANDLE);
+		return Original<decltype(&CloseHandle)>(HOOK_CLOSE_HANDLE)(handle);
+	}
+
+	static void* const xInterceptors[HOOK_COUNT] = {
+		(void*)&HookHeapAlloc, (void*)&HookHeapReAlloc, (void*)&HookHeapFree, (void*)&HookVirtualAlloc, (void*)&HookVirtualFree,
+		(void*)&HookEnterCriticalSection, (void*)&HookAcquireSRWLockExclusive, (void*)&HookAcquireSRWLockShared,
+		(void*)&HookWaitForSingleObject, (void*)&HookWaitForSingleObjectEx, (void*)&HookWaitForMultipleObjects,
+		(void*)&HookSleep, (void*)&HookSleepEx,
+		(void*)&HookCreateFileA, (void*)&HookCreateFileW, (void*)&HookReadFile, (void*)&HookWriteFile,
+		(void*)&HookSetFilePointer, (void*)&HookSetFilePointerEx, (void*)&HookCloseHandle,
+	};
+
+	/**
+	 * Points the import slots of hooked functions in a module to the interceptors
+	 * @return Number of slots patched
+	 */
+	static int PatchImports(HMODULE module)
+	{
+		BYTE* base = (BYTE*)module;
+		const IMAGE_NT_HEADERS* nt = (const IMAGE_NT_HEADERS*)(base + ((const IMAGE_DOS_HEADER*)base)->e_lfanew);
+		const IMAGE_DATA_DIRECTORY& dir = nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_IMPORT];
+		if (!dir.VirtualAddress || !dir.Size)
+			return 0;
+
+		int patched = 0;
+		for (const IMAGE_IMPORT_DESCRIPTOR* imp = (const IMAGE_IMPORT_DESCRIPTOR*)(base + dir.VirtualAddress); imp->Name; ++imp)
+		{
+			if (!imp->OriginalFirstThunk)
+				continue; // no names to match
+			const IMAGE_THUNK_DATA* names = (const IMAGE_THUNK_DATA*)(base + imp->OriginalFirstThunk);
+			IMAGE_THUNK_DATA* slots = (IMAGE_THUNK_DATA*)(base + imp->FirstThunk);
+			for (; names->u1.AddressOfData; ++names, ++slots)
+			{
+				if (IMAGE_SNAP_BY_ORDINAL(names->u1.Ordinal))
+					continue;
+				const char* name = (const char*)((const IMAGE_IMPORT_BY_NAME*)(base + names->u1.AddressOfData))->Name;
+				for (int i = 0; i < HOOK_COUNT; ++i)
+				{
+					HookEntry& h = xHooks[i];
+					void* current = (void*)slots->u1.Function;
+					if (strcmp(name, h.name) || current == xInterceptors[i])
+						continue;
+					DWORD protect;
+					if (!VirtualProtect(&slots->u1.Function, sizeof(slots->u1.Function), PAGE_READWRITE, &protect))
+						break;
+					if (!h.original) h.original = current; // all modules bind the same export
+					InterlockedExchangePointer((void**)&slots->u1.Function, xInterceptors[i]);
+					VirtualProtect(&slots->u1.Function, sizeof(slots->u1.Function), protect, &protect);
+					++patched;
+					break;
+				}
+			}
+		}
+		return patched;
+	}
+
+	/**
+	 * @return TRUE if the module implements the hooked functions, patching it would only double count
+	 */
+	static bool IsKernelModule(HMODULE module)
+	{
+		char path[MAX_PATH];
+		if (!GetModuleFileNameA(module, path, MAX_PATH))
+			return true;
+		const char* name = strrchr(path, '\\');
+		name = name ? name + 1 : path;
+		return !_stricmp(name, "ntdll.dll") || !_stricmp(name, "kernel32.dll") || !_stricmp(name, "kernelbase.dll");
+	}
+
+#pragma endregion
+
+#endif // S3D_RTCHECK
+
+
+
+
+	//////
+	// RealtimeCheck impl
+	//
+
+#pragma region RealtimeCheck
+
+	static const char* xViolationNames[RT_VIOLATION_KINDS] = { "allocation", "lock", "wait", "file I/O" };
+
+	/**
+	 * Installs the interceptors into all modules loaded so far. Call again after loading DLLs
+	 * whose code runs on the audio thread, already patched modules are skipped.
+	 * Patching is process wide, it is never done unless the host calls this.
+	 * @return FALSE if the checker is not compiled in (S3D_RTCHECK is 0)
+	 */
+	bool RealtimeCheck::Enable()
+	{
+	#if S3D_RTCHECK
+		static volatile LONG patching;
+		while (InterlockedCompareExchange(&patching, 1, 0))
+			SwitchToThread(); // every new Engine enables again once the host did, maybe from many threads
+
+		HMODULE modules[1024];
+		DWORD bytes = 0;
+		int patched = 0;
+		if (EnumProcessModules(GetCurrentProcess(), modules, sizeof(modules), &bytes))
+		{
+			const int count = std::min<int>(bytes / sizeof(HMODULE), 1024);
+			for (int i = 0; i < count; ++i)
+				if (!IsKernelModule(modules[i]))
+					patched += PatchImports(modules[i]);
+		}
+		for (HookEntry& h : xHooks) // for modules patched later, which may import a function none did so far
+			if (!h.original) h.original = (void*)GetProcAddress(GetModuleHandleA("kernel32.dll"), h.name);
+		InterlockedExchange(&xEnabled, 1);
+		InterlockedExchange(&patching, 0);
+		indebug(if (patched) printf("RealtimeCheck::Enable() patched %d imports\n", patched));
+		return true;
+	#else
+		return false;
+	#endif
+	}
+
+	/**
+	 * @return TRUE if the interceptors are installed
+	 */
+	bool RealtimeCheck::Enabled()
+	{
+	#if S3D_RTCHECK
+		return xEnabled != 0;
+	#else
+		return false;
+	#endif
+	}
+
+	/**
+	 * @param kind [optional] RealtimeViolation to count, -1 for all kinds
+	 * @return Number of violations made by all threads since the last Clear()
+	 */
+	unsigned RealtimeCheck::Count(int kind)
+	{
+		unsigned count = 0;
+	#if S3D_RTCHECK
+		for (int i = 0; i < RT_VIOLATION_KINDS; ++i)
+			if (kind < 0 || kind == i) count += unsigned(xCounts[i]);
+	#endif
+		return count;
+	}
+
+	/**
+	 * @param kind [optional] RealtimeViolation to count, -1 for all kinds
+	 * @return Number of violations ever made by the calling thread, never cleared
+	 */
+	unsigned RealtimeCheck::ThreadCount(int kind)
+	{
+		unsigned count = 0;
+	#if S3D_RTCHECK
+		for (int i = 0; i < RT_VIOLATION_KINDS; ++i)
+			if (kind < 0 || kind == i) count += xThreadCounts[i];
+	#endif
+		return count;
+	}
+
+	/**
+	 * Copies the recorded call sites, most frequent first
+	 * @param reports Receives up to maxReports call sites
+	 * @param maxReports Capacity of reports
+	 * @return Number of reports copied
+	 */
+	int RealtimeCheck::Reports(RealtimeReport* reports, int maxReports)
+	{
+		int count = 0;
+	#if S3D_RTCHECK
+		std::vector<RealtimeReport> all(MaxSites);
+		for (const ViolationSite& site : xSites)
+		{
+			if (!site.ready)
+				continue;
+			RealtimeReport& r = all[count++];
+			r.kind = xHooks[site.hook].kind;
+			r.call = xHooks[site.hook].name;
+			r.count = unsigned(site.count);
+			r.frames = site.frames;
+			memcpy(r.stack, site.stack, site.frames * sizeof(void*));
+		}
+		std::sort(all.begin(), all.begin() + count, [](const RealtimeReport& a, const RealtimeReport& b) { return a.count > b.count; });
+		if (count > maxReports) count = maxReports;
+		std::copy(all.begin(), all.begin() + count, reports);
+	#endif
+		return count;
+	}
+
+	/**
+	 * Prints every recorded call site with its count and symbolized stack to stdout
+	 * @return Number of violations printed
+	 */
+	unsigned RealtimeCheck::Print()
+	{
+		unsigned total = 0;
+	#if S3D_RTCHECK
+		std::vector<RealtimeReport> reports(MaxSites);
+		const int count = Reports(reports.data(), MaxSites);
+		if (!count)
+			return 0;
+
+		HANDLE process = GetCurrentProcess();
+		SymSetOptions(SYMOPT_UNDNAME | SYMOPT_LOAD_LINES | SYMOPT_DEFERRED_LOADS);
+		const bool symbols = SymInitialize(process, nullptr, TRUE) != FALSE;
+		for (int i = 0; i < count; ++i)
+		{
+			const RealtimeReport& r = reports[i];
+			total += r.count;
+			printf("%s %s on the audio thread, %u times:\n", r.call, xViolationNames[r.kind], r.count);
+			for (int f = 0; f < r.frames; ++f)
+			{
+				const DWORD64 address = DWORD64(size_t(r.stack[f]));
+				char buffer[sizeof(SYMBOL_INFO) + 256];
+				SYMBOL_INFO* symbol = (SYMBOL_INFO*)buffer;
+				symbol->SizeOfStruct = sizeof(SYMBOL_INFO);
+				symbol->MaxNameLen = 256;
+				DWORD64 offset = 0;
+				DWORD column = 0;
+				IMAGEHLP_LINE64 line = { sizeof(IMAGEHLP_LINE64) };
+				if (!symbols || !SymFromAddr(process, address, &offset, symbol))
+					printf("    %p\n", r.stack[f]);
+				else if (SymGetLineFromAddr64(process, address, &column, &line))
+					printf("    %s  %s(%u)\n", symbol->Name, line.FileName, unsigned(line.LineNumber));
+				else
+					printf("    %s+0x%x\n", symbol->Name, unsigned(offset));
+			}
+		}
+		if (symbols) SymCleanup(process);
+		printf("%u real-time violations: %u allocations, %u locks, %u waits, %u file I/O\n", Count(),
+			   Count(RT_ALLOCATION), Count(RT_LOCK), Count(RT_WAIT), Count(RT_FILE_IO));
+	#endif
+		return total;
+	}
+
+	/**
+	 * Forgets all recorded call sites and resets Count(). Don't call while audio is playing.
+	 */
+	void RealtimeCheck::Clear()
+	{
+	#if S3D_RTCHECK
+		memset((void*)xSites, 0, sizeof(xSites));
+		memset((void*)xCounts, 0, sizeof(xCounts));
+	#endif
+	}
+
+#if S3D_RTCHECK
+	RealtimeScope::RealtimeScope()
+	{
+		++xRealtimeDepth;
+	}
+
+	RealtimeScope::~RealtimeScope()
+	{
+		--xRealtimeDepth;
+	}
+#endif
+
+#pragma endregion
+
+} // namespace S3D
@@ -0,0 +1,136 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// real-time checks are built into debug builds, define S3D_RTCHECK=1 to add them to a release (CI) build
+#ifndef S3D_RTCHECK
+	#ifdef _DEBUG
+		#define S3D_RTCHECK 1
+	#else
+		#define S3D_RTCHECK 0
+	#endif
+#endif
+
+namespace S3D {
+
+/**
+ * Kinds of calls that must not be made on the audio thread
+ */
+enum RealtimeViolation
+{
+	RT_ALLOCATION,		// heap or virtual memory allocated or freed
+	RT_LOCK,			// critical section or SRW lock acquired
+	RT_WAIT,			// waited on a kernel object or slept
+	RT_FILE_IO,			// file opened, read, written or closed
+	RT_VIOLATION_KINDS,
+};
+
+/**
+ * A call site that violated the real-time contract, with the number of times it did
+ */
+struct RealtimeReport
+{
+	enum { MaxFrames = 16 };
+	int kind;					// RealtimeViolation
+	const char* call;			// the intercepted API, ex. "HeapAlloc"
+	unsigned count;				// number of calls made from this stack
+	int frames;					// number of return addresses in the stack
+	void* stack[MaxFrames];		// return addresses, innermost first
+};
+
+
+
+
+/**
+ * Catches real-time safety regressions on the audio thread. The XAudio2 callbacks of the
+ * library (voice and engine callbacks, Effect::Process) run inside a RealtimeScope. While a
+ * thread is in a scope, every allocation, lock, wait and file I/O call it makes is counted
+ * and its stack is recorded, once per distinct stack.
+ *
+ * Calls are intercepted by patching the import tables of the modules loaded in the process,
+ * so it works with the release CRT too. The checker is compiled in with S3D_RTCHECK
+ * (on in debug builds), but only a host that opts in enables it, ex. Render -rtcheck or a test.
+ * Engines created after that patch the XAudio2 module as well. Render -rtcheck fails on violations.
+ */
+class RealtimeCheck
+{
+public:
+	/**
+	 * Installs the interceptors into all modules loaded so far. Call again after loading DLLs
+	 * whose code runs on the audio thread, already patched modules are skipped.
+	 * Patching is process wide, it is never done unless the host calls this.
+	 * @return FALSE if the checker is not compiled in (S3D_RTCHECK is 0)
+	 */
+	static bool Enable();
+
+	/**
+	 * @return TRUE if the interceptors are installed
+	 */
+	static bool Enabled();
+
+	/**
+	 * @param kind [optional] RealtimeViolation to count, -1 for all kinds
+	 * @return Number of violations made by all threads since the last Clear()
+	 */
+	static unsigned Count(int kind = -1);
+
+	/**
+	 * @param kind [optional] RealtimeViolation to count, -1 for all kinds
+	 * @return Number of violations ever made by the calling thread, never cleared
+	 */
+	static unsigned ThreadCount(int kind = -1);
+
+	/**
+	 * Copies the recorded call sites, most frequent first
+	 * @param reports Receives up to maxReports call sites
+	 * @param maxReports Capacity of reports
+	 * @return Number of reports copied
+	 */
+	static int Reports(RealtimeReport* reports, int maxReports);
+
+	/**
+	 * Prints every recorded call site with its count and symbolized stack to stdout
+	 * @return Number of violations printed
+	 */
+	static unsigned Print();
+
+	/**
+	 * Forgets all recorded call sites and resets Count(). Don't call while audio is playing.
+	 */
+	static void Clear();
+};
+
+
+
+
+/**
+ * Marks the calling thread as real-time for the lifetime of the scope. Scopes can be nested.
+ */
+class RealtimeScope
+{
+public:
+#if S3D_RTCHECK
+	RealtimeScope();
+	~RealtimeScope();
+#endif
+};
+
+} // namespace S3D
@@ -1,1398 +1,4383 @@
-/**
- * Sound3D - An open source 3D Audio Library
- * 
- * Copyright (c) 2013 Jorma Rebane
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
- * and associated documentation files (the "Software"), to deal in the Software without restriction, 
- * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
- * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
- * subject to the following conditions:
- * 
- * The above copyright notice and this permission notice shall be included in all copies or substantial 
- * portions of the Software.
- * 
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
- * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
- * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
- * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
- * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
- */
-#include "Sound3D.h"
-#include <stdio.h>
-#include <string.h>
-#include <Windows.h>
-
-#pragma comment(lib, "XAudio2_7/X3DAudio.lib")
-
-#ifdef _DEBUG
-#define indebug(x) x
-#else
-#define indebug(x) // ...
-#endif
-
-namespace S3D 
-{
-
-	static IXAudio2* xEngine;					// the core engine for XAudio2
-	static IXAudio2MasteringVoice* xMaster;		// the Mastering voice is the global LISTENER / mixer
-	static X3DAUDIO_HANDLE x3DAudioHandle;		// X3DSound
-	static X3DAUDIO_LISTENER xListener;			// global listener position for X3DSound
-
-
-	static void UninitXAudio2()
-	{
-		xMaster->DestroyVoice();
-		xEngine->Release();
-	}
-	static void InitXAudio2()
-	{
-		CoInitializeEx(NULL, COINIT_MULTITHREADED);
-		XAudio2Create(&xEngine);
-		xEngine->CreateMasteringVoice(&xMaster);
-		X3DAudioInitialize(SPEAKER_STEREO, 340.29f, x3DAudioHandle);
-
-		atexit(UninitXAudio2);
-	}
-
-
-	/**
-	 * @param ctx SoundBuffer passed to the buffer as its Context
-	 * @param size Size of the buffer to create and fill with audio data
-	 * @param strm AudioStream to stream from
-	 * @param pos [optional] Position of the stream to stream from. Returns the new position of the stream. (in BYTES)
-	 * @return NEW buffer if successful. NULL if EndOfStream or OutOfMemory.
-	 */
-	static XABuffer* CreateXABuffer(SoundBuffer* ctx, int size, AudioStreamer* strm, int* pos = nullptr)
-	{
-		if (pos) strm->Seek(*pos); // seek to specified pos, let the AudioStream handle error conditions
-		if (strm->IsEOS()) return nullptr; // EOS(), failed!
-
-		// min(size, available);
-		int bytesToRead = strm->Available();
-		if (size < bytesToRead) bytesToRead = size;
-
-		XABuffer* buffer = (XABuffer*)malloc(sizeof(XABuffer)+bytesToRead);
-		if (!buffer) return nullptr; // out of memory :S
-		BYTE* data = (BYTE*)buffer + sizeof(XABuffer); // sound data follows after the XABuffer header
-
-		int bytesRead = strm->ReadSome(data, bytesToRead);
-		if (pos) *pos += bytesRead; // update position
-
-		buffer->Flags = strm->IsEOS() ? XAUDIO2_END_OF_STREAM : 0; // end of stream?
-		buffer->AudioBytes = bytesRead;
-		buffer->pAudioData = data;
-		buffer->PlayBegin = 0;		// first sample to play
-		buffer->PlayLength = 0;		// number of samples to play
-		buffer->LoopBegin = 0;		// first sample to loop
-		buffer->LoopLength = 0;		// number of samples to loop
-		buffer->LoopCount = 0;		// how many times to loop the region
-		buffer->pContext = ctx;		// context of the buffer
-		indebug(ctx->RefCount()); // access the buffer Context in debug mode, to hopefully catch invalid ctx's
-		int sampleSize = strm->SingleSampleSize();
-		buffer->nBytesPerSample = sampleSize;
-
-		WAVEFORMATEX& wf = buffer->wf;
-		wf.wFormatTag = WAVE_FORMAT_PCM;
-		wf.nChannels = strm->Channels();
-		buffer->nPCMSamples = bytesRead / (sampleSize * wf.nChannels);
-		wf.nSamplesPerSec = strm->Frequency();
-		wf.wBitsPerSample = sampleSize * 8;
-		wf.nBlockAlign = (wf.nChannels * sampleSize);
-		wf.nAvgBytesPerSec = wf.nBlockAlign * wf.nSamplesPerSec;
-		wf.cbSize = sizeof(WAVEFORMATEX);
-		
-		// this is enough to create an somewhat unique pseudo-hash:
-		buffer->wfHash = wf.nSamplesPerSec + (wf.nChannels * 25) + (wf.wBitsPerSample * 7);
-		return buffer;
-	}
-
-	/**
-	 * Streams next chunk from the Stream set in XABuffer. Size is determined by existing buffer size.
-	 * @param buffer Buffer to fill with audio data
-	 * @param pos [optional] Position of the stream to stream from (in BYTES)
-	 */
-	static void StreamXABuffer(XABuffer* buffer, AudioStreamer* strm, int* pos = nullptr)
-	{
-		if (pos) strm->Seek(*pos); // seek to specified pos, let the AudioStream handle error conditions
-		
-		buffer->AudioBytes = strm->ReadSome((void*)buffer->pAudioData, buffer->AudioBytes);
-		if (strm->IsEOS()) // end of stream was reached
-			buffer->Flags = XAUDIO2_END_OF_STREAM;
-
-		if (pos) *pos += buffer->AudioBytes; // update position
-	}
-
-	/**
-	 * @param buffer Reference to an Audio buffer to destroy. Buffer will be NULL after this call.
-	 */
-	static void DestroyXABuffer(XABuffer*& buffer)
-	{
-		free((void*)buffer);
-		buffer = nullptr;
-	}
-
-	static int GetBuffersQueued(IXAudio2SourceVoice* source)
-	{
-		XAUDIO2_VOICE_STATE state;
-		source->GetState(&state);
-		return state.BuffersQueued;
-	}
-
-
-
-
-
-
-	/**
-	 * Creates a new SoundBuffer object
-	 */
-	SoundBuffer::SoundBuffer() : refCount(0), xaBuffer(nullptr)
-	{
-		if (!xEngine) InitXAudio2();
-	}
-
-	/**
-	 * Creates a new SoundBuffer and loads the specified sound file
-	 * @param file Path to sound file to load
-	 */
-	SoundBuffer::SoundBuffer(const char* file) : refCount(0), xaBuffer(nullptr)
-	{
-		if (!xEngine) InitXAudio2();
-		Load(file);
-	}
-
-	/**
-	 * Destroyes and unloads this buffer
-	 */
-	SoundBuffer::~SoundBuffer()
-	{
-		if (xaBuffer)
-			Unload();
-	}
-
-	/**
-	 * @return Frequency in Hz of this SoundBuffer data
-	 */
-	int SoundBuffer::Frequency() const
-	{
-		return xaBuffer->wf.nSamplesPerSec;
-	}
-
-	/**
-	 * @return Number of bits in a sample of this SoundBuffer data (8 or 16)
-	 */
-	int SoundBuffer::SampleBits() const
-	{
-		return xaBuffer->wf.wBitsPerSample;
-	}
-
-	/**
-	 * @return Number of bytes in a sample of this SoundBuffer data (1 or 2)
-	 */
-	int SoundBuffer::SampleBytes() const
-	{
-		return xaBuffer->nBytesPerSample;
-	}
-
-	/**
-	 * @return Number of sound channels in the SoundBuffer data (1 or 2)
-	 */
-	int SoundBuffer::Channels() const
-	{
-		return xaBuffer->wf.nChannels;
-	}
-
-	/** 
-	 * @return Size of a full sample block in bytes [LL][RR] (1 to 4)
-	 */
-	int SoundBuffer::FullSampleSize() const 
-	{
-		return xaBuffer->wf.nBlockAlign;
-	}
-
-	/**
-	 * @return Size of this SoundBuffer or SoundStream in BYTES
-	 */
-	int SoundBuffer::SizeBytes() const
-	{
-		return xaBuffer->AudioBytes;
-	}
-
-	/**
-	 * @return Number of Bytes Per Second for this audio data (Frequency * Channels * SampleBytes)
-	 */
-	int SoundBuffer::BytesPerSecond() const
-	{
-		return xaBuffer->wf.nAvgBytesPerSec;
-	}
-
-	/**
-	 * @return Size of this SoundBuffer in PCM SAMPLES
-	 */
-	int SoundBuffer::Size() const
-	{
-		return xaBuffer->nPCMSamples;
-	}
-
-	/**
-	 * @return Number of SoundObjects that still reference this SoundBuffer.
-	 */
-	int SoundBuffer::RefCount() const 
-	{
-		return refCount; 
-	}
-
-	/**
-	 * @return TRUE if this object is a Sound stream
-	 */
-	bool SoundBuffer::IsStream() const 
-	{ 
-		return false; 
-	}
-
-	/**
-	 * @return Wave format descriptor for this buffer
-	 */
-	const WAVEFORMATEX* SoundBuffer::WaveFormat() const
-	{
-		return xaBuffer ? &xaBuffer->wf : nullptr;
-	}
-
-	/**
-	 * @return Unique hash to distinguish between different Wave formats
-	 */
-	unsigned SoundBuffer::WaveFormatHash() const
-	{
-		return xaBuffer ? xaBuffer->wfHash : 0;
-	}
-
-	/**
-	 * Loads this SoundBuffer with data found in the specified file.
-	 * Supported formats: .wav .mp3
-	 * @param file Sound file to load
-	 * @return TRUE if loading succeeded and a valid buffer was created.
-	 */
-	bool SoundBuffer::Load(const char* file)
-	{
-		if (xaBuffer) // is there existing data?
-			return false;
-		
-		AudioStreamer mem; // temporary stream
-		AudioStreamer* strm = &mem;
-		if (!CreateAudioStreamer(strm, file))
-			return false; // invalid file format or file not found
-
-		if (!strm->OpenStream(file))
-			return false; // failed to open the stream (probably not really correct format)
-
-		xaBuffer = CreateXABuffer(this, strm->Size(), strm);
-		strm->CloseStream(); // close this manually, otherwise we get a nasty error when the dtor runs...
-		return xaBuffer != nullptr;
-	}
-
-	/**
-	 * Tries to release the underlying sound buffer and free the memory.
-	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundBuffer
-	 * @return TRUE if SoundBuffer was freed, FALSE if SoundBuffer is still used by a SoundObject.
-	 */
-	bool SoundBuffer::Unload()
-	{
-		if (!xaBuffer)
-			return true; // yes, its unloaded
-		if (refCount > 0) {
-			indebug(printf("SoundBuffer::Unload() Memory Leak: failed to delete alBuffer, because it's still in use.\n"));
-			return false; // can't do anything here while still referenced
-		}
-		DestroyXABuffer(xaBuffer);
-		return true;
-	}
-
-	/**
-	 * Binds a specific source to this SoundBuffer and increases the refCount.
-	 * @param so SoundObject to bind to this SoundBuffer.
-	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
-	 */
-	bool SoundBuffer::BindSource(SoundObject* so)
-	{
-		if (!xaBuffer) 
-			return false; // no data
-
-		if (so->Sound == this)
-			return false; // no double-binding dude, it will mess up refCounting.
-
-		so->Source->SubmitSourceBuffer(xaBuffer); // enqueue this buffer
-		++refCount;
-		return true;
-	}
-
-	/**
-	 * Unbinds a specific source from this SoundBuffer and decreases the refCount.
-	 * @param so SoundObject to unbind from this SoundBuffer.
-	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
-	 */
-	bool SoundBuffer::UnbindSource(SoundObject* so)
-	{
-		if (so->Sound == this) // correct buffer link?
-		{
-			so->Source->Stop(); // make sure its stopped (otherwise Flush won't work)
-			if (GetBuffersQueued(so->Source))
-				so->Source->FlushSourceBuffers(); // ensure not in queue anymore
-			--refCount;
-		}
-		return true;
-	}
-
-	/**
-	 * Resets the buffer in the context of the specified SoundObject
-	 * @note Calls ResetStream on AudioStreams.
-	 * @param so SoundObject to reset this buffer for
-	 * @return TRUE if reset was successful
-	 */
-	bool SoundBuffer::ResetBuffer(SoundObject* so)
-	{
-		if (!xaBuffer || !so->Source)
-			return false; // nothing to do here
-
-		so->Source->Stop();
-		if (GetBuffersQueued(so->Source)) // only flush IF we have buffers to flush
-			so->Source->FlushSourceBuffers();
-
-		so->Source->SubmitSourceBuffer(xaBuffer);
-		return true;
-	}
-
-
-
-
-
-
-
-
-
-	/**
-	 * Creates a new SoundsStream object
-	 */
-	SoundStream::SoundStream()
-	{
-	}
-
-	/**
-	 * Creates a new SoundStream object and loads the specified sound file
-	 * @param file Path to the sound file to load
-	 */
-	SoundStream::SoundStream(const char* file)
-	{
-		Load(file);
-	}
-
-	/**
-	 * Destroys and unloads any resources held
-	 */
-	SoundStream::~SoundStream()
-	{
-		if (xaBuffer) // active buffer?
-			Unload();
-	}
-
-	/**
-	 * @return Size of this SoundStream in PCM SAMPLES
-	 */
-	int SoundStream::Size() const
-	{
-		return alStream ? (alStream->Size() / FullSampleSize()) : 0;
-	}
-
-	/**
-	 * @return TRUE if this object is a Sound stream
-	 */
-	bool SoundStream::IsStream() const
-	{
-		return true;
-	}
-
-	/**
-	 * Initializes this SoundStream with data found in the specified file.
-	 * Supported formats: .wav .mp3
-	 * @param file Sound file to load
-	 * @return TRUE if loading succeeded and a stream was initialized.
-	 */
-	bool SoundStream::Load(const char* file)
-	{
-		if (xaBuffer) // is there existing data?
-			return false;
-
-		if (!(alStream = CreateAudioStreamer(file)))
-			return false; // :(
-		
-		if (!alStream->OpenStream(file))
-			return false;
-
-		// load the first buffer in the stream:
-		xaBuffer = CreateXABuffer(this, alStream->BytesPerSecond(), alStream, 0);
-		return xaBuffer != nullptr;
-	}
-
-	/**
-	 * Tries to release the underlying sound buffers and free the memory.
-	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundStream
-	 * @return TRUE if SoundStream data was freed, FALSE if SoundStream is still used by a SoundObject.
-	 */
-	bool SoundStream::Unload()
-	{
-		if (!xaBuffer)
-			return true; // yes, its unloaded
-		if (refCount > 0) {
-			indebug(printf("SoundStream::Unload() Memory Leak: failed to delete xaBuffer, because it's still in use.\n"));
-			return false; // can't do anything here while still referenced
-		}
-		DestroyXABuffer(xaBuffer);
-		if (alStream) { delete alStream; alStream = NULL; }
-		return true;
-	}
-
-	/**
-	 * Binds a specific source to this SoundStream and increases the refCount.
-	 * @param so SoundObject to bind to this SoundStream.
-	 * @return FALSE is the binding failed. TODO: POSSIBLE REASONS?
-	 */
-	bool SoundStream::BindSource(SoundObject* so)
-	{
-		if (!xaBuffer) 
-			return false; // no data loaded yet
-
-		alSources.emplace_back(so);				// default streamPos
-		LoadStreamData(alSources.back(), 0);	// load initial stream data (2 buffers)
-
-		++refCount;
-		return true;
-	}
-
-	/**
-	 * Unbinds a specific source from this SoundStream and decreases the refCount.
-	 * @param so SoundObject to unbind from this SoundStream.
-	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
-	 */
-	bool SoundStream::UnbindSource(SoundObject* so)
-	{
-		if (!xaBuffer)
-			return false; // no data loaded yet
-		
-		SO_ENTRY* e = GetSOEntry(so);
-		if (!e) return false; // source doesn't exist
-
-		ClearStreamData(*e); // unload all buffers
-
-		alSources.erase(alSources.begin() + (e - alSources.data()));
-		--refCount;
-		return true;
-	}
-
-	/**
-	 * Resets the buffer in the context of the specified SoundObject
-	 * @note Calls ResetStream on AudioStreams.
-	 * @param so SoundObject to reset this buffer for
-	 * @return TRUE if reset was successful
-	 */
-	bool SoundStream::ResetBuffer(SoundObject* so)
-	{
-		return ResetStream(so);
-	}
-
-	/**
-	 * Streams the next Buffer block from the stream.
-	 * @param so Specific SoundObject to stream with.
-	 * @return TRUE if a buffer was streamed. FALSE if EOS() or stream is busy.
-	 */
-	bool SoundStream::StreamNext(SoundObject* so)
-	{
-		if (!xaBuffer) 
-			return false; // nothing to do here
-		if (SO_ENTRY* e = GetSOEntry(so))
-		{
-			if (e->busy) return false; // can't stream when stream is busy
-			return StreamNext(*e);
-		}
-		return false; // nothing to stream
-	}
-
-	/**
-	 * Resets the stream by unloading previous buffers and requeuing the first two buffers.
-	 * @param so SoundObject to reset the stream for
-	 * @return TRUE if stream was successfully reloaded
-	 */
-	bool SoundStream::ResetStream(SoundObject* so)
-	{
-		// simply clear and load again, to avoid code maintenance hell
-		if (SO_ENTRY* e = GetSOEntry(so)) {
-			ClearStreamData(*e);
-			return LoadStreamData(*e, 0);
-		}
-		return false;
-	}
-
-	/**
-	 * @param so Specific SoundObject to check for end of stream
-	 * @return TRUE if End of Stream was reached or if there is no stream loaded
-	 */
-	bool SoundStream::IsEOS(const SoundObject* so) const
-	{
-		SO_ENTRY* e = GetSOEntry(so);
-		return e ? true : (alStream ? (e->next >= alStream->Size()) : true);
-	}
-
-	/**
-	 * @param so SoundObject to query index of
-	 * @return A valid pointer if this SoundObject is bound. Otherwise NULL.
-	 */
-	SoundStream::SO_ENTRY* SoundStream::GetSOEntry(const SoundObject* so) const
-	{
-		for (const SO_ENTRY& e : alSources)
-			if (e.obj == so)
-				return (SO_ENTRY*)&e;
-		return nullptr; // not found
-	}
-
-	/**
-	 * Seeks to the specified sample position in the stream.
-	 * @note The SoundObject will stop playing and must be manually restarted!
-	 * @param so SoundObject to perform seek on
-	 * @param samplepos Position in the stream in samples [0..SoundStream::Size()]
-	 */
-	void SoundStream::Seek(SoundObject* so, int samplepos)
-	{
-		if (SO_ENTRY* e = GetSOEntry(so))
-		{
-			// if samplepos out of bounds THEN 0 ELSE convert samplepos to bytepos
-			int bytepos = (samplepos >= Size()) ? 0 : samplepos * xaBuffer->wf.nBlockAlign;
-			ClearStreamData(*e);
-			LoadStreamData(*e, bytepos);
-
-		}
-
-	}
-
-	//// PROTECTED: ////
-
-	/**
-	 * Internal stream function.
-	 * @param soe SoundObject Entry to stream
-	 * @return TRUE if a buffer was streamed
-	 */
-	bool SoundStream::StreamNext(SO_ENTRY& e)
-	{
-		if (e.next >= alStream->Size()) // is EOF?
-			return false;
-
-		// front buffer was processed, swap buffers:
-		std::swap(e.front, e.back);
-
-		e.base = e.next; // shift the base pointer forward
-		if (e.back == xaBuffer) // we can't refill xaBuffer
-		{
-			e.back = CreateXABuffer(this, xaBuffer->wf.nAvgBytesPerSec, alStream, &e.next);
-			if (!e.back)
-				return false; // oh no...
-		}
-		else
-		{
-			if (!e.back) // no backbuffer. probably ClearStreamData() was called
-				return false;
-			StreamXABuffer(e.back, alStream, &e.next);
-		}
-
-		e.obj->Source->SubmitSourceBuffer(e.back); // submit the backbuffer to the queue
-		return true;
-	}
-
-	/**
-	 * [internal] Load streaming data into the specified SoundObject
-	 * at the optionally specified streamposition.
-	 * @param so SoundObject to queue with stream data
-	 * @param streampos [optional] PCM byte position in stream where to seek data from. 
-	 *                  If unspecified (default -1), stream will use the current streampos
-	 */
-	bool SoundStream::LoadStreamData(SO_ENTRY& so, int streampos)
-	{
-		int pos = streampos == -1 ? so.next : streampos; // -1: use next, else use streampos
-		int streamSize = alStream->Size() - pos; // lets calculate stream size from the SEEK position
-		int bytesPerSecond = alStream->BytesPerSecond();
-		int numBuffers = streamSize > bytesPerSecond ? 2 : 1;
-		IXAudio2SourceVoice* source = so.obj->Source;
-
-		so.base = pos;
-		if (pos == 0) // pos 0 means we load alBuffer
-		{
-			pos += xaBuffer->AudioBytes; // update pos
-			source->SubmitSourceBuffer(so.front = xaBuffer);
-		}
-		else // load at arbitrary position
-		{
-			so.front = CreateXABuffer(this, bytesPerSecond, alStream, &pos);
-			source->SubmitSourceBuffer(so.front);
-		}
-
-		if (numBuffers == 2) // also load a backbuffer
-		{
-			so.back = CreateXABuffer(this, bytesPerSecond, alStream, &pos); 
-			source->SubmitSourceBuffer(so.back);
-		}
-		so.next = pos;  // pos variable was updated by CreateXABuffer
-		return true;
-	}
-
-	/**
-	 * [internal] Unloads all queued data for the specified SoundObject
-	 * @param so SoundObject to unqueue and unload data for
-	 */
-	void SoundStream::ClearStreamData(SO_ENTRY& so)
-	{
-		so.busy = TRUE;
-		IXAudio2SourceVoice* source = so.obj->Source;
-		source->Stop();
-		if (GetBuffersQueued(source)) // only flush if we have something to flush
-			source->FlushSourceBuffers();
-
-		if (so.front) {
-			if (so.front != xaBuffer)
-				delete so.front;
-			so.front = nullptr;
-		}
-		if (so.back)
-			delete so.back, so.back = nullptr;
-		so.busy = FALSE;
-	}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-	struct SoundObjectState : public IXAudio2VoiceCallback
-	{
-		SoundObject* sound;
-		bool isInitial;		// is the Sound object Rewinded to its initial position?
-		bool isPlaying;		// is the Voice digesting buffers?
-		bool isLoopable;	// should this sound act as a loopable sound?
-		bool isPaused;		// currently paused?
-		XABuffer shallow;	// a shallow buffer reference (no actual data)
-
-		SoundObjectState(SoundObject* so) 
-			: sound(so), 
-			isInitial(false), isPlaying(false), 
-			isLoopable(false), isPaused(false)
-		{
-		}
-
-		// end of stream was reached (last buffer object was processed)
-		void __stdcall OnStreamEnd() override
-		{
-			if (isLoopable) // loopable?
-				sound->Rewind(); // rewind the sound and continue playing
-			else
-				isPlaying = false;
-		}
-
-		// a buffer object finished processing
-		void __stdcall OnBufferEnd(void* ctx) override
-		{
-			isInitial = false;
-			if (((SoundBuffer*)ctx)->IsStream())
-			{
-				// stream fetch next buffer for this sound
-				((SoundStream*)ctx)->StreamNext(sound);
-			}
-		}
-
-		void __stdcall OnVoiceProcessingPassStart(UINT32 samplesRequired) override {}
-		void __stdcall OnVoiceProcessingPassEnd() override {}
-		void __stdcall OnBufferStart(void* ctx) override {}
-		void __stdcall OnLoopEnd(void* ctx) override {}
-		void __stdcall OnVoiceError(void* ctx, HRESULT error) override {}
-
-	};
-
-
-
-
-
-
-	/**
-	 * Creates an uninitialzed empty SoundObject
-	 */
-	SoundObject::SoundObject()
-		: Sound(nullptr), Source(nullptr), State(nullptr)
-	{
-		memset(&Emitter, 0, sizeof(Emitter));
-		Emitter.ChannelCount = 1;
-		Emitter.CurveDistanceScaler = FLT_MIN;
-	}
-	/**
-	 * Creates a soundobject with an attached buffer
-	 * @param sound SoundBuffer this object uses for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	SoundObject::SoundObject(SoundBuffer* sound, bool loop, bool play)
-		: Sound(nullptr), Source(nullptr), State(nullptr)
-	{
-		memset(&Emitter, 0, sizeof(Emitter));
-		Emitter.ChannelCount = 1;
-		Emitter.CurveDistanceScaler = FLT_MIN;
-
-		if (sound) SetSound(sound, loop);
-		if (play) Play();
-	}
-
-	SoundObject::~SoundObject() // unhooks any sounds and frees resources
-	{
-		if (Sound) SetSound(nullptr);
-		if (Source) Source->DestroyVoice(), Source = nullptr;
-	}
-
-
-
-
-	/**
-	 * Sets the SoundBuffer or SoundStream for this SoundObject. Set NULL to remove and unbind the SoundBuffer.
-	 * @param sound Sound to bind to this object. Can be NULL to unbind sounds from this object.
-	 * @param loop [optional] Sets the sound looping or non-looping. Streams cannot be looped.
-	 */
-	void SoundObject::SetSound(SoundBuffer* sound, bool loop)
-	{
-		if (Sound) Sound->UnbindSource(this); // unbind old, but still keep it around
-		if (sound) // new sound?
-		{
-			if (!Source) // no Source object created yet? First init.
-			{
-				State = new SoundObjectState(this);
-				xEngine->CreateSourceVoice(&Source, sound->WaveFormat(), 0, 2.0F, State);
-			}
-			else if (sound->WaveFormatHash() != Sound->WaveFormatHash()) // WaveFormat has changed?
-			{
-				Source->DestroyVoice(); // Destroy old and re-create with new
-				xEngine->CreateSourceVoice(&Source, sound->WaveFormat(), 0, 2.0F, State);
-			}
-			sound->BindSource(this);
-			State->isInitial = true;
-			State->isPlaying = false;
-			State->isLoopable = loop;
-			State->isPaused = false;
-			Sound = sound; // set new Sound
-		}
-	}
-
-	/**
-	 * @return TRUE if this SoundObject has an attached SoundStream that can be streamed.
-	 */
-	bool SoundObject::IsStreamable() const
-	{
-		return Sound && Sound->IsStream();
-	}
-
-	/**
-	 * @return TRUE if this SoundObject is streamable and the End Of Stream was reached.
-	 */
-	bool SoundObject::IsEOS() const
-	{
-		return Sound && Sound->IsStream() && ((SoundStream*)Sound)->IsEOS(this);
-	}
-
-
-	/**
-	 * Starts playing the sound. If the sound is already playing, it is rewinded and played again from the start.
-	 */
-	void SoundObject::Play()
-	{
-		if (State->isPlaying) Rewind();		// rewind to start of stream and continue playing
-		else if (Source)
-		{
-			State->isPlaying = true;
-			State->isPaused = false;
-			if (!GetBuffersQueued(Source))		// no buffers queued (track probably finished)
-			{
-				State->isInitial = true;
-				Sound->ResetBuffer(this);	// reset buffer to beginning
-			}
-			Source->Start();				// continue if paused or suspended
-		}
-	}
-
-	/**
-	 * Starts playing a new sound. Any older playing sounds will be stopped and replaced with this sound.
-	 * @param sound SoundBuffer or SoundStream to start playing
-	 * @param loop [false] Sets if the sound is looping or not. Streams are never loopable.
-	 */
-	void SoundObject::Play(SoundBuffer* sound, bool loop)
-	{
-		SetSound(sound, loop);
-		Play();
-	}
-	/**
-	 * Stops playing the sound and unloads streaming buffers.
-	 */
-	void SoundObject::Stop()
-	{
-		if (Source && State->isPlaying) { // only if isPlaying, to avoid rewind
-			State->isPlaying = false;
-			State->isPaused = false;
-			Source->Stop();
-			Source->FlushSourceBuffers();
-		}
-	}
-	/**
-	 * Temporarily pauses sound playback and doesn't unload any streaming buffers.
-	 */
-	void SoundObject::Pause()
-	{
-		if (Source)
-		{
-			State->isPlaying = false;
-			State->isPaused = true;
-			Source->Stop(); // Stop() effectively pauses playback
-		}
-	}
-	/**
-	 * If current status is Playing, then this rewinds to start of the soundbuffer/stream and starts playing again.
-	 * If current status is NOT playing, then any stream resources are freed and the object is reset.
-	 */
-	void SoundObject::Rewind()
-	{
-		Sound->ResetBuffer(this); // reset stream or buffer to initial state
-		State->isInitial = true;
-		State->isPaused = false;
-		if (State->isPlaying) // should we continue playing?
-		{
-			Source->Start();
-		}
-	}
-
-	/**
-	 * @return TRUE if the sound source is PLAYING.
-	 */
-	bool SoundObject::IsPlaying() const
-	{
-		return State && State->isPlaying;
-	}
-
-	/**
-	 * @return TRUE if the sound source is STOPPED.
-	 */
-	bool SoundObject::IsStopped() const
-	{
-		return !State || !State->isPlaying;
-	}
-
-	/**
-	 * @return TRUE if the sound source is PAUSED.
-	 */
-	bool SoundObject::IsPaused() const
-	{
-		return State && State->isPaused;
-	}
-
-	/**
-	 * @return TRUE if the sound source is at the beginning of the sound buffer.
-	 */
-	bool SoundObject::IsInitial() const
-	{
-		return State && State->isInitial;
-	}
-
-
-	/**
-	 * @return TRUE if the sound source is in LOOPING mode.
-	 */
-	bool SoundObject::IsLooping() const
-	{
-		return State && State->isLoopable;
-	}
-
-	/**
-	 * Sets the looping mode of the sound source.
-	 */
-	void SoundObject::Looping(bool looping)
-	{
-		if (State) State->isLoopable = looping;
-	}
-
-	/**
-	 * Indicates the gain (volume amplification) applied. Range [0.0f .. 1.0f]
-	 * Each division by 2 equals an attenuation of -6dB. Each multiplicaton with 2 equals an amplification of +6dB.
-	 * A value of 0.0 is meaningless with respect to a logarithmic scale; it is interpreted as zero volume - the channel is effectively disabled.
-	 * @param gain Gain value between 0.0..1.0
-	 */
-	void SoundObject::Volume(float volume)
-	{
-		Source->SetVolume(volume);
-	}
-
-	/**
-	 * @return Current gain value of this source
-	 */
-	float SoundObject::Volume() const
-	{
-		float volume;
-		Source->GetVolume(&volume);
-		return volume;
-	}
-
-	/**
-	 * @return Gets the current playback position in the SoundBuffer or SoundStream in SAMPLES
-	 */
-	int SoundObject::PlaybackPos() const
-	{
-		if (!Source) return 0;
-		XAUDIO2_VOICE_STATE state;
-		Source->GetState(&state);
-		return (int)state.SamplesPlayed;
-	}
-
-	/**
-	 * Sets the playback position of the underlying SoundBuffer or SoundStream in SAMPLES
-	 */
-	void SoundObject::PlaybackPos(int seekpos)
-	{
-		if (!Sound) return;
-		if (Sound->IsStream()) // stream objects
-		{
-			((SoundStream*)Sound)->Seek(this, seekpos); // seek the stream
-		}
-		else // single buffer objects
-		{
-			// first create a shallow copy of the xaBuffer:
-			XABuffer& shallow = State->shallow = *Sound->xaBuffer;
-			shallow.PlayBegin = seekpos;
-			shallow.PlayLength = shallow.nPCMSamples - seekpos;
-
-			State->isPaused = false;
-			Source->Stop();
-			if (GetBuffersQueued(Source)) // only flush if there is something to flush
-				Source->FlushSourceBuffers();
-			Source->SubmitSourceBuffer(&shallow);
-		}
-		if (State->isPlaying) 
-			Source->Start();
-	}
-
-	/**
-	 * @return Playback size of the underlying SoundBuffer or SoundStream in SAMPLES
-	 */
-	int SoundObject::PlaybackSize() const
-	{
-		return Sound ? Sound->Size() : 0;
-	}
-
-
-	/**
-	 * @return Number of samples processed every second (aka SampleRate or Frequency)
-	 */
-	int SoundObject::SamplesPerSecond() const
-	{
-		return Sound ? Sound->Frequency() : 0;
-	}
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-	/**
-	 * Creates an uninitialzed Sound2D, but also
-	 * setups the sound source as an environment/bakcground sound.
-	 */
-	Sound::Sound() : SoundObject()
-	{
-		Reset();
-	}
-	/**
-	 * Creates a Sound2D with an attached buffer
-	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	Sound::Sound(SoundBuffer* sound, bool loop, bool play) : SoundObject(sound, loop, play)
-	{
-		Reset();
-	}
-
-	/**
-	 * Resets all background audio parameters to their defaults
-	 */
-	void Sound::Reset()
-	{
-
-	}
-
-
-
-
-
-
-
-
-
-
-
-	/**
-	 * Creates an uninitialzed Sound3D, but also
-	 * setups the sound source as a 3D positional sound.
-	 */
-	Sound3D::Sound3D() : SoundObject()
-	{
-		Reset();
-	}
-	/**
-	 * Creates a Sound3D with an attached buffer
-	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	Sound3D::Sound3D(SoundBuffer* sound, bool loop, bool play) : SoundObject(sound, loop, play)
-	{
-		Reset();
-	}
-
-	/**
-	 * Resets all 3D positional audio parameters to their defaults
-	 */
-	void Sound3D::Reset()
-	{
-
-	}
-
-	/**
-	 * Sets the 3D position of this Sound3D object
-	 * @param x Position x component
-	 * @param y Position Y component
-	 * @param z Position z component
-	 */
-	void Sound3D::Position(float x, float y, float z)
-	{
-
-	}
-
-	/**
-	 * Sets the 3D position of this Sound3D object
-	 * @param xyz Float vector containing 3D position X Y Z components
-	 */
-	void Sound3D::Position(float* xyz)
-	{
-	}
-
-	/**
-	 * @return 3D position vector of this SoundObject
-	 */
-	Vector3 Sound3D::Position() const
-	{
-		float xyz[3];
-		return Vector3(xyz[0], xyz[1], xyz[2]);
-	}
-
-	/**
-	 * Sets the 3D direction of this Sound3D object
-	 * @param x Direction x component
-	 * @param y Direction Y component
-	 * @param z Direction z component
-	 */
-	void Sound3D::Direction(float x, float y, float z)
-	{
-
-	}
-
-	/**
-	 * Sets the 3D direction of this Sound3D object
-	 * @param xyz Float vector containing 3D direction X Y Z components
-	 */
-	void Sound3D::Direction(float* xyz)
-	{
-	}
-
-	/**
-	 * @return 3D direction vector of this SoundObject
-	 */
-	Vector3 Sound3D::Direction() const
-	{
-		float xyz[3];
-		return Vector3(xyz[0], xyz[1], xyz[2]);
-	}
-
-	/**
-	 * Sets the 3D velocity of this Sound3D object
-	 * @param x Velocity x component
-	 * @param y Velocity Y component
-	 * @param z Velocity z component
-	 */
-	void Sound3D::Velocity(float x, float y, float z)
-	{
-
-	}
-
-	/**
-	 * Sets the 3D velocity of this Sound3D object
-	 * @param xyz Float vector containing 3D velocity X Y Z components
-	 */
-	void Sound3D::Velocity(float* xyz)
-	{
-	}
-
-	/**
-	 * @return 3D velocity vector of this SoundObject
-	 */
-	Vector3 Sound3D::Velocity() const
-	{
-		float xyz[3];
-		return Vector3(xyz[0], xyz[1], xyz[2]);
-	}
-
-	/**
-	 * Sets the position of this SoundObject as relative to the global listener
-	 * @param isrelative TRUE if the position of this SoundObject is relative
-	 */
-	void Sound3D::Relative(bool isrelative)
-	{
-	}
-
-	/**
-	 * @return TRUE if the position of this SoundObject is relative
-	 */
-	bool Sound3D::IsRelative() const
-	{
-		return false;
-	}
-
-
-	void Sound3D::MaxDistance(float maxdist)
-	{
-	}
-	float Sound3D::MaxDistance() const
-	{
-		return 0.0f;
-	}
-
-	void Sound3D::RolloffFactor(float rolloff)
-	{
-	}
-	float Sound3D::RolloffFactor() const
-	{
-		return 0.0f;
-	}
-
-	void Sound3D::ReferenceDistance(float refdist)
-	{
-	}
-	float Sound3D::ReferenceDistance() const
-	{
-		return 0.0f;
-	}
-
-	void Sound3D::ConeOuterGain(float value)
-	{
-	}
-	float Sound3D::ConeOuterGain() const
-	{
-		return 0.0f;
-	}
-
-	void Sound3D::ConeInnerAngle(float angle)
-	{
-	}
-	float Sound3D::ConeInnerAngle() const
-	{
-		return 0.0f;
-	}
-
-	/**
-	 * Sets the outer sound cone angle in degrees. Default is 360.
-	 * Outer cone angle cannot be smaller than inner cone angle
-	 * @param angle Angle 
-	 */
-	void Sound3D::ConeOuterAngle(float angle)
-	{
-		float innerAngle = ConeInnerAngle();
-		if (angle < innerAngle)
-			angle = innerAngle;
-	}
-	float Sound3D::ConeOuterAngle() const
-	{
-		return 0.0f;
-	}
-
-
-
-
-
-
-
-
-
-
-
-
-	/**
-	 * Sets the master gain value (Volume) of the listener object for Audio3D.
-	 * Valid range is [0.0 - Any], meaning the global volume can be increased
-	 * until the sound starts distorting. WARNING! This does not change system volume!
-	 * @param gain Gain value to set for the listener. Range[0.0 - Any].
-	 */
-	void Listener::Volume(float gain)
-	{
-		if (gain < 0.0f) gain = 0.0f;
-		xMaster->SetVolume(gain);
-	}
-
-	/**
-	 * Gets the master gain value (Volume) of the listener object for Audio3D.
-	 * Valid range is [0.0 - Any], meaning the global volume can be increased
-	 * until the sound starts distorting. WARNING! This does not change system volume!
-	 * @return Master gain value (Volume). Range[0.0 - Any].
-	 */
-	float Listener::Volume()
-	{
-		float value;
-		xMaster->GetVolume(&value);
-		return value;
-	}
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param pos Vector containing x y z components of the position
-	 */
-	void Listener::Position(const Vector3& pos)
-	{
-
-	}
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param x X component of the new position
-	 * @param y Y component of the new position
-	 * @param z Z component of the new position
-	 */
-	void Listener::Position(float x, float y, float z)
-	{
-
-	}
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param xyz Float array containing x y z components of the position
-	 */
-	void Listener::Position(float* xyz)
-	{
-
-	}
-
-	/**
-	 * @return Position of the listener object for Audio3D
-	 */
-	Vector3 Listener::Position()
-	{
-		float xyz[3];
-		return Vector3(xyz[0], xyz[1], xyz[2]);
-	}
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param pos Vector containing x y z components of the velocity
-	 */
-	void Listener::Velocity(const Vector3& vel)
-	{
-
-	}
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param x X component of the new velocity
-	 * @param y Y component of the new velocity
-	 * @param z Z component of the new velocity
-	 */
-	void Listener::Velocity(float x, float y, float z)
-	{
-
-	}
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param xyz Float array containing x y z components of the velocity
-	 */
-	void Listener::Velocity(float* xyz)
-	{
-	}
-
-	/**
-	 * @return Velocity of the listener object for Audio3D
-	 */
-	Vector3 Listener::Velocity()
-	{
-		float xyz[3];
-		return Vector3(xyz[0], xyz[1], xyz[2]);
-	}
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param target Vector containing x y z components of target where to 'look', thus changing the orientation.
-	 * @param up Vector containing x y z components of the orientation 'up' vector
-	 */
-	void Listener::LookAt(const Vector3& target, const Vector3& up)
-	{
-		LookAt(target.x, target.y, target.z, up.x, up.y, up.z);
-	}
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param x X component of the new direction
-	 * @param y Y component of the new direction
-	 * @param z Z component of the new direction
-	 */
-	void Listener::LookAt(float xAT, float yAT, float zAT, float xUP, float yUP, float zUP)
-	{
-		LookAt(Vector3(xAT, yAT, zAT), Vector3(xUP, yUP, zUP));
-	}
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param xyzATxyzUP Float array containing x y z components of the direction
-	 */
-	void Listener::LookAt(float* xyzATxyzUP)
-	{
-	}
-
-	/**
-	 * @return Target position of the listener object's orientation
-	 */
-	Vector3 Listener::Target()
-	{
-		float xyzATxyzUP[6];
-		return Vector3(xyzATxyzUP[0], xyzATxyzUP[1], xyzATxyzUP[2]);
-	}
-
-	/**
-	 * @return Up vector of the listener object's orientation
-	 */
-	Vector3 Listener::Up()
-	{
-		float xyzATxyzUP[6];
-		return Vector3(xyzATxyzUP[3], xyzATxyzUP[4], xyzATxyzUP[5]);
-	}
-
-
-} // namespace S3D
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "Sound3D.h"
+#include "PCMConvert.h"
+#include "PCMCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>		// offsetof
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <Windows.h>
+#include <Psapi.h>		// GetProcessMemoryInfo
+#include <avrt.h>		// MMCSS
+
+#pragma comment(lib, "XAudio2_7/X3DAudio.lib")
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "avrt.lib")
+
+#ifdef _DEBUG
+#define indebug(x) x
+#else
+#define indebug(x) // ...
+#endif
+
+namespace S3D 
+{
+
+	/**
+	 * Guards the sound and zone lists and Source voice swaps of an Engine against its spatial pass.
+	 * The game thread Locks, the XAudio2 thread only TryLocks and skips the pass if it's busy,
+	 * so the audio thread never blocks and XAudio2 calls made under the lock can't deadlock.
+	 */
+	struct SpatialMutex
+	{
+		CRITICAL_SECTION cs;
+		SpatialMutex()  { InitializeCriticalSection(&cs); }
+		~SpatialMutex() { DeleteCriticalSection(&cs); }
+		void Lock()     { EnterCriticalSection(&cs); }
+		void Unlock()   { LeaveCriticalSection(&cs); }
+		bool TryLock()  { return TryEnterCriticalSection(&cs) ? true : false; }
+	};
+
+
+	static __declspec(thread) int xCommandDepth; // nesting of recorded API calls on this thread
+
+	/**
+	 * Marks a public API call for the CommandRecorder. Calls made from inside another
+	 * recorded call are not recorded, replaying the outer call makes them again.
+	 */
+	struct CommandScope
+	{
+		const bool record;	// outermost call on this thread, while recording
+		CommandScope() : record(xCommandDepth++ == 0 && CommandRecorder::IsRecording()) {}
+		~CommandScope() { --xCommandDepth; }
+	};
+
+	static inline void RecordVector(CommandOp op, const void* object, float x, float y, float z)
+	{
+		const float args[3] = { x, y, z };
+		RecordCommand(op, object, nullptr, 0, args, 3);
+	}
+
+
+	/**
+	 * @return Audio clock time in seconds. All transform updates are stamped with this clock.
+	 */
+	static double AudioClock()
+	{
+		static double period = 0.0;
+		LARGE_INTEGER t;
+		if (!period)
+		{
+			QueryPerformanceFrequency(&t);
+			period = 1.0 / double(t.QuadPart);
+		}
+		QueryPerformanceCounter(&t);
+		return double(t.QuadPart) * period;
+	}
+
+
+	static inline X3DAUDIO_VECTOR Vec(float x, float y, float z) { X3DAUDIO_VECTOR v = { x, y, z }; return v; }
+	static inline X3DAUDIO_VECTOR Lerp(const X3DAUDIO_VECTOR& a, const X3DAUDIO_VECTOR& b, float t)
+	{
+		return Vec(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t);
+	}
+	static inline X3DAUDIO_VECTOR Normalize(const X3DAUDIO_VECTOR& v, const X3DAUDIO_VECTOR& fallback)
+	{
+		float len = sqrtf(v.x*v.x + v.y*v.y + v.z*v.z);
+		if (len < 1e-6f) return fallback;
+		return Vec(v.x / len, v.y / len, v.z / len);
+	}
+
+
+	/**
+	 * A single timestamped transform update
+	 */
+	struct TransformKey
+	{
+		X3DAUDIO_VECTOR pos;	// position
+		X3DAUDIO_VECTOR front;	// normalized front orientation
+		X3DAUDIO_VECTOR top;	// normalized top orientation
+		X3DAUDIO_VECTOR vel;	// velocity, only used if it was set explicitly
+		double time;			// AudioClock() time of the update
+	};
+
+	/**
+	 * The two most recent transform updates of an emitter or the listener.
+	 * One game thread Pushes, the XAudio2 thread Samples through a sequence lock.
+	 */
+	struct TransformTrack
+	{
+		static const double CoalesceTime;		// updates closer than this belong to the same game tick
+		static const double MaxInterval;		// longer gaps between updates are teleports
+		static const double MaxExtrapolation;	// how far past the last update we extrapolate
+
+		TransformKey prev, last;
+		bool hasVelocity;		// velocity was set explicitly, otherwise it's derived from the positions
+		volatile LONG seq;		// odd while the game thread is writing
+
+		TransformTrack() : hasVelocity(false), seq(0) {}
+
+		/**
+		 * Discards the history and jumps to the specified transform
+		 */
+		void Reset(const TransformKey& key, bool velocity)
+		{
+			InterlockedIncrement(&seq);
+			prev = last = key;
+			hasVelocity = velocity;
+			InterlockedIncrement(&seq);
+		}
+
+		/**
+		 * Pushes a new update. Setting Position, Direction and Velocity in the same tick only adds one key.
+		 */
+		void Push(const TransformKey& key, bool velocity)
+		{
+			InterlockedIncrement(&seq);
+			double dt = key.time - last.time;
+			if (dt > MaxInterval) // too old to interpolate from
+				prev = key;
+			else if (dt >= CoalesceTime)
+				prev = last;
+			double time = dt >= CoalesceTime ? key.time : last.time;
+			last = key;
+			last.time = time;
+			if (velocity) hasVelocity = true;
+			InterlockedIncrement(&seq);
+		}
+
+		/**
+		 * [audio thread] Samples the transform at (now - delay)
+		 * @param now Current AudioClock() time
+		 * @param delay Interpolation delay in seconds, negative to use the update interval
+		 * @param out Receives the interpolated or extrapolated transform
+		 */
+		void Sample(double now, float delay, TransformKey& out) const
+		{
+			TransformKey a, b;
+			bool velocity;
+			LONG s;
+			do {
+				s = seq;
+				MemoryBarrier();
+				a = prev, b = last, velocity = hasVelocity;
+				MemoryBarrier();
+			} while ((s & 1) || s != seq);
+
+			const double span = b.time - a.time;
+			if (span <= 0.0) // single update, nothing to interpolate
+			{
+				out = b;
+				if (!velocity) out.vel = Vec(0.0f, 0.0f, 0.0f);
+				return;
+			}
+
+			// f in [0..1] interpolates between the updates, beyond 1 extrapolates from the last one
+			const double wait = delay < 0.0f ? span : delay;
+			double f = (now - wait - a.time) / span;
+			double fmax = 1.0 + MaxExtrapolation / span;
+			if (f < 0.0) f = 0.0;
+			else if (f > fmax) f = fmax;
+			const float t = float(f);
+			const float o = t < 1.0f ? t : 1.0f; // orientation is never extrapolated
+
+			out.pos   = Lerp(a.pos, b.pos, t);
+			out.front = Normalize(Lerp(a.front, b.front, o), b.front);
+			out.top   = Normalize(Lerp(a.top, b.top, o), b.top);
+			if (velocity)
+				out.vel = Lerp(a.vel, b.vel, o);
+			else
+			{
+				const float inv = float(1.0 / span);
+				out.vel = Vec((b.pos.x - a.pos.x) * inv, (b.pos.y - a.pos.y) * inv, (b.pos.z - a.pos.z) * inv);
+			}
+			out.time = now - wait;
+		}
+	};
+
+	const double TransformTrack::CoalesceTime     = 0.002;
+	const double TransformTrack::MaxInterval      = 0.25;
+	const double TransformTrack::MaxExtrapolation = 0.1;
+
+	static TransformKey MakeKey(const X3DAUDIO_VECTOR& pos, const X3DAUDIO_VECTOR& front,
+								const X3DAUDIO_VECTOR& top, const X3DAUDIO_VECTOR& vel)
+	{
+		TransformKey key = { pos, front, top, vel, AudioClock() };
+		return key;
+	}
+
+
+	/**
+	 * Holds the timestamped transform updates of a Sound3D
+	 */
+	struct SpatialState
+	{
+		enum { MaxSrcChannels = 2, MaxDstChannels = 8 };
+
+		TransformTrack track;								// transform updates from the game thread
+		Attenuation atten;									// distance and cone attenuation parameters
+		float matrix[MaxSrcChannels * MaxDstChannels];		// [audio thread] output matrix to the master
+		bool propagation;									// delay Play() by the propagation time
+		volatile bool relative;								// listener relative, statically panned on the game thread
+		volatile double startTime;							// AudioClock() time of a scheduled start, 0 if none
+		volatile bool isVirtual;							// inaudible stream without buffers, only time advances
+		double virtualTime;									// AudioClock() time when the stream became virtual
+		int virtualPos;										// stream position in samples when it became virtual
+
+		SpatialState() : propagation(false), relative(false), startTime(0.0), isVirtual(false), virtualTime(0.0), virtualPos(0) {}
+	};
+
+	// X3DAudio only pans, the distance and cone gains are applied from Attenuation
+	static X3DAUDIO_DISTANCE_CURVE_POINT xFlatCurvePoints[2] = { { 0.0f, 1.0f }, { 1.0f, 1.0f } };
+	static X3DAUDIO_DISTANCE_CURVE xFlatCurve = { xFlatCurvePoints, 2 };
+
+	/**
+	 * Per processing pass SoA data of all playing Sound3D objects.
+	 * Capacity is reserved on the game thread when Sound3D objects are created,
+	 * so the spatial pass never allocates.
+	 */
+	struct SpatialBatch
+	{
+		std::vector<Sound3D*> sounds;					// playing sounds in this pass
+		std::vector<TransformKey> keys;					// sampled transform of each sound
+		std::vector<float> distances;					// distance of each sound from the listener
+		std::vector<const FalloffCurve*> volumeCurves;	// SoundBuffer curves of each sound, may be NULL
+		std::vector<const FalloffCurve*> lowpassCurves;
+		std::vector<const FalloffCurve*> reverbCurves;
+		std::vector<float> volumes;						// evaluated curves of each sound
+		std::vector<float> lowpasses;
+		std::vector<float> reverbs;
+
+		void Reserve(size_t n)
+		{
+			sounds.reserve(n), keys.reserve(n), distances.reserve(n);
+			volumeCurves.reserve(n), lowpassCurves.reserve(n), reverbCurves.reserve(n);
+			volumes.reserve(n), lowpasses.reserve(n), reverbs.reserve(n);
+		}
+
+		void Clear()
+		{
+			sounds.clear(), keys.clear(), distances.clear();
+			volumeCurves.clear(), lowpassCurves.clear(), reverbCurves.clear();
+		}
+
+		/**
+		 * Evaluates all curves of all sounds, 4 sounds at a time
+		 */
+		void Evaluate()
+		{
+			const int count = (int)sounds.size();
+			volumes.resize(count), lowpasses.resize(count), reverbs.resize(count); // within reserved capacity
+			if (!count) return;
+			FalloffCurve::EvaluateBatch(volumeCurves.data(),  distances.data(), volumes.data(),   count);
+			FalloffCurve::EvaluateBatch(lowpassCurves.data(), distances.data(), lowpasses.data(), count);
+			FalloffCurve::EvaluateBatch(reverbCurves.data(),  distances.data(), reverbs.data(),   count);
+		}
+	};
+
+	static float xStereoAzimuths[2] = { X3DAUDIO_PI * 1.5f, X3DAUDIO_PI * 0.5f }; // left, right
+
+
+	static volatile LONG xMixerPriority = PRIORITY_NORMAL;	// AudioThreads settings
+	static volatile LONG xMixerAffinity = 0;
+	static volatile LONG xMixerSettings = 0;				// bumped on every change, mixers reapply
+	static ThreadPriority xWorkerPriority = PRIORITY_NORMAL;
+	static unsigned xWorkerAffinity = 0;
+
+	/**
+	 * Scheduling of an audio thread, applied by the thread itself
+	 */
+	struct ThreadSchedule
+	{
+		HANDLE task;				// MMCSS task of the thread, NULL if it hasn't joined one
+		int basePriority;			// priority before the first change, THREAD_PRIORITY_ERROR_RETURN if unchanged
+		bool pinned;				// affinity was restricted
+		LONG applied;				// xMixerSettings applied last
+		ThreadPriority priority;	// priority the thread actually runs at, whatever was asked for
+
+		ThreadSchedule() : task(nullptr), basePriority(THREAD_PRIORITY_ERROR_RETURN), 
+			pinned(false), applied(-1), priority(PRIORITY_NORMAL) {}
+
+		/**
+		 * Applies a priority and CPU affinity to the calling thread. PRIORITY_NORMAL and 
+		 * a 0 mask restore what the thread had before. A thread that already runs higher
+		 * than asked, like the XAudio2 processing thread, is never lowered.
+		 */
+		void Apply(int wanted, unsigned affinity)
+		{
+			HANDLE thread = GetCurrentThread();
+			if (basePriority == THREAD_PRIORITY_ERROR_RETURN)
+				basePriority = GetThreadPriority(thread);
+			if (task && wanted != PRIORITY_REALTIME)
+			{
+				AvRevertMmThreadCharacteristics(task);
+				task = nullptr;
+			}
+
+			if (wanted == PRIORITY_REALTIME)
+			{
+				DWORD taskIndex = 0;
+				if (!task) task = AvSetMmThreadCharacteristicsA("Pro Audio", &taskIndex);
+				if (task) AvSetMmThreadPriority(task, AVRT_PRIORITY_CRITICAL);
+				else SetThreadPriority(thread, Raised(THREAD_PRIORITY_TIME_CRITICAL)); // no MMCSS service
+			}
+			else if (wanted == PRIORITY_HIGH)
+				SetThreadPriority(thread, Raised(THREAD_PRIORITY_HIGHEST));
+			else 
+				SetThreadPriority(thread, basePriority);
+
+			const int now = GetThreadPriority(thread);
+			priority = task || now >= THREAD_PRIORITY_TIME_CRITICAL ? PRIORITY_REALTIME :
+					   now >= THREAD_PRIORITY_HIGHEST ? PRIORITY_HIGH : PRIORITY_NORMAL;
+
+			if (affinity || pinned)
+			{
+				DWORD_PTR processMask, systemMask;
+				GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask);
+				DWORD_PTR mask = affinity ? DWORD_PTR(affinity) & processMask : processMask;
+				if (mask && SetThreadAffinityMask(thread, mask))
+					pinned = affinity && mask != processMask;
+				indebug(if (!mask) printf("AudioThreads: affinity %x has no CPUs of this process\n", affinity));
+			}
+		}
+
+		/**
+		 * @return The wanted thread priority, or the base priority if that is higher already
+		 */
+		int Raised(int wanted) const
+		{
+			return basePriority > wanted ? basePriority : wanted;
+		}
+	};
+
+	struct EngineState;
+	static void DetachSoundSlots(EngineState& engine);
+	static void FreeSoundCommands(EngineState& engine);
+
+	/**
+	 * Runs the spatial pass of an Engine at the start of every XAudio2 processing pass
+	 */
+	struct SpatialEngine : public IXAudio2EngineCallback
+	{
+		EngineState* state;	// engine whose sounds this pass spatializes
+		double passStart;	// AudioClock() time at the start of the current pass
+		double lastPass;	// AudioClock() time at the start of the previous spatial pass
+		unsigned passes;	// number of spatial passes, alternates the half rate sounds
+		ThreadSchedule schedule; // AudioThreads settings of the processing thread
+
+		SpatialEngine() : state(nullptr), passStart(0.0), lastPass(0.0), passes(0) {}
+
+		void __stdcall OnProcessingPassStart() override;
+		void __stdcall OnProcessingPassEnd() override;
+		void __stdcall OnCriticalError(HRESULT error) override {}
+
+		/**
+		 * Applies changed AudioThreads settings and measures how late the thread woke up
+		 */
+		void Schedule(double prevStart, double now);
+
+		/**
+		 * Bypasses the reverb of zones whose sends stayed inaudible for longer than the reverb
+		 * decay time, so the tail has already died out. Bypassed buses are muted, their dry sends
+		 * don't leak through. Zones resume as soon as a send is audible.
+		 */
+		void UpdateZoneBypass(int level, float elapsed);
+	};
+
+
+	/**
+	 * @return Page faults of this process so far. Win32 doesn't count faults per thread.
+	 */
+	static DWORD ProcessPageFaults()
+	{
+		PROCESS_MEMORY_COUNTERS counters = { sizeof(counters) };
+		return GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ? counters.PageFaultCount : 0;
+	}
+
+	/**
+	 * Everything an Engine owns. Each engine has its own XAudio2 instance, so its spatial pass
+	 * runs on its own processing thread and never touches the state of another engine.
+	 */
+	struct EngineState
+	{
+		Engine* owner;							// the public Engine object
+		LONG id;								// unique id, a new Engine may reuse the address of a destroyed one
+		IXAudio2* xaudio;						// the core engine for XAudio2
+		IXAudio2MasteringVoice* master;			// the Mastering voice is the LISTENER / mixer of this engine
+		X3DAUDIO_HANDLE x3daudio;				// X3DSound
+		X3DAUDIO_LISTENER listener;				// listener position for X3DSound
+		std::vector<Sound3D*> sounds;			// all Sound3D objects, they send to every ReverbZone
+		std::vector<ReverbZone*> zones;			// all ReverbZones
+		UINT32 masterChannels;					// number of output channels of the mastering voice
+		Vector3 listenerTarget;					// last Listener::LookAt target
+		Vector3 listenerUp;						// last Listener::LookAt up vector
+		volatile float interpolation;			// Listener::Interpolation delay in seconds
+		float speedOfSound;						// world units per second, for doppler and propagation delay
+		float propagationBudget;				// maximum propagation delay in seconds
+		float virtualThreshold;					// streams quieter than this (-60dB) become virtual
+		float governorBudget;					// Governor budget per pass in milliseconds, 0: disabled
+		volatile int governorLevel;				// current GovernorLevel, read by the audio thread
+		volatile float passMillis;				// smoothed processing pass time in milliseconds
+		double governorChange;					// AudioClock() time of the last level change
+		std::vector<GovernorTransition> transitions; // level changes since the last GetAudioStats
+		DWORD pageFaults;						// process page fault count at the last GetAudioStats
+		volatile int mixerPriority;				// ThreadPriority the processing thread got
+		volatile float wakeupLate;				// smoothed wakeup lateness of the processing thread in ms
+		volatile float wakeupLateMax;			// worst wakeup lateness since the last GetAudioStats
+		SLIST_HEADER commands;					// SoundTable calls posted to this engine, run by Update()
+		EffectChain masterEffects;				// Listener::Effects on the mastering voice
+		SpatialMutex mutex;						// guards sounds, zones and Source voice swaps
+		SpatialBatch batch;						// [audio thread] batch of the current spatial pass
+		TransformTrack listenerTrack;			// transform updates of the listener
+		SpatialEngine spatial;					// spatial pass callback of the XAudio2 instance
+
+		EngineState(Engine* owner) 
+			: owner(owner), id(0), xaudio(nullptr), master(nullptr), masterChannels(0), listenerUp(0.0f, 1.0f, 0.0f), 
+			interpolation(-1.0f), speedOfSound(340.29f), propagationBudget(2.0f), virtualThreshold(0.001f), 
+			governorBudget(0.0f), governorLevel(GOVERNOR_FULL_QUALITY), passMillis(0.0f), governorChange(0.0), 
+			pageFaults(ProcessPageFaults()), mixerPriority(PRIORITY_NORMAL), wakeupLate(0.0f), wakeupLateMax(0.0f)
+		{
+			memset(&x3daudio, 0, sizeof(x3daudio));
+			memset(&listener, 0, sizeof(listener));
+			listener.OrientFront = Vec(0.0f, 0.0f, 1.0f); // facing +Z, up +Y
+			listener.OrientTop = Vec(0.0f, 1.0f, 0.0f);
+			spatial.state = this;
+			InitializeSListHead(&commands);
+		}
+	};
+
+
+	struct SpatialLock
+	{
+		SpatialMutex& mutex;
+		SpatialLock(EngineState& engine) : mutex(engine.mutex) { mutex.Lock(); }
+		~SpatialLock() { mutex.Unlock(); }
+	};
+
+
+	static SpatialMutex xEnginesMutex;				// guards xEngines and xDefaultEngine
+	static std::vector<EngineState*> xEngines;		// all existing engines
+	static Engine* xDefaultEngine;					// engine of the threads that never called MakeCurrent()
+	static volatile LONG xEngineIds;				// last EngineState::id given out
+	static volatile LONG xEnginesDestroyed;			// bumped by ~Engine, threads then check their current engine again
+	static __declspec(thread) Engine* xCurrentEngine; // Engine::MakeCurrent() of this thread
+	static __declspec(thread) LONG xCurrentEngineId;  // its EngineState::id
+	static __declspec(thread) LONG xCurrentChecked;   // xEnginesDestroyed when xCurrentEngine was last checked
+
+	/**
+	 * @return The MakeCurrent() engine of the calling thread, NULL if there is none or it was destroyed
+	 */
+	static Engine* ThreadEngine()
+	{
+		if (!xCurrentEngine || xCurrentChecked == xEnginesDestroyed)
+			return xCurrentEngine; // no engine was destroyed since the last check
+		xEnginesMutex.Lock();
+		Engine* current = nullptr;
+		for (EngineState* engine : xEngines)
+			if (engine->owner == xCurrentEngine && engine->id == xCurrentEngineId)
+				current = xCurrentEngine;
+		xCurrentChecked = xEnginesDestroyed;
+		xEnginesMutex.Unlock();
+		return xCurrentEngine = current;
+	}
+
+	/**
+	 * Locks the spatial pass of every engine, for state that all engines share (SoundBuffer curves)
+	 */
+	struct SpatialLockAll
+	{
+		SpatialLockAll()
+		{
+			xEnginesMutex.Lock();
+			for (EngineState* engine : xEngines) engine->mutex.Lock();
+		}
+		~SpatialLockAll()
+		{
+			for (EngineState* engine : xEngines) engine->mutex.Unlock();
+			xEnginesMutex.Unlock();
+		}
+	};
+
+	/**
+	 * @return State of the current Engine of the calling thread
+	 */
+	static inline EngineState& CurrentState()
+	{
+		return *Engine::Current()->State();
+	}
+
+
+	void __stdcall SpatialEngine::OnProcessingPassStart()
+	{
+		EngineState& engine = *state;
+		const double prevStart = passStart;
+		const double now = passStart = AudioClock();
+		Schedule(prevStart, now); // new AudioThreads settings take system calls, outside the real-time checks
+		RealtimeScope realtime;
+		if (!engine.mutex.TryLock())
+			return; // the game thread is adding or removing voices, keep last pass' parameters
+
+		const float delay = engine.interpolation;
+		X3DAUDIO_LISTENER listener = engine.listener;
+		TransformKey key;
+		engine.listenerTrack.Sample(now, delay, key);
+		listener.Position = key.pos;
+		listener.OrientFront = key.front;
+		listener.OrientTop = key.top;
+		listener.Velocity = key.vel;
+
+		// gather all playing sounds, evaluate their curves in one SIMD batch, then apply
+		SpatialBatch& batch = engine.batch;
+		batch.Clear();
+		for (Sound3D* sound : engine.sounds)
+			sound->BeginSpatial(batch, listener, now);
+		batch.Evaluate();
+		for (ReverbZone* zone : engine.zones)
+			zone->passPeak = 0.0f;
+		const int level = engine.governorLevel;
+		const unsigned parity = ++passes & 1;
+		for (int i = 0; i < (int)batch.sounds.size(); ++i)
+			if (level < GOVERNOR_HALF_RATE_SPATIAL || (i & 1) == parity)
+				batch.sounds[i]->ApplySpatial(batch, i, listener);
+		UpdateZoneBypass(level, float(now - lastPass));
+		lastPass = now;
+
+		engine.mutex.Unlock();
+	}
+
+	void __stdcall SpatialEngine::OnProcessingPassEnd()
+	{
+		RealtimeScope realtime;
+		if (!passStart) return;
+		float millis = float((AudioClock() - passStart) * 1000.0);
+		state->passMillis += (millis - state->passMillis) * 0.1f; // ~10 pass average
+	}
+
+	/**
+	 * Applies changed AudioThreads settings and measures how late the thread woke up
+	 */
+	void SpatialEngine::Schedule(double prevStart, double now)
+	{
+		const LONG settings = xMixerSettings;
+		if (schedule.applied != settings)
+		{
+			schedule.applied = settings;
+			schedule.Apply(xMixerPriority, unsigned(xMixerAffinity));
+			state->mixerPriority = schedule.priority;
+		}
+		if (!prevStart) 
+			return;
+		// passes are due every quantum, a longer gap is time the thread waited to be scheduled
+		float late = float((now - prevStart) * 1000.0) - XAUDIO2_QUANTUM_MS;
+		if (late < 0.0f) late = 0.0f;
+		state->wakeupLate += (late - state->wakeupLate) * 0.1f; // ~10 pass average
+		if (late > state->wakeupLateMax) state->wakeupLateMax = late;
+	}
+
+	/**
+	 * Bypasses the reverb of zones whose sends stayed inaudible for longer than the reverb
+	 * decay time, so the tail has already died out. Bypassed buses are muted, their dry sends
+	 * don't leak through. Zones resume as soon as a send is audible.
+	 */
+	void SpatialEngine::UpdateZoneBypass(int level, float elapsed)
+	{
+		if (elapsed > 0.1f) elapsed = 0.1f; // skipped passes or the very first pass
+		for (ReverbZone* zone : state->zones)
+		{
+			zone->quietTime = zone->passPeak >= 0.01f ? 0.0f : zone->quietTime + elapsed; // -40dB
+			bool bypass = level >= GOVERNOR_SKIP_QUIET_REVERB && zone->quietTime > zone->reverb->DecayTime();
+			if (bypass != zone->bypassed && zone->bus)
+			{
+				// a disabled effect passes the dry sends through, so the bypassed bus is muted too
+				if (bypass) zone->bus->DisableEffect(0), zone->bus->SetVolume(0.0f);
+				else		zone->bus->SetVolume(1.0f), zone->bus->EnableEffect(0);
+				zone->bypassed = bypass;
+			}
+		}
+	}
+
+
+
+
+	/**
+	 * Creates a new audio world with its own XAudio2 engine on the default audio device
+	 */
+	Engine::Engine() : state(new EngineState(this))
+	{
+		EngineState& engine = *state;
+		CoInitializeEx(NULL, COINIT_MULTITHREADED);
+		// every XAudio2 instance has its own processing thread, started on the AudioThreads mixer CPUs
+		const XAUDIO2_PROCESSOR processor = xMixerAffinity ? XAUDIO2_PROCESSOR(xMixerAffinity) : XAUDIO2_DEFAULT_PROCESSOR;
+		HRESULT hr = XAudio2Create(&engine.xaudio, 0, processor);
+		if (RealtimeCheck::Enabled()) // the host opted in, XAudio2 is loaded now and gets checked too
+			RealtimeCheck::Enable();
+		if (FAILED(hr))
+			engine.xaudio = nullptr;
+		else if (FAILED(hr = engine.xaudio->CreateMasteringVoice(&engine.master)))
+			engine.xaudio->Release(), engine.xaudio = nullptr, engine.master = nullptr;
+		if (!engine.xaudio)
+		{
+			indebug(printf("Engine: XAudio2 failed with 0x%08x, no audio device?\n", hr));
+			xEnginesMutex.Lock();
+			engine.id = InterlockedIncrement(&xEngineIds);
+			xEngines.push_back(state); // an invalid Engine is still current, its objects stay silent
+			xEnginesMutex.Unlock();
+			return;
+		}
+		engine.masterEffects.Attach(engine.master);
+
+		// X3DAudio must pan to the actual speaker layout of the master
+		XAUDIO2_DEVICE_DETAILS device;
+		engine.xaudio->GetDeviceDetails(0, &device);
+		X3DAudioInitialize(device.OutputFormat.dwChannelMask, engine.speedOfSound, engine.x3daudio);
+		XAUDIO2_VOICE_DETAILS master;
+		engine.master->GetVoiceDetails(&master);
+		engine.masterChannels = master.InputChannels;
+
+		const X3DAUDIO_LISTENER& l = engine.listener;
+		engine.listenerTrack.Reset(MakeKey(l.Position, l.OrientFront, l.OrientTop, l.Velocity), false);
+		engine.xaudio->RegisterForCallbacks(&engine.spatial);
+
+		xEnginesMutex.Lock();
+		engine.id = InterlockedIncrement(&xEngineIds);
+		xEngines.push_back(state);
+		xEnginesMutex.Unlock();
+	}
+
+	/**
+	 * Destroys the XAudio2 engine. All SoundObjects and ReverbZones of this Engine must be destroyed first.
+	 */
+	Engine::~Engine()
+	{
+		xEnginesMutex.Lock();
+		xEngines.erase(std::find(xEngines.begin(), xEngines.end(), state));
+		if (xDefaultEngine == this) xDefaultEngine = nullptr;
+		InterlockedIncrement(&xEnginesDestroyed); // other threads that made it current drop it
+		xEnginesMutex.Unlock();
+		if (xCurrentEngine == this) xCurrentEngine = nullptr;
+
+		EngineState& engine = *state;
+		if (engine.xaudio)
+		{
+			engine.xaudio->UnregisterForCallbacks(&engine.spatial);
+			engine.master->DestroyVoice();
+			engine.xaudio->Release();
+		}
+		DetachSoundSlots(engine); // handles of leftover sounds stop posting here
+		FreeSoundCommands(engine);
+		delete state;
+	}
+
+	/**
+	 * @return FALSE if XAudio2 or the mastering voice could not be created, ex. there is no audio device.
+	 *         Objects of an invalid Engine stay silent.
+	 */
+	bool Engine::IsValid() const
+	{
+		return state->xaudio != nullptr;
+	}
+
+	/**
+	 * Makes this the current Engine of the calling thread. New SoundObjects and ReverbZones
+	 * are created in it, and the Listener, Governor, GetAudioStats and Update operate on it.
+	 */
+	void Engine::MakeCurrent()
+	{
+		xCurrentEngine = this;
+		xCurrentEngineId = state->id;
+		xCurrentChecked = xEnginesDestroyed;
+	}
+
+	/**
+	 * @return Current Engine of the calling thread, the Default engine if MakeCurrent() was never called
+	 */
+	Engine* Engine::Current()
+	{
+		Engine* current = ThreadEngine();
+		return current ? current : Default();
+	}
+
+	static void DestroyDefaultEngine()
+	{
+		delete xDefaultEngine;
+	}
+
+	/**
+	 * @return Engine of the threads that never called MakeCurrent(), created on first use
+	 */
+	Engine* Engine::Default()
+	{
+		xEnginesMutex.Lock();
+		if (!xDefaultEngine)
+		{
+			xDefaultEngine = new Engine();
+			atexit(DestroyDefaultEngine);
+		}
+		Engine* engine = xDefaultEngine;
+		xEnginesMutex.Unlock();
+		return engine;
+	}
+
+
+	/**
+	 * @return Pseudo-hash of the wave format, to detect format changes of a voice
+	 */
+	static unsigned HashWaveFormat(const WAVEFORMATEX& wf)
+	{
+		// this is enough to create an somewhat unique pseudo-hash:
+		return wf.nSamplesPerSec + (wf.nChannels * 25) + (wf.wBitsPerSample * 7) + (wf.wFormatTag << 24);
+	}
+
+	/**
+	 * How the memory of an XABuffer was allocated
+	 */
+	enum XABufferMemory
+	{
+		XAMEM_HEAP,		// malloc
+		XAMEM_LOCKED,	// VirtualAlloc, locked into the working set
+		XAMEM_LARGE,	// VirtualAlloc of large pages, never paged out
+	};
+
+	static volatile LONG64 xResidentBytes;	// audio data locked in physical memory
+	static volatile LONG64 xLargePageBytes;	// of which in large pages
+
+	/**
+	 * Measures the peak level and the silent tail of freshly decoded PCM data in the buffer
+	 * @param buffer Buffer holding PCM data
+	 * @param fmt Format of the PCM data
+	 */
+	static void ScanXABuffer(XABuffer* buffer, const PCMFormat& fmt)
+	{
+		const int frames = buffer->AudioBytes / fmt.BlockAlign();
+		buffer->peak = PeakPCM(buffer->pAudioData, frames, fmt);
+		buffer->nAudibleSamples = buffer->peak > SilencePeak ? AudibleFrames(buffer->pAudioData, frames, fmt) : 0;
+	}
+
+	/**
+	 * Fills the XABuffer header for audio data that follows it
+	 * @param buffer Buffer to initialize
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param fmt Format of the PCM data
+	 * @param bytesRead Number of PCM bytes in the buffer
+	 */
+	static void InitXABuffer(XABuffer* buffer, SoundBuffer* ctx, const PCMFormat& fmt, int bytesRead)
+	{
+		BYTE* data = (BYTE*)buffer + sizeof(XABuffer); // sound data follows after the XABuffer header
+		buffer->Flags = XAUDIO2_END_OF_STREAM;
+		buffer->AudioBytes = bytesRead;
+		buffer->pAudioData = data;
+		buffer->PlayBegin = 0;		// first sample to play
+		buffer->PlayLength = 0;		// number of samples to play
+		buffer->LoopBegin = 0;		// first sample to loop
+		buffer->LoopLength = 0;		// number of samples to loop
+		buffer->LoopCount = 0;		// how many times to loop the region
+		buffer->pContext = ctx;		// context of the buffer
+		buffer->memory = XAMEM_HEAP;
+		buffer->residentBytes = 0;
+		indebug(ctx->RefCount()); // access the buffer Context in debug mode, to hopefully catch invalid ctx's
+		int sampleSize = fmt.bitsPerSample / 8;
+		buffer->nBytesPerSample = sampleSize;
+
+		WAVEFORMATEX& wf = buffer->wf;
+		wf.wFormatTag = WAVE_FORMAT_PCM;
+		wf.nChannels = fmt.channels;
+		buffer->nPCMSamples = bytesRead / (sampleSize * wf.nChannels);
+		wf.nSamplesPerSec = fmt.sampleRate;
+		wf.wBitsPerSample = sampleSize * 8;
+		wf.nBlockAlign = (wf.nChannels * sampleSize);
+		wf.nAvgBytesPerSec = wf.nBlockAlign * wf.nSamplesPerSec;
+		wf.cbSize = sizeof(WAVEFORMATEX);
+		
+		buffer->wfHash = HashWaveFormat(wf);
+		ScanXABuffer(buffer, fmt);
+	}
+
+	/**
+	 * Fills the XABuffer header for audio data decoded from a stream
+	 * @param buffer Buffer to initialize
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param strm AudioStream that decoded the data
+	 * @param bytesRead Number of PCM bytes in the buffer
+	 */
+	static void InitXABuffer(XABuffer* buffer, SoundBuffer* ctx, AudioStreamer* strm, int bytesRead)
+	{
+		InitXABuffer(buffer, ctx, PCMFormat(strm->Frequency(), strm->SingleSampleSize() * 8, strm->Channels()), bytesRead);
+	}
+
+	/**
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param size Size of the buffer to create and fill with audio data
+	 * @param strm AudioStream to stream from
+	 * @param pos [optional] Position of the stream to stream from. Returns the new position of the stream. (in BYTES)
+	 * @return NEW buffer if successful. NULL if EndOfStream or OutOfMemory.
+	 */
+	static XABuffer* CreateXABuffer(SoundBuffer* ctx, int size, AudioStreamer* strm, int* pos = nullptr)
+	{
+		if (pos) strm->Seek(*pos); // seek to specified pos, let the AudioStream handle error conditions
+		if (strm->IsEOS()) return nullptr; // EOS(), failed!
+
+		// min(size, available);
+		int bytesToRead = strm->Available();
+		if (size < bytesToRead) bytesToRead = size;
+
+		XABuffer* buffer = (XABuffer*)malloc(sizeof(XABuffer)+bytesToRead);
+		if (!buffer) return nullptr; // out of memory :S
+		BYTE* data = (BYTE*)buffer + sizeof(XABuffer); // sound data follows after the XABuffer header
+
+		int bytesRead = strm->ReadSome(data, bytesToRead);
+		if (pos) *pos += bytesRead; // update position
+
+		InitXABuffer(buffer, ctx, strm, bytesRead);
+		buffer->Flags = strm->IsEOS() ? XAUDIO2_END_OF_STREAM : 0; // end of stream?
+		return buffer;
+	}
+
+
+	static const int MinSegmentSeconds = 8;	// shortest segment worth a decoder instance of its own
+	static const int MaxSegments = 16;		// most decoders running on a single file
+
+	/**
+	 * A segment of a compressed file, decoded by its own decoder instance
+	 */
+	struct DecodeSegment
+	{
+		const char* file;	// file to open the decoder on
+		BYTE* dst;			// destination of the segment in the final buffer
+		int begin;			// PCM byte offset of the segment in the stream
+		int size;			// PCM bytes in the segment
+		int bytesRead;		// PCM bytes actually decoded
+	};
+
+	/**
+	 * Decodes from the current stream position until the destination is full or the stream ends
+	 * @return Number of bytes decoded
+	 */
+	static int ReadSegment(AudioStreamer* strm, BYTE* dst, int size)
+	{
+		int total = 0;
+		while (total < size)
+		{
+			int bytesRead = strm->ReadSome(dst + total, size - total);
+			if (bytesRead <= 0) break; // EOS
+			total += bytesRead;
+		}
+		return total;
+	}
+
+	static DWORD WINAPI DecodeSegmentProc(void* arg)
+	{
+		DecodeSegment& seg = *(DecodeSegment*)arg;
+		if (AudioStreamer* strm = CreateAudioStreamer(seg.file))
+		{
+			// both decoders seek sample exact: vorbisfile bisects the Ogg pages by granule position
+			// and pre-rolls the previous packet, mpg123 pre-rolls frames to refill the bit reservoir
+			if (strm->OpenStream(seg.file) && strm->Seek(seg.begin) == (unsigned)seg.begin)
+				seg.bytesRead = ReadSegment(strm, seg.dst, seg.size);
+			delete strm;
+		}
+		return 0;
+	}
+
+	/**
+	 * Decode worker thread, runs DecodeSegmentProc with the AudioThreads worker settings
+	 */
+	static DWORD WINAPI DecodeWorkerProc(void* arg)
+	{
+		ThreadSchedule schedule;
+		schedule.Apply(xWorkerPriority, xWorkerAffinity);
+		DecodeSegmentProc(arg);
+		schedule.Apply(PRIORITY_NORMAL, 0); // leaves the MMCSS task
+		return 0;
+	}
+
+	/**
+	 * Decodes an entire stream into a new buffer. Long compressed files are split into
+	 * block aligned segments that independent decoders decode in parallel, straight into
+	 * their place in the final buffer. Short files and WAV are read with CreateXABuffer.
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param strm Opened AudioStream of the file, it decodes the first segment
+	 * @param file Path of the file, every other segment opens its own decoder on it
+	 * @return NEW buffer if successful. NULL if EndOfStream or OutOfMemory.
+	 */
+	static XABuffer* CreateXABufferParallel(SoundBuffer* ctx, AudioStreamer* strm, const char* file)
+	{
+		const int size = strm->Size();
+		const int blockAlign = strm->FullSampleBlockSize();
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		int segments = size / (strm->BytesPerSecond() * MinSegmentSeconds);
+		if (segments > (int)info.dwNumberOfProcessors) segments = info.dwNumberOfProcessors;
+		if (segments > MaxSegments) segments = MaxSegments;
+		if (!strm->IsCompressed() || segments < 2)
+			return CreateXABuffer(ctx, size, strm);
+
+		XABuffer* buffer = (XABuffer*)malloc(sizeof(XABuffer) + size);
+		if (!buffer) return nullptr; // out of memory :S
+		BYTE* data = (BYTE*)buffer + sizeof(XABuffer); // sound data follows after the XABuffer header
+
+		DecodeSegment segs[MaxSegments];
+		HANDLE threads[MaxSegments];
+		int numThreads = 0;
+		const int segmentSize = size / segments / blockAlign * blockAlign;
+		for (int i = 0; i < segments; ++i)
+		{
+			DecodeSegment& seg = segs[i];
+			seg.file = file;
+			seg.begin = i * segmentSize;
+			seg.size = (i == segments - 1) ? size - seg.begin : segmentSize;
+			seg.dst = data + seg.begin;
+			seg.bytesRead = 0;
+			if (i == 0)
+				continue; // decoded on this thread
+			if (HANDLE thread = CreateThread(nullptr, 0, DecodeWorkerProc, &seg, 0, nullptr))
+				threads[numThreads++] = thread;
+			else
+				DecodeSegmentProc(&seg); // no more threads, decode it here
+		}
+		strm->Seek(0);
+		segs[0].bytesRead = ReadSegment(strm, segs[0].dst, segs[0].size);
+		WaitForMultipleObjects(numThreads, threads, TRUE, INFINITE);
+		for (int i = 0; i < numThreads; ++i)
+			CloseHandle(threads[i]);
+
+		// segments must join without gaps, only the last one may end early on an estimated length
+		int bytesRead = 0;
+		for (int i = 0; i < segments; ++i)
+		{
+			bytesRead += segs[i].bytesRead;
+			if (i != segments - 1 && segs[i].bytesRead != segs[i].size)
+			{
+				indebug(printf("Parallel decode of \"%s\" failed at segment %d, decoding sequentially\n", file, i));
+				free(buffer);
+				int pos = 0;
+				return CreateXABuffer(ctx, size, strm, &pos);
+			}
+		}
+		InitXABuffer(buffer, ctx, strm, bytesRead);
+		return buffer;
+	}
+
+	/**
+	 * Streams next chunk from the Stream set in XABuffer. Size is determined by existing buffer size.
+	 * @param buffer Buffer to fill with audio data
+	 * @param pos [optional] Position of the stream to stream from (in BYTES)
+	 */
+	static void StreamXABuffer(XABuffer* buffer, AudioStreamer* strm, int* pos = nullptr)
+	{
+		if (pos) strm->Seek(*pos); // seek to specified pos, let the AudioStream handle error conditions
+		
+		buffer->AudioBytes = strm->ReadSome((void*)buffer->pAudioData, buffer->AudioBytes);
+		if (strm->IsEOS()) // end of stream was reached
+			buffer->Flags = XAUDIO2_END_OF_STREAM;
+		buffer->nPCMSamples = buffer->AudioBytes / buffer->wf.nBlockAlign;
+		ScanXABuffer(buffer, PCMFormat(buffer->wf.nSamplesPerSec, buffer->wf.wBitsPerSample, buffer->wf.nChannels));
+
+		if (pos) *pos += buffer->AudioBytes; // update position
+	}
+
+	/**
+	 * @param buffer Reference to an Audio buffer to destroy. Buffer will be NULL after this call.
+	 */
+	static void DestroyXABuffer(XABuffer*& buffer)
+	{
+		if (!buffer) return;
+		if (buffer->residentBytes)
+		{
+			InterlockedExchangeAdd64(&xResidentBytes, -LONG64(buffer->residentBytes));
+			if (buffer->memory == XAMEM_LARGE)
+				InterlockedExchangeAdd64(&xLargePageBytes, -LONG64(buffer->residentBytes));
+		}
+		if (buffer->memory == XAMEM_HEAP)
+			free((void*)buffer);
+		else
+			VirtualFree(buffer, 0, MEM_RELEASE); // also unlocks the pages
+		buffer = nullptr;
+	}
+
+	static int GetBuffersQueued(IXAudio2SourceVoice* source)
+	{
+		XAUDIO2_VOICE_STATE state;
+		source->GetState(&state);
+		return state.BuffersQueued;
+	}
+
+	static UINT32 VoiceFlags(IXAudio2Voice* voice)
+	{
+		XAUDIO2_VOICE_DETAILS details;
+		voice->GetVoiceDetails(&details);
+		return details.CreationFlags;
+	}
+
+
+
+
+
+
+	// XABuffer::wf and the fields after it are passed to XAudio2 as a single ADPCMWAVEFORMAT
+	static_assert(offsetof(XABuffer, wSamplesPerBlock) - offsetof(XABuffer, wf) == offsetof(ADPCMWAVEFORMAT, wSamplesPerBlock) &&
+				  offsetof(XABuffer, wNumCoef) - offsetof(XABuffer, wf) == offsetof(ADPCMWAVEFORMAT, wNumCoef) &&
+				  offsetof(XABuffer, aCoef) - offsetof(XABuffer, wf) == offsetof(ADPCMWAVEFORMAT, aCoef),
+				  "XABuffer ADPCM extension is not laid out as ADPCMWAVEFORMAT");
+
+	/**
+	 * Encodes a 16-bit PCM buffer to MS ADPCM, which XAudio2 decodes during playback
+	 * @param buffer Fully loaded 16-bit PCM buffer, freed if it was encoded
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @return The encoded buffer, or the original buffer if encoding failed
+	 */
+	static XABuffer* EncodeXABuffer(XABuffer* buffer, SoundBuffer* ctx)
+	{
+		const WAVEFORMATEX& wf = buffer->wf;
+		if (wf.wBitsPerSample != 16 || wf.nChannels > 2)
+			return buffer; // XAudio2 only plays mono and stereo ADPCM
+
+		const int frames = buffer->nPCMSamples;
+		XABuffer* encoded = (XABuffer*)malloc(sizeof(XABuffer) + ADPCMEncodedSize(frames, wf.nChannels));
+		if (!encoded) return buffer;
+		int bytes = EncodeADPCM((const short*)buffer->pAudioData, frames, wf.nChannels, (BYTE*)encoded + sizeof(XABuffer));
+
+		*encoded = *buffer; // keeps the flags, the PCM format fields and the silence scan of the PCM data
+		encoded->pAudioData = (BYTE*)encoded + sizeof(XABuffer);
+		encoded->AudioBytes = bytes;
+		encoded->pContext = ctx;
+		encoded->nPCMSamples = frames; // the last block is padded
+		
+		WAVEFORMATEX& adpcm = encoded->wf;
+		adpcm.wFormatTag = WAVE_FORMAT_ADPCM;
+		adpcm.wBitsPerSample = 4;
+		adpcm.nBlockAlign = ADPCMBlockAlign(adpcm.nChannels);
+		adpcm.nAvgBytesPerSec = adpcm.nSamplesPerSec * adpcm.nBlockAlign / ADPCMSamplesPerBlock;
+		adpcm.cbSize = sizeof(WORD) * 2 + sizeof(ADPCMCOEFSET) * ADPCMNumCoef;
+		encoded->wSamplesPerBlock = ADPCMSamplesPerBlock;
+		encoded->wNumCoef = ADPCMNumCoef;
+		for (int i = 0; i < ADPCMNumCoef; ++i) {
+			encoded->aCoef[i].iCoef1 = ADPCMCoefficients[i][0];
+			encoded->aCoef[i].iCoef2 = ADPCMCoefficients[i][1];
+		}
+		encoded->wfHash = HashWaveFormat(adpcm);
+		free(buffer);
+		return encoded;
+	}
+
+	/**
+	 * Converts a loaded buffer to the quality profile, if the profile reduces its format
+	 * @param buffer Fully loaded buffer, freed if it was converted
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param profile Target format
+	 * @return The converted buffer, or the original buffer if nothing changed or conversion failed
+	 */
+	static XABuffer* ReduceXABuffer(XABuffer* buffer, SoundBuffer* ctx, const QualityProfile& profile)
+	{
+		const WAVEFORMATEX& wf = buffer->wf;
+		PCMFormat src(wf.nSamplesPerSec, wf.wBitsPerSample, wf.nChannels);
+		PCMFormat dst = src;
+		if (profile.sampleRate > 0 && profile.sampleRate < dst.sampleRate) dst.sampleRate = profile.sampleRate;
+		if (profile.bitsPerSample == 8) dst.bitsPerSample = 8;
+		if (profile.channels == 1) dst.channels = 1;
+		if (profile.codec == CODEC_ADPCM) dst.bitsPerSample = 16; // ADPCM encodes 16-bit samples
+		if (dst.sampleRate == src.sampleRate && dst.bitsPerSample == src.bitsPerSample && dst.channels == src.channels)
+			return profile.codec == CODEC_ADPCM ? EncodeXABuffer(buffer, ctx) : buffer;
+
+		int size = ConvertedSize(buffer->AudioBytes, src, dst);
+		XABuffer* reduced = (XABuffer*)malloc(sizeof(XABuffer) + size);
+		if (!reduced) return buffer; // out of memory, keep the full quality data
+		int bytes = ConvertPCM(buffer->pAudioData, buffer->AudioBytes, src, (BYTE*)reduced + sizeof(XABuffer), dst);
+		if (!bytes) {
+			indebug(printf("ReduceXABuffer() unsupported conversion, keeping the source format\n"));
+			free(reduced);
+			return buffer;
+		}
+		InitXABuffer(reduced, ctx, dst, bytes);
+		reduced->Flags = buffer->Flags;
+		free(buffer);
+		return profile.codec == CODEC_ADPCM ? EncodeXABuffer(reduced, ctx) : reduced;
+	}
+
+	/**
+	 * @return Hash of a quality profile, to tell apart shared buffers converted differently
+	 */
+	static unsigned ProfileHash(const QualityProfile& profile)
+	{
+		return (unsigned(profile.sampleRate) * 2654435761u) ^ (profile.bitsPerSample << 8) ^ 
+			   (profile.channels << 16) ^ (unsigned(profile.codec) << 24);
+	}
+
+	/**
+	 * Maps a buffer published by another process. Only the XABuffer header is private,
+	 * the audio data is read straight from the shared view.
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param file Source sound file
+	 * @param variant Hash of the quality profile
+	 * @param shared Receives the shared mapping, owned by the SoundBuffer
+	 * @return New buffer header, NULL if nothing is published
+	 */
+	static XABuffer* OpenSharedXABuffer(SoundBuffer* ctx, const char* file, unsigned variant, SharedPCM** shared)
+	{
+		SharedPCM* sh = new SharedPCM();
+		XABuffer* buffer = nullptr;
+		if (sh->Open(file, variant) && sh->MetaBytes() == sizeof(XABuffer) && 
+			(buffer = (XABuffer*)malloc(sizeof(XABuffer))))
+		{
+			memcpy(buffer, sh->Meta(), sizeof(XABuffer)); // pointers are fixed below
+			buffer->pAudioData = (const BYTE*)sh->Data();
+			buffer->pContext = ctx;
+			*shared = sh;
+			return buffer;
+		}
+		delete sh;
+		return nullptr;
+	}
+
+	/**
+	 * Publishes a loaded buffer for other processes and switches it to the shared copy
+	 * @param buffer Fully loaded buffer, freed if it was published
+	 * @param ctx SoundBuffer passed to the buffer as its Context
+	 * @param file Source sound file
+	 * @param variant Hash of the quality profile
+	 * @param shared Receives the shared mapping, owned by the SoundBuffer
+	 * @return Buffer header pointing to the shared data, or the original buffer if another process was faster
+	 */
+	static XABuffer* PublishXABuffer(XABuffer* buffer, SoundBuffer* ctx, const char* file, unsigned variant, SharedPCM** shared)
+	{
+		SharedPCM* sh = new SharedPCM();
+		XABuffer* header = (XABuffer*)malloc(sizeof(XABuffer));
+		if (!header || !sh->Publish(file, variant, buffer, sizeof(XABuffer), buffer->pAudioData, buffer->AudioBytes)) {
+			free(header);
+			delete sh;
+			return buffer;
+		}
+		memcpy(header, buffer, sizeof(XABuffer));
+		header->pAudioData = (const BYTE*)sh->Data();
+		header->pContext = ctx;
+		free(buffer);
+		*shared = sh;
+		return header;
+	}
+
+	/**
+	 * Enables SeLockMemoryPrivilege for this process, once
+	 * @return Large page size, 0 if the process may not allocate large pages
+	 */
+	static SIZE_T LargePageSize()
+	{
+		static volatile LONG size = -1;
+		if (size >= 0)
+			return SIZE_T(size);
+		LONG result = 0;
+		HANDLE token;
+		if (SIZE_T minimum = GetLargePageMinimum())
+		{
+			if (OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token))
+			{
+				TOKEN_PRIVILEGES tp;
+				tp.PrivilegeCount = 1;
+				tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+				// AdjustTokenPrivileges succeeds without the privilege, only GetLastError tells
+				if (LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) && 
+					AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) && GetLastError() == ERROR_SUCCESS)
+					result = LONG(minimum);
+				CloseHandle(token);
+			}
+		}
+		indebug(if (!result) printf("Large pages are not available, SeLockMemoryPrivilege is required\n"));
+		InterlockedExchange(&size, result);
+		return SIZE_T(result);
+	}
+
+	/**
+	 * Locks pages into the working set, growing the working set if the lock doesn't fit
+	 */
+	static bool LockPages(const void* mem, SIZE_T bytes)
+	{
+		if (VirtualLock((void*)mem, bytes))
+			return true;
+		SIZE_T minimum, maximum; // locked pages count against the minimum working set
+		HANDLE process = GetCurrentProcess();
+		return GetProcessWorkingSetSize(process, &minimum, &maximum) && 
+			   SetProcessWorkingSetSize(process, minimum + bytes, maximum + bytes) && 
+			   VirtualLock((void*)mem, bytes);
+	}
+
+	/**
+	 * Touches every page of a block so it's faulted in now, not on the audio thread
+	 */
+	static void Prefault(const void* mem, SIZE_T bytes)
+	{
+		volatile const BYTE* p = (const BYTE*)mem;
+		for (SIZE_T i = 0; i < bytes; i += 4096)
+			(void)p[i];
+		if (bytes) (void)p[bytes - 1];
+	}
+
+	/**
+	 * Moves a loaded buffer into locked, prefaulted pages. Buffers that fill a large page are put in
+	 * large pages when the process may use them; shared buffers stay in their view, which is locked.
+	 * @param buffer Fully loaded buffer, freed if it was moved
+	 * @param shared [optional] Shared mapping the data of the buffer lives in
+	 * @return The resident buffer, or the original buffer if the memory could not be locked
+	 */
+	static XABuffer* ResidentXABuffer(XABuffer* buffer, const SharedPCM* shared)
+	{
+		const SIZE_T dataBytes = buffer->AudioBytes;
+		if (shared) // the view is released with the mapping, that also unlocks it
+		{
+			Prefault(buffer->pAudioData, dataBytes);
+			if (LockPages(buffer->pAudioData, dataBytes)) {
+				buffer->residentBytes = unsigned(dataBytes);
+				InterlockedExchangeAdd64(&xResidentBytes, LONG64(dataBytes));
+			}
+			return buffer;
+		}
+
+		// large pages are always resident, but round up: only use them if less than 1/8 is wasted
+		const SIZE_T bytes = sizeof(XABuffer) + dataBytes;
+		const SIZE_T large = LargePageSize();
+		const SIZE_T rounded = large ? (bytes + large - 1) / large * large : 0;
+		XABuffer* resident = nullptr;
+		int memory = XAMEM_LARGE;
+		if (large && bytes >= large && rounded - bytes <= bytes / 8)
+			resident = (XABuffer*)VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+		if (!resident)
+		{
+			memory = XAMEM_LOCKED;
+			resident = (XABuffer*)VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+			if (!resident) 
+				return buffer;
+			if (!LockPages(resident, bytes)) { // over the working set quota
+				indebug(printf("ResidentXABuffer() failed to lock %u bytes\n", unsigned(bytes)));
+				VirtualFree(resident, 0, MEM_RELEASE);
+				return buffer;
+			}
+		}
+		memcpy(resident, buffer, bytes); // writes, and so faults in, every page
+		resident->pAudioData = (BYTE*)resident + sizeof(XABuffer);
+		resident->memory = memory;
+		resident->residentBytes = unsigned(dataBytes);
+		InterlockedExchangeAdd64(&xResidentBytes, LONG64(dataBytes));
+		if (memory == XAMEM_LARGE)
+			InterlockedExchangeAdd64(&xLargePageBytes, LONG64(dataBytes));
+		free(buffer);
+		return resident;
+	}
+
+	static QualityProfile xDefaultQuality; // quality profile used by SoundBuffer::Load(file)
+	static char xCacheDirectory[MAX_PATH]; // decoded PCM cache of compressed files, disabled if empty
+	static bool xSharedMemory = false;     // share decoded SoundBuffers with other processes
+	static bool xResidentMemory = false;   // keep SoundBuffer data in locked, prefaulted pages
+
+
+
+
+	/**
+	 * Creates a new SoundBuffer object
+	 */
+	SoundBuffer::SoundBuffer() 
+		: refCount(0), xaBuffer(nullptr), shared(nullptr), volumeCurve(nullptr), lowpassCurve(nullptr), reverbCurve(nullptr)
+	{
+	}
+
+	/**
+	 * Creates a new SoundBuffer and loads the specified sound file
+	 * @param file Path to sound file to load
+	 */
+	SoundBuffer::SoundBuffer(const char* file) 
+		: refCount(0), xaBuffer(nullptr), shared(nullptr), volumeCurve(nullptr), lowpassCurve(nullptr), reverbCurve(nullptr)
+	{
+		Load(file);
+	}
+
+	/**
+	 * Destroyes and unloads this buffer
+	 */
+	SoundBuffer::~SoundBuffer()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_BUFFER_DESTROY, this);
+		if (xaBuffer)
+			Unload();
+		delete volumeCurve;
+		delete lowpassCurve;
+		delete reverbCurve;
+	}
+
+	/**
+	 * @return Frequency in Hz of this SoundBuffer data
+	 */
+	int SoundBuffer::Frequency() const
+	{
+		return xaBuffer->wf.nSamplesPerSec;
+	}
+
+	/**
+	 * @return Number of bits in a sample of this SoundBuffer data (8 or 16, 4 for ADPCM)
+	 */
+	int SoundBuffer::SampleBits() const
+	{
+		return xaBuffer->wf.wBitsPerSample;
+	}
+
+	/**
+	 * @return Format of the audio data in memory
+	 */
+	SampleCodec SoundBuffer::Codec() const
+	{
+		return xaBuffer->wf.wFormatTag == WAVE_FORMAT_ADPCM ? CODEC_ADPCM : CODEC_PCM;
+	}
+
+	/**
+	 * @return Number of bytes in a sample of this SoundBuffer data (1 or 2)
+	 */
+	int SoundBuffer::SampleBytes() const
+	{
+		return xaBuffer->nBytesPerSample;
+	}
+
+	/**
+	 * @return Number of sound channels in the SoundBuffer data (1 or 2)
+	 */
+	int SoundBuffer::Channels() const
+	{
+		return xaBuffer->wf.nChannels;
+	}
+
+	/** 
+	 * @return Size of a full sample block in bytes [LL][RR] (1 to 4)
+	 */
+	int SoundBuffer::FullSampleSize() const 
+	{
+		return xaBuffer->nBytesPerSample * xaBuffer->wf.nChannels; // nBlockAlign is a whole block for ADPCM
+	}
+
+	/**
+	 * @return Size of this SoundBuffer or SoundStream in BYTES
+	 */
+	int SoundBuffer::SizeBytes() const
+	{
+		return xaBuffer->AudioBytes;
+	}
+
+	/**
+	 * @return Number of Bytes Per Second for this audio data (Frequency * Channels * SampleBytes)
+	 */
+	int SoundBuffer::BytesPerSecond() const
+	{
+		return xaBuffer->wf.nAvgBytesPerSec;
+	}
+
+	/**
+	 * @return Size of this SoundBuffer in PCM SAMPLES
+	 */
+	int SoundBuffer::Size() const
+	{
+		return xaBuffer->nPCMSamples;
+	}
+
+	/**
+	 * @return Number of SoundObjects that still reference this SoundBuffer.
+	 */
+	int SoundBuffer::RefCount() const 
+	{
+		return refCount; 
+	}
+
+	/**
+	 * @return TRUE if this object is a Sound stream
+	 */
+	bool SoundBuffer::IsStream() const 
+	{ 
+		return false; 
+	}
+
+	/**
+	 * @return Wave format descriptor for this buffer
+	 */
+	const WAVEFORMATEX* SoundBuffer::WaveFormat() const
+	{
+		return xaBuffer ? &xaBuffer->wf : nullptr;
+	}
+
+	/**
+	 * @return Unique hash to distinguish between different Wave formats
+	 */
+	unsigned SoundBuffer::WaveFormatHash() const
+	{
+		return xaBuffer ? xaBuffer->wfHash : 0;
+	}
+
+	/**
+	 * Records a SoundBuffer load with its quality profile
+	 */
+	static void RecordLoad(const SoundBuffer* buffer, const char* file, const QualityProfile& p)
+	{
+		const float args[4] = { float(p.sampleRate), float(p.bitsPerSample), float(p.channels), float(p.codec) };
+		RecordCommand(COMMAND_BUFFER_LOAD, buffer, nullptr, 0, args, 4, file, file ? (int)strlen(file) : 0);
+	}
+
+	/**
+	 * Loads this SoundBuffer with data found in the specified file.
+	 * Supported formats: .wav .mp3
+	 * @param file Sound file to load
+	 * @return TRUE if loading succeeded and a valid buffer was created.
+	 */
+	bool SoundBuffer::Load(const char* file)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordLoad(this, file, xDefaultQuality);
+		return Load(file, xDefaultQuality);
+	}
+
+	/**
+	 * Loads this SoundBuffer and converts the data to the specified quality profile.
+	 * @note SoundStreams ignore the profile
+	 * @param file Sound file to load
+	 * @param profile Target format of the data in memory
+	 * @return TRUE if loading succeeded and a valid buffer was created.
+	 */
+	bool SoundBuffer::Load(const char* file, const QualityProfile& profile)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordLoad(this, file, profile);
+		if (xaBuffer) // is there existing data?
+			return false;
+		
+		if (xSharedMemory && (xaBuffer = OpenSharedXABuffer(this, file, ProfileHash(profile), &shared)))
+		{
+			if (xResidentMemory) xaBuffer = ResidentXABuffer(xaBuffer, shared);
+			return true; // another process already decoded it
+		}
+
+		AudioStreamer mem; // temporary stream
+		AudioStreamer* strm = &mem;
+		if (!CreateAudioStreamer(strm, file))
+			return false; // invalid file format or file not found
+
+		const bool cached = *xCacheDirectory && strm->IsCompressed(); // WAV is already raw PCM
+		if (cached) {
+			PCMFormat fmt; int bytes;
+			if (XABuffer* buffer = (XABuffer*)LoadPCMCache(xCacheDirectory, file, sizeof(XABuffer), &fmt, &bytes)) {
+				InitXABuffer(buffer, this, fmt, bytes);
+				xaBuffer = buffer;
+			}
+		}
+
+		if (!xaBuffer) {
+			if (!strm->OpenStream(file))
+				return false; // failed to open the stream (probably not really correct format)
+
+			xaBuffer = CreateXABufferParallel(this, strm, file); // long MP3 and OGG files decode on all cores
+			strm->CloseStream(); // close this manually, otherwise we get a nasty error when the dtor runs...
+			if (xaBuffer && cached) {
+				const WAVEFORMATEX& wf = xaBuffer->wf;
+				StorePCMCache(xCacheDirectory, file, xaBuffer->pAudioData, xaBuffer->AudioBytes, 
+							  PCMFormat(wf.nSamplesPerSec, wf.wBitsPerSample, wf.nChannels));
+			}
+		}
+		if (!xaBuffer)
+			return false;
+		xaBuffer = ReduceXABuffer(xaBuffer, this, profile);
+		if (xSharedMemory)
+			xaBuffer = PublishXABuffer(xaBuffer, this, file, ProfileHash(profile), &shared);
+		if (xResidentMemory)
+			xaBuffer = ResidentXABuffer(xaBuffer, shared);
+		return true;
+	}
+
+	/**
+	 * Sets the quality profile used by Load(file), ex. per platform memory tier.
+	 * @param profile Target format of loaded SoundBuffers. Default keeps the source format
+	 */
+	void SoundBuffer::DefaultQuality(const QualityProfile& profile)
+	{
+		xDefaultQuality = profile;
+	}
+	const QualityProfile& SoundBuffer::DefaultQuality()
+	{
+		return xDefaultQuality;
+	}
+
+	/**
+	 * Enables the decoded PCM cache. Compressed files (MP3, OGG) are decoded once and kept
+	 * in this directory, losslessly compressed, so later loads skip the slow decoding.
+	 * @param dir Existing directory for the cache files. NULL or "" disables the cache (default)
+	 */
+	void SoundBuffer::CacheDirectory(const char* dir)
+	{
+		if (!dir) dir = "";
+		strncpy(xCacheDirectory, dir, sizeof(xCacheDirectory) - 1);
+		xCacheDirectory[sizeof(xCacheDirectory) - 1] = '\0';
+	}
+	const char* SoundBuffer::CacheDirectory()
+	{
+		return xCacheDirectory;
+	}
+
+	/**
+	 * Shares decoded SoundBuffer data with other processes on this machine, ex. many instances
+	 * of a headless server. The first process to load a file publishes it, the others map it read-only.
+	 * @param enable TRUE to share buffers loaded from now on. Default is FALSE
+	 */
+	void SoundBuffer::SharedMemory(bool enable)
+	{
+		xSharedMemory = enable;
+	}
+	bool SoundBuffer::SharedMemory()
+	{
+		return xSharedMemory;
+	}
+
+	/**
+	 * Keeps loaded SoundBuffer data resident: it's copied into locked pages and every page is touched
+	 * at load time, so the first playback takes no page faults on the audio thread. Buffers that fill
+	 * a large page use large pages (fewer TLB misses) if the process holds SeLockMemoryPrivilege.
+	 * @param enable TRUE for buffers loaded from now on. Default is FALSE
+	 */
+	void SoundBuffer::ResidentMemory(bool enable)
+	{
+		xResidentMemory = enable;
+	}
+
+	/**
+	 * @return TRUE if loaded SoundBuffers are kept in locked, prefaulted pages
+	 */
+	bool SoundBuffer::ResidentMemory()
+	{
+		return xResidentMemory;
+	}
+
+	/**
+	 * Tries to release the underlying sound buffer and free the memory.
+	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundBuffer
+	 * @return TRUE if SoundBuffer was freed, FALSE if SoundBuffer is still used by a SoundObject.
+	 */
+	bool SoundBuffer::Unload()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_BUFFER_UNLOAD, this);
+		if (!xaBuffer)
+			return true; // yes, its unloaded
+		if (refCount > 0) {
+			indebug(printf("SoundBuffer::Unload() Memory Leak: failed to delete alBuffer, because it's still in use.\n"));
+			return false; // can't do anything here while still referenced
+		}
+		DestroyXABuffer(xaBuffer);
+		delete shared; // unmaps the shared data, if any
+		shared = nullptr;
+		return true;
+	}
+
+	/**
+	 * [internal] Decodes ADPCM data to 16-bit PCM in software, for voices that can't take WAVE_FORMAT_ADPCM
+	 * @return FALSE if the data is not ADPCM, other SoundObjects still use it or out of memory
+	 */
+	bool SoundBuffer::DecodeToPCM()
+	{
+		if (!xaBuffer || xaBuffer->wf.wFormatTag != WAVE_FORMAT_ADPCM || refCount > 0)
+			return false; // other voices already play the ADPCM data
+		const WAVEFORMATEX& wf = xaBuffer->wf;
+		const int frames = xaBuffer->nPCMSamples;
+		XABuffer* decoded = (XABuffer*)malloc(sizeof(XABuffer) + frames * wf.nChannels * sizeof(short));
+		if (!decoded)
+			return false;
+		short* pcm = (short*)((BYTE*)decoded + sizeof(XABuffer));
+		const int decodedFrames = DecodeADPCM(xaBuffer->pAudioData, xaBuffer->AudioBytes, wf.nChannels, pcm, frames);
+		if (!decodedFrames) {
+			free(decoded);
+			return false;
+		}
+		InitXABuffer(decoded, this, PCMFormat(wf.nSamplesPerSec, 16, wf.nChannels), decodedFrames * wf.nChannels * sizeof(short));
+		decoded->Flags = xaBuffer->Flags;
+		indebug(printf("SoundBuffer::DecodeToPCM() the voice can't play ADPCM, decoded %d frames\n", decodedFrames));
+		DestroyXABuffer(xaBuffer); // a shared mapping stays with the SoundBuffer until Unload
+		xaBuffer = decoded;
+		return true;
+	}
+
+	static XABuffer& ShallowBuffer(SoundObject* so);
+
+	/**
+	 * Picks the buffer to submit for a SoundObject. One-shots end with their last audible block,
+	 * so a long silent tail isn't mixed. Loops play the whole buffer to keep their period.
+	 * @param so SoundObject that plays the buffer
+	 * @param buffer Fully loaded buffer
+	 * @return The buffer itself or a shallow copy of it with a shorter PlayLength
+	 */
+	static const XAUDIO2_BUFFER* PlayableXABuffer(SoundObject* so, XABuffer* buffer)
+	{
+		const int block = buffer->wf.wFormatTag == WAVE_FORMAT_ADPCM ? buffer->wSamplesPerBlock : SilenceBlockFrames;
+		int audible = (buffer->nAudibleSamples + block - 1) / block * block; // ADPCM can only end at a block
+		if (audible == 0) audible = block; // all silent, PlayLength 0 would play everything
+		if (so->IsLooping() || audible + SilenceBlockFrames >= buffer->nPCMSamples)
+			return buffer;
+		XABuffer& shallow = ShallowBuffer(so);
+		shallow = *buffer;
+		shallow.PlayLength = audible;
+		return &shallow;
+	}
+
+	/**
+	 * Binds a specific source to this SoundBuffer and increases the refCount.
+	 * @param so SoundObject to bind to this SoundBuffer.
+	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
+	 */
+	bool SoundBuffer::BindSource(SoundObject* so)
+	{
+		if (!xaBuffer) 
+			return false; // no data
+
+		if (so->Sound == this)
+			return false; // no double-binding dude, it will mess up refCounting.
+
+		so->Source->SubmitSourceBuffer(PlayableXABuffer(so, xaBuffer)); // enqueue this buffer
+		++refCount;
+		return true;
+	}
+
+	/**
+	 * Unbinds a specific source from this SoundBuffer and decreases the refCount.
+	 * @param so SoundObject to unbind from this SoundBuffer.
+	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
+	 */
+	bool SoundBuffer::UnbindSource(SoundObject* so)
+	{
+		if (so->Sound == this) // correct buffer link?
+		{
+			so->Source->Stop(); // make sure its stopped (otherwise Flush won't work)
+			if (GetBuffersQueued(so->Source))
+				so->Source->FlushSourceBuffers(); // ensure not in queue anymore
+			--refCount;
+		}
+		return true;
+	}
+
+	/**
+	 * Resets the buffer in the context of the specified SoundObject
+	 * @note Calls ResetStream on AudioStreams.
+	 * @param so SoundObject to reset this buffer for
+	 * @return TRUE if reset was successful
+	 */
+	bool SoundBuffer::ResetBuffer(SoundObject* so)
+	{
+		if (!xaBuffer || !so->Source)
+			return false; // nothing to do here
+
+		so->Source->Stop();
+		if (GetBuffersQueued(so->Source)) // only flush IF we have buffers to flush
+			so->Source->FlushSourceBuffers();
+
+		so->Source->SubmitSourceBuffer(PlayableXABuffer(so, xaBuffer));
+		return true;
+	}
+
+	/**
+	 * Bakes a new curve and swaps it in, the spatial pass must not be reading the old one
+	 * @param which Recorded curve: 0 volume, 1 lowpass, 2 reverb
+	 */
+	static void ReplaceCurve(const SoundBuffer* buffer, int which, FalloffCurve*& curve, const CurvePoint* points, int count)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_BUFFER_CURVE, buffer, nullptr, which, nullptr, 0, 
+									  points, points && count > 0 ? count * (int)sizeof(CurvePoint) : 0);
+		FalloffCurve* baked = points && count > 0 ? new FalloffCurve(points, count) : nullptr;
+		FalloffCurve* old;
+		{
+			SpatialLockAll lock; // the buffer may be playing in every engine
+			old = curve;
+			curve = baked;
+		}
+		delete old;
+	}
+
+	/**
+	 * Sets a custom volume falloff curve for all Sound3D objects playing this buffer.
+	 * The curve replaces the Sound3D distance model, cone attenuation still applies.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void SoundBuffer::VolumeCurve(const CurvePoint* points, int count)
+	{
+		ReplaceCurve(this, 0, volumeCurve, points, count);
+	}
+
+	/**
+	 * Sets a custom lowpass curve for all Sound3D objects playing this buffer.
+	 * Values are [0.0 - 1.0], where 1.0 is unfiltered. Set it before binding the buffer
+	 * to any sound objects, only voices created after this have a filter.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void SoundBuffer::LowpassCurve(const CurvePoint* points, int count)
+	{
+		ReplaceCurve(this, 1, lowpassCurve, points, count);
+	}
+
+	/**
+	 * Sets a custom ReverbZone send curve for all Sound3D objects playing this buffer.
+	 * The curve value scales the send to every ReverbZone.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void SoundBuffer::ReverbCurve(const CurvePoint* points, int count)
+	{
+		ReplaceCurve(this, 2, reverbCurve, points, count);
+	}
+
+
+
+
+
+
+
+
+
+	StreamProfile::StreamProfile()
+		: latency(0.0f), decodeCost(0.0f), deviation(0.0f), measurements(0), 
+		chunkSeconds(1.0f), depth(MinDepth), mS(0.0), mT(0.0), mSS(0.0), mST(0.0), mRes(0.0)
+	{
+	}
+
+	/**
+	 * The chosen buffering of a StreamProfile packed into one value, so the game thread and
+	 * the callback thread always see a chunk size and depth that belong together
+	 */
+	static inline LONG PackBuffering(const StreamProfile& p) { return LONG(p.chunkSeconds * 1000.0f + 0.5f) << 4 | p.depth; }
+	static inline float BufferingSeconds(LONG buffering) { return (buffering >> 4) * 0.001f; }
+	static inline int BufferingDepth(LONG buffering) { return buffering & 15; }
+
+	/**
+	 * Adds a single decode measurement to the fit
+	 * @param seconds Seconds of audio that were decoded
+	 * @param time Time the decode call took in seconds
+	 */
+	void StreamProfile::Measure(float seconds, float time)
+	{
+		if (seconds <= 0.0f)
+			return;
+		// running averages over the first 32 decodes, then exponential forgetting
+		double a = 1.0 / (measurements < 32 ? ++measurements : 32);
+		mS  += a * (seconds - mS);
+		mT  += a * (time - mT);
+		mSS += a * (seconds*seconds - mSS);
+		mST += a * (seconds*time - mST);
+
+		// least squares fit of time = latency + seconds * decodeCost; latency can only be
+		// separated once chunks of different length were decoded, until then it's kept
+		double varS = mSS - mS*mS;
+		if (varS > 0.01 * mS*mS)
+		{
+			double cost = (mST - mS*mT) / varS;
+			double lat = mT - cost * mS;
+			if (lat >= 0.0 && cost >= 0.0)
+				latency = float(lat), decodeCost = float(cost);
+		}
+		else
+		{
+			double cost = (mT - latency) / mS;
+			decodeCost = float(cost > 0.0 ? cost : 0.0);
+		}
+
+		double residual = time - (latency + seconds * decodeCost);
+		mRes += a * (residual*residual - mRes);
+		deviation = float(sqrt(mRes));
+	}
+
+	/**
+	 * Picks the smallest chunkSeconds * depth that keeps the underrun probability under target
+	 * @param underrun Target probability that a single decode doesn't finish in time
+	 */
+	void StreamProfile::Choose(float underrun)
+	{
+		if (measurements < 4) // not enough data, keep the default 2x1s buffering
+			return;
+
+		// one-sided normal quantile for the underrun probability (Abramowitz & Stegun 26.2.23)
+		double p = underrun < 1e-9f ? 1e-9 : underrun > 0.5f ? 0.5 : underrun;
+		double t = sqrt(-2.0 * log(p));
+		double z = t - (2.515517 + 0.802853*t + 0.010328*t*t) 
+					 / (1.0 + 1.432788*t + 0.189269*t*t + 0.001308*t*t*t);
+		double worst = latency + z * deviation; // decode time of a chunk, without the per second cost
+
+		// while one buffer is decoded, the remaining depth-1 buffers must keep playing
+		static const float chunks[] = { 0.25f, 0.5f, 1.0f, 2.0f };
+		float bestChunk = chunks[3];
+		int bestDepth = MaxDepth;
+		float bestTotal = FLT_MAX;
+		for (float c : chunks)
+		{
+			double need = (worst + c * decodeCost) / c; // buffers needed to cover one decode
+			if (need > MaxDepth - 1)
+				continue;
+			int d = 1 + int(ceil(need));
+			if (d < MinDepth) d = MinDepth;
+			if (c * d < bestTotal)
+				bestChunk = c, bestDepth = d, bestTotal = c * d;
+		}
+		chunkSeconds = bestChunk;
+		depth = bestDepth;
+	}
+
+
+
+
+	/**
+	 * Creates a new SoundsStream object
+	 */
+	SoundStream::SoundStream() : alStream(nullptr), underrun(0.001f),
+		alBuffering(PackBuffering(StreamProfile())), alMeasuring(0), peakSlot(-1), peakNext(0), peakMax(0.0f)
+	{
+	}
+
+	/**
+	 * Creates a new SoundStream object and loads the specified sound file
+	 * @param file Path to the sound file to load
+	 */
+	SoundStream::SoundStream(const char* file) : alStream(nullptr), underrun(0.001f),
+		alBuffering(PackBuffering(StreamProfile())), alMeasuring(0), peakSlot(-1), peakNext(0), peakMax(0.0f)
+	{
+		Load(file);
+	}
+
+	/**
+	 * Destroys and unloads any resources held
+	 */
+	SoundStream::~SoundStream()
+	{
+		CommandScope cmd; // ~SoundBuffer records the destruction
+		if (xaBuffer) // active buffer?
+			Unload();
+	}
+
+	/**
+	 * @return Size of this SoundStream in PCM SAMPLES
+	 */
+	int SoundStream::Size() const
+	{
+		return alStream ? (alStream->Size() / FullSampleSize()) : 0;
+	}
+
+	/**
+	 * @return TRUE if this object is a Sound stream
+	 */
+	bool SoundStream::IsStream() const
+	{
+		return true;
+	}
+
+	/**
+	 * Initializes this SoundStream with data found in the specified file.
+	 * Supported formats: .wav .mp3
+	 * @param file Sound file to load
+	 * @return TRUE if loading succeeded and a stream was initialized.
+	 */
+	bool SoundStream::Load(const char* file)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_BUFFER_LOAD, this, nullptr, 1, nullptr, 0, file, file ? (int)strlen(file) : 0);
+		if (xaBuffer) // is there existing data?
+			return false;
+
+		if (!(alStream = CreateAudioStreamer(file)))
+			return false; // :(
+		
+		if (!alStream->OpenStream(file))
+			return false;
+
+		// load the first buffer in the stream, this is also the first decode measurement:
+		double start = AudioClock();
+		xaBuffer = CreateXABuffer(this, alStream->BytesPerSecond(), alStream, 0);
+		if (!xaBuffer)
+			return false;
+		const int slot = alStream->Frequency() / PeakSlotsPerSecond;
+		alPeaks.assign(slot > 0 ? (Size() + slot - 1) / slot : 0, -1.0f);
+		peakSlot = -1;
+		RecordPeaks(xaBuffer, 0);
+		alProfile.Measure(float(xaBuffer->AudioBytes) / alStream->BytesPerSecond(), float(AudioClock() - start));
+		alProfile.Choose(underrun);
+		InterlockedExchange(&alBuffering, PackBuffering(alProfile));
+		return true;
+	}
+
+	/**
+	 * Streams are decoded in their source format, the profile is ignored.
+	 * @param file Sound file to load
+	 * @param profile Ignored
+	 * @return TRUE if loading succeeded and a stream was initialized.
+	 */
+	bool SoundStream::Load(const char* file, const QualityProfile& profile)
+	{
+		return SoundStream::Load(file);
+	}
+
+	/**
+	 * Tries to release the underlying sound buffers and free the memory.
+	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundStream
+	 * @return TRUE if SoundStream data was freed, FALSE if SoundStream is still used by a SoundObject.
+	 */
+	bool SoundStream::Unload()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_BUFFER_UNLOAD, this);
+		if (!xaBuffer)
+			return true; // yes, its unloaded
+		if (refCount > 0) {
+			indebug(printf("SoundStream::Unload() Memory Leak: failed to delete xaBuffer, because it's still in use.\n"));
+			return false; // can't do anything here while still referenced
+		}
+		DestroyXABuffer(xaBuffer);
+		if (alStream) { delete alStream; alStream = NULL; }
+		alPeaks.clear();
+		peakSlot = -1;
+		return true;
+	}
+
+	/**
+	 * Binds a specific source to this SoundStream and increases the refCount.
+	 * @param so SoundObject to bind to this SoundStream.
+	 * @return FALSE is the binding failed. TODO: POSSIBLE REASONS?
+	 */
+	bool SoundStream::BindSource(SoundObject* so)
+	{
+		if (!xaBuffer) 
+			return false; // no data loaded yet
+
+		alSources.emplace_back(so);				// default streamPos
+		LoadStreamData(alSources.back(), 0);	// load initial stream data (prefetch depth buffers)
+
+		++refCount;
+		return true;
+	}
+
+	/**
+	 * Unbinds a specific source from this SoundStream and decreases the refCount.
+	 * @param so SoundObject to unbind from this SoundStream.
+	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
+	 */
+	bool SoundStream::UnbindSource(SoundObject* so)
+	{
+		if (!xaBuffer)
+			return false; // no data loaded yet
+		
+		SO_ENTRY* e = GetSOEntry(so);
+		if (!e) return false; // source doesn't exist
+
+		ClearStreamData(*e); // unload all buffers
+
+		alSources.erase(alSources.begin() + (e - alSources.data()));
+		--refCount;
+		return true;
+	}
+
+	/**
+	 * Resets the buffer in the context of the specified SoundObject
+	 * @note Calls ResetStream on AudioStreams.
+	 * @param so SoundObject to reset this buffer for
+	 * @return TRUE if reset was successful
+	 */
+	bool SoundStream::ResetBuffer(SoundObject* so)
+	{
+		return ResetStream(so);
+	}
+
+	/**
+	 * Streams the next Buffer block from the stream.
+	 * @param so Specific SoundObject to stream with.
+	 * @return TRUE if a buffer was streamed. FALSE if EOS() or stream is busy.
+	 */
+	bool SoundStream::StreamNext(SoundObject* so)
+	{
+		if (!xaBuffer) 
+			return false; // nothing to do here
+		if (SO_ENTRY* e = GetSOEntry(so))
+		{
+			if (e->busy) return false; // can't stream when stream is busy
+			return StreamNext(*e);
+		}
+		return false; // nothing to stream
+	}
+
+	/**
+	 * Resets the stream by unloading previous buffers and requeuing the first buffers.
+	 * @param so SoundObject to reset the stream for
+	 * @return TRUE if stream was successfully reloaded
+	 */
+	bool SoundStream::ResetStream(SoundObject* so)
+	{
+		// simply clear and load again, to avoid code maintenance hell
+		if (SO_ENTRY* e = GetSOEntry(so)) {
+			ClearStreamData(*e);
+			return LoadStreamData(*e, 0);
+		}
+		return false;
+	}
+
+	/**
+	 * @param so Specific SoundObject to check for end of stream
+	 * @return TRUE if End of Stream was reached or if there is no stream loaded
+	 */
+	bool SoundStream::IsEOS(const SoundObject* so) const
+	{
+		SO_ENTRY* e = GetSOEntry(so);
+		return e ? true : (alStream ? (e->next >= alStream->Size()) : true);
+	}
+
+	/**
+	 * @param so SoundObject to query index of
+	 * @return A valid pointer if this SoundObject is bound. Otherwise NULL.
+	 */
+	SoundStream::SO_ENTRY* SoundStream::GetSOEntry(const SoundObject* so) const
+	{
+		for (const SO_ENTRY& e : alSources)
+			if (e.obj == so)
+				return (SO_ENTRY*)&e;
+		return nullptr; // not found
+	}
+
+	/**
+	 * Seeks to the specified sample position in the stream.
+	 * @note The SoundObject will stop playing and must be manually restarted!
+	 * @param so SoundObject to perform seek on
+	 * @param samplepos Position in the stream in samples [0..SoundStream::Size()]
+	 */
+	void SoundStream::Seek(SoundObject* so, int samplepos)
+	{
+		if (SO_ENTRY* e = GetSOEntry(so))
+		{
+			// if samplepos out of bounds THEN 0 ELSE convert samplepos to bytepos
+			int bytepos = (samplepos >= Size()) ? 0 : samplepos * xaBuffer->wf.nBlockAlign;
+			ClearStreamData(*e);
+			LoadStreamData(*e, bytepos);
+
+		}
+
+	}
+
+	/**
+	 * @param so SoundObject to query
+	 * @return Current playback position of the SoundObject in the stream in SAMPLES
+	 */
+	int SoundStream::Tell(const SoundObject* so) const
+	{
+		SO_ENTRY* e = GetSOEntry(so);
+		if (!e || !xaBuffer) return 0;
+		int pos = e->base / xaBuffer->wf.nBlockAlign;
+		if (e->queued)
+		{
+			XAUDIO2_VOICE_STATE state;
+			so->Source->GetState(&state);
+			// SamplesPlayed restarts after an end of stream, in that case it's already relative to base
+			pos += int(state.SamplesPlayed >= e->played ? state.SamplesPlayed - e->played : state.SamplesPlayed);
+		}
+		int size = Size();
+		return pos < size ? pos : size;
+	}
+
+	/**
+	 * Stops the SoundObject and frees its stream buffers, but keeps it bound.
+	 * Seek() loads the buffers again.
+	 * @param so SoundObject to release the buffers of
+	 */
+	void SoundStream::ReleaseBuffers(SoundObject* so)
+	{
+		if (SO_ENTRY* e = GetSOEntry(so))
+			ClearStreamData(*e);
+	}
+
+	/**
+	 * Sets the target probability of a buffer underrun. Prefetch depth and chunk size
+	 * are adapted to the measured decode speed to meet this target.
+	 * @param probability Underrun probability per decoded chunk [0.0 - 0.5]. Default is 0.001
+	 */
+	void SoundStream::UnderrunProbability(float probability)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_STREAM_UNDERRUN, this, nullptr, 0, &probability, 1);
+		underrun = probability < 1e-9f ? 1e-9f : probability > 0.5f ? 0.5f : probability;
+		while (InterlockedCompareExchange(&alMeasuring, 1, 0))
+			SwitchToThread(); // a decoder is measuring, that only takes a moment
+		alProfile.Choose(underrun);
+		InterlockedExchange(&alBuffering, PackBuffering(alProfile));
+		InterlockedExchange(&alMeasuring, 0);
+	}
+
+	//// PROTECTED: ////
+
+	/**
+	 * Internal stream function.
+	 * @param soe SoundObject Entry to stream
+	 * @return TRUE if a buffer was streamed
+	 */
+	bool SoundStream::StreamNext(SO_ENTRY& e)
+	{
+		if (!e.queued) // no buffers. probably ClearStreamData() was called
+			return false;
+
+		// frontbuffer was processed, pop it from the queue:
+		XABuffer* done = e.queue[0];
+		for (int i = 1; i < e.queued; ++i)
+			e.queue[i - 1] = e.queue[i];
+		--e.queued;
+
+		e.base += done->AudioBytes; // shift the base pointer forward
+		XAUDIO2_VOICE_STATE state;
+		e.obj->Source->GetState(&state);
+		e.played = state.SamplesPlayed; // the new frontbuffer starts here
+
+		// refill the finished buffer and top up the queue if the prefetch depth grew
+		const int depth = BufferingDepth(alBuffering);
+		bool streamed = false;
+		while (e.queued < depth && e.next < alStream->Size())
+		{
+			XABuffer* buffer = DecodeChunk(done, &e.next);
+			done = nullptr;
+			if (!buffer)
+				return streamed; // oh no...
+			e.obj->Source->SubmitSourceBuffer(buffer); // submit the backbuffer to the queue
+			e.queue[e.queued++] = buffer;
+			streamed = true;
+		}
+		if (done && done != xaBuffer) // the prefetch depth shrunk or EOF
+			DestroyXABuffer(done);
+		return streamed;
+	}
+
+	/**
+	 * [internal] Load streaming data into the specified SoundObject
+	 * at the optionally specified streamposition.
+	 * @param so SoundObject to queue with stream data
+	 * @param streampos [optional] PCM byte position in stream where to seek data from. 
+	 *                  If unspecified (default -1), stream will use the current streampos
+	 */
+	bool SoundStream::LoadStreamData(SO_ENTRY& so, int streampos)
+	{
+		int pos = streampos == -1 ? so.next : streampos; // -1: use next, else use streampos
+		IXAudio2SourceVoice* source = so.obj->Source;
+
+		XAUDIO2_VOICE_STATE state;
+		source->GetState(&state);
+		so.played = state.SamplesPlayed; // nothing of the new buffers was played yet
+		so.base = pos;
+		if (pos == 0) // pos 0 means we load alBuffer
+		{
+			pos += xaBuffer->AudioBytes; // update pos
+			source->SubmitSourceBuffer(so.queue[so.queued++] = xaBuffer);
+		}
+
+		// fill the queue up to the prefetch depth, at arbitrary position
+		const int depth = BufferingDepth(alBuffering);
+		while (so.queued < depth && pos < alStream->Size())
+		{
+			XABuffer* buffer = DecodeChunk(nullptr, &pos); // pos variable is updated by DecodeChunk
+			if (!buffer)
+				break;
+			source->SubmitSourceBuffer(so.queue[so.queued++] = buffer);
+		}
+		so.next = pos;
+		return so.queued != 0;
+	}
+
+	/**
+	 * [internal] Unloads all queued data for the specified SoundObject
+	 * @param so SoundObject to unqueue and unload data for
+	 */
+	void SoundStream::ClearStreamData(SO_ENTRY& so)
+	{
+		so.busy = TRUE;
+		IXAudio2SourceVoice* source = so.obj->Source;
+		source->Stop();
+		if (GetBuffersQueued(source)) // only flush if we have something to flush
+			source->FlushSourceBuffers();
+
+		for (int i = 0; i < so.queued; ++i)
+			if (so.queue[i] != xaBuffer)
+				DestroyXABuffer(so.queue[i]);
+		so.queued = 0;
+		so.busy = FALSE;
+	}
+
+	/**
+	 * [internal] Decodes the next chunk and updates the decode speed profile
+	 * @param buffer [optional] Finished buffer to refill. It's replaced if the chunk size changed.
+	 * @param pos PCM byte position to decode from. Returns the new position.
+	 * @return Filled buffer or NULL if EndOfStream or OutOfMemory
+	 */
+	XABuffer* SoundStream::DecodeChunk(XABuffer* buffer, int* pos)
+	{
+		int blockAlign = alStream->FullSampleBlockSize();
+		int bytesPerSecond = alStream->BytesPerSecond();
+		int chunkBytes = int(BufferingSeconds(alBuffering) * bytesPerSecond) / blockAlign * blockAlign;
+
+		const int streampos = *pos;
+		double start = AudioClock();
+		if (buffer && buffer != xaBuffer && buffer->AudioBytes == (UINT32)chunkBytes)
+		{
+			StreamXABuffer(buffer, alStream, pos); // same size, reuse the buffer
+		}
+		else
+		{
+			if (buffer && buffer != xaBuffer)
+				DestroyXABuffer(buffer);
+			if (!(buffer = CreateXABuffer(this, chunkBytes, alStream, pos)))
+				return nullptr;
+		}
+		// the game thread (Seek, Play) and the callback thread both decode, one of them measures at a time
+		if (!InterlockedCompareExchange(&alMeasuring, 1, 0))
+		{
+			alProfile.Measure(float(buffer->AudioBytes) / bytesPerSecond, float(AudioClock() - start));
+			alProfile.Choose(underrun);
+			RecordPeaks(buffer, streampos);
+			InterlockedExchange(&alBuffering, PackBuffering(alProfile));
+			InterlockedExchange(&alMeasuring, 0);
+		}
+		return buffer;
+	}
+
+	/**
+	 * [internal] Records the peak levels of the slots a freshly decoded buffer covers.
+	 * A slot that continues into the next chunk is carried over in peakSlot until its last frame is decoded.
+	 * @param buffer Decoded buffer
+	 * @param streampos PCM byte position of the buffer in the stream
+	 */
+	void SoundStream::RecordPeaks(const XABuffer* buffer, int streampos)
+	{
+		const int blockAlign = buffer->wf.nBlockAlign;
+		const int slot = int(buffer->wf.nSamplesPerSec) / PeakSlotsPerSecond;
+		if (slot <= 0 || !blockAlign)
+			return;
+		const int begin = streampos / blockAlign;
+		const int end = begin + buffer->AudioBytes / blockAlign;
+		const int size = Size();
+		const PCMFormat fmt(buffer->wf.nSamplesPerSec, buffer->wf.wBitsPerSample, buffer->wf.nChannels);
+		for (int i = begin / slot; i < (int)alPeaks.size(); ++i)
+		{
+			const int first = i * slot;
+			const int last = first + slot < size ? first + slot : size; // the last slot ends with the stream
+			const int lo = first > begin ? first : begin;
+			const int hi = last < end ? last : end;
+			if (lo >= hi)
+				break;
+			// a silent chunk is silent everywhere, only an audible one is scanned again by slot
+			float peak = buffer->peak <= SilencePeak ? buffer->peak : 
+				PeakPCM(buffer->pAudioData + (lo - begin) * blockAlign, hi - lo, fmt);
+			if (lo > first) // the start of this slot came with the previous chunk, if it was decoded at all
+			{
+				if (peakSlot != i || peakNext != lo)
+				{
+					peakSlot = -1; // seeked into the middle of the slot, it stays unknown
+					continue;
+				}
+				if (peakMax > peak) peak = peakMax;
+			}
+			if (hi == last) // slot complete
+			{
+				alPeaks[i] = peak;
+				peakSlot = -1;
+			}
+			else // partially decoded, the rest comes with the next chunk
+			{
+				peakSlot = i;
+				peakNext = hi;
+				peakMax = peak;
+			}
+		}
+	}
+
+	/**
+	 * Peak levels are recorded while the stream is decoded, parts that were never decoded count as full scale.
+	 * Ranges past the end of the stream wrap around to its start, as loops do.
+	 * @param samplepos Start of the range in SAMPLES
+	 * @param samples Length of the range in SAMPLES
+	 * @return Peak level of the stream in the range [0.0 - 1.0]
+	 */
+	float SoundStream::Peak(int samplepos, int samples) const
+	{
+		const int count = (int)alPeaks.size();
+		const int slot = alStream ? alStream->Frequency() / PeakSlotsPerSecond : 0;
+		if (!count || slot <= 0)
+			return 1.0f;
+		int n = (samplepos % slot + samples + slot - 1) / slot; // slots touched by the range
+		if (n > count) n = count;
+		float peak = 0.0f;
+		for (int i = (samplepos / slot) % count; n > 0; --n, i = (i + 1) % count)
+		{
+			const float p = alPeaks[i];
+			if (p < 0.0f) return 1.0f; // never decoded
+			if (p > peak) peak = p;
+		}
+		return peak;
+	}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+	struct SoundObjectState : public IXAudio2VoiceCallback
+	{
+		SoundObject* sound;
+		bool isInitial;		// is the Sound object Rewinded to its initial position?
+		bool isPlaying;		// is the Voice digesting buffers?
+		bool isLoopable;	// should this sound act as a loopable sound?
+		bool isPaused;		// currently paused?
+		XABuffer shallow;	// a shallow buffer reference (no actual data)
+
+		SoundObjectState(SoundObject* so) 
+			: sound(so), 
+			isInitial(false), isPlaying(false), 
+			isLoopable(false), isPaused(false)
+		{
+		}
+
+		// end of stream was reached (last buffer object was processed)
+		void __stdcall OnStreamEnd() override
+		{
+			RealtimeScope realtime;
+			if (isLoopable) // loopable?
+				sound->Rewind(); // rewind the sound and continue playing
+			else
+				isPlaying = false;
+		}
+
+		// a buffer object finished processing
+		void __stdcall OnBufferEnd(void* ctx) override
+		{
+			RealtimeScope realtime;
+			isInitial = false;
+			if (((SoundBuffer*)ctx)->IsStream())
+			{
+				// stream fetch next buffer for this sound
+				((SoundStream*)ctx)->StreamNext(sound);
+			}
+		}
+
+		void __stdcall OnVoiceProcessingPassStart(UINT32 samplesRequired) override {}
+		void __stdcall OnVoiceProcessingPassEnd() override {}
+		void __stdcall OnBufferStart(void* ctx) override {}
+		void __stdcall OnLoopEnd(void* ctx) override {}
+		void __stdcall OnVoiceError(void* ctx, HRESULT error) override {}
+
+		// the shallow buffer of a SoundObject, for partial submits of a shared buffer
+		static XABuffer& Shallow(SoundObject* so) { return so->State->shallow; }
+		// the destructor is protected, objects are destroyed through the SoundTable
+		static void Destroy(SoundObject* so) { delete so; }
+	};
+
+	static XABuffer& ShallowBuffer(SoundObject* so)
+	{
+		return SoundObjectState::Shallow(so);
+	}
+
+
+
+
+
+	//////
+	// SoundTable impl
+	//
+
+#pragma region SoundTable
+
+	struct SoundSlot
+	{
+		SoundObject* sound;			// the object, NULL if the slot is free
+		Sound3D* sound3D;			// the object if it's a Sound3D, for the 3D calls
+		EngineState* volatile engine; // engine of the object, posted calls are queued there
+		volatile LONG generation;	// bumped when the slot is freed, so all its handles go stale
+		int nextFree;				// next free slot, -1 for none
+	};
+
+	/**
+	 * A call posted through SoundTable::Post. malloc alignment is MEMORY_ALLOCATION_ALIGNMENT,
+	 * as SList entries need.
+	 */
+	struct SoundCommand
+	{
+		SLIST_ENTRY entry;			// first, the command is its own list entry
+		SoundHandle handle;
+		CommandOp op;
+		int value;
+		float args[3];
+	};
+
+	enum { SlotPageBits = 10, SlotPageSize = 1 << SlotPageBits, MaxSlotPages = 64 }; // 65536 slots, 16 handle bits
+	enum { MinFreeSlots = SlotPageSize }; // a freed slot waits for this many others, so its 16-bit generation wraps slowly
+
+	// pages are never freed or moved, so any thread can read a slot without a lock
+	static SoundSlot* volatile xSlotPages[MaxSlotPages];
+	static int xSlotCount;				// slots in all pages
+	static int xFreeSlot = -1;			// oldest free slot, slots are reused first in first out
+	static int xFreeLast = -1;			// newest free slot
+	static int xFreeSlots;				// length of the free queue
+	static int xLiveSounds;
+	static SpatialMutex xSlotsMutex;	// guards allocating and freeing slots
+	static volatile LONG xPosting;		// SoundTable::Post calls in progress, ~Engine waits for them
+	static SLIST_HEADER xFreeCommands;	// recycled SoundCommands, zeroed means empty
+
+	static inline SoundSlot* FindSlot(SoundHandle handle)
+	{
+		const unsigned index = handle & 0xffff;
+		SoundSlot* page = xSlotPages[index >> SlotPageBits];
+		return page ? &page[index & (SlotPageSize - 1)] : nullptr;
+	}
+
+	/**
+	 * @return Slot of a handle if the handle is current, NULL if it is stale
+	 */
+	static inline SoundSlot* LiveSlot(SoundHandle handle)
+	{
+		SoundSlot* slot = FindSlot(handle);
+		return slot && LONG(handle >> 16) == slot->generation ? slot : nullptr;
+	}
+
+	/**
+	 * Gives a new SoundObject a slot
+	 * @return Handle of the object, 0 if the table is full
+	 */
+	static SoundHandle RegisterSound(SoundObject* so)
+	{
+		xSlotsMutex.Lock();
+		if (xFreeSlots < MinFreeSlots && xSlotCount < MaxSlotPages * SlotPageSize)
+		{
+			SoundSlot* page = (SoundSlot*)calloc(SlotPageSize, sizeof(SoundSlot));
+			if (page)
+			{
+				for (int i = 0; i < SlotPageSize; ++i) {
+					page[i].generation = 1;
+					page[i].nextFree = i + 1 < SlotPageSize ? xSlotCount + i + 1 : -1;
+				}
+				if (xFreeLast >= 0) FindSlot(SoundHandle(xFreeLast))->nextFree = xSlotCount;
+				else xFreeSlot = xSlotCount;
+				xSlotPages[xSlotCount >> SlotPageBits] = page;
+				xFreeLast = xSlotCount + SlotPageSize - 1;
+				xFreeSlots += SlotPageSize;
+				xSlotCount += SlotPageSize;
+			}
+		}
+		SoundHandle handle = 0;
+		if (xFreeSlot >= 0)
+		{
+			const int index = xFreeSlot;
+			SoundSlot& slot = *FindSlot(SoundHandle(index));
+			xFreeSlot = slot.nextFree;
+			if (xFreeSlot < 0) xFreeLast = -1;
+			--xFreeSlots;
+			slot.sound = so;
+			slot.sound3D = nullptr;
+			slot.engine = so->GetEngine()->State();
+			handle = (SoundHandle(slot.generation) << 16) | SoundHandle(index);
+			++xLiveSounds;
+		}
+		xSlotsMutex.Unlock();
+		indebug(if (!handle) printf("SoundTable is full, SoundObject has no handle\n"));
+		return handle;
+	}
+
+	/**
+	 * Frees the slot of a destroyed SoundObject, all handles to it go stale
+	 */
+	static void UnregisterSound(SoundHandle handle)
+	{
+		xSlotsMutex.Lock();
+		if (SoundSlot* slot = LiveSlot(handle))
+		{
+			LONG generation = (slot->generation + 1) & 0xffff;
+			InterlockedExchange(&slot->generation, generation ? generation : 1); // 0 would make handle 0 valid
+			slot->sound = nullptr;
+			slot->sound3D = nullptr;
+			slot->engine = nullptr;
+			slot->nextFree = -1;
+			const int index = int(handle & 0xffff); // to the end of the queue
+			if (xFreeLast >= 0) FindSlot(SoundHandle(xFreeLast))->nextFree = index;
+			else xFreeSlot = index;
+			xFreeLast = index;
+			++xFreeSlots;
+			--xLiveSounds;
+		}
+		xSlotsMutex.Unlock();
+	}
+
+	/**
+	 * Lets the 3D calls of posted commands reach a Sound3D
+	 */
+	static void RegisterSound3D(SoundHandle handle, Sound3D* sound)
+	{
+		if (SoundSlot* slot = LiveSlot(handle))
+			slot->sound3D = sound;
+	}
+
+	/**
+	 * [game thread] Executes the calls posted to an Engine, in the order they were posted.
+	 * They run as outermost calls, so the CommandRecorder records them like direct calls.
+	 */
+	static void ExecuteSoundCommands(EngineState& engine)
+	{
+		const int depth = xCommandDepth;
+		xCommandDepth = 0;
+		SLIST_ENTRY* entry = InterlockedFlushSList(&engine.commands);
+		SLIST_ENTRY* ordered = nullptr; // the list is LIFO, reverse it
+		while (entry)
+		{
+			SLIST_ENTRY* next = entry->Next;
+			entry->Next = ordered;
+			ordered = entry;
+			entry = next;
+		}
+		for (entry = ordered; entry; )
+		{
+			SoundCommand& c = *(SoundCommand*)entry;
+			entry = entry->Next; // before the command is recycled
+			SoundSlot* slot = LiveSlot(c.handle);
+			SoundObject* so = slot && slot->engine == &engine ? slot->sound : nullptr;
+			Sound3D* so3D = so ? slot->sound3D : nullptr;
+			if (so) switch (c.op)
+			{
+			case COMMAND_PLAY:		so->Play(); break;
+			case COMMAND_STOP:		so->Stop(); break;
+			case COMMAND_PAUSE:		so->Pause(); break;
+			case COMMAND_REWIND:	so->Rewind(); break;
+			case COMMAND_LOOPING:	so->Looping(c.value != 0); break;
+			case COMMAND_VOLUME:	so->Volume(c.args[0]); break;
+			case COMMAND_SEEK:		so->PlaybackPos(c.value); break;
+			case COMMAND_POSITION:	if (so3D) so3D->Position(c.args[0], c.args[1], c.args[2]); break;
+			case COMMAND_DIRECTION:	if (so3D) so3D->Direction(c.args[0], c.args[1], c.args[2]); break;
+			case COMMAND_VELOCITY:	if (so3D) so3D->Velocity(c.args[0], c.args[1], c.args[2]); break;
+			case COMMAND_RELATIVE:	if (so3D) so3D->Relative(c.value != 0); break;
+			case COMMAND_DESTROY:	SoundObjectState::Destroy(so); break;
+			default: break;
+			}
+			InterlockedPushEntrySList(&xFreeCommands, &c.entry);
+		}
+		xCommandDepth = depth;
+	}
+
+	/**
+	 * Stops posting to an Engine that is destroyed: sounds it still has keep their slots,
+	 * but no call reaches its queue anymore. Returns once no Post() can be pushing to it.
+	 */
+	static void DetachSoundSlots(EngineState& engine)
+	{
+		xSlotsMutex.Lock();
+		for (int i = 0; i < xSlotCount; ++i)
+		{
+			SoundSlot& slot = *FindSlot(SoundHandle(i));
+			if (slot.engine == &engine) slot.engine = nullptr;
+		}
+		xSlotsMutex.Unlock();
+		MemoryBarrier(); // Post() reads the engine after counting itself in xPosting
+		while (xPosting) SwitchToThread();
+	}
+
+	/**
+	 * Frees the calls that were still queued when an Engine is destroyed
+	 */
+	static void FreeSoundCommands(EngineState& engine)
+	{
+		for (SLIST_ENTRY* entry = InterlockedFlushSList(&engine.commands); entry; )
+		{
+			SLIST_ENTRY* next = entry->Next;
+			InterlockedPushEntrySList(&xFreeCommands, entry);
+			entry = next;
+		}
+	}
+
+
+	/**
+	 * [game thread] Gets the object of a handle
+	 * @param handle Handle of the object
+	 * @return The object, NULL if the handle is stale
+	 */
+	SoundObject* SoundTable::Resolve(SoundHandle handle)
+	{
+		SoundSlot* slot = LiveSlot(handle);
+		return slot ? slot->sound : nullptr;
+	}
+
+	/**
+	 * @param handle Handle to check
+	 * @return TRUE if the object of the handle still exists. It may be destroyed right after on another thread.
+	 */
+	bool SoundTable::IsValid(SoundHandle handle)
+	{
+		return LiveSlot(handle) != nullptr;
+	}
+
+	/**
+	 * Queues a call on the object of a handle, executed by the next Update() of its Engine.
+	 * @param handle Handle of the object
+	 * @param op One of COMMAND_PLAY, STOP, PAUSE, REWIND, LOOPING, VOLUME, SEEK, POSITION, 
+	 *           DIRECTION, VELOCITY, RELATIVE or DESTROY, the 3D calls only apply to Sound3D objects
+	 * @param value [optional] Integer argument: LOOPING and RELATIVE flag, SEEK sample position
+	 * @param x [optional] VOLUME gain, POSITION, DIRECTION and VELOCITY vector
+	 * @param y [optional]
+	 * @param z [optional]
+	 * @return FALSE if the handle is stale, the call was dropped
+	 */
+	bool SoundTable::Post(SoundHandle handle, CommandOp op, int value, float x, float y, float z)
+	{
+		SoundSlot* slot = FindSlot(handle);
+		if (!slot)
+			return false;
+		InterlockedIncrement(&xPosting); // the engine can't be destroyed until this call is done with it
+		EngineState* engine = slot->engine;
+		MemoryBarrier(); // the engine must be read before the generation is checked
+		SoundCommand* c = nullptr;
+		if (engine && LONG(handle >> 16) == slot->generation) // else stale, freed before or while reading the engine
+		{
+			c = (SoundCommand*)InterlockedPopEntrySList(&xFreeCommands);
+			if (c || (c = (SoundCommand*)malloc(sizeof(SoundCommand))))
+			{
+				c->handle = handle;
+				c->op = op;
+				c->value = value;
+				c->args[0] = x, c->args[1] = y, c->args[2] = z;
+				InterlockedPushEntrySList(&engine->commands, &c->entry);
+			}
+		}
+		InterlockedDecrement(&xPosting);
+		return c != nullptr;
+	}
+
+	/**
+	 * @return Number of live SoundObjects in the table
+	 */
+	int SoundTable::Count()
+	{
+		return xLiveSounds;
+	}
+
+#pragma endregion
+
+
+
+
+
+
+	/**
+	 * Creates an uninitialzed empty SoundObject
+	 */
+	SoundObject::SoundObject()
+		: Owner(Engine::Current()), Sound(nullptr), Source(nullptr), State(nullptr)
+	{
+		Handle = RegisterSound(this);
+		memset(&Emitter, 0, sizeof(Emitter));
+		Emitter.ChannelCount = 1;
+		Emitter.CurveDistanceScaler = FLT_MIN;
+	}
+	/**
+	 * Creates a soundobject with an attached buffer
+	 * @param sound SoundBuffer this object uses for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	SoundObject::SoundObject(SoundBuffer* sound, bool loop, bool play)
+		: Owner(Engine::Current()), Sound(nullptr), Source(nullptr), State(nullptr)
+	{
+		Handle = RegisterSound(this);
+		memset(&Emitter, 0, sizeof(Emitter));
+		Emitter.ChannelCount = 1;
+		Emitter.CurveDistanceScaler = FLT_MIN;
+
+		if (sound) SetSound(sound, loop);
+		if (play) Play();
+	}
+
+	SoundObject::~SoundObject() // unhooks any sounds and frees resources
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_DESTROY, this);
+		UnregisterSound(Handle); // queued calls on this object are dropped from here on
+		if (Sound) SetSound(nullptr);
+		if (Source) Source->DestroyVoice(), Source = nullptr;
+	}
+
+
+
+
+	/**
+	 * Creates a Source voice for a SoundBuffer. ADPCM data the voice can't take is decoded
+	 * to 16-bit PCM and tried again.
+	 */
+	static HRESULT CreateSourceVoice(IXAudio2* xaudio, IXAudio2SourceVoice** source, SoundBuffer* sound, 
+									 UINT32 flags, IXAudio2VoiceCallback* callback)
+	{
+		HRESULT hr = xaudio->CreateSourceVoice(source, sound->WaveFormat(), flags, 2.0F, callback);
+		if (FAILED(hr) && sound->Codec() == CODEC_ADPCM && sound->DecodeToPCM())
+			hr = xaudio->CreateSourceVoice(source, sound->WaveFormat(), flags, 2.0F, callback);
+		return hr;
+	}
+
+	/**
+	 * Sets the SoundBuffer or SoundStream for this SoundObject. Set NULL to remove and unbind the SoundBuffer.
+	 * @param sound Sound to bind to this object. Can be NULL to unbind sounds from this object.
+	 * @param loop [optional] Sets the sound looping or non-looping. Streams cannot be looped.
+	 */
+	void SoundObject::SetSound(SoundBuffer* sound, bool loop)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_SET_SOUND, this, sound, loop ? 1 : 0);
+		if (Sound) Sound->UnbindSource(this); // unbind old, but still keep it around
+		if (sound) // new sound?
+		{
+			UINT32 flags = sound->LowpassCurve() ? XAUDIO2_VOICE_USEFILTER : 0; // filters cost CPU, only when needed
+			IXAudio2* xaudio = Owner->State()->xaudio;
+			if (!Source) // no Source object created yet? First init.
+			{
+				if (!State) State = new SoundObjectState(this);
+				SpatialLock lock(*Owner->State()); // the spatial pass must never see a half created voice
+				if (!xaudio || FAILED(CreateSourceVoice(xaudio, &Source, sound, flags, State)))
+				{
+					Source = nullptr, Sound = nullptr;
+					return; // invalid Engine or unsupported format, this object stays silent
+				}
+				Chain.Attach(Source);
+				OnVoiceCreated();
+			}
+			else if (sound->WaveFormatHash() != Sound->WaveFormatHash() || // WaveFormat has changed?
+					 flags != (VoiceFlags(Source) & XAUDIO2_VOICE_USEFILTER)) // or the filter?
+			{
+				SpatialLock lock(*Owner->State());
+				Source->DestroyVoice(); // Destroy old and re-create with new
+				if (FAILED(CreateSourceVoice(xaudio, &Source, sound, flags, State)))
+				{
+					Source = nullptr, Sound = nullptr;
+					return;
+				}
+				Chain.Attach(Source);
+				OnVoiceCreated();
+			}
+			State->isLoopable = loop; // one-shots are submitted without their silent tail
+			sound->BindSource(this);
+			State->isInitial = true;
+			State->isPlaying = false;
+			State->isPaused = false;
+			Sound = sound; // set new Sound
+		}
+	}
+
+	/**
+	 * @return TRUE if this SoundObject has an attached SoundStream that can be streamed.
+	 */
+	bool SoundObject::IsStreamable() const
+	{
+		return Sound && Sound->IsStream();
+	}
+
+	/**
+	 * @return TRUE if this SoundObject is streamable and the End Of Stream was reached.
+	 */
+	bool SoundObject::IsEOS() const
+	{
+		return Sound && Sound->IsStream() && ((SoundStream*)Sound)->IsEOS(this);
+	}
+
+
+	/**
+	 * Starts playing the sound. If the sound is already playing, it is rewinded and played again from the start.
+	 */
+	void SoundObject::Play()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_PLAY, this);
+		if (State && State->isPlaying) Restart(true);	// retrigger from the start, 3D sounds propagate again
+		else if (Source)
+		{
+			bool resume = State->isPaused;
+			State->isPlaying = true;
+			State->isPaused = false;
+			if (!GetBuffersQueued(Source) &&	// no buffers queued (track probably finished)
+				!(resume && TracksPosition()))	// unless a paused virtual stream resumes at its position
+			{
+				State->isInitial = true;
+				Sound->ResetBuffer(this);	// reset buffer to beginning
+			}
+			StartVoice(!resume);			// continue if paused or suspended
+		}
+	}
+
+	/**
+	 * Starts the Source voice. 3D sounds may schedule the start for later.
+	 * @param fresh TRUE if playback starts from a stop, FALSE if it resumes from a pause
+	 */
+	void SoundObject::StartVoice(bool fresh)
+	{
+		Source->Start();
+	}
+
+	/**
+	 * Starts playing a new sound. Any older playing sounds will be stopped and replaced with this sound.
+	 * @param sound SoundBuffer or SoundStream to start playing
+	 * @param loop [false] Sets if the sound is looping or not. Streams are never loopable.
+	 */
+	void SoundObject::Play(SoundBuffer* sound, bool loop)
+	{
+		SetSound(sound, loop);
+		Play();
+	}
+	/**
+	 * Stops playing the sound and unloads streaming buffers.
+	 */
+	void SoundObject::Stop()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_STOP, this);
+		if (Source && State->isPlaying) { // only if isPlaying, to avoid rewind
+			State->isPlaying = false;
+			State->isPaused = false;
+			Source->Stop();
+			Source->FlushSourceBuffers();
+		}
+	}
+	/**
+	 * Temporarily pauses sound playback and doesn't unload any streaming buffers.
+	 */
+	void SoundObject::Pause()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_PAUSE, this);
+		if (Source)
+		{
+			State->isPlaying = false;
+			State->isPaused = true;
+			Source->Stop(); // Stop() effectively pauses playback
+		}
+	}
+	/**
+	 * If current status is Playing, then this rewinds to start of the soundbuffer/stream and starts playing again.
+	 * If current status is NOT playing, then any stream resources are freed and the object is reset.
+	 */
+	void SoundObject::Rewind()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_REWIND, this);
+		Restart(false);
+	}
+
+	/**
+	 * Resets the sound to its start and continues playing if it was playing
+	 * @param fresh TRUE if a playing sound is retriggered by Play(), FALSE for Rewind()
+	 */
+	void SoundObject::Restart(bool fresh)
+	{
+		if (!Sound) return; // invalid Engine or rejected format, the object stays silent
+		Sound->ResetBuffer(this); // reset stream or buffer to initial state
+		State->isInitial = true;
+		State->isPaused = false;
+		if (State->isPlaying) // should we continue playing?
+		{
+			StartVoice(fresh);
+		}
+	}
+
+	/**
+	 * @return TRUE if the sound source is PLAYING.
+	 */
+	bool SoundObject::IsPlaying() const
+	{
+		return State && State->isPlaying;
+	}
+
+	/**
+	 * @return TRUE if the sound source is STOPPED.
+	 */
+	bool SoundObject::IsStopped() const
+	{
+		return !State || !State->isPlaying;
+	}
+
+	/**
+	 * @return TRUE if the sound source is PAUSED.
+	 */
+	bool SoundObject::IsPaused() const
+	{
+		return State && State->isPaused;
+	}
+
+	/**
+	 * @return TRUE if the sound source is at the beginning of the sound buffer.
+	 */
+	bool SoundObject::IsInitial() const
+	{
+		return State && State->isInitial;
+	}
+
+
+	/**
+	 * @return TRUE if the sound source is in LOOPING mode.
+	 */
+	bool SoundObject::IsLooping() const
+	{
+		return State && State->isLoopable;
+	}
+
+	/**
+	 * Sets the looping mode of the sound source.
+	 */
+	void SoundObject::Looping(bool looping)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LOOPING, this, nullptr, looping ? 1 : 0);
+		if (!State || State->isLoopable == looping)
+			return;
+		State->isLoopable = looping;
+		if (State->isInitial && !State->isPlaying && Sound && !Sound->IsStream())
+			Sound->ResetBuffer(this); // resubmit with or without the silent tail
+	}
+
+	/**
+	 * Indicates the gain (volume amplification) applied. Range [0.0f .. 1.0f]
+	 * Each division by 2 equals an attenuation of -6dB. Each multiplicaton with 2 equals an amplification of +6dB.
+	 * A value of 0.0 is meaningless with respect to a logarithmic scale; it is interpreted as zero volume - the channel is effectively disabled.
+	 * @param gain Gain value between 0.0..1.0
+	 */
+	void SoundObject::Volume(float volume)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_VOLUME, this, nullptr, 0, &volume, 1);
+		if (Source) Source->SetVolume(volume);
+	}
+
+	/**
+	 * @return Current gain value of this source
+	 */
+	float SoundObject::Volume() const
+	{
+		if (!Source) return 0.0f; // silent without a voice
+		float volume;
+		Source->GetVolume(&volume);
+		return volume;
+	}
+
+	/**
+	 * @return Gets the current playback position in the SoundBuffer or SoundStream in SAMPLES
+	 */
+	int SoundObject::PlaybackPos() const
+	{
+		if (!Source) return 0;
+		XAUDIO2_VOICE_STATE state;
+		Source->GetState(&state);
+		return (int)state.SamplesPlayed;
+	}
+
+	/**
+	 * Sets the playback position of the underlying SoundBuffer or SoundStream in SAMPLES
+	 */
+	void SoundObject::PlaybackPos(int seekpos)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_SEEK, this, nullptr, seekpos);
+		if (!Sound) return;
+		if (Sound->IsStream()) // stream objects
+		{
+			((SoundStream*)Sound)->Seek(this, seekpos); // seek the stream
+		}
+		else // single buffer objects
+		{
+			// first create a shallow copy of the xaBuffer:
+			XABuffer& shallow = State->shallow = *Sound->xaBuffer;
+			if (shallow.wf.wFormatTag == WAVE_FORMAT_ADPCM)
+				seekpos -= seekpos % shallow.wSamplesPerBlock; // ADPCM can only start at a block
+			shallow.PlayBegin = seekpos;
+			shallow.PlayLength = shallow.wf.wFormatTag == WAVE_FORMAT_ADPCM ? 0 : shallow.nPCMSamples - seekpos;
+
+			State->isPaused = false;
+			Source->Stop();
+			if (GetBuffersQueued(Source)) // only flush if there is something to flush
+				Source->FlushSourceBuffers();
+			Source->SubmitSourceBuffer(&shallow);
+		}
+		if (State->isPlaying) 
+			Source->Start();
+	}
+
+	/**
+	 * @return Playback size of the underlying SoundBuffer or SoundStream in SAMPLES
+	 */
+	int SoundObject::PlaybackSize() const
+	{
+		return Sound ? Sound->Size() : 0;
+	}
+
+
+	/**
+	 * @return Number of samples processed every second (aka SampleRate or Frequency)
+	 */
+	int SoundObject::SamplesPerSecond() const
+	{
+		return Sound ? Sound->Frequency() : 0;
+	}
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+
+	/**
+	 * Creates an uninitialzed Sound2D, but also
+	 * setups the sound source as an environment/bakcground sound.
+	 */
+	Sound::Sound() : SoundObject()
+	{
+		Reset();
+		CommandScope cmd; // the object is known to the recorder from here on
+		if (cmd.record) RecordCommand(COMMAND_CREATE_SOUND, this);
+	}
+	/**
+	 * Creates a Sound2D with an attached buffer
+	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	Sound::Sound(SoundBuffer* sound, bool loop, bool play) : SoundObject(sound, loop, play)
+	{
+		Reset();
+		CommandScope cmd; // the object is known to the recorder from here on
+		if (cmd.record) RecordCommand(COMMAND_CREATE_SOUND, this, sound, (loop ? 1 : 0) | (play ? 2 : 0));
+	}
+
+	/**
+	 * Resets all background audio parameters to their defaults
+	 */
+	void Sound::Reset()
+	{
+
+	}
+
+
+
+
+
+
+
+
+
+
+
+	/**
+	 * Creates an uninitialzed Sound3D, but also
+	 * setups the sound source as a 3D positional sound.
+	 */
+	Sound3D::Sound3D() : SoundObject(), Spatial(new SpatialState())
+	{
+		EngineState& engine = *Owner->State();
+		Reset();
+		SpatialLock lock(engine);
+		engine.sounds.push_back(this);
+		engine.batch.Reserve(engine.sounds.size());
+		RegisterSound3D(Handle, this);
+		CommandScope cmd; // the object is known to the recorder from here on
+		if (cmd.record) RecordCommand(COMMAND_CREATE_SOUND3D, this);
+	}
+	/**
+	 * Creates a Sound3D with an attached buffer
+	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	Sound3D::Sound3D(SoundBuffer* sound, bool loop, bool play) 
+		: SoundObject(sound, loop, play), Spatial(new SpatialState())
+	{
+		EngineState& engine = *Owner->State();
+		Reset();
+		SpatialLock lock(engine);
+		if (Source) OnVoiceCreated(); // the voice was created before this object was a Sound3D
+		engine.sounds.push_back(this);
+		engine.batch.Reserve(engine.sounds.size());
+		RegisterSound3D(Handle, this);
+		CommandScope cmd; // the object is known to the recorder from here on
+		if (cmd.record) RecordCommand(COMMAND_CREATE_SOUND3D, this, sound, (loop ? 1 : 0) | (play ? 2 : 0));
+	}
+
+	/**
+	 * Unhooks this Sound3D from the ReverbZones and frees resources
+	 */
+	Sound3D::~Sound3D()
+	{
+		{
+			EngineState& engine = *Owner->State();
+			SpatialLock lock(engine);
+			engine.sounds.erase(std::find(engine.sounds.begin(), engine.sounds.end(), this));
+		}
+		delete Spatial;
+	}
+
+	/**
+	 * Sends this Source voice to the master and to every ReverbZone bus
+	 */
+	void Sound3D::RouteSends()
+	{
+		if (!Source) return;
+		EngineState& engine = *Owner->State();
+		std::vector<XAUDIO2_SEND_DESCRIPTOR> sends;
+		sends.reserve(engine.zones.size() + 1);
+		XAUDIO2_SEND_DESCRIPTOR master = { 0, engine.master };
+		sends.push_back(master);
+		for (ReverbZone* zone : engine.zones) {
+			if (!zone->Bus()) continue;
+			XAUDIO2_SEND_DESCRIPTOR send = { 0, zone->Bus() };
+			sends.push_back(send);
+		}
+		XAUDIO2_VOICE_SENDS sendList = { (UINT32)sends.size(), sends.data() };
+		Source->SetOutputVoices(&sendList);
+		UpdateZoneSends(Position());
+	}
+
+	/**
+	 * Updates the send level to every ReverbZone from the zone membership of the specified position
+	 * @param pos Position of this sound
+	 * @param scale [1.0] Extra scale of all sends, from the SoundBuffer reverb curve
+	 * @param gain [0.0] Gain of this sound at the listener, how loud the sends are for the Governor
+	 */
+	void Sound3D::UpdateZoneSends(const Vector3& pos, float scale, float gain)
+	{
+		EngineState& engine = *Owner->State();
+		if (!Source || engine.zones.empty()) return;
+
+		XAUDIO2_VOICE_DETAILS details;
+		Source->GetVoiceDetails(&details);
+		const UINT32 srcChannels = details.InputChannels;
+
+		float matrix[2 * XAUDIO2_MAX_AUDIO_CHANNELS];
+		for (ReverbZone* zone : engine.zones)
+		{
+			if (!zone->Bus()) continue; // its bus could not be created
+			zone->Bus()->GetVoiceDetails(&details);
+			const UINT32 dstChannels = details.InputChannels;
+			const float level = zone->Membership(pos) * zone->SendLevel() * scale;
+			if (level * gain > zone->passPeak)
+				zone->passPeak = level * gain;
+
+			// matrix[S + srcChannels * D]; mono goes to all channels, stereo goes L->L R->R
+			for (UINT32 d = 0; d < dstChannels; ++d)
+				for (UINT32 s = 0; s < srcChannels; ++s)
+					matrix[s + srcChannels * d] = (srcChannels == 1 || s == d) ? level : 0.0f;
+			Source->SetOutputMatrix(zone->Bus(), srcChannels, dstChannels, matrix);
+		}
+	}
+
+	/**
+	 * [audio thread] Adds this sound to the spatial batch if it's playing
+	 * @param batch Batch of the current spatial pass
+	 * @param listener Listener sampled at the same time
+	 * @param now Current audio clock time in seconds
+	 */
+	void Sound3D::BeginSpatial(SpatialBatch& batch, const X3DAUDIO_LISTENER& listener, double now)
+	{
+		if (!Source) return;
+		if (Spatial->startTime) // scheduled start after propagation delay
+		{
+			if (!State->isPlaying)
+				Spatial->startTime = 0.0; // stopped or paused while waiting
+			else if (now >= Spatial->startTime)
+			{
+				Spatial->startTime = 0.0;
+				Source->Start();
+			}
+		}
+		if (!State->isPlaying || Spatial->isVirtual || Spatial->relative) return; // relative sounds have a static pan
+		const EngineState& engine = *Owner->State();
+		if (Emitter.ChannelCount > SpatialState::MaxSrcChannels || engine.masterChannels > SpatialState::MaxDstChannels)
+			return; // not pannable, plays with the default matrix
+
+		TransformKey key;
+		Spatial->track.Sample(now, engine.interpolation, key);
+		const X3DAUDIO_VECTOR& lp = listener.Position;
+		float dx = lp.x - key.pos.x, dy = lp.y - key.pos.y, dz = lp.z - key.pos.z;
+
+		batch.sounds.push_back(this);
+		batch.keys.push_back(key);
+		batch.distances.push_back(sqrtf(dx*dx + dy*dy + dz*dz));
+		batch.volumeCurves.push_back(Sound->VolumeCurve());
+		batch.lowpassCurves.push_back(Sound->LowpassCurve());
+		batch.reverbCurves.push_back(Sound->ReverbCurve());
+	}
+
+	/**
+	 * [audio thread] Applies panning, doppler, attenuation, lowpass and zone sends after the batch was evaluated
+	 * @param batch Batch of the current spatial pass
+	 * @param i Index of this sound in the batch
+	 * @param listener Listener sampled at the same time
+	 */
+	void Sound3D::ApplySpatial(const SpatialBatch& batch, int i, const X3DAUDIO_LISTENER& listener)
+	{
+		const EngineState& engine = *Owner->State();
+		const TransformKey& key = batch.keys[i];
+		const float distance = batch.distances[i];
+
+		X3DAUDIO_EMITTER emitter = Emitter;
+		emitter.Position = key.pos;
+		emitter.OrientFront = key.front;
+		emitter.OrientTop = key.top;
+		emitter.Velocity = key.vel;
+		emitter.pVolumeCurve = &xFlatCurve;
+		emitter.pCone = nullptr;
+
+		X3DAUDIO_DSP_SETTINGS dsp;
+		memset(&dsp, 0, sizeof(dsp));
+		dsp.SrcChannelCount = emitter.ChannelCount;
+		dsp.DstChannelCount = engine.masterChannels;
+		dsp.pMatrixCoefficients = Spatial->matrix;
+		const bool doppler = engine.governorLevel < GOVERNOR_NO_DOPPLER;
+		X3DAudioCalculate(engine.x3daudio, &listener, &emitter, 
+						  X3DAUDIO_CALCULATE_MATRIX | (doppler ? X3DAUDIO_CALCULATE_DOPPLER : 0), &dsp);
+		if (!doppler) dsp.DopplerFactor = 1.0f;
+
+		// distance and cone attenuation: a curve table, a division or a table lookup per emitter instead of pow/acos
+		const Attenuation& atten = Spatial->atten;
+		float gain = batch.volumeCurves[i] ? batch.volumes[i] : atten.DistanceGain(distance);
+		if (atten.HasCone() && distance > 0.0f)
+		{
+			const X3DAUDIO_VECTOR& lp = listener.Position;
+			float cosAngle = ((lp.x - key.pos.x)*key.front.x + (lp.y - key.pos.y)*key.front.y + 
+							  (lp.z - key.pos.z)*key.front.z) / distance;
+			gain *= atten.ConeGain(cosAngle);
+		}
+		const UINT32 count = dsp.SrcChannelCount * dsp.DstChannelCount;
+		for (UINT32 n = 0; n < count; ++n)
+			Spatial->matrix[n] *= gain;
+
+		Source->SetOutputMatrix(engine.master, dsp.SrcChannelCount, dsp.DstChannelCount, Spatial->matrix);
+		Source->SetFrequencyRatio(dsp.DopplerFactor < 2.0f ? dsp.DopplerFactor : 2.0f); // voices are created with max ratio 2.0
+		if (batch.lowpassCurves[i] && (VoiceFlags(Source) & XAUDIO2_VOICE_USEFILTER))
+		{
+			XAUDIO2_FILTER_PARAMETERS filter = { LowPassFilter, 2.0f * sinf(X3DAUDIO_PI / 6.0f * batch.lowpasses[i]), 1.0f };
+			Source->SetFilterParameters(&filter);
+		}
+		UpdateZoneSends(Vector3(key.pos.x, key.pos.y, key.pos.z), batch.reverbs[i], gain * Volume());
+	}
+
+	/**
+	 * Sets up the emitter channels and reroutes the new Source voice to the ReverbZone buses
+	 */
+	void Sound3D::OnVoiceCreated()
+	{
+		XAUDIO2_VOICE_DETAILS details;
+		Source->GetVoiceDetails(&details);
+		Emitter.ChannelCount = details.InputChannels;
+		if (Emitter.ChannelCount == 2) // stereo emitters spread their channels left and right
+		{
+			Emitter.ChannelRadius = 1.0f;
+			Emitter.pChannelAzimuths = xStereoAzimuths;
+		}
+		else
+		{
+			Emitter.ChannelRadius = 0.0f;
+			Emitter.pChannelAzimuths = nullptr;
+		}
+		RouteSends();
+		UpdateRelativePan(true);
+	}
+
+	/**
+	 * [game thread] Sets the static pan of a listener relative sound from its position and direction
+	 * @param resetVoice TRUE to also reset doppler, lowpass and the ReverbZone sends left by the spatial pass
+	 */
+	void Sound3D::UpdateRelativePan(bool resetVoice)
+	{
+		if (!Source || !Spatial->relative) return;
+		EngineState& engine = *Owner->State();
+		if (Emitter.ChannelCount > SpatialState::MaxSrcChannels || engine.masterChannels > SpatialState::MaxDstChannels)
+			return; // not pannable, plays with the default matrix
+
+		// the listener's head is the origin, facing +Z
+		X3DAUDIO_LISTENER head;
+		memset(&head, 0, sizeof(head));
+		head.OrientFront = Vec(0.0f, 0.0f, 1.0f);
+		head.OrientTop = Vec(0.0f, 1.0f, 0.0f);
+		X3DAUDIO_EMITTER emitter = Emitter;
+		emitter.Velocity = Vec(0.0f, 0.0f, 0.0f);
+		emitter.pVolumeCurve = &xFlatCurve;
+		emitter.pCone = nullptr;
+
+		float matrix[SpatialState::MaxSrcChannels * SpatialState::MaxDstChannels]; // Spatial->matrix is the audio thread's
+		X3DAUDIO_DSP_SETTINGS dsp;
+		memset(&dsp, 0, sizeof(dsp));
+		dsp.SrcChannelCount = emitter.ChannelCount;
+		dsp.DstChannelCount = engine.masterChannels;
+		dsp.pMatrixCoefficients = matrix;
+		X3DAudioCalculate(engine.x3daudio, &head, &emitter, X3DAUDIO_CALCULATE_MATRIX, &dsp);
+		Source->SetOutputMatrix(engine.master, dsp.SrcChannelCount, dsp.DstChannelCount, matrix);
+
+		if (resetVoice)
+		{
+			Source->SetFrequencyRatio(1.0f);
+			if (VoiceFlags(Source) & XAUDIO2_VOICE_USEFILTER)
+			{
+				XAUDIO2_FILTER_PARAMETERS filter = { LowPassFilter, 1.0f, 1.0f }; // fully open
+				Source->SetFilterParameters(&filter);
+			}
+			UpdateZoneSends(Position(), 0.0f); // silent sends
+		}
+	}
+
+	/**
+	 * Schedules the start after the propagation delay, if it's enabled
+	 */
+	void Sound3D::StartVoice(bool fresh)
+	{
+		if (fresh && Spatial->propagation && !Spatial->relative) // relative sounds are at the listener
+		{
+			const EngineState& engine = *Owner->State();
+			const X3DAUDIO_VECTOR& a = Emitter.Position;
+			const X3DAUDIO_VECTOR& b = engine.listener.Position;
+			float dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+			float delay = sqrtf(dx*dx + dy*dy + dz*dz) / engine.speedOfSound;
+			if (delay > engine.propagationBudget) delay = engine.propagationBudget;
+			if (delay > 0.0f)
+			{
+				Spatial->startTime = AudioClock() + delay; // the spatial pass starts the voice
+				return;
+			}
+		}
+		Spatial->startTime = 0.0;
+		if (Spatial->isVirtual && !GetBuffersQueued(Source))
+			return; // resumed while virtual, UpdateVirtual() starts it once audible
+		Spatial->isVirtual = false; // Play/Rewind reloaded the buffers
+		Source->Start();
+	}
+
+	/**
+	 * @return Estimated gain of this sound at the listener from the last transform updates
+	 */
+	float Sound3D::Audibility() const
+	{
+		if (Spatial->relative)
+			return Volume(); // no distance attenuation
+		const EngineState& engine = *Owner->State();
+		const X3DAUDIO_VECTOR& a = Emitter.Position;
+		const X3DAUDIO_VECTOR& b = engine.listener.Position;
+		float dx = b.x - a.x, dy = b.y - a.y, dz = b.z - a.z;
+		float distance = sqrtf(dx*dx + dy*dy + dz*dz);
+
+		const Attenuation& atten = Spatial->atten;
+		const FalloffCurve* curve = Sound->VolumeCurve();
+		float gain = curve ? curve->Evaluate(distance) : atten.DistanceGain(distance);
+		if (atten.HasCone() && distance > 0.0f)
+		{
+			const X3DAUDIO_VECTOR& f = Emitter.OrientFront;
+			gain *= atten.ConeGain((dx*f.x + dy*f.y + dz*f.z) / distance);
+		}
+		return gain * Volume();
+	}
+
+	/**
+	 * @param engine Engine of the sound
+	 * @return Listener::VirtualThreshold, raised to -40dB while the Governor virtualizes voices
+	 */
+	static float VirtualThreshold(const EngineState& engine)
+	{
+		if (engine.governorLevel >= GOVERNOR_VIRTUALIZE && engine.virtualThreshold > 0.0f && engine.virtualThreshold < 0.01f)
+			return 0.01f;
+		return engine.virtualThreshold;
+	}
+
+	/**
+	 * [game thread] Moves an inaudible stream into the virtual state or brings it back
+	 * @param now Current audio clock time in seconds
+	 */
+	void Sound3D::UpdateVirtual(double now)
+	{
+		if (!Source || !Sound || !Sound->IsStream())
+			return;
+		SoundStream* stream = (SoundStream*)Sound;
+		SpatialState& s = *Spatial;
+
+		if (!s.isVirtual)
+		{
+			// only steadily playing streams go virtual, never one waiting for its propagation delay
+			// silent parts of the stream itself go virtual too, looking a little ahead to return in time
+			const float threshold = VirtualThreshold(*Owner->State());
+			if (!State->isPlaying || s.startTime || threshold <= 0.0f)
+				return;
+			const int pos = stream->Tell(this);
+			const float audibility = Audibility();
+			if (audibility >= threshold && audibility * stream->Peak(pos, stream->Frequency() / 2) >= threshold)
+				return;
+			s.virtualPos = pos;
+			s.virtualTime = now;
+			s.isVirtual = true;
+			stream->ReleaseBuffers(this); // stops the voice, it costs nothing while stopped
+			return;
+		}
+
+		if (GetBuffersQueued(Source)) // Seek, Play or Rewind reloaded the stream meanwhile
+		{
+			s.isVirtual = false;
+			return;
+		}
+
+		if (!State->isPlaying) // the clock doesn't run while paused, Stop() ends the virtual state
+		{
+			s.virtualTime = now;
+			if (!State->isPaused) s.isVirtual = false;
+			return;
+		}
+
+		// where would the stream be by now? loops wrap around, one-shots may have ended
+		const int size = stream->Size();
+		double pos = s.virtualPos + (now - s.virtualTime) * stream->Frequency();
+		if (pos >= size)
+		{
+			if (!State->isLoopable || size <= 0)
+			{
+				s.isVirtual = false;
+				State->isPlaying = false; // finished while inaudible
+				State->isInitial = true;
+				return;
+			}
+			pos = fmod(pos, double(size));
+		}
+		s.virtualPos = int(pos);
+		s.virtualTime = now;
+		if (Audibility() * stream->Peak(s.virtualPos, stream->Frequency() / 2) < VirtualThreshold(*Owner->State()) * 2.0f)
+			return; // 6dB hysteresis
+
+		s.isVirtual = false;
+		stream->Seek(this, s.virtualPos); // decodes directly at the current position
+		Source->Start();
+	}
+
+	/**
+	 * @return TRUE if this is an inaudible stream that only tracks its playback time.
+	 * Virtual streams hold no decoded buffers and their voice is stopped.
+	 */
+	bool Sound3D::IsVirtual() const
+	{
+		return Spatial->isVirtual;
+	}
+
+	/**
+	 * @return TRUE while this stream is virtual, UpdateVirtual() seeks it back to its position
+	 */
+	bool Sound3D::TracksPosition() const
+	{
+		return Spatial->isVirtual;
+	}
+
+	/**
+	 * Resets all 3D positional audio parameters to their defaults
+	 */
+	void Sound3D::Reset()
+	{
+		Emitter.Position = Vec(0.0f, 0.0f, 0.0f);
+		Emitter.OrientFront = Vec(0.0f, 0.0f, 1.0f);
+		Emitter.OrientTop = Vec(0.0f, 1.0f, 0.0f);
+		Emitter.Velocity = Vec(0.0f, 0.0f, 0.0f);
+		Emitter.CurveDistanceScaler = 1.0f;
+		Emitter.DopplerScaler = 1.0f;
+		Spatial->track.Reset(MakeKey(Emitter.Position, Emitter.OrientFront, 
+									 Emitter.OrientTop, Emitter.Velocity), false);
+		UpdateRelativePan();
+	}
+
+	/**
+	 * Sets the 3D position of this Sound3D object
+	 * @param x Position x component
+	 * @param y Position Y component
+	 * @param z Position z component
+	 */
+	void Sound3D::Position(float x, float y, float z)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_POSITION, this, x, y, z);
+		const X3DAUDIO_VECTOR& p = Emitter.Position;
+		const bool moved = p.x != x || p.y != y || p.z != z;
+		Emitter.Position = Vec(x, y, z);
+		Spatial->track.Push(MakeKey(Emitter.Position, Emitter.OrientFront, 
+									Emitter.OrientTop, Emitter.Velocity), false);
+		if (moved) UpdateRelativePan();
+	}
+
+	/**
+	 * Sets the 3D position of this Sound3D object
+	 * @param xyz Float vector containing 3D position X Y Z components
+	 */
+	void Sound3D::Position(float* xyz)
+	{
+		Position(xyz[0], xyz[1], xyz[2]);
+	}
+
+	/**
+	 * @return 3D position vector of this SoundObject
+	 */
+	Vector3 Sound3D::Position() const
+	{
+		return Vector3(Emitter.Position.x, Emitter.Position.y, Emitter.Position.z);
+	}
+
+	/**
+	 * Sets the 3D direction of this Sound3D object
+	 * @param x Direction x component
+	 * @param y Direction Y component
+	 * @param z Direction z component
+	 */
+	void Sound3D::Direction(float x, float y, float z)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_DIRECTION, this, x, y, z);
+		const X3DAUDIO_VECTOR front = Emitter.OrientFront;
+		Emitter.OrientFront = Normalize(Vec(x, y, z), Emitter.OrientFront);
+
+		// keep OrientTop orthonormal with the new front
+		X3DAUDIO_VECTOR& f = Emitter.OrientFront;
+		X3DAUDIO_VECTOR& t = Emitter.OrientTop;
+		float d = t.x*f.x + t.y*f.y + t.z*f.z;
+		X3DAUDIO_VECTOR up = Vec(t.x - f.x*d, t.y - f.y*d, t.z - f.z*d);
+		if (up.x*up.x + up.y*up.y + up.z*up.z < 1e-6f) // front is parallel to top
+			up = fabsf(f.y) < 0.9f ? Vec(-f.x*f.y, 1.0f - f.y*f.y, -f.z*f.y) : Vec(1.0f - f.x*f.x, -f.y*f.x, -f.z*f.x);
+		t = Normalize(up, Vec(0.0f, 1.0f, 0.0f));
+
+		Spatial->track.Push(MakeKey(Emitter.Position, Emitter.OrientFront, 
+									Emitter.OrientTop, Emitter.Velocity), false);
+		if (f.x != front.x || f.y != front.y || f.z != front.z) // only stereo emitters pan by direction
+			UpdateRelativePan();
+	}
+
+	/**
+	 * Sets the 3D direction of this Sound3D object
+	 * @param xyz Float vector containing 3D direction X Y Z components
+	 */
+	void Sound3D::Direction(float* xyz)
+	{
+		Direction(xyz[0], xyz[1], xyz[2]);
+	}
+
+	/**
+	 * @return 3D direction vector of this SoundObject
+	 */
+	Vector3 Sound3D::Direction() const
+	{
+		return Vector3(Emitter.OrientFront.x, Emitter.OrientFront.y, Emitter.OrientFront.z);
+	}
+
+	/**
+	 * Sets the 3D velocity of this Sound3D object.
+	 * If the velocity is never set, it is derived from the Position updates.
+	 * @param x Velocity x component
+	 * @param y Velocity Y component
+	 * @param z Velocity z component
+	 */
+	void Sound3D::Velocity(float x, float y, float z)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_VELOCITY, this, x, y, z);
+		Emitter.Velocity = Vec(x, y, z);
+		Spatial->track.Push(MakeKey(Emitter.Position, Emitter.OrientFront, 
+									Emitter.OrientTop, Emitter.Velocity), true);
+	}
+
+	/**
+	 * Sets the 3D velocity of this Sound3D object
+	 * @param xyz Float vector containing 3D velocity X Y Z components
+	 */
+	void Sound3D::Velocity(float* xyz)
+	{
+		Velocity(xyz[0], xyz[1], xyz[2]);
+	}
+
+	/**
+	 * @return 3D velocity vector of this SoundObject
+	 */
+	Vector3 Sound3D::Velocity() const
+	{
+		return Vector3(Emitter.Velocity.x, Emitter.Velocity.y, Emitter.Velocity.z);
+	}
+
+	/**
+	 * Makes this a listener relative sound, for UI, HUD and first person sounds. The Position is then
+	 * relative to the listener's head (+Z front, +Y up) and only pans: there is no distance or cone
+	 * attenuation, doppler or ReverbZone send. The pan is computed when the position or direction
+	 * changes and the spatial pass skips the sound, so relative sounds cost nothing per pass.
+	 * @param isrelative TRUE if the position of this SoundObject is relative. Default is FALSE.
+	 */
+	void Sound3D::Relative(bool isrelative)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_RELATIVE, this, nullptr, isrelative ? 1 : 0);
+		if (Spatial->relative == isrelative)
+			return;
+		SpatialLock lock(*Owner->State()); // a running spatial pass must not overwrite the static pan
+		Spatial->relative = isrelative;
+		UpdateRelativePan(true); // a world sound is panned again by the next spatial pass
+	}
+
+	/**
+	 * @return TRUE if the position of this SoundObject is relative
+	 */
+	bool Sound3D::IsRelative() const
+	{
+		return Spatial->relative;
+	}
+
+	/**
+	 * Enables propagation delay: Play() starts the sound only after it has traveled 
+	 * from the emitter to the listener at Listener::SpeedOfSound. Useful for distant thunder and explosions.
+	 * The delay is limited by Listener::PropagationBudget. While waiting the sound IsPlaying().
+	 * @param enable TRUE to enable propagation delay. Default is FALSE.
+	 */
+	void Sound3D::PropagationDelay(bool enable)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_PROPAGATION_DELAY, this, nullptr, enable ? 1 : 0);
+		Spatial->propagation = enable;
+	}
+	bool Sound3D::PropagationDelay() const
+	{
+		return Spatial->propagation;
+	}
+
+
+	/**
+	 * Sets the distance attenuation model of this Sound3D. Default is INVERSE_DISTANCE.
+	 * @param model Distance model, evaluated once per audio processing pass
+	 */
+	void Sound3D::DistanceModel(AttenuationModel model)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_DISTANCE_MODEL, this, nullptr, int(model));
+		Spatial->atten.Model(model);
+	}
+	AttenuationModel Sound3D::DistanceModel() const
+	{
+		return Spatial->atten.Model();
+	}
+
+	/**
+	 * Sets the distance after which there is no more attenuation. Default is unlimited (FLT_MAX).
+	 * With LINEAR_DISTANCE the gain reaches 0 at this distance (for RolloffFactor 1).
+	 */
+	void Sound3D::MaxDistance(float maxdist)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_MAX_DISTANCE, this, nullptr, 0, &maxdist, 1);
+		Spatial->atten.MaxDistance(maxdist);
+	}
+	float Sound3D::MaxDistance() const
+	{
+		return Spatial->atten.MaxDistance();
+	}
+
+	/**
+	 * Sets how fast the gain falls off with distance. 0 disables distance attenuation. Default is 1.
+	 */
+	void Sound3D::RolloffFactor(float rolloff)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_ROLLOFF_FACTOR, this, nullptr, 0, &rolloff, 1);
+		Spatial->atten.RolloffFactor(rolloff);
+	}
+	float Sound3D::RolloffFactor() const
+	{
+		return Spatial->atten.RolloffFactor();
+	}
+
+	/**
+	 * Sets the distance under which the gain is 1.0. Default is 1.
+	 */
+	void Sound3D::ReferenceDistance(float refdist)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_REFERENCE_DISTANCE, this, nullptr, 0, &refdist, 1);
+		Spatial->atten.ReferenceDistance(refdist);
+	}
+	float Sound3D::ReferenceDistance() const
+	{
+		return Spatial->atten.ReferenceDistance();
+	}
+
+	/**
+	 * Sets the gain applied outside the outer cone. Range [0.0 - 1.0], default is 1.0.
+	 */
+	void Sound3D::ConeOuterGain(float value)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_CONE_OUTER_GAIN, this, nullptr, 0, &value, 1);
+		Spatial->atten.ConeOuterGain(value);
+	}
+	float Sound3D::ConeOuterGain() const
+	{
+		return Spatial->atten.ConeOuterGain();
+	}
+
+	/**
+	 * Sets the inner sound cone angle in degrees. Default is 360.
+	 * The outer cone angle grows to match if it's smaller.
+	 * @param angle Angle
+	 */
+	void Sound3D::ConeInnerAngle(float angle)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_CONE_INNER_ANGLE, this, nullptr, 0, &angle, 1);
+		Spatial->atten.ConeInnerAngle(angle);
+	}
+	float Sound3D::ConeInnerAngle() const
+	{
+		return Spatial->atten.ConeInnerAngle();
+	}
+
+	/**
+	 * Sets the outer sound cone angle in degrees. Default is 360.
+	 * Outer cone angle cannot be smaller than inner cone angle
+	 * @param angle Angle 
+	 */
+	void Sound3D::ConeOuterAngle(float angle)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_CONE_OUTER_ANGLE, this, nullptr, 0, &angle, 1);
+		Spatial->atten.ConeOuterAngle(angle);
+	}
+	float Sound3D::ConeOuterAngle() const
+	{
+		return Spatial->atten.ConeOuterAngle();
+	}
+
+
+
+
+
+
+
+
+
+
+
+
+	/**
+	 * Sets the master gain value (Volume) of the listener object for Audio3D.
+	 * Valid range is [0.0 - Any], meaning the global volume can be increased
+	 * until the sound starts distorting. WARNING! This does not change system volume!
+	 * @param gain Gain value to set for the listener. Range[0.0 - Any].
+	 */
+	void Listener::Volume(float gain)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LISTENER_VOLUME, nullptr, nullptr, 0, &gain, 1);
+		EngineState& engine = CurrentState();
+		if (gain < 0.0f) gain = 0.0f;
+		if (engine.master) engine.master->SetVolume(gain);
+	}
+
+	/**
+	 * Gets the master gain value (Volume) of the listener object for Audio3D.
+	 * Valid range is [0.0 - Any], meaning the global volume can be increased
+	 * until the sound starts distorting. WARNING! This does not change system volume!
+	 * @return Master gain value (Volume). Range[0.0 - Any].
+	 */
+	float Listener::Volume()
+	{
+		EngineState& engine = CurrentState();
+		float value = 0.0f;
+		if (engine.master) engine.master->GetVolume(&value);
+		return value;
+	}
+
+	/**
+	 * Pushes the current listener transform to the spatial pass
+	 * @param engine Engine of the listener
+	 * @param velocity TRUE if the velocity was set explicitly
+	 */
+	static void PushListener(EngineState& engine, bool velocity)
+	{
+		const X3DAUDIO_LISTENER& l = engine.listener;
+		engine.listenerTrack.Push(MakeKey(l.Position, l.OrientFront, l.OrientTop, l.Velocity), velocity);
+	}
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param pos Vector containing x y z components of the position
+	 */
+	void Listener::Position(const Vector3& pos)
+	{
+		Position(pos.x, pos.y, pos.z);
+	}
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param x X component of the new position
+	 * @param y Y component of the new position
+	 * @param z Z component of the new position
+	 */
+	void Listener::Position(float x, float y, float z)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_LISTENER_POSITION, nullptr, x, y, z);
+		EngineState& engine = CurrentState();
+		engine.listener.Position = Vec(x, y, z);
+		PushListener(engine, false);
+	}
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param xyz Float array containing x y z components of the position
+	 */
+	void Listener::Position(float* xyz)
+	{
+		Position(xyz[0], xyz[1], xyz[2]);
+	}
+
+	/**
+	 * @return Position of the listener object for Audio3D
+	 */
+	Vector3 Listener::Position()
+	{
+		EngineState& engine = CurrentState();
+		return Vector3(engine.listener.Position.x, engine.listener.Position.y, engine.listener.Position.z);
+	}
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D.
+	 * If the velocity is never set, it is derived from the Position updates.
+	 * @param pos Vector containing x y z components of the velocity
+	 */
+	void Listener::Velocity(const Vector3& vel)
+	{
+		Velocity(vel.x, vel.y, vel.z);
+	}
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D
+	 * @param x X component of the new velocity
+	 * @param y Y component of the new velocity
+	 * @param z Z component of the new velocity
+	 */
+	void Listener::Velocity(float x, float y, float z)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_LISTENER_VELOCITY, nullptr, x, y, z);
+		EngineState& engine = CurrentState();
+		engine.listener.Velocity = Vec(x, y, z);
+		PushListener(engine, true);
+	}
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D
+	 * @param xyz Float array containing x y z components of the velocity
+	 */
+	void Listener::Velocity(float* xyz)
+	{
+		Velocity(xyz[0], xyz[1], xyz[2]);
+	}
+
+	/**
+	 * @return Velocity of the listener object for Audio3D
+	 */
+	Vector3 Listener::Velocity()
+	{
+		EngineState& engine = CurrentState();
+		return Vector3(engine.listener.Velocity.x, engine.listener.Velocity.y, engine.listener.Velocity.z);
+	}
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param target Vector containing x y z components of target where to 'look', thus changing the orientation.
+	 * @param up Vector containing x y z components of the orientation 'up' vector
+	 */
+	void Listener::LookAt(const Vector3& target, const Vector3& up)
+	{
+		LookAt(target.x, target.y, target.z, up.x, up.y, up.z);
+	}
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param x X component of the new direction
+	 * @param y Y component of the new direction
+	 * @param z Z component of the new direction
+	 */
+	void Listener::LookAt(float xAT, float yAT, float zAT, float xUP, float yUP, float zUP)
+	{
+		CommandScope cmd;
+		if (cmd.record)
+		{
+			const float args[6] = { xAT, yAT, zAT, xUP, yUP, zUP };
+			RecordCommand(COMMAND_LISTENER_LOOKAT, nullptr, nullptr, 0, args, 6);
+		}
+		EngineState& engine = CurrentState();
+		engine.listenerTarget = Vector3(xAT, yAT, zAT);
+		engine.listenerUp = Vector3(xUP, yUP, zUP);
+
+		const X3DAUDIO_VECTOR& p = engine.listener.Position;
+		X3DAUDIO_VECTOR f = Normalize(Vec(xAT - p.x, yAT - p.y, zAT - p.z), engine.listener.OrientFront);
+		float d = xUP*f.x + yUP*f.y + zUP*f.z; // make up orthonormal with front
+		X3DAUDIO_VECTOR t = Normalize(Vec(xUP - f.x*d, yUP - f.y*d, zUP - f.z*d), engine.listener.OrientTop);
+		engine.listener.OrientFront = f;
+		engine.listener.OrientTop = t;
+		PushListener(engine, false);
+	}
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param xyzATxyzUP Float array containing x y z components of the direction
+	 */
+	void Listener::LookAt(float* xyzATxyzUP)
+	{
+		LookAt(xyzATxyzUP[0], xyzATxyzUP[1], xyzATxyzUP[2], xyzATxyzUP[3], xyzATxyzUP[4], xyzATxyzUP[5]);
+	}
+
+	/**
+	 * @return Target position of the listener object's orientation
+	 */
+	Vector3 Listener::Target()
+	{
+		return CurrentState().listenerTarget;
+	}
+
+	/**
+	 * @return Up vector of the listener object's orientation
+	 */
+	Vector3 Listener::Up()
+	{
+		return CurrentState().listenerUp;
+	}
+
+	/**
+	 * Sets how far behind the latest transform update the spatial pass renders Sound3D objects
+	 * and the listener. Updates are interpolated inside this window and extrapolated beyond it.
+	 * @param delay Delay in seconds. 0 only extrapolates. Negative (default) uses each object's own update interval.
+	 */
+	void Listener::Interpolation(float delay)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LISTENER_INTERPOLATION, nullptr, nullptr, 0, &delay, 1);
+		CurrentState().interpolation = delay;
+	}
+
+	/**
+	 * @return Interpolation delay in seconds, negative if it follows the update interval
+	 */
+	float Listener::Interpolation()
+	{
+		return CurrentState().interpolation;
+	}
+
+	/**
+	 * Sets the gain under which playing Sound3D streams become virtual: they release their
+	 * decoded buffers and only track their playback time, until they're audible again.
+	 * @param gain Audibility threshold. 0 disables virtual voices. Default is 0.001 (-60dB).
+	 */
+	void Listener::VirtualThreshold(float gain)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LISTENER_VIRTUAL, nullptr, nullptr, 0, &gain, 1);
+		CurrentState().virtualThreshold = gain < 0.0f ? 0.0f : gain;
+	}
+	float Listener::VirtualThreshold()
+	{
+		return CurrentState().virtualThreshold;
+	}
+
+	/**
+	 * @return Custom effects on the master voice, they run on the final mix
+	 */
+	EffectChain& Listener::Effects()
+	{
+		return CurrentState().masterEffects;
+	}
+
+	/**
+	 * Sets the speed of sound used for doppler and propagation delay.
+	 * @param unitsPerSecond Speed in world units per second. Default is 340.29 (meters).
+	 */
+	void Listener::SpeedOfSound(float unitsPerSecond)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LISTENER_SPEED_OF_SOUND, nullptr, nullptr, 0, &unitsPerSecond, 1);
+		if (unitsPerSecond < FLT_MIN) unitsPerSecond = FLT_MIN;
+		EngineState& engine = CurrentState();
+		engine.speedOfSound = unitsPerSecond;
+		if (!engine.xaudio)
+			return;
+		XAUDIO2_DEVICE_DETAILS device;
+		engine.xaudio->GetDeviceDetails(0, &device);
+		SpatialLock lock(engine); // X3DAudio handle is in use by the spatial pass
+		X3DAudioInitialize(device.OutputFormat.dwChannelMask, engine.speedOfSound, engine.x3daudio);
+	}
+	float Listener::SpeedOfSound()
+	{
+		return CurrentState().speedOfSound;
+	}
+
+	/**
+	 * Sets the global propagation delay budget: no Sound3D start is delayed longer than this.
+	 * Delayed starts are scheduled, so they need no per voice memory.
+	 * @param seconds Maximum propagation delay in seconds. Default is 2.0.
+	 */
+	void Listener::PropagationBudget(float seconds)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_LISTENER_PROPAGATION, nullptr, nullptr, 0, &seconds, 1);
+		CurrentState().propagationBudget = seconds < 0.0f ? 0.0f : seconds;
+	}
+	float Listener::PropagationBudget()
+	{
+		return CurrentState().propagationBudget;
+	}
+
+
+
+
+
+
+
+
+
+
+
+
+	/**
+	 * Creates a new ReverbZone with its own reverb bus and routes all Sound3D objects to it
+	 * @param numLines [8] Number of FDN delay lines, 8 or 16. More lines give a denser tail.
+	 */
+	ReverbZone::ReverbZone(int numLines)
+		: owner(Engine::Current()), bus(nullptr), reverb(nullptr), radius(10.0f), falloff(5.0f), sendLevel(1.0f), 
+		passPeak(0.0f), quietTime(0.0f), bypassed(false)
+	{
+		EngineState& engine = *owner->State();
+
+		// the bus runs in the master format, so the reverb output needs no conversion
+		XAUDIO2_VOICE_DETAILS master = { 0, 2, 48000 };
+		if (engine.master) engine.master->GetVoiceDetails(&master);
+		reverb = new FDNReverb(numLines, master.InputSampleRate);
+
+		if (engine.xaudio && FAILED(engine.xaudio->CreateSubmixVoice(&bus, master.InputChannels, master.InputSampleRate)))
+			bus = nullptr; // an invalid Engine has no bus, the zone stays silent
+		effects.Attach(bus);
+		effects.Add(reverb);
+
+		SpatialLock lock(engine);
+		engine.zones.push_back(this);
+		for (Sound3D* sound : engine.sounds)
+			sound->RouteSends();
+		CommandScope cmd; // the zone is known to the recorder from here on
+		if (cmd.record) RecordCommand(COMMAND_ZONE_CREATE, this, nullptr, numLines);
+	}
+
+	/**
+	 * Unroutes all Sound3D objects from this zone and destroys the reverb bus
+	 */
+	ReverbZone::~ReverbZone()
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_ZONE_DESTROY, this);
+		{
+			EngineState& engine = *owner->State();
+			SpatialLock lock(engine);
+			engine.zones.erase(std::find(engine.zones.begin(), engine.zones.end(), this));
+			for (Sound3D* sound : engine.sounds) // a voice can't be destroyed while something still sends to it
+				sound->RouteSends();
+		}
+		if (bus) bus->DestroyVoice(), bus = nullptr;
+		delete reverb; // the XAPO was released with the bus
+	}
+
+	/**
+	 * Sets the center of this zone
+	 */
+	void ReverbZone::Position(const Vector3& pos)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordVector(COMMAND_ZONE_POSITION, this, pos.x, pos.y, pos.z);
+		center = pos;
+	}
+	void ReverbZone::Position(float x, float y, float z)
+	{
+		Position(Vector3(x, y, z));
+	}
+	Vector3 ReverbZone::Position() const
+	{
+		return center;
+	}
+
+	/**
+	 * Sets the radius inside which sounds get the full send level. Default is 10.
+	 */
+	void ReverbZone::Radius(float value)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_ZONE_RADIUS, this, nullptr, 0, &value, 1);
+		radius = value < 0.0f ? 0.0f : value;
+	}
+	float ReverbZone::Radius() const
+	{
+		return radius;
+	}
+
+	/**
+	 * Sets the distance outside Radius over which the send level fades to 0. Default is 5.
+	 */
+	void ReverbZone::Falloff(float distance)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_ZONE_FALLOFF, this, nullptr, 0, &distance, 1);
+		falloff = distance < 0.0f ? 0.0f : distance;
+	}
+	float ReverbZone::Falloff() const
+	{
+		return falloff;
+	}
+
+	/**
+	 * Sets the send level of sounds fully inside this zone. Range [0.0 - 1.0], default is 1.0.
+	 */
+	void ReverbZone::SendLevel(float level)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_ZONE_SEND_LEVEL, this, nullptr, 0, &level, 1);
+		sendLevel = level < 0.0f ? 0.0f : (level > 1.0f ? 1.0f : level);
+	}
+	float ReverbZone::SendLevel() const
+	{
+		return sendLevel;
+	}
+
+	/**
+	 * @return Zone membership weight of the specified point [0.0 - 1.0]
+	 */
+	float ReverbZone::Membership(const Vector3& pos) const
+	{
+		float dx = pos.x - center.x, dy = pos.y - center.y, dz = pos.z - center.z;
+		float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+		if (dist <= radius)
+			return 1.0f;
+		if (dist >= radius + falloff)
+			return 0.0f;
+		return 1.0f - (dist - radius) / falloff; // falloff > 0 here
+	}
+
+
+
+
+
+
+
+
+
+
+
+	/**
+	 * Sets the processing time budget of a single XAudio2 pass (the pass is 10ms).
+	 * @param milliseconds Budget per pass in milliseconds. 0 disables the governor (default).
+	 */
+	void Governor::Budget(float milliseconds)
+	{
+		CommandScope cmd;
+		if (cmd.record) RecordCommand(COMMAND_GOVERNOR_BUDGET, nullptr, nullptr, 0, &milliseconds, 1);
+		CurrentState().governorBudget = milliseconds > 0.0f ? milliseconds : 0.0f;
+	}
+	float Governor::Budget()
+	{
+		return CurrentState().governorBudget;
+	}
+
+	/**
+	 * @return Current quality level
+	 */
+	GovernorLevel Governor::Level()
+	{
+		return GovernorLevel(CurrentState().governorLevel);
+	}
+
+	/**
+	 * @return Smoothed processing time of an XAudio2 pass in milliseconds
+	 */
+	float Governor::PassMillis()
+	{
+		return CurrentState().passMillis;
+	}
+
+
+
+
+	/**
+	 * @param priority Priority of the mixer threads. Default is PRIORITY_NORMAL, XAudio2's own.
+	 */
+	void AudioThreads::MixerPriority(ThreadPriority priority)
+	{
+		InterlockedExchange(&xMixerPriority, priority);
+		InterlockedIncrement(&xMixerSettings);
+	}
+	ThreadPriority AudioThreads::MixerPriority()
+	{
+		return ThreadPriority(xMixerPriority);
+	}
+
+	/**
+	 * @param mask Bit mask of the CPUs the mixer threads may run on, 0 for any CPU (default)
+	 */
+	void AudioThreads::MixerAffinity(unsigned mask)
+	{
+		InterlockedExchange(&xMixerAffinity, LONG(mask));
+		InterlockedIncrement(&xMixerSettings);
+	}
+	unsigned AudioThreads::MixerAffinity()
+	{
+		return unsigned(xMixerAffinity);
+	}
+
+	/**
+	 * @param priority Priority of the decode workers. Default is PRIORITY_NORMAL.
+	 */
+	void AudioThreads::WorkerPriority(ThreadPriority priority)
+	{
+		xWorkerPriority = priority;
+	}
+	ThreadPriority AudioThreads::WorkerPriority()
+	{
+		return xWorkerPriority;
+	}
+
+	/**
+	 * @param mask Bit mask of the CPUs the decode workers may run on, 0 for any CPU (default)
+	 */
+	void AudioThreads::WorkerAffinity(unsigned mask)
+	{
+		xWorkerAffinity = mask;
+	}
+	unsigned AudioThreads::WorkerAffinity()
+	{
+		return xWorkerAffinity;
+	}
+
+
+
+
+	/**
+	 * Fills the statistics of the current Engine.
+	 * @param stats Statistics structure to fill
+	 */
+	void GetAudioStats(AudioStats& stats)
+	{
+		EngineState& engine = CurrentState();
+		XAUDIO2_PERFORMANCE_DATA perf;
+		memset(&perf, 0, sizeof(perf));
+		if (engine.xaudio) engine.xaudio->GetPerformanceData(&perf);
+		stats.activeSourceVoices = perf.ActiveSourceVoiceCount;
+		stats.totalSourceVoices  = perf.TotalSourceVoiceCount;
+		stats.activeSubmixVoices = perf.ActiveSubmixVoiceCount;
+		stats.latencySamples     = perf.CurrentLatencyInSamples;
+		stats.glitches           = perf.GlitchesSinceEngineStarted;
+		stats.memoryBytes        = perf.MemoryUsageInBytes;
+		stats.virtualVoices      = 0;
+		for (Sound3D* sound : engine.sounds)
+			if (sound->IsVirtual()) ++stats.virtualVoices;
+		stats.cpuLoad = perf.TotalCyclesSinceLastQuery ? 
+			float(double(perf.AudioCyclesSinceLastQuery) / double(perf.TotalCyclesSinceLastQuery)) : 0.0f;
+		stats.passMillis    = engine.passMillis;
+		stats.governorLevel = GovernorLevel(engine.governorLevel);
+		stats.mp3Decoder    = MP3Streamer::Decoder();
+		const DWORD faults  = ProcessPageFaults();
+		stats.pageFaults    = faults - engine.pageFaults;
+		engine.pageFaults   = faults;
+		stats.residentBytes  = size_t(xResidentBytes);
+		stats.largePageBytes = size_t(xLargePageBytes);
+		stats.mixerPriority  = ThreadPriority(engine.mixerPriority);
+		stats.wakeupLateMillis    = engine.wakeupLate;
+		stats.wakeupLateMaxMillis = engine.wakeupLateMax;
+		engine.wakeupLateMax = 0.0f;
+		stats.transitions.swap(engine.transitions);
+		engine.transitions.clear();
+
+		stats.zones.clear();
+		for (ReverbZone* zone : engine.zones)
+		{
+			ReverbZoneStats zs;
+			zs.zone      = zone;
+			zs.numLines  = zone->Reverb()->NumLines();
+			zs.cpuMicros = zone->Timing().avgMicros;
+			zs.cpuLoad   = zone->Timing().Load();
+			stats.zones.push_back(zs);
+		}
+	}
+
+	/**
+	 * Walks the Governor one level at a time: down fast when over budget, back up
+	 * slowly once the pass time is well under budget, so it doesn't oscillate.
+	 * @param engine Engine to govern
+	 * @param now Current audio clock time in seconds
+	 */
+	static void UpdateGovernor(EngineState& engine, double now)
+	{
+		const int level = engine.governorLevel;
+		const float millis = engine.passMillis;
+		int next = level;
+		if (engine.governorBudget <= 0.0f)
+			next = GOVERNOR_FULL_QUALITY;
+		else if (millis > engine.governorBudget && level < GOVERNOR_SKIP_QUIET_REVERB)
+		{
+			if (now - engine.governorChange > 0.1) // let the previous step take effect
+				next = level + 1;
+		}
+		else if (millis < engine.governorBudget * 0.7f && level > GOVERNOR_FULL_QUALITY)
+		{
+			if (now - engine.governorChange > 1.0)
+				next = level - 1;
+		}
+		if (next == level)
+			return;
+
+		GovernorTransition t = { now, GovernorLevel(level), GovernorLevel(next), millis };
+		if (engine.transitions.size() < 256) // nobody is reading the stats, keep the oldest
+			engine.transitions.push_back(t);
+		indebug(printf("Governor: level %d -> %d at %.2fms per pass\n", level, next, millis));
+		engine.governorLevel = next;
+		engine.governorChange = now;
+	}
+
+	/**
+	 * Game thread housekeeping of the current Engine, call it once per game tick.
+	 * Runs the calls posted through the SoundTable and the Governor,
+	 * moves inaudible Sound3D streams into virtual voices and brings audible ones back.
+	 */
+	void Update()
+	{
+		CommandScope cmd;
+		Engine* current = ThreadEngine();
+		if (!current) current = xDefaultEngine;
+		if (current) // posted calls are recorded before the Update, the replay makes them directly
+			ExecuteSoundCommands(*current->State());
+		if (cmd.record) RecordCommand(COMMAND_UPDATE, nullptr);
+		if (!current) return; // no engine was ever created
+		EngineState& engine = *current->State();
+		const double now = AudioClock();
+		UpdateGovernor(engine, now);
+		for (Sound3D* sound : engine.sounds)
+			sound->UpdateVirtual(now);
+	}
+
+
+} // namespace S3D
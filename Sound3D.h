@@ -1,818 +1,1648 @@
-#pragma once
-/**
- * Sound3D - An open source 3D Audio Library
- * 
- * Copyright (c) 2013 Jorma Rebane
- *
- * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
- * and associated documentation files (the "Software"), to deal in the Software without restriction, 
- * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
- * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
- * subject to the following conditions:
- * 
- * The above copyright notice and this permission notice shall be included in all copies or substantial 
- * portions of the Software.
- * 
- * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
- * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
- * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
- * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
- * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
- */
-#ifndef WIN32_LEAN_AND_MEAN
-#define WIN32_LEAN_AND_MEAN
-#endif
-#include "AudioStreamer.h"
-#include <vector>
-#include "XAudio2_7\XAudio2.h"	// from DirectX SDK 2010
-#include "XAudio2_7\X3DAudio.h" // from DirectX SDK 2010
-
-
-namespace S3D
-{
-
-#if !VECTOR3_DEFINED
-struct Vector3
-{
-	float x, y, z;
-	inline Vector3() : x(0), y(0), z(0) {}
-	inline Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
-};
-#endif
-
-
-
-/**
- * A Sound Object contains data on Sound playing state, volume, 3D position, etc.
- */
-class SoundObject;
-
-
-
-/** 
- * Our XAudio buffer object
- */
-struct XABuffer : XAUDIO2_BUFFER
-{
-	WAVEFORMATEX wf;		// wave format descriptor
-	int nBytesPerSample;	// number of bytes per single audio sample (1 or 2 bytes)
-	int nPCMSamples;		// number of PCM samples in the entire buffer
-	unsigned wfHash;		// waveformat pseudo-hash
-};
-
-
-
-/**
- * A simple SoundBuffer designed for loading small sound files into a static buffer.
- * Should be used for sound files smaller than 64KB (1.5s @ 41kHz).
- */
-class SoundBuffer
-{
-	friend class SoundObject;
-
-protected:
-
-	// number of references of this buffer held by SoundObjects; 
-	// NOTE: SoundBuffer can't be Unloaded until refCount == 0.
-	int refCount;				
-	XABuffer* xaBuffer;			// sound buffer object
-	
-public:
-
-	/**
-	 * Creates a new SoundBuffer object
-	 */
-	SoundBuffer();
-
-	/**
-	 * Creates a new SoundBuffer and loads the specified sound file
-	 * @param file Path to sound file to load
-	 */
-	SoundBuffer(const char* file);
-
-	/**
-	 * Destroyes and unloads this buffer
-	 */
-	virtual ~SoundBuffer();
-
-	/**
-	 * @return Frequency in Hz of this SoundBuffer data
-	 */
-	int Frequency() const;
-
-	/**
-	 * @return Number of bits in a sample of this SoundBuffer data (8 or 16)
-	 */
-	int SampleBits() const;	
-
-	/**
-	 * @return Number of bytes in a sample of this SoundBuffer data (1 or 2)
-	 */
-	int SampleBytes() const;
-
-	/**
-	 * @return Number of sound channels in the SoundBuffer data (1 or 2)
-	 */
-	int Channels() const;	
-
-	/** 
-	 * @return Size of a full sample block in bytes [LL][RR] (1 to 4)
-	 */
-	int FullSampleSize() const;
-
-	/**
-	 * @return Size of this SoundBuffer or SoundStream in BYTES
-	 */
-	int SizeBytes() const;
-
-	/**
-	 * @return Number of Bytes Per Second for this audio data (Frequency * Channels * SampleBytes)
-	 */
-	int BytesPerSecond() const;
-
-	/**
-	 * @return Size of this SoundBuffer in PCM SAMPLES
-	 */
-	virtual int Size() const;		
-
-	/**
-	 * @return Number of SoundObjects that still reference this SoundBuffer.
-	 */
-	int RefCount() const;
-
-	/**
-	 * @return TRUE if this object is a Sound stream
-	 */
-	virtual bool IsStream() const;
-
-	/**
-	 * @return Wave format descriptor for this buffer
-	 */
-	const WAVEFORMATEX* WaveFormat() const;
-
-	/**
-	 * @return Unique hash to distinguish between different Wave formats
-	 */
-	unsigned WaveFormatHash() const;	
-
-	/**
-	 * Loads this SoundBuffer with data found in the specified file.
-	 * Supported formats: .wav .mp3
-	 * @param file Sound file to load
-	 * @return TRUE if loading succeeded and a valid buffer was created.
-	 */
-	virtual bool Load(const char* file);
-
-	/**
-	 * Tries to release the underlying sound buffer and free the memory.
-	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundBuffer
-	 * @return TRUE if SoundBuffer data was freed, FALSE if SoundBuffer is still used by a SoundObject.
-	 */
-	virtual bool Unload();
-
-	/**
-	 * Binds a specific source to this SoundBuffer and increases the refCount.
-	 * @param so SoundObject to bind to this SoundBuffer.
-	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
-	 */
-	virtual bool BindSource(SoundObject* so);
-
-	/**
-	 * Unbinds a specific source from this SoundBuffer and decreases the refCount.
-	 * @param so SoundObject to unbind from this SoundBuffer.
-	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
-	 */
-	virtual bool UnbindSource(SoundObject* so);
-
-	/**
-	 * Resets the buffer in the context of the specified SoundObject
-	 * @note Calls ResetStream on AudioStreams.
-	 * @param so SoundObject to reset this buffer for
-	 * @return TRUE if reset was successful
-	 */
-	virtual bool ResetBuffer(SoundObject* so);
-
-};
-
-
-
-
-
-
-
-
-/**
- * SoundStream stream audio data from a file source.
- * Extremely useful for large file playback. Even a 4m long mp3 can take over 40mb of ram.
- * Multiple sources can be bound to this stream.
- */
-class SoundStream : public SoundBuffer
-{
-protected:
-	struct SO_ENTRY 
-	{ 
-		SoundObject* obj; 
-		int base; // current PCM block offset
-		int next; // the next PCM block offset to load
-
-		XABuffer* front;	// currently playing buffer - frontbuffer
-		XABuffer* back;		// enqueued backbuffer
-		BOOL busy;			// the stream is busy on an internal operation, all other operations are ignored
-
-		inline SO_ENTRY(SoundObject* obj) 
-			: obj(obj), base(0), next(0), front(0), back(0), busy(0)
-		{
-		} 
-	};
-	
-	std::vector<SO_ENTRY> alSources;	// bound sources
-	AudioStreamer* alStream;			// streamer object
-
-public:
-
-	/**
-	 * Creates a new SoundsStream object
-	 */
-	SoundStream();
-
-	/**
-	 * Creates a new SoundStream object and loads the specified sound file
-	 * @param file Path to the sound file to load
-	 */
-	SoundStream(const char* file);
-
-	/**
-	 * Destroys and unloads any resources held
-	 */
-	virtual ~SoundStream();
-
-	/**
-	 * @return Size of this SoundStream in PCM SAMPLES
-	 */
-	virtual int Size() const override;
-
-	/**
-	 * @return TRUE if this object is a Sound stream
-	 */
-	virtual bool IsStream() const override;
-
-	/**
-	 * Initializes this SoundStream with data found in the specified file.
-	 * Supported formats: .wav .mp3
-	 * @param file Sound file to load
-	 * @return TRUE if loading succeeded and a stream was initialized.
-	 */
-	virtual bool Load(const char* file) override;
-
-	/**
-	 * Tries to release the underlying sound buffers and free the memory.
-	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundStream
-	 * @return TRUE if SoundStream data was freed, FALSE if SoundStream is still used by a SoundObject.
-	 */
-	virtual bool Unload() override;
-
-	/**
-	 * Binds a specific source to this SoundStream and increases the refCount.
-	 * @param so SoundObject to bind to this SoundStream.
-	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
-	 */
-	virtual bool BindSource(SoundObject* so) override;
-
-	/**
-	 * Unbinds a specific source from this SoundStream and decreases the refCount.
-	 * @param so SoundObject to unbind from this SoundStream.
-	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
-	 */
-	virtual bool UnbindSource(SoundObject* so) override;
-
-	/**
-	 * Resets the buffer in the context of the specified SoundObject
-	 * @note Calls ResetStream on AudioStreams.
-	 * @param so SoundObject to reset this buffer for
-	 * @return TRUE if reset was successful
-	 */
-	virtual bool ResetBuffer(SoundObject* so) override;
-
-	/**
-	 * Resets the stream by unloading previous buffers and requeuing the first two buffers.
-	 * @param so SoundObject to reset the stream for
-	 * @return TRUE if stream was successfully reloaded
-	 */
-	bool ResetStream(SoundObject* so);
-
-	/**
-	 * Streams the next Buffer block from the stream.
-	 * @param so Specific SoundObject to stream with.
-	 * @return TRUE if a buffer was streamed. FALSE if EOS() or stream is busy.
-	 */
-	bool StreamNext(SoundObject* so);
-
-	/**
-	 * @param so Specific SoundObject to check for end of stream
-	 * @return TRUE if End of Stream was reached or if there is no stream loaded
-	 */
-	bool IsEOS(const SoundObject* so) const;
-
-	/**
-	 * @param so SoundObject to query index of
-	 * @return A valid pointer if this SoundObject is bound. Otherwise NULL.
-	 */
-	SO_ENTRY* GetSOEntry(const SoundObject* so) const;
-
-	/**
-	 * Seeks to the specified sample position in the stream.
-	 * @note The SoundObject will stop playing and must be manually restarted!
-	 * @param so SoundObject to perform seek on
-	 * @param samplepos Position in the stream in samples [0..SoundStream::Size()]
-	 */
-	void Seek(SoundObject* so, int samplepos);
-
-protected:
-
-	/**
-	 * Internal stream function.
-	 * @param soe SoundObject Entry to stream
-	 * @return TRUE if a buffer was streamed
-	 */
-	bool StreamNext(SO_ENTRY& soe);
-
-	/**
-	 * [internal] Load streaming data into the specified SoundObject
-	 * at the optionally specified streamposition.
-	 * @param so SO_ENTRY handle to queue with stream data
-	 * @param streampos [optional] PCM byte position in stream where to seek data from. 
-	 *                  If unspecified (default -1), stream will use the current streampos
-	 */
-	bool LoadStreamData(SO_ENTRY& so, int streampos = -1);
-
-	/**
-	 * [internal] Unloads all queued data for the specified SoundObject
-	 * @param so SO_ENTRY handle to unqueue and unload data for
-	 */
-	void ClearStreamData(SO_ENTRY& so);
-};
-
-
-
-
-
-
-
-
-
-
-
-
-/**
- * Holds and manages the current state of a SoundObject
- */
-struct SoundObjectState; 
-
-
-
-/**
- * Base for all 3D and Ambient sound objects
- */
-class SoundObject
-{
-protected:
-	friend class SoundBuffer;			// give soundbuffer access to the internals of this object
-	friend class SoundStream;			// give soundstream access to the internals of this object
-	friend struct SoundObjectState;		// allow some control for the State object
-
-	SoundBuffer* Sound;					// soundbuffer or stream to use
-	IXAudio2SourceVoice* Source;		// the sound source generator (interfaces XAudio2 to generate waveforms)
-	SoundObjectState* State;			// Holds and manages the current state of a SoundObject
-	X3DAUDIO_EMITTER Emitter;			// 3D sound emitter data (this object)
-
-	/**
-	 * Creates an uninitialzed empty SoundObject
-	 */
-	SoundObject();
-	/**
-	 * Creates a soundobject with an attached buffer
-	 * @param sound SoundBuffer this object uses for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	SoundObject(SoundBuffer* sound, bool loop = false, bool play = false);
-	~SoundObject(); // unhooks any sounds and frees resources
-
-public:
-	/**
-	 * Sets the SoundBuffer or SoundStream for this SoundObject. Set NULL to remove and unbind the SoundBuffer.
-	 * @param sound Sound to bind to this object. Can be NULL to unbind sounds from this object.
-	 * @param loop [optional] Sets the sound looping or non-looping. Streams cannot be looped.
-	 */
-	void SetSound(SoundBuffer* sound, bool loop = false);
-
-	/**
-	 * @return Current soundbuffer set to this soundobject
-	 */
-	inline SoundBuffer* GetSound() const { return Sound; }
-
-	/**
-	 * @return TRUE if this SoundObject has an attached SoundStream that can be streamed.
-	 */
-	bool IsStreamable() const;
-
-	/**
-	 * @return TRUE if this SoundObject is streamable and the End Of Stream was reached.
-	 */
-	bool IsEOS() const;
-
-	/**
-	 * Starts playing the sound. If the sound is already playing, it is rewinded and played again from the start.
-	 */
-	void Play();
-
-	/**
-	 * Starts playing a new sound. Any older playing sounds will be stopped and replaced with this sound.
-	 * @param sound SoundBuffer or SoundStream to start playing
-	 * @param loop [false] Sets if the sound is looping or not. Streams are never loopable.
-	 */
-	void Play(SoundBuffer* sound, bool loop = false);
-
-	/**
-	 * Stops playing the sound and unloads streaming buffers.
-	 */
-	void Stop();
-
-	/**
-	 * Temporarily pauses sound playback and doesn't unload any streaming buffers.
-	 */
-	void Pause();
-
-	/**
-	 * If current status is Playing, then this rewinds to start of the soundbuffer/stream and starts playing again.
-	 * If current status is NOT playing, then any stream resources are freed and the object is reset.
-	 */
-	void Rewind();
-
-	/**
-	 * @return TRUE if the sound source is PLAYING.
-	 */
-	bool IsPlaying() const;
-
-	/**
-	 * @return TRUE if the sound source is STOPPED.
-	 */
-	bool IsStopped() const;
-
-	/**
-	 * @return TRUE if the sound source is PAUSED.
-	 */
-	bool IsPaused() const;
-
-	/**
-	 * @return TRUE if the sound source is at the beginning of the sound buffer.
-	 */
-	bool IsInitial() const;
-
-	/**
-	 * @return TRUE if the sound source is in LOOPING mode.
-	 */
-	bool IsLooping() const;
-
-	/**
-	 * Sets the looping mode of the sound source.
-	 */
-	void Looping(bool looping);
-
-	/**
-	 * Indicates the gain (volume amplification) applied. Range [0.0f .. 1.0f]
-	 * Each division by 2 equals an attenuation of -6dB. Each multiplicaton with 2 equals an amplification of +6dB.
-	 * A value of 0.0 is meaningless with respect to a logarithmic scale; it is interpreted as zero volume - the channel is effectively disabled.
-	 * @param gain Gain value between 0.0..1.0
-	 */
-	void Volume(float gain);
-
-	/**
-	 * @return Current gain value of this source
-	 */
-	float Volume() const;
-
-	/**
-	 * @return Gets the current playback position in the SoundBuffer or SoundStream in SAMPLES
-	 */
-	int PlaybackPos() const;
-
-	/**
-	 * Sets the playback position of the underlying SoundBuffer or SoundStream in SAMPLES
-	 * @param seekpos Position in SAMPLES where to seek in the SoundBuffer or SoundStream [0..PlaybackSize]
-	 */
-	void PlaybackPos(int seekpos);
-
-	/**
-	 * @return Playback size of the underlying SoundBuffer or SoundStream in SAMPLES
-	 */
-	int PlaybackSize() const;
-
-	/**
-	 * @return Number of samples processed every second (aka SampleRate or Frequency)
-	 */
-	int SamplesPerSecond() const;
-};
-
-
-
-
-/**
- * A positionless sound object used for playing background music or sounds.
- */
-class Sound : public SoundObject
-{
-public:
-
-	/**
-	 * Creates an uninitialzed Sound2D, but also
-	 * setups the sound source as an environment/bakcground sound.
-	 */
-	Sound();
-
-	/**
-	 * Creates a Sound2D with an attached buffer
-	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	Sound(SoundBuffer* sound, bool loop = false, bool play = false);
-
-	/**
-	 * Resets all background audio parameters to their defaults
-	 */
-	void Reset();
-};
-
-
-
-
-/**
- * A 3D positional sound object used for playing environment-aware music or sounds.
- */
-class Sound3D : public SoundObject
-{
-public:
-
-	/**
-	 * Creates an uninitialzed Sound3D, but also
-	 * setups the sound source as a 3D positional sound.
-	 */
-	Sound3D();
-
-	/**
-	 * Creates a Sound3D with an attached buffer
-	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
-	 * @param loop True if sound looping is wished
-	 * @param play True if sound should start playing immediatelly
-	 */
-	Sound3D(SoundBuffer* sound, bool loop = false, bool play = false);
-
-	/**
-	 * Resets all 3D positional audio parameters to their defaults
-	 */
-	void Reset();
-
-	/**
-	 * Sets the 3D position of this Sound3D object
-	 * @param x Position x component
-	 * @param y Position Y component
-	 * @param z Position z component
-	 */
-	void Position(float x, float y, float z);
-
-	/**
-	 * Sets the 3D position of this Sound3D object
-	 * @param xyz Float vector containing 3D position X Y Z components
-	 */
-	void Position(float* xyz);
-
-	/**
-	 * @return 3D position vector of this SoundObject
-	 */
-	Vector3 Position() const;
-
-	/**
-	 * Sets the 3D direction of this Sound3D object
-	 * @param x Direction x component
-	 * @param y Direction Y component
-	 * @param z Direction z component
-	 */
-	void Direction(float x, float y, float z);
-	
-	/**
-	 * Sets the 3D direction of this Sound3D object
-	 * @param xyz Float vector containing 3D direction X Y Z components
-	 */
-	void Direction(float* xyz);
-
-	/**
-	 * @return 3D direction vector of this SoundObject
-	 */
-	Vector3 Direction() const;
-
-	/**
-	 * Sets the 3D velocity of this Sound3D object
-	 * @param x Velocity x component
-	 * @param y Velocity Y component
-	 * @param z Velocity z component
-	 */
-	void Velocity(float x, float y, float z);
-
-	/**
-	 * Sets the 3D velocity of this Sound3D object
-	 * @param xyz Float vector containing 3D velocity X Y Z components
-	 */
-	void Velocity(float* xyz);
-
-	/**
-	 * @return 3D velocity vector of this SoundObject
-	 */
-	Vector3 Velocity() const;
-
-	/**
-	 * Sets the position of this SoundObject as relative to the global listener
-	 * @param isrelative TRUE if the position of this SoundObject is relative
-	 */
-	void Relative(bool isrelative);
-
-	/**
-	 * @return TRUE if the position of this SoundObject is relative
-	 */
-	bool IsRelative() const;
-
-
-	void MaxDistance(float maxdist);
-	float MaxDistance() const;
-
-	void RolloffFactor(float rolloff);
-	float RolloffFactor() const;
-
-	void ReferenceDistance(float refdist);
-	float ReferenceDistance() const;
-
-	/**
-	 * The inner cone angle is where the listener hears no extra attenuation (ie, you 
-		hear the regular distance-based attenuation), while the outer cone is where 
-		the AL_CONE_OUTER_GAIN fully applied (ie, you hear the distance-based 
-		attenuation as well as AL_CONE_OUTER_GAIN both applied).
-
-		> 2. if outer cone angle is 360 deg, and inner cone angle is less than that,
-		> can the source still be heard from listener at angle > inner angle
-
-		Yes, with varying degrees of attenuation (the closer to the outer cone angle 
-		you are, the more AL_CONE_OUTER_GAIN is applied).
-
-		> 3. does it still valid if outer cone angle is larger than inner cone angle ?
-
-		Yes. In fact, if the outer cone angle is smaller than the inner cone angle, 
-		then the cone attenuation won't work properly.
-
-		> 4. how does the outer cone gain (angle-dependent attenuation) will be
-		> applied to source gain (in equation) ?
-
-		When the listener is at (or beyond) the outer cone angle, the source gain and 
-		outer cone gain are multiplied together. When the listener is at (or within) 
-		the inner cone angle, the outer cone gain isn't applied at all.
-
-		If the listener is between the inner cone angle and outer cone angle, then 
-		OpenAL will only partially apply the outer cone gain. The exact method is 
-		implementation dependent, but it is a smooth curve from no extra attenuation 
-		to full attenuation (a linear slope is not uncommon, but it can be something 
-		else).
-
-		> 5. what's the default value for inner, outer cone angle, and outer cone
-		> gain ?
-
-		The inner cone angle and outer cone angle default to 360 degrees. The outer 
-		cone gain defaults to 1.0.
-
-		Note that the angle between the source and listener only gets up to 180 
-		degrees (when the listener is directly behind the source), so the actual total 
-		area covered by the cones is double the value you specify.. eg, an inner angle 
-		of 90 with the listener directly to the left or right of the source will not 
-		be attenuated by the cones; 180 degree coverage.
-	 */
-	void ConeOuterGain(float value);
-	float ConeOuterGain() const;
-
-	void ConeInnerAngle(float angle);
-	float ConeInnerAngle() const;
-
-	/**
-	 * Sets the outer sound cone angle in degrees. Default is 360.
-	 * Outer cone angle cannot be smaller than inner cone angle
-	 * @param angle Angle 
-	 */
-	void ConeOuterAngle(float angle);
-	float ConeOuterAngle() const;
-};
-
-
-/**
- * Sound3D sound listener
- */
-class Listener
-{
-public:
-
-	/**
-	 * Sets the master gain value (Volume) of the listener object for Audio3D.
-	 * Valid range is [0.0 - Any], meaning the global volume can be increased
-	 * until the sound starts distorting. WARNING! This does not change system volume!
-	 * @param gain Gain value to set for the listener. Range[0.0 - Any].
-	 */
-	static void Volume(float gain);
-
-	/**
-	 * Gets the master gain value (Volume) of the listener object for Audio3D.
-	 * Valid range is [0.0 - Any], meaning the global volume can be increased
-	 * until the sound starts distorting. WARNING! This does not change system volume!
-	 * @return Master gain value (Volume). Range[0.0 - Any].
-	 */
-	static float Volume();
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param pos Vector containing x y z components of the position
-	 */
-	static void Position(const Vector3& pos);
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param x X component of the new position
-	 * @param y Y component of the new position
-	 * @param z Z component of the new position
-	 */
-	static void Position(float x, float y, float z);
-
-	/**
-	 * Sets the position of the listener object for Audio3D
-	 * @param xyz Float array containing x y z components of the position
-	 */
-	static void Position(float* xyz);
-
-	/**
-	 * @return Position of the listener object for Audio3D
-	 */
-	static Vector3 Position();
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param pos Vector containing x y z components of the velocity
-	 */
-	static void Velocity(const Vector3& vel);
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param x X component of the new velocity
-	 * @param y Y component of the new velocity
-	 * @param z Z component of the new velocity
-	 */
-	static void Velocity(float x, float y, float z);
-
-	/**
-	 * Sets the velocity of the listener object for Audio3D
-	 * @param xyz Float array containing x y z components of the velocity
-	 */
-	static void Velocity(float* xyz);
-
-	/**
-	 * @return Velocity of the listener object for Audio3D
-	 */
-	static Vector3 Velocity();
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param target Vector containing x y z components of target where to 'look', thus changing the orientation.
-	 * @param up Vector containing x y z components of the orientation 'up' vector
-	 */
-	static void LookAt(const Vector3& target, const Vector3& up);
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param x X component of the new direction
-	 * @param y Y component of the new direction
-	 * @param z Z component of the new direction
-	 */
-	static void LookAt(float xAT, float yAT, float zAT, float xUP, float yUP, float zUP);
-
-	/**
-	 * Sets the direction of the listener object for Audio3D
-	 * @param xyzATxyzUP Float array containing x y z components of the direction
-	 */
-	static void LookAt(float* xyzATxyzUP);
-
-	/**
-	 * @return Target position of the listener object's orientation
-	 */
-	static Vector3 Target();
-
-	/**
-	 * @return Up vector of the listener object's orientation
-	 */
-	static Vector3 Up();
-
-};
-
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include "AudioStreamer.h"
+#include "SoundEffect.h"
+#include "Attenuation.h"
+#include "CommandLog.h"
+#include "RealtimeCheck.h"
+#include <vector>
+#include "XAudio2_7\XAudio2.h"	// from DirectX SDK 2010
+#include "XAudio2_7\X3DAudio.h" // from DirectX SDK 2010
+
+
+namespace S3D
+{
+
+#if !VECTOR3_DEFINED
+struct Vector3
+{
+	float x, y, z;
+	inline Vector3() : x(0), y(0), z(0) {}
+	inline Vector3(float x, float y, float z) : x(x), y(y), z(z) {}
+};
+#endif
+
+
+
+/**
+ * A Sound Object contains data on Sound playing state, volume, 3D position, etc.
+ */
+class SoundObject;
+
+/**
+ * Decoded audio data shared between processes
+ */
+class SharedPCM;
+
+
+
+/** 
+ * Our XAudio buffer object
+ */
+struct XABuffer : XAUDIO2_BUFFER
+{
+	WAVEFORMATEX wf;		// wave format descriptor
+	WORD wSamplesPerBlock;	// ADPCMWAVEFORMAT extension of wf, only valid for WAVE_FORMAT_ADPCM
+	WORD wNumCoef;
+	ADPCMCOEFSET aCoef[7];
+	int nBytesPerSample;	// number of bytes per single audio sample (1 or 2 bytes)
+	int nPCMSamples;		// number of PCM samples in the entire buffer
+	int nAudibleSamples;	// PCM samples up to the end of the last block above SilencePeak
+	float peak;				// peak level of the PCM data [0.0 - 1.0], measured when it was decoded
+	unsigned wfHash;		// waveformat pseudo-hash
+	int memory;				// how the buffer was allocated, tells DestroyXABuffer how to release it
+	unsigned residentBytes;	// bytes of audio data locked in physical memory, 0 if pageable
+};
+
+
+
+/**
+ * Format of the audio data kept in memory
+ */
+enum SampleCodec
+{
+	CODEC_PCM,		// uncompressed PCM samples
+	CODEC_ADPCM,	// MS ADPCM, 4 bits per sample (~4x smaller than 16-bit PCM), decoded by XAudio2
+};
+
+/**
+ * Target format of SoundBuffer data, applied when the buffer is loaded.
+ * Lets a single asset set serve all memory tiers: low memory platforms reduce
+ * the data at load time instead of shipping separate assets.
+ * Conversion only ever reduces the data: a 0 field or a value above the
+ * source format keeps the source value. Channels can only be reduced to mono.
+ */
+struct QualityProfile
+{
+	int sampleRate;		// max sample rate in Hz, ex. 22050 (0: keep)
+	int bitsPerSample;	// max bits per sample, 8 or 16 (0: keep)
+	int channels;		// max number of channels, 1 downmixes to mono (0: keep)
+	SampleCodec codec;	// format of the data in memory, ADPCM is always 16-bit mono or stereo
+
+	inline QualityProfile(int rate = 0, int bits = 0, int channels = 0, SampleCodec codec = CODEC_PCM)
+		: sampleRate(rate), bitsPerSample(bits), channels(channels), codec(codec) {}
+};
+
+
+
+/**
+ * A simple SoundBuffer designed for loading small sound files into a static buffer.
+ * Should be used for sound files smaller than 64KB (1.5s @ 41kHz).
+ */
+class SoundBuffer
+{
+	friend class SoundObject;
+
+protected:
+
+	// number of references of this buffer held by SoundObjects; 
+	// NOTE: SoundBuffer can't be Unloaded until refCount == 0.
+	int refCount;				
+	XABuffer* xaBuffer;			// sound buffer object
+	SharedPCM* shared;			// audio data mapped from shared memory, NULL if the data is private
+	FalloffCurve* volumeCurve;	// custom Sound3D volume over distance, replaces the distance model
+	FalloffCurve* lowpassCurve;	// custom Sound3D lowpass over distance (1.0 is unfiltered)
+	FalloffCurve* reverbCurve;	// custom Sound3D ReverbZone send over distance
+	
+public:
+
+	/**
+	 * Creates a new SoundBuffer object
+	 */
+	SoundBuffer();
+
+	/**
+	 * Creates a new SoundBuffer and loads the specified sound file
+	 * @param file Path to sound file to load
+	 */
+	SoundBuffer(const char* file);
+
+	/**
+	 * Destroyes and unloads this buffer
+	 */
+	virtual ~SoundBuffer();
+
+	/**
+	 * @return Frequency in Hz of this SoundBuffer data
+	 */
+	int Frequency() const;
+
+	/**
+	 * @return Number of bits in a sample of this SoundBuffer data (8 or 16, 4 for ADPCM)
+	 */
+	int SampleBits() const;	
+
+	/**
+	 * @return Format of the audio data in memory
+	 */
+	SampleCodec Codec() const;
+
+	/**
+	 * @return Number of bytes in a sample of this SoundBuffer data (1 or 2)
+	 */
+	int SampleBytes() const;
+
+	/**
+	 * @return Number of sound channels in the SoundBuffer data (1 or 2)
+	 */
+	int Channels() const;	
+
+	/** 
+	 * @return Size of a full sample block in bytes [LL][RR] (1 to 4)
+	 */
+	int FullSampleSize() const;
+
+	/**
+	 * @return Size of this SoundBuffer or SoundStream in BYTES
+	 */
+	int SizeBytes() const;
+
+	/**
+	 * @return Number of Bytes Per Second for this audio data (Frequency * Channels * SampleBytes)
+	 */
+	int BytesPerSecond() const;
+
+	/**
+	 * @return Size of this SoundBuffer in PCM SAMPLES
+	 */
+	virtual int Size() const;		
+
+	/**
+	 * @return Number of SoundObjects that still reference this SoundBuffer.
+	 */
+	int RefCount() const;
+
+	/**
+	 * @return TRUE if this object is a Sound stream
+	 */
+	virtual bool IsStream() const;
+
+	/**
+	 * @return Wave format descriptor for this buffer
+	 */
+	const WAVEFORMATEX* WaveFormat() const;
+
+	/**
+	 * @return Unique hash to distinguish between different Wave formats
+	 */
+	unsigned WaveFormatHash() const;	
+
+	/**
+	 * Loads this SoundBuffer with data found in the specified file.
+	 * Supported formats: .wav .mp3
+	 * @param file Sound file to load
+	 * @return TRUE if loading succeeded and a valid buffer was created.
+	 */
+	virtual bool Load(const char* file);
+
+	/**
+	 * Loads this SoundBuffer and converts the data to the specified quality profile.
+	 * @note SoundStreams ignore the profile
+	 * @param file Sound file to load
+	 * @param profile Target format of the data in memory
+	 * @return TRUE if loading succeeded and a valid buffer was created.
+	 */
+	virtual bool Load(const char* file, const QualityProfile& profile);
+
+	/**
+	 * Sets the quality profile used by Load(file), ex. per platform memory tier.
+	 * @param profile Target format of loaded SoundBuffers. Default keeps the source format
+	 */
+	static void DefaultQuality(const QualityProfile& profile);
+	static const QualityProfile& DefaultQuality();
+
+	/**
+	 * Enables the decoded PCM cache. Compressed files (MP3, OGG) are decoded once and kept
+	 * in this directory, losslessly compressed, so later loads skip the slow decoding.
+	 * @param dir Existing directory for the cache files. NULL or "" disables the cache (default)
+	 */
+	static void CacheDirectory(const char* dir);
+	static const char* CacheDirectory();
+
+	/**
+	 * Shares decoded SoundBuffer data with other processes on this machine, ex. many instances
+	 * of a headless server. The first process to load a file publishes it, the others map it read-only.
+	 * @param enable TRUE to share buffers loaded from now on. Default is FALSE
+	 */
+	static void SharedMemory(bool enable);
+	static bool SharedMemory();
+
+	/**
+	 * Keeps loaded SoundBuffer data resident: it's copied into locked pages and every page is touched
+	 * at load time, so the first playback takes no page faults on the audio thread. Buffers that fill
+	 * a large page use large pages (fewer TLB misses) if the process holds SeLockMemoryPrivilege.
+	 * @param enable TRUE for buffers loaded from now on. Default is FALSE
+	 */
+	static void ResidentMemory(bool enable);
+	static bool ResidentMemory();
+
+	/**
+	 * Tries to release the underlying sound buffer and free the memory.
+	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundBuffer
+	 * @return TRUE if SoundBuffer data was freed, FALSE if SoundBuffer is still used by a SoundObject.
+	 */
+	virtual bool Unload();
+
+	/**
+	 * [internal] Decodes ADPCM data to 16-bit PCM in software, for voices that can't take WAVE_FORMAT_ADPCM
+	 * @return FALSE if the data is not ADPCM, other SoundObjects still use it or out of memory
+	 */
+	bool DecodeToPCM();
+
+	/**
+	 * Binds a specific source to this SoundBuffer and increases the refCount.
+	 * @param so SoundObject to bind to this SoundBuffer.
+	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
+	 */
+	virtual bool BindSource(SoundObject* so);
+
+	/**
+	 * Unbinds a specific source from this SoundBuffer and decreases the refCount.
+	 * @param so SoundObject to unbind from this SoundBuffer.
+	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
+	 */
+	virtual bool UnbindSource(SoundObject* so);
+
+	/**
+	 * Resets the buffer in the context of the specified SoundObject
+	 * @note Calls ResetStream on AudioStreams.
+	 * @param so SoundObject to reset this buffer for
+	 * @return TRUE if reset was successful
+	 */
+	virtual bool ResetBuffer(SoundObject* so);
+
+	/**
+	 * Sets a custom volume falloff curve for all Sound3D objects playing this buffer.
+	 * The curve replaces the Sound3D distance model, cone attenuation still applies.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void VolumeCurve(const CurvePoint* points, int count);
+	inline const FalloffCurve* VolumeCurve() const { return volumeCurve; }
+
+	/**
+	 * Sets a custom lowpass curve for all Sound3D objects playing this buffer.
+	 * Values are [0.0 - 1.0], where 1.0 is unfiltered. Set it before binding the buffer
+	 * to any sound objects, only voices created after this have a filter.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void LowpassCurve(const CurvePoint* points, int count);
+	inline const FalloffCurve* LowpassCurve() const { return lowpassCurve; }
+
+	/**
+	 * Sets a custom ReverbZone send curve for all Sound3D objects playing this buffer.
+	 * The curve value scales the send to every ReverbZone.
+	 * @param points Curve points sorted by distance, NULL to remove the curve
+	 * @param count Number of curve points
+	 */
+	void ReverbCurve(const CurvePoint* points, int count);
+	inline const FalloffCurve* ReverbCurve() const { return reverbCurve; }
+
+};
+
+
+
+
+
+
+
+
+/**
+ * Runtime decode measurements of a SoundStream. Every decode call is timed and fitted
+ * to: time = latency + seconds * decodeCost. The prefetch depth and chunk size are then
+ * picked so that decoding the next chunk outlasts the queued audio only with the
+ * target underrun probability.
+ */
+struct StreamProfile
+{
+	enum { MinDepth = 2, MaxDepth = 6 };
+
+	float latency;		// fixed cost of a decode call (I/O, seek) in seconds
+	float decodeCost;	// seconds spent decoding one second of audio
+	float deviation;	// standard deviation of the decode time around the fit, in seconds
+	int measurements;	// number of decode calls measured so far
+	float chunkSeconds;	// chosen length of a single stream buffer in seconds
+	int depth;			// chosen number of queued stream buffers per SoundObject
+
+	double mS, mT, mSS, mST, mRes; // running moments of audio seconds / decode time
+
+	StreamProfile();
+
+	/**
+	 * Adds a single decode measurement to the fit
+	 * @param seconds Seconds of audio that were decoded
+	 * @param time Time the decode call took in seconds
+	 */
+	void Measure(float seconds, float time);
+
+	/**
+	 * Picks the smallest chunkSeconds * depth that keeps the underrun probability under target
+	 * @param underrun Target probability that a single decode doesn't finish in time
+	 */
+	void Choose(float underrun);
+};
+
+
+
+
+/**
+ * SoundStream stream audio data from a file source.
+ * Extremely useful for large file playback. Even a 4m long mp3 can take over 40mb of ram.
+ * Multiple sources can be bound to this stream.
+ */
+class SoundStream : public SoundBuffer
+{
+protected:
+	struct SO_ENTRY 
+	{ 
+		SoundObject* obj; 
+		int base; // PCM block offset of the currently playing buffer
+		int next; // the next PCM block offset to load
+
+		XABuffer* queue[StreamProfile::MaxDepth]; // queued buffers in play order, queue[0] is the frontbuffer
+		int queued;			// number of buffers in the queue
+		BOOL busy;			// the stream is busy on an internal operation, all other operations are ignored
+		UINT64 played;		// voice SamplesPlayed when the frontbuffer started playing
+
+		inline SO_ENTRY(SoundObject* obj) 
+			: obj(obj), base(0), next(0), queued(0), busy(0), played(0)
+		{
+		} 
+	};
+	
+	std::vector<SO_ENTRY> alSources;	// bound sources
+	AudioStreamer* alStream;			// streamer object
+	StreamProfile alProfile;			// measured decode speed and the chosen buffering
+	float underrun;						// target underrun probability
+	volatile LONG alBuffering;			// chosen buffering of alProfile, chunk ms << 4 | depth, swapped atomically
+	volatile LONG alMeasuring;			// a thread is updating alProfile or the peaks, others skip their measurement
+	std::vector<float> alPeaks;			// peak level of every PeakSlot of the stream, -1 until it was decoded
+	int peakSlot;						// slot that straddles two chunks, -1 if none is pending
+	int peakNext;						// first frame of peakSlot that isn't decoded yet
+	float peakMax;						// peak level of the decoded part of peakSlot
+
+public:
+	enum { PeakSlotsPerSecond = 4 };	// resolution of the recorded peak levels
+
+public:
+
+	/**
+	 * Creates a new SoundsStream object
+	 */
+	SoundStream();
+
+	/**
+	 * Creates a new SoundStream object and loads the specified sound file
+	 * @param file Path to the sound file to load
+	 */
+	SoundStream(const char* file);
+
+	/**
+	 * Destroys and unloads any resources held
+	 */
+	virtual ~SoundStream();
+
+	/**
+	 * @return Size of this SoundStream in PCM SAMPLES
+	 */
+	virtual int Size() const override;
+
+	/**
+	 * @return TRUE if this object is a Sound stream
+	 */
+	virtual bool IsStream() const override;
+
+	/**
+	 * Initializes this SoundStream with data found in the specified file.
+	 * Supported formats: .wav .mp3
+	 * @param file Sound file to load
+	 * @return TRUE if loading succeeded and a stream was initialized.
+	 */
+	virtual bool Load(const char* file) override;
+
+	/**
+	 * Streams are decoded in their source format, the profile is ignored.
+	 * @param file Sound file to load
+	 * @param profile Ignored
+	 * @return TRUE if loading succeeded and a stream was initialized.
+	 */
+	virtual bool Load(const char* file, const QualityProfile& profile) override;
+
+	/**
+	 * Tries to release the underlying sound buffers and free the memory.
+	 * @note This function will fail if refCount > 0. This means there are SoundObjects still using this SoundStream
+	 * @return TRUE if SoundStream data was freed, FALSE if SoundStream is still used by a SoundObject.
+	 */
+	virtual bool Unload() override;
+
+	/**
+	 * Binds a specific source to this SoundStream and increases the refCount.
+	 * @param so SoundObject to bind to this SoundStream.
+	 * @return FALSE if the binding failed. TODO: POSSIBLE REASONS?
+	 */
+	virtual bool BindSource(SoundObject* so) override;
+
+	/**
+	 * Unbinds a specific source from this SoundStream and decreases the refCount.
+	 * @param so SoundObject to unbind from this SoundStream.
+	 * @return FALSE if the unbinding failed. TODO: POSSIBLE REASONS?
+	 */
+	virtual bool UnbindSource(SoundObject* so) override;
+
+	/**
+	 * Resets the buffer in the context of the specified SoundObject
+	 * @note Calls ResetStream on AudioStreams.
+	 * @param so SoundObject to reset this buffer for
+	 * @return TRUE if reset was successful
+	 */
+	virtual bool ResetBuffer(SoundObject* so) override;
+
+	/**
+	 * Resets the stream by unloading previous buffers and requeuing the first buffers.
+	 * @param so SoundObject to reset the stream for
+	 * @return TRUE if stream was successfully reloaded
+	 */
+	bool ResetStream(SoundObject* so);
+
+	/**
+	 * Streams the next Buffer block from the stream.
+	 * @param so Specific SoundObject to stream with.
+	 * @return TRUE if a buffer was streamed. FALSE if EOS() or stream is busy.
+	 */
+	bool StreamNext(SoundObject* so);
+
+	/**
+	 * @param so Specific SoundObject to check for end of stream
+	 * @return TRUE if End of Stream was reached or if there is no stream loaded
+	 */
+	bool IsEOS(const SoundObject* so) const;
+
+	/**
+	 * @param so SoundObject to query index of
+	 * @return A valid pointer if this SoundObject is bound. Otherwise NULL.
+	 */
+	SO_ENTRY* GetSOEntry(const SoundObject* so) const;
+
+	/**
+	 * Seeks to the specified sample position in the stream.
+	 * @note The SoundObject will stop playing and must be manually restarted!
+	 * @param so SoundObject to perform seek on
+	 * @param samplepos Position in the stream in samples [0..SoundStream::Size()]
+	 */
+	void Seek(SoundObject* so, int samplepos);
+
+	/**
+	 * @param so SoundObject to query
+	 * @return Current playback position of the SoundObject in the stream in SAMPLES
+	 */
+	int Tell(const SoundObject* so) const;
+
+	/**
+	 * Stops the SoundObject and frees its stream buffers, but keeps it bound.
+	 * Seek() loads the buffers again.
+	 * @param so SoundObject to release the buffers of
+	 */
+	void ReleaseBuffers(SoundObject* so);
+
+	/**
+	 * Peak levels are recorded while the stream is decoded, parts that were never decoded count as full scale.
+	 * Ranges past the end of the stream wrap around to its start, as loops do.
+	 * @param samplepos Start of the range in SAMPLES
+	 * @param samples Length of the range in SAMPLES
+	 * @return Peak level of the stream in the range [0.0 - 1.0]
+	 */
+	float Peak(int samplepos, int samples) const;
+
+	/**
+	 * Sets the target probability of a buffer underrun. Prefetch depth and chunk size
+	 * are adapted to the measured decode speed to meet this target.
+	 * @param probability Underrun probability per decoded chunk [0.0 - 0.5]. Default is 0.001
+	 */
+	void UnderrunProbability(float probability);
+	inline float UnderrunProbability() const { return underrun; }
+
+	/**
+	 * @return Decode speed measurements and the currently chosen buffering of this stream.
+	 *         The callback thread may update it meanwhile, the decoder uses a consistent copy.
+	 */
+	inline const StreamProfile& Profile() const { return alProfile; }
+
+protected:
+
+	/**
+	 * Internal stream function.
+	 * @param soe SoundObject Entry to stream
+	 * @return TRUE if a buffer was streamed
+	 */
+	bool StreamNext(SO_ENTRY& soe);
+
+	/**
+	 * [internal] Load streaming data into the specified SoundObject
+	 * at the optionally specified streamposition.
+	 * @param so SO_ENTRY handle to queue with stream data
+	 * @param streampos [optional] PCM byte position in stream where to seek data from. 
+	 *                  If unspecified (default -1), stream will use the current streampos
+	 */
+	bool LoadStreamData(SO_ENTRY& so, int streampos = -1);
+
+	/**
+	 * [internal] Unloads all queued data for the specified SoundObject
+	 * @param so SO_ENTRY handle to unqueue and unload data for
+	 */
+	void ClearStreamData(SO_ENTRY& so);
+
+	/**
+	 * [internal] Decodes the next chunk and updates the decode speed profile
+	 * @param buffer [optional] Finished buffer to refill. It's replaced if the chunk size changed.
+	 * @param pos PCM byte position to decode from. Returns the new position.
+	 * @return Filled buffer or NULL if EndOfStream or OutOfMemory
+	 */
+	XABuffer* DecodeChunk(XABuffer* buffer, int* pos);
+
+	/**
+	 * [internal] Records the peak levels of the slots a freshly decoded buffer covers.
+	 * A slot that continues into the next chunk is carried over in peakSlot until its last frame is decoded.
+	 * @param buffer Decoded buffer
+	 * @param streampos PCM byte position of the buffer in the stream
+	 */
+	void RecordPeaks(const XABuffer* buffer, int streampos);
+};
+
+
+
+
+
+
+
+
+
+
+
+
+/**
+ * Holds and manages the current state of a SoundObject
+ */
+struct SoundObjectState; 
+
+/**
+ * Voices, listener, buses and spatial pass of an Engine
+ */
+struct EngineState;
+
+/**
+ * Generation checked reference to a SoundObject: [16 bit generation][16 bit slot].
+ * It stays safe to use after the object is destroyed, calls on a stale handle are no-ops.
+ * Freed slots are reused first in first out behind at least 1024 others, so a generation
+ * only repeats after ~64 million objects were created. 0 is never a valid handle. See SoundTable.
+ */
+typedef unsigned SoundHandle;
+
+
+
+/**
+ * An independent audio world with its own XAudio2 engine and processing thread, mastering voice,
+ * Listener, Governor, Sound3D objects and ReverbZones. Separate engines render in parallel.
+ *
+ * SoundObjects and ReverbZones are created in the current Engine of the calling thread and stay
+ * in it for their lifetime. Listener, Governor, GetAudioStats and Update operate on the current Engine.
+ * Programs that never create an Engine use the Default engine, which is created on first use.
+ * SoundBuffers don't belong to any Engine and can play in all of them.
+ */
+class Engine
+{
+	EngineState* state;					// everything this engine owns
+
+	Engine(const Engine&);				// not copyable
+	Engine& operator=(const Engine&);
+public:
+	/**
+	 * Creates a new audio world with its own XAudio2 engine on the default audio device
+	 */
+	Engine();
+
+	/**
+	 * Destroys the XAudio2 engine. All SoundObjects and ReverbZones of this Engine must be destroyed first.
+	 */
+	~Engine();
+
+	/**
+	 * @return FALSE if XAudio2 or the mastering voice could not be created, ex. there is no audio device.
+	 *         Objects of an invalid Engine stay silent.
+	 */
+	bool IsValid() const;
+
+	/**
+	 * Makes this the current Engine of the calling thread. New SoundObjects and ReverbZones
+	 * are created in it, and the Listener, Governor, GetAudioStats and Update operate on it.
+	 */
+	void MakeCurrent();
+
+	/**
+	 * @return Current Engine of the calling thread, the Default engine if MakeCurrent() was never called
+	 */
+	static Engine* Current();
+
+	/**
+	 * @return Engine of the threads that never called MakeCurrent(), created on first use
+	 */
+	static Engine* Default();
+
+	/**
+	 * [internal] @return Voices, listener, buses and spatial pass of this engine
+	 */
+	inline EngineState* State() const { return state; }
+};
+
+
+
+/**
+ * Base for all 3D and Ambient sound objects
+ */
+class SoundObject
+{
+protected:
+	friend class SoundBuffer;			// give soundbuffer access to the internals of this object
+	friend class SoundStream;			// give soundstream access to the internals of this object
+	friend struct SoundObjectState;		// allow some control for the State object
+
+	Engine* Owner;						// engine this object plays in, the current one when it was created
+	SoundBuffer* Sound;					// soundbuffer or stream to use
+	IXAudio2SourceVoice* Source;		// the sound source generator (interfaces XAudio2 to generate waveforms)
+	SoundObjectState* State;			// Holds and manages the current state of a SoundObject
+	X3DAUDIO_EMITTER Emitter;			// 3D sound emitter data (this object)
+	EffectChain Chain;					// custom effects on the Source voice
+	SoundHandle Handle;					// slot of this object in the SoundTable
+
+	/**
+	 * Creates an uninitialzed empty SoundObject
+	 */
+	SoundObject();
+	/**
+	 * Creates a soundobject with an attached buffer
+	 * @param sound SoundBuffer this object uses for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	SoundObject(SoundBuffer* sound, bool loop = false, bool play = false);
+	virtual ~SoundObject(); // unhooks any sounds and frees resources
+
+	/**
+	 * Called after a new Source voice was created for this object (the old voice and its sends are gone)
+	 */
+	virtual void OnVoiceCreated() {}
+
+	/**
+	 * Starts the Source voice. 3D sounds may schedule the start for later.
+	 * @param fresh TRUE if playback starts from a stop, FALSE if it resumes from a pause
+	 */
+	virtual void StartVoice(bool fresh);
+
+	/**
+	 * Resets the sound to its start and continues playing if it was playing
+	 * @param fresh TRUE if a playing sound is retriggered by Play(), FALSE for Rewind()
+	 */
+	void Restart(bool fresh);
+
+	/**
+	 * @return TRUE if the voice holds no buffers but still tracks its playback position, 
+	 *         so resuming it must not reload the sound from the start
+	 */
+	virtual bool TracksPosition() const { return false; }
+
+public:
+	/**
+	 * Sets the SoundBuffer or SoundStream for this SoundObject. Set NULL to remove and unbind the SoundBuffer.
+	 * @param sound Sound to bind to this object. Can be NULL to unbind sounds from this object.
+	 * @param loop [optional] Sets the sound looping or non-looping. Streams cannot be looped.
+	 */
+	void SetSound(SoundBuffer* sound, bool loop = false);
+
+	/**
+	 * @return Current soundbuffer set to this soundobject
+	 */
+	inline SoundBuffer* GetSound() const { return Sound; }
+
+	/**
+	 * @return Engine this SoundObject plays in
+	 */
+	inline Engine* GetEngine() const { return Owner; }
+
+	/**
+	 * @return Generation checked handle of this object, for SoundTable calls from any thread
+	 */
+	inline SoundHandle GetHandle() const { return Handle; }
+
+	/**
+	 * @return Custom effects of this SoundObject, they run on the voice before panning and mixing
+	 */
+	inline EffectChain& Effects() { return Chain; }
+
+	/**
+	 * @return TRUE if this SoundObject has an attached SoundStream that can be streamed.
+	 */
+	bool IsStreamable() const;
+
+	/**
+	 * @return TRUE if this SoundObject is streamable and the End Of Stream was reached.
+	 */
+	bool IsEOS() const;
+
+	/**
+	 * Starts playing the sound. If the sound is already playing, it is rewinded and played again from the start.
+	 */
+	void Play();
+
+	/**
+	 * Starts playing a new sound. Any older playing sounds will be stopped and replaced with this sound.
+	 * @param sound SoundBuffer or SoundStream to start playing
+	 * @param loop [false] Sets if the sound is looping or not. Streams are never loopable.
+	 */
+	void Play(SoundBuffer* sound, bool loop = false);
+
+	/**
+	 * Stops playing the sound and unloads streaming buffers.
+	 */
+	void Stop();
+
+	/**
+	 * Temporarily pauses sound playback and doesn't unload any streaming buffers.
+	 */
+	void Pause();
+
+	/**
+	 * If current status is Playing, then this rewinds to start of the soundbuffer/stream and starts playing again.
+	 * If current status is NOT playing, then any stream resources are freed and the object is reset.
+	 */
+	void Rewind();
+
+	/**
+	 * @return TRUE if the sound source is PLAYING.
+	 */
+	bool IsPlaying() const;
+
+	/**
+	 * @return TRUE if the sound source is STOPPED.
+	 */
+	bool IsStopped() const;
+
+	/**
+	 * @return TRUE if the sound source is PAUSED.
+	 */
+	bool IsPaused() const;
+
+	/**
+	 * @return TRUE if the sound source is at the beginning of the sound buffer.
+	 */
+	bool IsInitial() const;
+
+	/**
+	 * @return TRUE if the sound source is in LOOPING mode.
+	 */
+	bool IsLooping() const;
+
+	/**
+	 * Sets the looping mode of the sound source.
+	 */
+	void Looping(bool looping);
+
+	/**
+	 * Indicates the gain (volume amplification) applied. Range [0.0f .. 1.0f]
+	 * Each division by 2 equals an attenuation of -6dB. Each multiplicaton with 2 equals an amplification of +6dB.
+	 * A value of 0.0 is meaningless with respect to a logarithmic scale; it is interpreted as zero volume - the channel is effectively disabled.
+	 * @param gain Gain value between 0.0..1.0
+	 */
+	void Volume(float gain);
+
+	/**
+	 * @return Current gain value of this source
+	 */
+	float Volume() const;
+
+	/**
+	 * @return Gets the current playback position in the SoundBuffer or SoundStream in SAMPLES
+	 */
+	int PlaybackPos() const;
+
+	/**
+	 * Sets the playback position of the underlying SoundBuffer or SoundStream in SAMPLES
+	 * @param seekpos Position in SAMPLES where to seek in the SoundBuffer or SoundStream [0..PlaybackSize]
+	 */
+	void PlaybackPos(int seekpos);
+
+	/**
+	 * @return Playback size of the underlying SoundBuffer or SoundStream in SAMPLES
+	 */
+	int PlaybackSize() const;
+
+	/**
+	 * @return Number of samples processed every second (aka SampleRate or Frequency)
+	 */
+	int SamplesPerSecond() const;
+};
+
+
+
+
+/**
+ * A positionless sound object used for playing background music or sounds.
+ */
+class Sound : public SoundObject
+{
+public:
+
+	/**
+	 * Creates an uninitialzed Sound2D, but also
+	 * setups the sound source as an environment/bakcground sound.
+	 */
+	Sound();
+
+	/**
+	 * Creates a Sound2D with an attached buffer
+	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	Sound(SoundBuffer* sound, bool loop = false, bool play = false);
+
+	/**
+	 * Resets all background audio parameters to their defaults
+	 */
+	void Reset();
+};
+
+
+
+
+/**
+ * Timestamped transform updates of a Sound3D, sampled by the spatial pass
+ */
+struct SpatialState;
+
+/**
+ * Per processing pass SoA data of all playing Sound3D objects
+ */
+struct SpatialBatch;
+
+
+
+/**
+ * A 3D positional sound object used for playing environment-aware music or sounds.
+ * Position, Direction and Velocity updates are timestamped and interpolated (or extrapolated)
+ * once per audio processing pass, so the game can update them at its own tick rate.
+ */
+class Sound3D : public SoundObject
+{
+protected:
+	friend class ReverbZone;		// zones reroute the sends of all Sound3D objects
+	friend struct SpatialEngine;	// runs the spatial pass on the XAudio2 thread
+
+	SpatialState* Spatial;			// timestamped transform updates and the output matrix
+
+	/**
+	 * Sends this Source voice to the master and to every ReverbZone bus
+	 */
+	void RouteSends();
+
+	/**
+	 * Updates the send level to every ReverbZone from the zone membership of the specified position
+	 * @param pos Position of this sound
+	 * @param scale [1.0] Extra scale of all sends, from the SoundBuffer reverb curve
+	 * @param gain [0.0] Gain of this sound at the listener, how loud the sends are for the Governor
+	 */
+	void UpdateZoneSends(const Vector3& pos, float scale = 1.0f, float gain = 0.0f);
+
+	/**
+	 * [audio thread] Adds this sound to the spatial batch if it's playing
+	 * @param batch Batch of the current spatial pass
+	 * @param listener Listener sampled at the same time
+	 * @param now Current audio clock time in seconds
+	 */
+	void BeginSpatial(SpatialBatch& batch, const X3DAUDIO_LISTENER& listener, double now);
+
+	/**
+	 * [audio thread] Applies panning, doppler, attenuation, lowpass and zone sends after the batch was evaluated
+	 * @param batch Batch of the current spatial pass
+	 * @param i Index of this sound in the batch
+	 * @param listener Listener sampled at the same time
+	 */
+	void ApplySpatial(const SpatialBatch& batch, int i, const X3DAUDIO_LISTENER& listener);
+
+	/**
+	 * Sets up the emitter channels and reroutes the new Source voice to the ReverbZone buses
+	 */
+	virtual void OnVoiceCreated() override;
+
+	/**
+	 * Schedules the start after the propagation delay, if it's enabled
+	 */
+	virtual void StartVoice(bool fresh) override;
+
+	/**
+	 * @return TRUE while this stream is virtual, UpdateVirtual() seeks it back to its position
+	 */
+	virtual bool TracksPosition() const override;
+
+	friend void Update();
+
+	/**
+	 * [game thread] Moves an inaudible stream into the virtual state or brings it back
+	 * @param now Current audio clock time in seconds
+	 */
+	void UpdateVirtual(double now);
+
+	/**
+	 * @return Estimated gain of this sound at the listener from the last transform updates
+	 */
+	float Audibility() const;
+
+	/**
+	 * [game thread] Sets the static pan of a listener relative sound from its position and direction
+	 * @param resetVoice TRUE to also reset doppler, lowpass and the ReverbZone sends left by the spatial pass
+	 */
+	void UpdateRelativePan(bool resetVoice = false);
+
+public:
+
+	/**
+	 * Creates an uninitialzed Sound3D, but also
+	 * setups the sound source as a 3D positional sound.
+	 */
+	Sound3D();
+
+	/**
+	 * Creates a Sound3D with an attached buffer
+	 * @param sound SoundBuffer/SoundStream this object can use for playing sounds
+	 * @param loop True if sound looping is wished
+	 * @param play True if sound should start playing immediatelly
+	 */
+	Sound3D(SoundBuffer* sound, bool loop = false, bool play = false);
+
+	/**
+	 * Unhooks this Sound3D from the ReverbZones and frees resources
+	 */
+	virtual ~Sound3D();
+
+	/**
+	 * Resets all 3D positional audio parameters to their defaults
+	 */
+	void Reset();
+
+	/**
+	 * Sets the 3D position of this Sound3D object
+	 * @param x Position x component
+	 * @param y Position Y component
+	 * @param z Position z component
+	 */
+	void Position(float x, float y, float z);
+
+	/**
+	 * Sets the 3D position of this Sound3D object
+	 * @param xyz Float vector containing 3D position X Y Z components
+	 */
+	void Position(float* xyz);
+
+	/**
+	 * @return 3D position vector of this SoundObject
+	 */
+	Vector3 Position() const;
+
+	/**
+	 * Sets the 3D direction of this Sound3D object
+	 * @param x Direction x component
+	 * @param y Direction Y component
+	 * @param z Direction z component
+	 */
+	void Direction(float x, float y, float z);
+	
+	/**
+	 * Sets the 3D direction of this Sound3D object
+	 * @param xyz Float vector containing 3D direction X Y Z components
+	 */
+	void Direction(float* xyz);
+
+	/**
+	 * @return 3D direction vector of this SoundObject
+	 */
+	Vector3 Direction() const;
+
+	/**
+	 * Sets the 3D velocity of this Sound3D object
+	 * @param x Velocity x component
+	 * @param y Velocity Y component
+	 * @param z Velocity z component
+	 */
+	void Velocity(float x, float y, float z);
+
+	/**
+	 * Sets the 3D velocity of this Sound3D object
+	 * @param xyz Float vector containing 3D velocity X Y Z components
+	 */
+	void Velocity(float* xyz);
+
+	/**
+	 * @return 3D velocity vector of this SoundObject
+	 */
+	Vector3 Velocity() const;
+
+	/**
+	 * Makes this a listener relative sound, for UI, HUD and first person sounds. The Position is then
+	 * relative to the listener's head (+Z front, +Y up) and only pans: there is no distance or cone
+	 * attenuation, doppler or ReverbZone send. The pan is computed when the position or direction
+	 * changes and the spatial pass skips the sound, so relative sounds cost nothing per pass.
+	 * @param isrelative TRUE if the position of this SoundObject is relative. Default is FALSE.
+	 */
+	void Relative(bool isrelative);
+
+	/**
+	 * @return TRUE if the position of this SoundObject is relative
+	 */
+	bool IsRelative() const;
+
+	/**
+	 * @return TRUE if this is an inaudible stream that only tracks its playback time.
+	 * Virtual streams hold no decoded buffers and their voice is stopped.
+	 */
+	bool IsVirtual() const;
+
+	/**
+	 * Enables propagation delay: Play() starts the sound only after it has traveled 
+	 * from the emitter to the listener at Listener::SpeedOfSound. Useful for distant thunder and explosions.
+	 * The delay is limited by Listener::PropagationBudget. While waiting the sound IsPlaying().
+	 * @param enable TRUE to enable propagation delay. Default is FALSE.
+	 */
+	void PropagationDelay(bool enable);
+	bool PropagationDelay() const;
+
+
+	/**
+	 * Sets the distance attenuation model of this Sound3D. Default is INVERSE_DISTANCE.
+	 * @param model Distance model, evaluated once per audio processing pass
+	 */
+	void DistanceModel(AttenuationModel model);
+	AttenuationModel DistanceModel() const;
+
+	/**
+	 * Sets the distance after which there is no more attenuation. Default is unlimited (FLT_MAX).
+	 * With LINEAR_DISTANCE the gain reaches 0 at this distance (for RolloffFactor 1).
+	 */
+	void MaxDistance(float maxdist);
+	float MaxDistance() const;
+
+	/**
+	 * Sets how fast the gain falls off with distance. 0 disables distance attenuation. Default is 1.
+	 */
+	void RolloffFactor(float rolloff);
+	float RolloffFactor() const;
+
+	/**
+	 * Sets the distance under which the gain is 1.0. Default is 1.
+	 */
+	void ReferenceDistance(float refdist);
+	float ReferenceDistance() const;
+
+	/**
+	 * The inner cone angle is where the listener hears no extra attenuation (ie, you 
+		hear the regular distance-based attenuation), while the outer cone is where 
+		the AL_CONE_OUTER_GAIN fully applied (ie, you hear the distance-based 
+		attenuation as well as AL_CONE_OUTER_GAIN both applied).
+
+		> 2. if outer cone angle is 360 deg, and inner cone angle is less than that,
+		> can the source still be heard from listener at angle > inner angle
+
+		Yes, with varying degrees of attenuation (the closer to the outer cone angle 
+		you are, the more AL_CONE_OUTER_GAIN is applied).
+
+		> 3. does it still valid if outer cone angle is larger than inner cone angle ?
+
+		Yes. In fact, if the outer cone angle is smaller than the inner cone angle, 
+		then the cone attenuation won't work properly.
+
+		> 4. how does the outer cone gain (angle-dependent attenuation) will be
+		> applied to source gain (in equation) ?
+
+		When the listener is at (or beyond) the outer cone angle, the source gain and 
+		outer cone gain are multiplied together. When the listener is at (or within) 
+		the inner cone angle, the outer cone gain isn't applied at all.
+
+		If the listener is between the inner cone angle and outer cone angle, then 
+		OpenAL will only partially apply the outer cone gain. The exact method is 
+		implementation dependent, but it is a smooth curve from no extra attenuation 
+		to full attenuation (a linear slope is not uncommon, but it can be something 
+		else).
+
+		> 5. what's the default value for inner, outer cone angle, and outer cone
+		> gain ?
+
+		The inner cone angle and outer cone angle default to 360 degrees. The outer 
+		cone gain defaults to 1.0.
+
+		Note that the angle between the source and listener only gets up to 180 
+		degrees (when the listener is directly behind the source), so the actual total 
+		area covered by the cones is double the value you specify.. eg, an inner angle 
+		of 90 with the listener directly to the left or right of the source will not 
+		be attenuated by the cones; 180 degree coverage.
+	 */
+	void ConeOuterGain(float value);
+	float ConeOuterGain() const;
+
+	/**
+	 * Sets the inner sound cone angle in degrees. Default is 360.
+	 * The outer cone angle grows to match if it's smaller.
+	 * @param angle Angle
+	 */
+	void ConeInnerAngle(float angle);
+	float ConeInnerAngle() const;
+
+	/**
+	 * Sets the outer sound cone angle in degrees. Default is 360.
+	 * Outer cone angle cannot be smaller than inner cone angle
+	 * @param angle Angle 
+	 */
+	void ConeOuterAngle(float angle);
+	float ConeOuterAngle() const;
+};
+
+
+
+
+/**
+ * Central table of all SoundObjects, indexed by SoundHandle. Every SoundObject takes a slot
+ * when it's created and frees it when it's destroyed, which makes all handles to it stale.
+ *
+ * Calls made through a handle are queued on the Engine of the sound without touching the
+ * object, so any thread can make them, and they are executed by the next Update() of that
+ * Engine. Calls on stale handles are dropped. Resolve() gives the object on the game thread.
+ */
+class SoundTable
+{
+public:
+	/**
+	 * [game thread] Gets the object of a handle
+	 * @param handle Handle of the object
+	 * @return The object, NULL if the handle is stale
+	 */
+	static SoundObject* Resolve(SoundHandle handle);
+
+	/**
+	 * @param handle Handle to check
+	 * @return TRUE if the object of the handle still exists. It may be destroyed right after on another thread.
+	 */
+	static bool IsValid(SoundHandle handle);
+
+	/**
+	 * Queues a call on the object of a handle, executed by the next Update() of its Engine.
+	 * @param handle Handle of the object
+	 * @param op One of COMMAND_PLAY, STOP, PAUSE, REWIND, LOOPING, VOLUME, SEEK, POSITION, 
+	 *           DIRECTION, VELOCITY, RELATIVE or DESTROY, the 3D calls only apply to Sound3D objects
+	 * @param value [optional] Integer argument: LOOPING and RELATIVE flag, SEEK sample position
+	 * @param x [optional] VOLUME gain, POSITION, DIRECTION and VELOCITY vector
+	 * @param y [optional]
+	 * @param z [optional]
+	 * @return FALSE if the handle is stale, the call was dropped
+	 */
+	static bool Post(SoundHandle handle, CommandOp op, int value = 0, float x = 0.0f, float y = 0.0f, float z = 0.0f);
+
+	static inline bool Play(SoundHandle handle)   { return Post(handle, COMMAND_PLAY); }
+	static inline bool Stop(SoundHandle handle)   { return Post(handle, COMMAND_STOP); }
+	static inline bool Pause(SoundHandle handle)  { return Post(handle, COMMAND_PAUSE); }
+	static inline bool Rewind(SoundHandle handle) { return Post(handle, COMMAND_REWIND); }
+	static inline bool Looping(SoundHandle handle, bool looping) { return Post(handle, COMMAND_LOOPING, looping ? 1 : 0); }
+	static inline bool Volume(SoundHandle handle, float gain)    { return Post(handle, COMMAND_VOLUME, 0, gain); }
+	static inline bool Position(SoundHandle handle, float x, float y, float z) { return Post(handle, COMMAND_POSITION, 0, x, y, z); }
+
+	/**
+	 * Queues deleting the object of the handle. Only for Sound and Sound3D objects created with new.
+	 */
+	static inline bool Destroy(SoundHandle handle) { return Post(handle, COMMAND_DESTROY); }
+
+	/**
+	 * @return Number of live SoundObjects in the table
+	 */
+	static int Count();
+};
+
+
+
+
+/**
+ * Sound3D sound listener of the current Engine
+ */
+class Listener
+{
+public:
+
+	/**
+	 * Sets the master gain value (Volume) of the listener object for Audio3D.
+	 * Valid range is [0.0 - Any], meaning the global volume can be increased
+	 * until the sound starts distorting. WARNING! This does not change system volume!
+	 * @param gain Gain value to set for the listener. Range[0.0 - Any].
+	 */
+	static void Volume(float gain);
+
+	/**
+	 * Gets the master gain value (Volume) of the listener object for Audio3D.
+	 * Valid range is [0.0 - Any], meaning the global volume can be increased
+	 * until the sound starts distorting. WARNING! This does not change system volume!
+	 * @return Master gain value (Volume). Range[0.0 - Any].
+	 */
+	static float Volume();
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param pos Vector containing x y z components of the position
+	 */
+	static void Position(const Vector3& pos);
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param x X component of the new position
+	 * @param y Y component of the new position
+	 * @param z Z component of the new position
+	 */
+	static void Position(float x, float y, float z);
+
+	/**
+	 * Sets the position of the listener object for Audio3D
+	 * @param xyz Float array containing x y z components of the position
+	 */
+	static void Position(float* xyz);
+
+	/**
+	 * @return Position of the listener object for Audio3D
+	 */
+	static Vector3 Position();
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D
+	 * @param pos Vector containing x y z components of the velocity
+	 */
+	static void Velocity(const Vector3& vel);
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D
+	 * @param x X component of the new velocity
+	 * @param y Y component of the new velocity
+	 * @param z Z component of the new velocity
+	 */
+	static void Velocity(float x, float y, float z);
+
+	/**
+	 * Sets the velocity of the listener object for Audio3D
+	 * @param xyz Float array containing x y z components of the velocity
+	 */
+	static void Velocity(float* xyz);
+
+	/**
+	 * @return Velocity of the listener object for Audio3D
+	 */
+	static Vector3 Velocity();
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param target Vector containing x y z components of target where to 'look', thus changing the orientation.
+	 * @param up Vector containing x y z components of the orientation 'up' vector
+	 */
+	static void LookAt(const Vector3& target, const Vector3& up);
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param x X component of the new direction
+	 * @param y Y component of the new direction
+	 * @param z Z component of the new direction
+	 */
+	static void LookAt(float xAT, float yAT, float zAT, float xUP, float yUP, float zUP);
+
+	/**
+	 * Sets the direction of the listener object for Audio3D
+	 * @param xyzATxyzUP Float array containing x y z components of the direction
+	 */
+	static void LookAt(float* xyzATxyzUP);
+
+	/**
+	 * @return Target position of the listener object's orientation
+	 */
+	static Vector3 Target();
+
+	/**
+	 * @return Up vector of the listener object's orientation
+	 */
+	static Vector3 Up();
+
+	/**
+	 * Sets how far behind the latest transform update the spatial pass renders Sound3D objects
+	 * and the listener. Updates are interpolated inside this window and extrapolated beyond it.
+	 * @param delay Delay in seconds. 0 only extrapolates. Negative (default) uses each object's own update interval.
+	 */
+	static void Interpolation(float delay);
+
+	/**
+	 * @return Interpolation delay in seconds, negative if it follows the update interval
+	 */
+	static float Interpolation();
+
+	/**
+	 * Sets the gain under which playing Sound3D streams become virtual: they release their
+	 * decoded buffers and only track their playback time, until they're audible again.
+	 * @param gain Audibility threshold. 0 disables virtual voices. Default is 0.001 (-60dB).
+	 */
+	static void VirtualThreshold(float gain);
+	static float VirtualThreshold();
+
+	/**
+	 * @return Custom effects on the master voice, they run on the final mix
+	 */
+	static EffectChain& Effects();
+
+	/**
+	 * Sets the speed of sound used for doppler and propagation delay.
+	 * @param unitsPerSecond Speed in world units per second. Default is 340.29 (meters).
+	 */
+	static void SpeedOfSound(float unitsPerSecond);
+	static float SpeedOfSound();
+
+	/**
+	 * Sets the global propagation delay budget: no Sound3D start is delayed longer than this.
+	 * Delayed starts are scheduled, so they need no per voice memory.
+	 * @param seconds Maximum propagation delay in seconds. Default is 2.0.
+	 */
+	static void PropagationBudget(float seconds);
+	static float PropagationBudget();
+
+};
+
+
+
+
+/**
+ * A spherical acoustic zone with its own algorithmic reverb bus.
+ * The bus runs a Feedback Delay Network reverb, which is a lot cheaper than convolution.
+ * Every Sound3D sends to every zone, weighted by how far inside the zone it is:
+ * full send inside Radius, fading linearly to zero over Falloff.
+ */
+class ReverbZone
+{
+protected:
+	friend class Sound3D;		// sounds report their send loudness to the zone
+	friend struct SpatialEngine;	// bypasses the reverb of quiet zones
+
+	Engine* owner;				// engine the zone bus is mixed in
+	IXAudio2SubmixVoice* bus;	// zone bus, the reverb is its only effect
+	FDNReverb* reverb;			// reverb processed on the zone bus
+	EffectChain effects;		// effects on the zone bus, the reverb is always the first one
+	Vector3 center;				// center of the zone
+	float radius;				// full membership radius
+	float falloff;				// membership fades to 0 over this distance outside radius
+	float sendLevel;			// send level for sounds fully inside the zone
+	float passPeak;				// [audio thread] loudest send of the current spatial pass
+	float quietTime;			// [audio thread] seconds since the loudest send was audible
+	bool bypassed;				// [audio thread] reverb is disabled by the Governor
+
+public:
+
+	/**
+	 * Creates a new ReverbZone with its own reverb bus and routes all Sound3D objects to it
+	 * @param numLines [8] Number of FDN delay lines, 8 or 16. More lines give a denser tail.
+	 */
+	ReverbZone(int numLines = 8);
+
+	/**
+	 * Unroutes all Sound3D objects from this zone and destroys the reverb bus
+	 */
+	~ReverbZone();
+
+	/**
+	 * Sets the center of this zone
+	 */
+	void Position(const Vector3& pos);
+	void Position(float x, float y, float z);
+	Vector3 Position() const;
+
+	/**
+	 * Sets the radius inside which sounds get the full send level. Default is 10.
+	 */
+	void Radius(float radius);
+	float Radius() const;
+
+	/**
+	 * Sets the distance outside Radius over which the send level fades to 0. Default is 5.
+	 */
+	void Falloff(float distance);
+	float Falloff() const;
+
+	/**
+	 * Sets the send level of sounds fully inside this zone. Range [0.0 - 1.0], default is 1.0.
+	 */
+	void SendLevel(float level);
+	float SendLevel() const;
+
+	/**
+	 * @return Zone membership weight of the specified point [0.0 - 1.0]
+	 */
+	float Membership(const Vector3& pos) const;
+
+	/**
+	 * @return The reverb effect of this zone. Use it to set DecayTime, Damping, RoomSize and Wet.
+	 */
+	inline FDNReverb* Reverb() const { return reverb; }
+
+	/**
+	 * @return CPU time accounting of this zone's reverb
+	 */
+	inline const EffectTiming& Timing() const { return effects.Timing(0); }
+
+	/**
+	 * @return Effects on this zone's bus. The reverb is the first one, add custom effects after it.
+	 */
+	inline EffectChain& Effects() { return effects; }
+
+	/**
+	 * @return XAudio2 submix voice of this zone
+	 */
+	inline IXAudio2SubmixVoice* Bus() const { return bus; }
+
+	/**
+	 * @return Engine this zone is mixed in, only its Sound3D objects send to it
+	 */
+	inline Engine* GetEngine() const { return owner; }
+};
+
+
+
+
+/**
+ * Quality levels of the DSP budget Governor. Each level includes all the previous ones.
+ */
+enum GovernorLevel
+{
+	GOVERNOR_FULL_QUALITY,		// everything is processed every pass
+	GOVERNOR_HALF_RATE_SPATIAL,	// Sound3D objects update their panning every other pass
+	GOVERNOR_NO_DOPPLER,		// doppler is frozen, voices resample at a fixed ratio
+	GOVERNOR_VIRTUALIZE,		// streams become virtual at -40dB instead of Listener::VirtualThreshold
+	GOVERNOR_SKIP_QUIET_REVERB,	// reverb of ReverbZones without audible sends is bypassed
+};
+
+/**
+ * A single quality change of the Governor, as reported by GetAudioStats
+ */
+struct GovernorTransition
+{
+	double time;				// audio clock time of the transition in seconds
+	GovernorLevel from;			// previous quality level
+	GovernorLevel to;			// new quality level
+	float passMillis;			// smoothed processing pass time that caused the change
+};
+
+/**
+ * DSP budget governor. Measures the XAudio2 processing pass time and walks down the
+ * GovernorLevel ladder while it's over budget, and back up once it's well under budget.
+ * Decisions are made in Update(), so it only runs if Update() is called every game tick.
+ * Every Engine has its own Governor, these operate on the current Engine.
+ */
+class Governor
+{
+public:
+
+	/**
+	 * Sets the processing time budget of a single XAudio2 pass (the pass is 10ms).
+	 * @param milliseconds Budget per pass in milliseconds. 0 disables the governor (default).
+	 */
+	static void Budget(float milliseconds);
+	static float Budget();
+
+	/**
+	 * @return Current quality level
+	 */
+	static GovernorLevel Level();
+
+	/**
+	 * @return Smoothed processing time of an XAudio2 pass in milliseconds
+	 */
+	static float PassMillis();
+};
+
+
+
+
+/**
+ * Scheduling priority of the audio threads
+ */
+enum ThreadPriority
+{
+	PRIORITY_NORMAL,	// left as created
+	PRIORITY_HIGH,		// THREAD_PRIORITY_HIGHEST
+	PRIORITY_REALTIME,	// MMCSS "Pro Audio" task, THREAD_PRIORITY_TIME_CRITICAL if MMCSS is not available
+};
+
+/**
+ * Scheduling of the audio threads, so heavy game threads don't preempt them.
+ * The mixer is the XAudio2 processing thread of every Engine: it mixes, runs the effects and
+ * the spatial pass, and decodes the streams. Settings are applied on its next pass.
+ * The workers are the decode threads of SoundBuffer::Load, applied when they start.
+ */
+class AudioThreads
+{
+public:
+
+	/**
+	 * @param priority Priority of the mixer threads. Default is PRIORITY_NORMAL, XAudio2's own.
+	 */
+	static void MixerPriority(ThreadPriority priority);
+	static ThreadPriority MixerPriority();
+
+	/**
+	 * @param mask Bit mask of the CPUs the mixer threads may run on, 0 for any CPU (default)
+	 */
+	static void MixerAffinity(unsigned mask);
+	static unsigned MixerAffinity();
+
+	/**
+	 * @param priority Priority of the decode workers. Default is PRIORITY_NORMAL.
+	 */
+	static void WorkerPriority(ThreadPriority priority);
+	static ThreadPriority WorkerPriority();
+
+	/**
+	 * @param mask Bit mask of the CPUs the decode workers may run on, 0 for any CPU (default)
+	 */
+	static void WorkerAffinity(unsigned mask);
+	static unsigned WorkerAffinity();
+};
+
+
+
+
+/**
+ * Per-zone reverb cost, as reported by GetAudioStats
+ */
+struct ReverbZoneStats
+{
+	const ReverbZone* zone;		// the zone
+	int numLines;				// number of FDN delay lines
+	float cpuMicros;			// smoothed reverb processing time per pass in microseconds
+	float cpuLoad;				// fraction of the processing pass spent in the reverb
+};
+
+/**
+ * Audio engine statistics
+ */
+struct AudioStats
+{
+	unsigned activeSourceVoices;	// source voices currently playing
+	unsigned totalSourceVoices;		// source voices currently existing
+	unsigned activeSubmixVoices;	// submix voices (ReverbZone buses, etc.)
+	unsigned latencySamples;		// current device latency in samples
+	unsigned glitches;				// audio dropouts since the engine was started
+	unsigned memoryBytes;			// XAudio2 heap usage in bytes
+	unsigned virtualVoices;			// inaudible streams that only track their playback time
+	float cpuLoad;					// fraction of CPU time spent in XAudio2 since the last query
+	float passMillis;				// smoothed processing time of a pass in milliseconds
+	GovernorLevel governorLevel;	// current quality level of the Governor
+	const char* mp3Decoder;			// mpg123 decoder kernel picked for this CPU, NULL until an MP3 is streamed
+	unsigned pageFaults;			// page faults of the whole process since the last query
+	size_t residentBytes;			// SoundBuffer data locked in physical memory (SoundBuffer::ResidentMemory)
+	size_t largePageBytes;			// of which in large pages
+	ThreadPriority mixerPriority;	// priority the mixer thread actually got, see AudioThreads
+	float wakeupLateMillis;			// smoothed lateness of the mixer wakeups vs. the 10ms pass period
+	float wakeupLateMaxMillis;		// worst mixer wakeup lateness since the last query
+
+	std::vector<ReverbZoneStats> zones;	// reverb cost of each ReverbZone
+	std::vector<GovernorTransition> transitions; // Governor level changes since the last query
+};
+
+/**
+ * Fills the statistics of the current Engine.
+ * @param stats Statistics structure to fill
+ */
+void GetAudioStats(AudioStats& stats);
+
+/**
+ * Game thread housekeeping of the current Engine, call it once per game tick.
+ * Runs the calls posted through the SoundTable,
+ * moves inaudible Sound3D streams into virtual voices and brings audible ones back.
+ */
+void Update();
+
 } // namespace S3D
\ No newline at end of file
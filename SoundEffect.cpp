@@ -0,0 +1,682 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <Windows.h>
+#include "SoundEffect.h"
+#include "RealtimeCheck.h"
+#include "XAudio2_7\XAudio2.h"	// from DirectX SDK 2010
+#include <xapobase.h>	// from DirectX SDK 2010
+#include <xmmintrin.h>	// SSE
+#include <emmintrin.h>	// SSE2
+#include <malloc.h>		// _aligned_malloc
+#include <string.h>
+#include <math.h>
+
+#pragma comment(lib, "xapobase.lib")
+
+namespace S3D
+{
+
+	//////
+	// FDNReverb impl
+	//
+
+#pragma region FDNReverb
+
+	// mutually prime delay lengths at 48kHz (30ms .. 89ms); 8 line networks use every other length
+	static const unsigned FDNBaseLengths[FDNReverb::MaxLines] = {
+		1433, 1601, 1867, 2053, 2251, 2399, 2617, 2797,
+		3089, 3203, 3371, 3527, 3719, 3911, 4099, 4261,
+	};
+
+	static unsigned NextPow2(unsigned x)
+	{
+		unsigned p = 1;
+		while (p < x) p <<= 1;
+		return p;
+	}
+
+	static inline float HorizontalSum(__m128 v)
+	{
+		__m128 s = _mm_add_ps(v, _mm_movehl_ps(v, v));		// [0+2, 1+3, ...]
+		s = _mm_add_ss(s, _mm_shuffle_ps(s, s, 1));			// [0+2+1+3]
+		return _mm_cvtss_f32(s);
+	}
+
+	/**
+	 * In-place Hadamard transform of N = 4*K lines held in K SSE registers.
+	 * The two 4-point stages run inside each register, the remaining stages
+	 * are butterflies across registers. The result is scaled by 'norm'.
+	 */
+	static inline void Hadamard(__m128* v, int K, __m128 norm)
+	{
+		const __m128 sign1 = _mm_setr_ps(1.0f, 1.0f, -1.0f, -1.0f);
+		const __m128 sign2 = _mm_setr_ps(1.0f, -1.0f, 1.0f, -1.0f);
+		for (int k = 0; k < K; ++k)
+		{
+			__m128 x = v[k];
+			__m128 lo = _mm_shuffle_ps(x, x, _MM_SHUFFLE(1,0,1,0));	// [a b a b]
+			__m128 hi = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3,2,3,2));	// [c d c d]
+			x = _mm_add_ps(lo, _mm_mul_ps(hi, sign1));				// [a+c b+d a-c b-d]
+			lo = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2,2,0,0));
+			hi = _mm_shuffle_ps(x, x, _MM_SHUFFLE(3,3,1,1));
+			v[k] = _mm_add_ps(lo, _mm_mul_ps(hi, sign2));
+		}
+		for (int h = 1; h < K; h <<= 1)
+		{
+			for (int i = 0; i < K; i += h << 1)
+			{
+				for (int j = i; j < i + h; ++j)
+				{
+					__m128 a = v[j], b = v[j + h];
+					v[j]     = _mm_add_ps(a, b);
+					v[j + h] = _mm_sub_ps(a, b);
+				}
+			}
+		}
+		for (int k = 0; k < K; ++k)
+			v[k] = _mm_mul_ps(v[k], norm);
+	}
+
+	/**
+	 * Creates a new FDN reverb and preallocates all delay lines
+	 * @param numLines Number of delay lines, clamped to [8, 16] and rounded to a multiple of 4
+	 * @param sampleRate Sample rate of the processed audio
+	 */
+	FDNReverb::FDNReverb(int numLines, int sampleRate)
+		: numLines(numLines), sampleRate(sampleRate), pos(0), memory(nullptr),
+		decayTime(1.5f), damping(0.3f), roomSize(1.0f), wet(0.5f), dirty(true)
+	{
+		if (this->numLines < MinLines) this->numLines = MinLines;
+		if (this->numLines > MaxLines) this->numLines = MaxLines;
+		this->numLines &= ~3; // SIMD works on groups of 4 lines
+		const int N = this->numLines;
+
+		// size every line for the largest room, so RoomSize() never reallocates
+		unsigned sizes[MaxLines];
+		unsigned total = 5 * N; // gains, lowpass, signL, signR, taps
+		for (int i = 0; i < N; ++i)
+		{
+			unsigned maxLength = unsigned(FDNBaseLengths[i * MaxLines / N] * (sampleRate / 48000.0f)) + 1;
+			sizes[i] = NextPow2(maxLength);
+			total += sizes[i];
+		}
+		memory = (float*)_aligned_malloc(total * sizeof(float), 16);
+		memset(memory, 0, total * sizeof(float));
+
+		gains   = memory;
+		lowpass = memory + N;
+		signL   = memory + N * 2;
+		signR   = memory + N * 3;
+		taps    = memory + N * 4;
+		float* line = memory + N * 5;
+		const float norm = 1.0f / sqrtf(float(N));
+		for (int i = 0; i < N; ++i)
+		{
+			lines[i] = line;
+			masks[i] = sizes[i] - 1;
+			line += sizes[i];
+			signL[i] = (i & 1) ? -norm : norm;			// + - + - ...
+			signR[i] = (i & 2) ? -norm : norm;			// + + - - ...
+		}
+		UpdateParameters();
+	}
+
+	/**
+	 * Frees all delay line memory
+	 */
+	FDNReverb::~FDNReverb()
+	{
+		_aligned_free(memory);
+	}
+
+	void FDNReverb::DecayTime(float seconds)
+	{
+		if (seconds < 0.1f) seconds = 0.1f;
+		decayTime = seconds;
+		dirty = true;
+	}
+
+	void FDNReverb::Damping(float value)
+	{
+		if (value < 0.0f) value = 0.0f;
+		else if (value > 1.0f) value = 1.0f;
+		damping = value;
+		dirty = true;
+	}
+
+	void FDNReverb::RoomSize(float size)
+	{
+		if (size < 0.25f) size = 0.25f;
+		else if (size > 1.0f) size = 1.0f;
+		roomSize = size;
+		dirty = true;
+	}
+
+	void FDNReverb::Wet(float gain)
+	{
+		if (gain < 0.0f) gain = 0.0f;
+		wet = gain;
+	}
+
+	/**
+	 * Silences the reverb tail
+	 */
+	void FDNReverb::Clear()
+	{
+		const int N = numLines;
+		memset(lowpass, 0, N * sizeof(float));
+		for (int i = 0; i < N; ++i)
+			memset(lines[i], 0, (masks[i] + 1) * sizeof(float));
+	}
+
+	/**
+	 * The delay lines are allocated in the constructor, this only checks the sample rate
+	 * @return TRUE if the sample rate matches the one this reverb was created with
+	 */
+	bool FDNReverb::Prepare(int sampleRate, int channels, int maxFrames)
+	{
+		return sampleRate == this->sampleRate;
+	}
+
+	/**
+	 * Silences the reverb tail, same as Clear()
+	 */
+	void FDNReverb::Reset()
+	{
+		Clear();
+	}
+
+	/**
+	 * [internal] Recalculates delay lengths and feedback gains from the current parameters
+	 */
+	void FDNReverb::UpdateParameters()
+	{
+		dirty = false;
+		const int N = numLines;
+		const float scale = roomSize * (sampleRate / 48000.0f);
+		for (int i = 0; i < N; ++i)
+		{
+			unsigned length = unsigned(FDNBaseLengths[i * MaxLines / N] * scale);
+			lengths[i] = length ? length : 1;
+			// per-line gain so that every line decays 60dB in decayTime seconds
+			gains[i] = powf(10.0f, -3.0f * lengths[i] / (decayTime * sampleRate));
+		}
+	}
+
+	/**
+	 * Processes a block of interleaved float audio in place.
+	 * All input channels are summed into the network, the output is written
+	 * to the first two channels (any extra channels are silenced).
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames in the buffer
+	 * @param channels Number of interleaved channels
+	 */
+	void FDNReverb::Process(float* buffer, int frames, int channels)
+	{
+		if (dirty) UpdateParameters();
+
+		// flush denormals to zero, decaying tails are full of them
+		const unsigned csr = _mm_getcsr();
+		_mm_setcsr(csr | 0x8040); // FTZ | DAZ
+
+		const int N = numLines;
+		const int K = N >> 2;
+		const float inScale = 1.0f / channels;
+		const float outGain = wet;
+		const __m128 norm = _mm_set1_ps(1.0f / sqrtf(float(N)));
+		const __m128 damp = _mm_set1_ps(damping * 0.7f);
+		__m128 v[MaxLines / 4];
+
+		for (int f = 0; f < frames; ++f)
+		{
+			float* frame = buffer + f * channels;
+			float in = 0.0f;
+			for (int c = 0; c < channels; ++c)
+				in += frame[c];
+			in *= inScale;
+
+			// gather the delayed samples
+			for (int i = 0; i < N; ++i)
+				taps[i] = lines[i][(pos - lengths[i]) & masks[i]];
+
+			__m128 outL = _mm_setzero_ps();
+			__m128 outR = _mm_setzero_ps();
+			for (int k = 0; k < K; ++k)
+			{
+				__m128 x  = _mm_load_ps(taps + k * 4);
+				__m128 lp = _mm_load_ps(lowpass + k * 4);
+				lp = _mm_add_ps(x, _mm_mul_ps(_mm_sub_ps(lp, x), damp)); // x + (lp - x) * d
+				_mm_store_ps(lowpass + k * 4, lp);
+
+				outL = _mm_add_ps(outL, _mm_mul_ps(lp, _mm_load_ps(signL + k * 4)));
+				outR = _mm_add_ps(outR, _mm_mul_ps(lp, _mm_load_ps(signR + k * 4)));
+				v[k] = _mm_mul_ps(lp, _mm_load_ps(gains + k * 4));
+			}
+
+			Hadamard(v, K, norm);
+
+			const __m128 input = _mm_set1_ps(in);
+			for (int k = 0; k < K; ++k)
+				_mm_store_ps(taps + k * 4, _mm_add_ps(v[k], input));
+
+			// scatter the feedback into the lines
+			for (int i = 0; i < N; ++i)
+				lines[i][pos & masks[i]] = taps[i];
+			++pos;
+
+			const float l = HorizontalSum(outL) * outGain;
+			const float r = HorizontalSum(outR) * outGain;
+			if (channels == 1)
+			{
+				frame[0] = (l + r) * 0.5f;
+			}
+			else
+			{
+				frame[0] = l;
+				frame[1] = r;
+				for (int c = 2; c < channels; ++c)
+					frame[c] = 0.0f;
+			}
+		}
+
+		_mm_setcsr(csr);
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// DitherEffect impl
+	//
+
+	/**
+	 * @param bitsPerSample Sample size of the device format, 16 or 24
+	 * @param dither Dither of the quantization
+	 */
+	DitherEffect::DitherEffect(int bitsPerSample, DitherMode dither) : stage(bitsPerSample, dither)
+	{
+	}
+
+	/**
+	 * @return FALSE if there are more channels than the OutputStage supports
+	 */
+	bool DitherEffect::Prepare(int sampleRate, int channels, int maxFrames)
+	{
+		stage.Reset();
+		return channels <= OutputStage::MaxChannels;
+	}
+
+	/**
+	 * Quantizes a block of interleaved float audio in place
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames in the buffer
+	 * @param channels Number of interleaved channels
+	 */
+	void DitherEffect::Process(float* buffer, int frames, int channels)
+	{
+		stage.Quantize(buffer, frames, channels);
+	}
+
+	/**
+	 * Clears the noise shaping history
+	 */
+	void DitherEffect::Reset()
+	{
+		stage.Reset();
+	}
+
+
+
+
+	//////
+	// XAPO bridge
+	//
+
+#pragma region EffectXAPO
+
+	/**
+	 * @return Peak magnitude of float samples, 4 at a time in SSE registers
+	 */
+	static float PeakFloat(const float* samples, int count)
+	{
+		const __m128 mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)); // clears the sign
+		__m128 peak = _mm_setzero_ps();
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+			peak = _mm_max_ps(peak, _mm_and_ps(_mm_loadu_ps(samples + i), mask));
+		peak = _mm_max_ps(peak, _mm_movehl_ps(peak, peak));
+		peak = _mm_max_ss(peak, _mm_shuffle_ps(peak, peak, 1));
+		float result = _mm_cvtss_f32(peak);
+		for (; i < count; ++i)
+			if (fabsf(samples[i]) > result) result = fabsf(samples[i]);
+		return result;
+	}
+
+	class __declspec(uuid("5dd650e0-60e3-4041-8fec-da94e50ae62b")) EffectXAPO : public CXAPOBase
+	{
+		Effect* effect;
+		EffectTiming* timing;
+		UINT32 channels;
+		UINT32 sampleRate;		// format the effect was prepared for
+		UINT32 maxFrames;
+		int silentFrames;		// frames of silent input processed since the input was last audible
+		bool idle;				// input silent and output decayed, Process() is skipped
+		LARGE_INTEGER frequency;
+		double cyclesPerTick;	// [debug] highest thread cycles per QPC tick seen, the rate when running
+
+		static XAPO_REGISTRATION_PROPERTIES Registration;
+
+	public:
+		EffectXAPO(Effect* effect, EffectTiming* timing)
+			: CXAPOBase(&Registration), effect(effect), timing(timing), channels(0), sampleRate(0), maxFrames(0),
+			  silentFrames(0), idle(false), cyclesPerTick(0.0)
+		{
+			QueryPerformanceFrequency(&frequency);
+		}
+
+		STDMETHOD(LockForProcess) (UINT32 InputLockedParameterCount,
+			const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pInputLockedParameters,
+			UINT32 OutputLockedParameterCount,
+			const XAPO_LOCKFORPROCESS_BUFFER_PARAMETERS* pOutputLockedParameters) override
+		{
+			// an edit of the chain locks the XAPOs that stay in it again, their state must survive that
+			const WAVEFORMATEX* format = pInputLockedParameters[0].pFormat;
+			const UINT32 frames = pInputLockedParameters[0].MaxFrameCount;
+			const bool prepared = channels == format->nChannels && sampleRate == format->nSamplesPerSec && maxFrames == frames;
+			if (!prepared && !effect->Prepare(format->nSamplesPerSec, format->nChannels, frames))
+				return XAPO_E_FORMAT_UNSUPPORTED;
+
+			HRESULT hr = CXAPOBase::LockForProcess(InputLockedParameterCount, pInputLockedParameters,
+				OutputLockedParameterCount, pOutputLockedParameters);
+			if (SUCCEEDED(hr))
+			{
+				channels = format->nChannels;
+				sampleRate = format->nSamplesPerSec;
+				maxFrames = frames;
+				if (timing) timing->sampleRate = format->nSamplesPerSec;
+			}
+			return hr;
+		}
+
+		STDMETHOD_(void, Reset) () override
+		{
+			effect->Reset();
+			silentFrames = 0;
+			idle = false;
+		}
+
+		STDMETHOD_(void, Process) (UINT32 InputProcessParameterCount,
+			const XAPO_PROCESS_BUFFER_PARAMETERS* pInputProcessParameters,
+			UINT32 OutputProcessParameterCount,
+			XAPO_PROCESS_BUFFER_PARAMETERS* pOutputProcessParameters,
+			BOOL IsEnabled) override
+		{
+			RealtimeScope realtime;
+			const XAPO_PROCESS_BUFFER_PARAMETERS& in = pInputProcessParameters[0];
+			XAPO_PROCESS_BUFFER_PARAMETERS& out = pOutputProcessParameters[0];
+			out.ValidFrameCount = in.ValidFrameCount;
+			out.BufferFlags = in.BufferFlags;
+			if (!IsEnabled)
+				return;
+
+			// voices playing silent data still deliver VALID buffers, check the level too
+			float* buffer = (float*)in.pBuffer; // in-place: pOutput->pBuffer == pInput->pBuffer
+			const int count = in.ValidFrameCount * channels;
+			const bool silent = in.BufferFlags == XAPO_BUFFER_SILENT || PeakFloat(buffer, count) <= SilencePeak;
+			if (!silent)
+				silentFrames = 0, idle = false;
+			else if (idle)
+			{
+				if (timing) ++timing->skipped;
+				return; // the input passes through, it's silent anyway
+			}
+
+			LARGE_INTEGER start, end;
+			QueryPerformanceCounter(&start);
+		#ifdef _DEBUG
+			ULONG64 cyclesStart, cyclesEnd;
+			QueryThreadCycleTime(GetCurrentThread(), &cyclesStart);
+			const unsigned allocations = RealtimeCheck::ThreadCount(RT_ALLOCATION);
+		#endif
+
+			if (in.BufferFlags == XAPO_BUFFER_SILENT) // silent input is not zeroed, but tails keep ringing
+				memset(buffer, 0, count * sizeof(float));
+			effect->Process(buffer, in.ValidFrameCount, channels);
+			out.BufferFlags = XAPO_BUFFER_VALID;
+			if (silent && effect->SkipSilence())
+			{
+				// the tail must have left the effect's delay before its level counts
+				silentFrames += in.ValidFrameCount;
+				idle = silentFrames > effect->Latency() && PeakFloat(buffer, count) <= SilencePeak;
+			}
+
+			QueryPerformanceCounter(&end);
+		#ifdef _DEBUG
+			QueryThreadCycleTime(GetCurrentThread(), &cyclesEnd);
+			CheckContract(RealtimeCheck::ThreadCount(RT_ALLOCATION) - allocations, 
+						  double(cyclesEnd - cyclesStart), double(end.QuadPart - start.QuadPart));
+		#endif
+			if (timing)
+			{
+				float micros = float(end.QuadPart - start.QuadPart) * 1000000.0f / float(frequency.QuadPart);
+				timing->lastMicros = micros;
+				timing->avgMicros = timing->avgMicros + (micros - timing->avgMicros) * 0.05f;
+				timing->frames = in.ValidFrameCount;
+			}
+		}
+
+	#ifdef _DEBUG
+		/**
+		 * A thread that ran for much fewer cycles than the wall time allows was descheduled
+		 * inside Process(): it waited on a lock, an event or I/O. Allocations are counted by
+		 * the RealtimeCheck interceptors, Process() runs in a RealtimeScope.
+		 */
+		void CheckContract(unsigned allocations, double cycles, double ticks)
+		{
+			if (!timing || ticks <= 0.0)
+				return;
+			timing->allocations += allocations;
+			double rate = cycles / ticks;
+			if (rate > cyclesPerTick) cyclesPerTick = rate;
+			bool stalled = ticks > frequency.QuadPart / 10000 && rate < cyclesPerTick * 0.5; // >100us
+			if (stalled) ++timing->stalls;
+
+			// report only the first violation, OutputDebugString doesn't allocate
+			if (allocations && timing->allocations == allocations)
+				OutputDebugStringA("S3D: Effect::Process() allocated memory on the audio thread!\n");
+			if (stalled && timing->stalls == 1)
+				OutputDebugStringA("S3D: Effect::Process() blocked the audio thread!\n");
+		}
+	#endif
+	};
+
+	XAPO_REGISTRATION_PROPERTIES EffectXAPO::Registration = {
+		__uuidof(EffectXAPO),
+		L"Sound3D Effect",
+		L"Copyright (c) 2013 Jorma Rebane",
+		1, 0,
+		XAPOBASE_DEFAULT_FLAG | XAPO_FLAG_INPLACE_REQUIRED,
+		1, 1, 1, 1
+	};
+
+	/**
+	 * Wraps an Effect into an XAPO that can be inserted into an XAudio2 effect chain.
+	 * @note The returned object has a refcount of 1. The effect must outlive the XAPO.
+	 * @param effect Effect to run in the XAPO
+	 * @param timing [optional] Receives CPU time of every processing pass
+	 * @return New XAPO object. Release() it after passing it to XAudio2.
+	 */
+	IUnknown* CreateEffectXAPO(Effect* effect, EffectTiming* timing)
+	{
+		return static_cast<IXAPO*>(new EffectXAPO(effect, timing));
+	}
+
+#pragma endregion
+
+
+
+
+	//////
+	// EffectChain impl
+	//
+
+#pragma region EffectChain
+
+	EffectChain::EffectChain() : voice(nullptr), count(0), applied(0)
+	{
+	}
+
+	EffectChain::~EffectChain()
+	{
+		ReleaseXAPOs();
+	}
+
+	/**
+	 * Appends an effect to the end of the chain
+	 * @param effect Effect to add
+	 * @return FALSE if the chain is full, the effect is already in it or it rejected the voice format
+	 */
+	bool EffectChain::Add(Effect* effect)
+	{
+		if (!effect || count == MaxEffects)
+			return false;
+		for (int i = 0; i < count; ++i)
+			if (effects[i] == effect)
+				return false;
+
+		int slot = 0; // a timings slot no other effect of the chain uses
+		for (int i = 0; i < count; ++i)
+			if (slots[i] == slot)
+				++slot, i = -1;
+		timings[slot] = EffectTiming();
+		slots[count] = slot;
+		xapos[count] = nullptr;
+		effects[count++] = effect;
+		if (Apply())
+			return true;
+		--count; // the effect didn't accept the voice format
+		if (xapos[count]) xapos[count]->Release(), xapos[count] = nullptr;
+		Apply();
+		return false;
+	}
+
+	/**
+	 * Removes an effect from the chain
+	 * @param effect Effect to remove
+	 * @return FALSE if the effect was not in the chain
+	 */
+	bool EffectChain::Remove(Effect* effect)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			if (effects[i] != effect)
+				continue;
+			IUnknown* xapo = xapos[i];
+			for (--count; i < count; ++i)
+			{
+				effects[i] = effects[i + 1];
+				xapos[i] = xapos[i + 1];
+				slots[i] = slots[i + 1];
+			}
+			Apply();
+			if (xapo) xapo->Release(); // the voice has let go of it too
+			return true;
+		}
+		return false;
+	}
+
+	/**
+	 * @return Total latency of the chain in frames
+	 */
+	int EffectChain::Latency() const
+	{
+		int latency = 0;
+		for (int i = 0; i < count; ++i)
+			latency += effects[i]->Latency();
+		return latency;
+	}
+
+	/**
+	 * [internal] Moves the chain to a new voice, or detaches it if voice is NULL
+	 * @param voice Voice to run the effects on
+	 */
+	void EffectChain::Attach(IXAudio2Voice* voice)
+	{
+		this->voice = voice;
+		applied = 0; // a new voice has no effects yet
+		ReleaseXAPOs(); // an XAPO runs in one voice only, the new voice gets new ones
+		Apply();
+	}
+
+	/**
+	 * [internal] Sets the effects on the voice, keeping the enabled state of existing ones.
+	 * Only effects new to the chain get a new XAPO, the others keep running with their state.
+	 * @return FALSE if the voice rejected the chain
+	 */
+	bool EffectChain::Apply()
+	{
+		if (!voice)
+			return true; // applied once the voice is created
+		if (!count && !applied)
+			return true; // nothing to set or clear
+
+		XAUDIO2_VOICE_DETAILS details;
+		voice->GetVoiceDetails(&details);
+
+		XAUDIO2_EFFECT_DESCRIPTOR descs[MaxEffects];
+		for (int i = 0; i < count; ++i)
+		{
+			if (!xapos[i])
+				xapos[i] = CreateEffectXAPO(effects[i], &timings[slots[i]]);
+			descs[i].pEffect = xapos[i];
+			descs[i].InitialState = TRUE;
+			descs[i].OutputChannels = details.InputChannels;
+			for (int j = 0; j < applied; ++j) // keep effects disabled if they were
+				if (current[j] == effects[i])
+					voice->GetEffectState(j, &descs[i].InitialState);
+		}
+		XAUDIO2_EFFECT_CHAIN chain = { (UINT32)count, descs };
+		HRESULT hr = voice->SetEffectChain(count ? &chain : nullptr); // the voice holds its own references
+		if (FAILED(hr))
+			return false;
+		for (int i = 0; i < count; ++i)
+			current[i] = effects[i];
+		applied = count;
+		return true;
+	}
+
+	/**
+	 * [internal] Releases the XAPOs of all effects, they are created again by the next Apply()
+	 */
+	void EffectChain::ReleaseXAPOs()
+	{
+		for (int i = 0; i < count; ++i)
+			if (xapos[i]) xapos[i]->Release(), xapos[i] = nullptr;
+	}
+
+#pragma endregion
+
+} // namespace S3D
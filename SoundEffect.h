@@ -0,0 +1,373 @@
+#pragma once
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#include "PCMConvert.h"	// OutputStage
+
+struct IUnknown;
+struct IXAudio2Voice;
+
+namespace S3D {
+
+/**
+ * CPU time accounting for an effect running on the XAudio2 processing thread.
+ * Written by the audio thread once per processing pass, read by the stats API.
+ */
+struct EffectTiming
+{
+	volatile float lastMicros;	// processing time of the last pass in microseconds
+	volatile float avgMicros;	// smoothed processing time per pass in microseconds
+	volatile int frames;		// number of frames in the last pass
+	volatile int sampleRate;	// sample rate the effect is locked to
+	volatile unsigned allocations;	// [debug] heap calls made inside Process() while RealtimeCheck is enabled, must stay 0
+	volatile unsigned stalls;		// [debug] Process() calls that blocked on a lock or I/O, must stay 0
+	volatile unsigned skipped;		// passes skipped because the input was silent and the output had decayed
+
+	inline EffectTiming() : lastMicros(0), avgMicros(0), frames(0), sampleRate(0), allocations(0), stalls(0), skipped(0) {}
+
+	/**
+	 * @return Average fraction of the processing pass spent in this effect [0.0 - 1.0+]
+	 */
+	inline float Load() const
+	{
+		return (frames && sampleRate) ? avgMicros / (frames * 1000000.0f / sampleRate) : 0.0f;
+	}
+};
+
+
+
+
+/**
+ * Block based audio effect. Derive from it to run custom DSP on a SoundObject voice,
+ * a ReverbZone bus or the master, through their EffectChain.
+ *
+ * Real-time contract: Process() runs on the XAudio2 thread. It must not allocate or free
+ * memory, take locks, wait or do I/O. All state is preallocated in Prepare().
+ * Debug builds count contract violations in EffectTiming and report them to the debugger.
+ *
+ * Once the input turns silent and the output of the effect decays below SilencePeak,
+ * Process() is no longer called until the input is audible again (see SkipSilence).
+ */
+class Effect
+{
+public:
+	virtual ~Effect() {}
+
+	/**
+	 * Called on the game thread when the effect is locked to a voice format, allocate all state here
+	 * @param sampleRate Sample rate of the processed audio
+	 * @param channels Number of interleaved channels
+	 * @param maxFrames Maximum number of frames in a single Process() call
+	 * @return FALSE if the format is not supported, the effect is then not added
+	 */
+	virtual bool Prepare(int sampleRate, int channels, int maxFrames) = 0;
+
+	/**
+	 * [audio thread] Processes a block of interleaved float audio in place
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames in the buffer
+	 * @param channels Number of interleaved channels
+	 */
+	virtual void Process(float* buffer, int frames, int channels) = 0;
+
+	/**
+	 * [audio thread] Silences all internal state, such as delay lines and filters
+	 */
+	virtual void Reset() {}
+
+	/**
+	 * @return Delay this effect adds to the signal in frames
+	 */
+	virtual int Latency() const { return 0; }
+
+	/**
+	 * @return TRUE if Process() can be skipped while the input is silent and the tail has decayed.
+	 *         Effects that must see every block, such as meters and captures, return FALSE.
+	 */
+	virtual bool SkipSilence() const { return true; }
+};
+
+
+
+
+/**
+ * Ordered list of Effects running on a single XAudio2 voice: a SoundObject voice,
+ * a ReverbZone bus or the master. An Effect can be in one chain at a time and
+ * must outlive it. Changes are applied to the voice immediately, on the game thread.
+ */
+class EffectChain
+{
+public:
+	enum { MaxEffects = 8 };
+
+protected:
+	IXAudio2Voice* voice;				// voice the chain runs on, NULL until the voice exists
+	int count;							// number of effects in the chain
+	int applied;						// number of effects currently set on the voice
+	Effect* effects[MaxEffects];		// effects in processing order
+	IUnknown* xapos[MaxEffects];		// XAPO of each effect, kept while it stays in the chain so its state survives edits
+	int slots[MaxEffects];				// timings slot of each effect, fixed while it stays in the chain
+	Effect* current[MaxEffects];		// effects currently set on the voice, in voice order
+	EffectTiming timings[MaxEffects];	// CPU time of each effect, by slot. The XAPOs point into it
+
+	EffectChain(const EffectChain&);	// not copyable, it owns the XAPOs
+	EffectChain& operator=(const EffectChain&);
+
+public:
+
+	EffectChain();
+	~EffectChain();
+
+	/**
+	 * Appends an effect to the end of the chain
+	 * @param effect Effect to add
+	 * @return FALSE if the chain is full, the effect is already in it or it rejected the voice format
+	 */
+	bool Add(Effect* effect);
+
+	/**
+	 * Removes an effect from the chain
+	 * @param effect Effect to remove
+	 * @return FALSE if the effect was not in the chain
+	 */
+	bool Remove(Effect* effect);
+
+	/**
+	 * @return Number of effects in the chain
+	 */
+	inline int Count() const { return count; }
+
+	/**
+	 * @return Effect at the specified index in processing order
+	 */
+	inline Effect* Get(int index) const { return effects[index]; }
+
+	/**
+	 * @return CPU time accounting of the effect at the specified index
+	 */
+	inline const EffectTiming& Timing(int index) const { return timings[slots[index]]; }
+
+	/**
+	 * @return Total latency of the chain in frames
+	 */
+	int Latency() const;
+
+	/**
+	 * [internal] Moves the chain to a new voice, or detaches it if voice is NULL
+	 * @param voice Voice to run the effects on
+	 */
+	void Attach(IXAudio2Voice* voice);
+
+protected:
+
+	/**
+	 * [internal] Sets the effects on the voice, keeping the enabled state of existing ones.
+	 * Only effects new to the chain get a new XAPO, the others keep running with their state.
+	 * @return FALSE if the voice rejected the chain
+	 */
+	bool Apply();
+
+	/**
+	 * [internal] Releases the XAPOs of all effects, they are created again by the next Apply()
+	 */
+	void ReleaseXAPOs();
+};
+
+
+
+
+/**
+ * Feedback Delay Network reverb. 8 or 16 delay lines are mixed through a
+ * normalized Hadamard feedback matrix; all per-line math runs in SSE registers
+ * (4 lines per register), only the delay line taps are scalar.
+ *
+ * All memory is allocated in the constructor, Process() never allocates.
+ * Parameter setters are safe to call from any thread, they are applied
+ * at the start of the next processed block.
+ */
+class FDNReverb : public Effect
+{
+public:
+	enum { MinLines = 8, MaxLines = 16 };
+
+protected:
+	int numLines;				// number of delay lines, 8 or 16
+	int sampleRate;				// sample rate of the processed audio
+	unsigned pos;				// shared write position of all delay lines
+	float* memory;				// 16-byte aligned block: per-line SIMD state followed by the delay lines
+	float* gains;				// [numLines] feedback gain of each line for the current decay time
+	float* lowpass;				// [numLines] one-pole damping filter state
+	float* signL;				// [numLines] left output tap pattern (scaled by 1/sqrt(N))
+	float* signR;				// [numLines] right output tap pattern (scaled by 1/sqrt(N))
+	float* taps;				// [numLines] scratch for gathering/scattering delay line samples
+	float* lines[MaxLines];		// start of each delay line
+	unsigned masks[MaxLines];	// power of 2 size mask of each delay line
+	unsigned lengths[MaxLines];	// current delay length of each line in samples
+
+	float decayTime;			// RT60 in seconds
+	float damping;				// high frequency damping [0.0 - 1.0]
+	float roomSize;				// delay length scale [0.25 - 1.0]
+	float wet;					// output gain
+	volatile bool dirty;		// parameters changed, recalculate before next block
+
+public:
+
+	/**
+	 * Creates a new FDN reverb and preallocates all delay lines
+	 * @param numLines Number of delay lines, clamped to [8, 16] and rounded to a multiple of 4
+	 * @param sampleRate Sample rate of the processed audio
+	 */
+	FDNReverb(int numLines, int sampleRate);
+
+	/**
+	 * Frees all delay line memory
+	 */
+	~FDNReverb();
+
+	/**
+	 * @return Number of delay lines in this network (8 or 16)
+	 */
+	inline int NumLines() const { return numLines; }
+
+	/**
+	 * Sets the reverb decay time (RT60, time to decay by 60dB)
+	 * @param seconds Decay time in seconds. Default is 1.5s
+	 */
+	void DecayTime(float seconds);
+	inline float DecayTime() const { return decayTime; }
+
+	/**
+	 * Sets high frequency damping of the reverb tail
+	 * @param damping Damping amount [0.0 - 1.0]. Default is 0.3
+	 */
+	void Damping(float damping);
+	inline float Damping() const { return damping; }
+
+	/**
+	 * Scales the delay line lengths, small rooms have denser early reflections
+	 * @param size Room size [0.25 - 1.0]. Default is 1.0
+	 */
+	void RoomSize(float size);
+	inline float RoomSize() const { return roomSize; }
+
+	/**
+	 * Sets the output gain of the reverb
+	 * @param gain Wet gain [0.0 - Any]. Default is 0.5
+	 */
+	void Wet(float gain);
+	inline float Wet() const { return wet; }
+
+	/**
+	 * Silences the reverb tail
+	 */
+	void Clear();
+
+	/**
+	 * The delay lines are allocated in the constructor, this only checks the sample rate
+	 * @return TRUE if the sample rate matches the one this reverb was created with
+	 */
+	virtual bool Prepare(int sampleRate, int channels, int maxFrames) override;
+
+	/**
+	 * Processes a block of interleaved float audio in place.
+	 * All input channels are summed into the network, the output is written
+	 * to the first two channels (any extra channels are silenced).
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames in the buffer
+	 * @param channels Number of interleaved channels
+	 */
+	virtual void Process(float* buffer, int frames, int channels) override;
+
+	/**
+	 * Silences the reverb tail, same as Clear()
+	 */
+	virtual void Reset() override;
+
+protected:
+
+	/**
+	 * [internal] Recalculates delay lengths and feedback gains from the current parameters
+	 */
+	void UpdateParameters();
+};
+
+
+
+
+/**
+ * Output stage on the master voice: saturates and dithers the mix to the levels of a 16 or 24-bit
+ * device format (OutputStage). The device's own conversion is then exact instead of truncating
+ * quiet signals. Add it as the last effect of Listener::Effects().
+ */
+class DitherEffect : public Effect
+{
+protected:
+	OutputStage stage;	// quantizer, its dither and shaping state
+
+public:
+
+	/**
+	 * @param bitsPerSample Sample size of the device format, 16 or 24
+	 * @param dither Dither of the quantization
+	 */
+	DitherEffect(int bitsPerSample = 16, DitherMode dither = DITHER_TPDF);
+
+	/**
+	 * @return The quantizer, with the number of clipped samples
+	 */
+	inline const OutputStage& Stage() const { return stage; }
+
+	/**
+	 * @return FALSE if there are more channels than the OutputStage supports
+	 */
+	virtual bool Prepare(int sampleRate, int channels, int maxFrames) override;
+
+	/**
+	 * Quantizes a block of interleaved float audio in place
+	 * @param buffer Interleaved float samples
+	 * @param frames Number of sample frames in the buffer
+	 * @param channels Number of interleaved channels
+	 */
+	virtual void Process(float* buffer, int frames, int channels) override;
+
+	/**
+	 * Clears the noise shaping history
+	 */
+	virtual void Reset() override;
+
+	/**
+	 * @return FALSE, quiet signals below the SilencePeak still need dither to not be truncated
+	 */
+	virtual bool SkipSilence() const override { return false; }
+};
+
+
+
+
+/**
+ * Wraps an Effect into an XAPO that can be inserted into an XAudio2 effect chain.
+ * @note The returned object has a refcount of 1. The effect must outlive the XAPO.
+ * @param effect Effect to run in the XAPO
+ * @param timing [optional] Receives CPU time of every processing pass
+ * @return New XAPO object. Release() it after passing it to XAudio2.
+ */
+IUnknown* CreateEffectXAPO(Effect* effect, EffectTiming* timing = nullptr);
+
+} // namespace S3D
@@ -0,0 +1,691 @@
+/**
+ * Sound3D - An open source 3D Audio Library
+ * 
+ * Copyright (c) 2013 Jorma Rebane
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software 
+ * and associated documentation files (the "Software"), to deal in the Software without restriction, 
+ * including without limitation the rights to use, copy, modify, merge, publish, distribute, sublicense, 
+ * and/or sell copies of the Software, and to permit persons to whom the Software is furnished to do so, 
+ * subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or substantial 
+ * portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT 
+ * LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN 
+ * NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, 
+ * WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+// Render - renders scripted scenes through the full Sound3D pipeline into WAV files
+//
+// usage: Render [-j threads] [-o outdir] [-monitor] [-bits 16|24|32] [-dither none|tpdf|shaped] [-rtcheck] scene1.txt capture.s3dr ...
+//
+// Every scene runs in its own Engine, so scenes render in parallel on separate cores.
+// XAudio2 only renders in realtime, a single scene takes as long as it plays, but
+// N worker threads render N scenes at once. The master mix is captured by an Effect
+// on Listener::Effects() and silenced, unless -monitor is given.
+// WAVs are 32-bit float by default, 16 and 24-bit go through the dithered OutputStage.
+// -rtcheck prints every allocation, lock, wait and file I/O the audio threads made and
+// fails with exit code 3 if there were any, needs a debug or S3D_RTCHECK=1 build.
+// -reccheck records calls posted through the SoundTable, replays the capture and fails
+// with exit code 4 if the replay is missing any of them. Scenes are optional with it.
+//
+// Scene script, one command per line, '#' starts a comment.
+// Asset files are relative to the scene file.
+//   length <seconds>                         length of the rendered WAV
+//   asset <name> <file> [stream]             SoundBuffer (or SoundStream) used by the events
+//   zone <x> <y> <z> <radius>                ReverbZone
+//   <time> play <id> <asset> [x y z] [loop]  starts sound <id>, a Sound3D if a position is given
+//   <time> stop <id>                         stops sound <id>
+//   <time> move <id> <x> <y> <z>             moves sound <id>, if it was played with a position
+//   <time> volume <id> <gain>                sets the volume of sound <id>
+//   <time> listener <x> <y> <z>              moves the listener
+//   <time> lookat <x> <y> <z>                turns the listener towards a point
+//
+// A *.s3dr file made by the CommandRecorder is replayed instead of a script: the recorded
+// API calls run on the capture clock, the render is as long as the recording plus 1s of tail.
+
+#include "Sound3D.h"
+using namespace S3D;
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <Windows.h>
+#include <process.h>
+#include <vector>
+#include <string>
+#include <map>
+#include <algorithm>
+
+struct SceneAsset
+{
+	std::string name;		// name used by the play events
+	std::string file;		// sound file, resolved against the scene directory
+	bool stream;			// load it as a SoundStream
+};
+
+struct SceneZone
+{
+	float x, y, z, radius;
+};
+
+struct SceneEvent
+{
+	double time;			// scene time in seconds
+	int line;				// script line, keeps events at the same time in script order
+	std::string command;	// play, stop, move, volume, listener, lookat
+	std::string id;			// sound instance name
+	std::string asset;		// asset name of a play event
+	float x, y, z;			// position or gain (x)
+	bool hasPosition;		// play event creates a Sound3D
+	bool loop;				// play event loops
+};
+
+struct SceneSound
+{
+	Sound* sound;			// played without a position
+	Sound3D* sound3D;		// played with a position
+
+	SceneSound() : sound(nullptr), sound3D(nullptr) {}
+	void Destroy() { delete sound, sound = nullptr; delete sound3D, sound3D = nullptr; }
+	SoundObject* Object() const { return sound ? (SoundObject*)sound : (SoundObject*)sound3D; }
+};
+
+struct Scene
+{
+	std::string path;		// scene script
+	std::string name;		// script file name without extension
+	double length;			// length of the render in seconds
+	std::vector<SceneAsset> assets;
+	std::vector<SceneZone> zones;
+	std::vector<SceneEvent> events;
+	bool replay;			// path is a CommandRecorder recording, not a script
+};
+
+struct SceneReport
+{
+	bool ok;
+	std::string error;
+	double loadSeconds;		// wall time spent loading assets
+	double renderSeconds;	// wall time spent rendering
+	int sampleRate, channels, frames;
+	int numEvents;
+	double lateAvgMs, lateMaxMs; // how far after their scene time events were applied
+	float passAvgMs, passMaxMs;	// XAudio2 processing pass time
+	unsigned glitches;
+	float peak;				// absolute peak of the mix
+	unsigned clipped;		// samples the OutputStage saturated
+	double samplesPerNs;	// OutputStage throughput
+
+	SceneReport() : ok(false), loadSeconds(0.0), renderSeconds(0.0), sampleRate(0), channels(0), frames(0), 
+		numEvents(0), lateAvgMs(0.0), lateMaxMs(0.0), passAvgMs(0.0f), passMaxMs(0.0f), glitches(0), peak(0.0f),
+		clipped(0), samplesPerNs(0.0) {}
+};
+
+struct Options
+{
+	int threads;
+	std::string outdir;
+	bool monitor;
+	int bits;				// WAV sample size: 16, 24 or 32 (float)
+	DitherMode dither;		// dither of 16 and 24-bit WAVs
+	bool rtcheck;			// fail on real-time safety violations of the audio threads
+	bool reccheck;			// round-trip posted calls through the CommandRecorder first
+};
+
+static std::vector<Scene> xScenes;
+static std::vector<SceneReport> xReports;
+static volatile LONG xNextScene = -1;
+static Options xOptions;
+
+static bool loadScene(const char* path, Scene& scene, std::string& error);
+static void renderScene(const Scene& scene, SceneReport& report);
+static bool writeWav(const std::string& path, const void* data, int frames, int channels, int sampleRate, int bits);
+static bool writeReport(const std::string& path, const Scene& scene, const SceneReport& report);
+static bool checkRecorder(std::string& error);
+static unsigned __stdcall renderWorker(void*);
+static double wallClock();
+
+
+
+
+/**
+ * Records the master mix into a buffer allocated up front for the whole scene,
+ * and silences the device output unless the render is monitored
+ */
+class CaptureEffect : public Effect
+{
+public:
+	double seconds;			// length of the capture
+	bool monitor;			// keep the device output audible
+	float* samples;			// interleaved float mix
+	int capacity;			// size of the capture in frames
+	volatile int frames;	// frames captured so far, written by the audio thread
+	int channels;
+	int sampleRate;
+
+	CaptureEffect(double seconds, bool monitor) 
+		: seconds(seconds), monitor(monitor), samples(nullptr), capacity(0), frames(0), channels(0), sampleRate(0) {}
+	~CaptureEffect() { free(samples); }
+
+	virtual bool Prepare(int rate, int numChannels, int maxFrames) override
+	{
+		free(samples);
+		capacity = int(seconds * rate + 0.5);
+		samples = (float*)malloc(sizeof(float) * (capacity > 0 ? capacity : 1) * numChannels);
+		sampleRate = rate;
+		channels = numChannels;
+		frames = 0;
+		return samples != nullptr;
+	}
+
+	virtual void Process(float* buffer, int count, int numChannels) override
+	{
+		const int pos = frames;
+		const int n = std::min(count, capacity - pos);
+		if (n > 0)
+		{
+			memcpy(samples + pos * numChannels, buffer, sizeof(float) * n * numChannels);
+			frames = pos + n;
+		}
+		if (!monitor) memset(buffer, 0, sizeof(float) * count * numChannels);
+	}
+
+	virtual bool SkipSilence() const override { return false; } // the capture is the scene clock
+
+	inline bool IsDone() const { return frames >= capacity; }
+	inline double Time() const { return sampleRate ? double(frames) / sampleRate : 0.0; }
+};
+
+
+
+
+int main(int argc, char** argv)
+{
+	xOptions.threads = 0;
+	xOptions.outdir = ".";
+	xOptions.monitor = false;
+	xOptions.bits = 32;
+	xOptions.dither = DITHER_TPDF;
+	xOptions.rtcheck = false;
+	xOptions.reccheck = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (!strcmp(argv[i], "-j") && i + 1 < argc)
+			xOptions.threads = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+			xOptions.outdir = argv[++i];
+		else if (!strcmp(argv[i], "-monitor"))
+			xOptions.monitor = true;
+		else if (!strcmp(argv[i], "-rtcheck"))
+			xOptions.rtcheck = true;
+		else if (!strcmp(argv[i], "-reccheck"))
+			xOptions.reccheck = true;
+		else if (!strcmp(argv[i], "-bits") && i + 1 < argc)
+			xOptions.bits = atoi(argv[++i]);
+		else if (!strcmp(argv[i], "-dither") && i + 1 < argc)
+		{
+			const char* mode = argv[++i];
+			xOptions.dither = !strcmp(mode, "none") ? DITHER_NONE : !strcmp(mode, "shaped") ? DITHER_SHAPED : DITHER_TPDF;
+		}
+		else
+		{
+			Scene scene;
+			std::string error;
+			if (!loadScene(argv[i], scene, error))
+			{
+				fprintf(stderr, "%s: %s\n", argv[i], error.c_str());
+				return 1;
+			}
+			xScenes.push_back(scene);
+		}
+	}
+	if (xOptions.reccheck)
+	{
+		std::string error;
+		CreateDirectoryA(xOptions.outdir.c_str(), NULL);
+		if (!checkRecorder(error))
+		{
+			printf("-reccheck: FAILED: %s\n", error.c_str());
+			return 4;
+		}
+		printf("-reccheck: posted calls were recorded and replayed\n");
+		if (xScenes.empty())
+			return 0;
+	}
+	if (xScenes.empty())
+	{
+		printf("usage: Render [-j threads] [-o outdir] [-monitor] [-bits 16|24|32] [-dither none|tpdf|shaped] [-rtcheck] [-reccheck] scene1.txt capture.s3dr ...\n");
+		return 1;
+	}
+	if (xOptions.bits != 16 && xOptions.bits != 24)
+		xOptions.bits = 32;
+	if (xOptions.threads <= 0) // one scene per core
+	{
+		SYSTEM_INFO info;
+		GetSystemInfo(&info);
+		xOptions.threads = int(info.dwNumberOfProcessors);
+	}
+	if (xOptions.threads > (int)xScenes.size())
+		xOptions.threads = (int)xScenes.size();
+	CreateDirectoryA(xOptions.outdir.c_str(), NULL);
+	if (xOptions.rtcheck)
+		RealtimeCheck::Enable(); // before the first Engine, which then patches XAudio2 as well
+
+	xReports.resize(xScenes.size());
+	const double start = wallClock();
+	std::vector<HANDLE> workers;
+	for (int i = 0; i < xOptions.threads; ++i)
+		if (HANDLE worker = (HANDLE)_beginthreadex(NULL, 0, renderWorker, NULL, 0, NULL))
+			workers.push_back(worker);
+	if (workers.empty()) // the scene queue is shared, this thread can drain it too
+		renderWorker(NULL);
+	for (HANDLE worker : workers) // WaitForMultipleObjects is limited to 64 handles
+	{
+		if (WaitForSingleObject(worker, INFINITE) != WAIT_OBJECT_0)
+			printf("render worker wait failed: %u\n", (unsigned)GetLastError());
+		CloseHandle(worker);
+	}
+	const double elapsed = wallClock() - start;
+
+	int failed = 0;
+	double audioSeconds = 0.0;
+	for (size_t i = 0; i < xScenes.size(); ++i)
+	{
+		const SceneReport& r = xReports[i];
+		if (!r.ok)
+		{
+			printf("%-24s FAILED: %s\n", xScenes[i].name.c_str(), r.error.c_str());
+			++failed;
+			continue;
+		}
+		audioSeconds += xScenes[i].length;
+		printf("%-24s %7.2fs  late max %5.1fms  pass max %5.2fms  glitches %u\n", xScenes[i].name.c_str(), 
+			   xScenes[i].length, r.lateMaxMs, r.passMaxMs, r.glitches);
+	}
+	printf("%d scenes, %.1fs of audio in %.1fs on %d threads (%.2fx realtime)\n", 
+		   (int)xScenes.size(), audioSeconds, elapsed, xOptions.threads, elapsed > 0.0 ? audioSeconds / elapsed : 0.0);
+	if (xOptions.rtcheck)
+	{
+		if (!RealtimeCheck::Enabled())
+			printf("-rtcheck: built without S3D_RTCHECK, nothing was checked\n");
+		else if (RealtimeCheck::Print() && !failed)
+			return 3;
+	}
+	return failed ? 2 : 0;
+}
+
+
+
+
+/**
+ * Records calls posted through the SoundTable, replays the capture and checks that the
+ * replay made every one of them. Posted calls run inside Update() and must still be recorded.
+ */
+static bool checkRecorder(std::string& error)
+{
+	const std::string path = xOptions.outdir + "\\reccheck.s3dr";
+	Engine engine; // the calls work on an Engine without a device too, its objects stay silent
+	engine.MakeCurrent();
+	if (!CommandRecorder::Start(path.c_str()))
+		return error = "cannot create " + path, false;
+	Sound* sound = new Sound();							// CREATE_SOUND
+	const SoundHandle handle = sound->GetHandle();
+	SoundTable::Looping(handle, true);
+	Update();											// LOOPING, UPDATE
+	SoundTable::Destroy(handle);
+	Update();											// DESTROY, UPDATE
+	CommandRecorder::Stop();
+	const int recorded = 5;
+
+	CommandReplay replay;
+	if (!replay.Open(path.c_str()))
+		return error = "cannot read " + path, false;
+	while (replay.Step()) {}
+	const int replayed = replay.Executed();
+	replay.Close();
+	DeleteFileA(path.c_str());
+	if (replayed != recorded)
+	{
+		char message[128];
+		sprintf(message, "replayed %d of %d calls, posted calls are missing from the capture", replayed, recorded);
+		return error = message, false;
+	}
+	return true;
+}
+
+static unsigned __stdcall renderWorker(void*)
+{
+	for (;;)
+	{
+		const LONG index = InterlockedIncrement(&xNextScene);
+		if (index >= (LONG)xScenes.size())
+			return 0;
+		const Scene& scene = xScenes[index];
+		SceneReport& report = xReports[index];
+		renderScene(scene, report);
+		const std::string path = xOptions.outdir + "\\" + scene.name + ".txt";
+		if (report.ok && !writeReport(path, scene, report))
+			report.ok = false, report.error = "cannot write " + path;
+	}
+}
+
+static void renderScene(const Scene& scene, SceneReport& report)
+{
+	Engine engine; // everything below is created in this scene's own audio world
+	engine.MakeCurrent();
+	if (!engine.IsValid())
+	{
+		report.error = "cannot create the audio engine, no audio device?";
+		return;
+	}
+
+	const double loadStart = wallClock();
+	std::map<std::string, SoundBuffer*> buffers;
+	std::map<std::string, SceneSound> sounds;
+	std::vector<ReverbZone*> zones;
+	for (const SceneAsset& asset : scene.assets)
+	{
+		SoundBuffer* buffer = asset.stream ? new SoundStream() : new SoundBuffer();
+		buffers[asset.name] = buffer;
+		if (!buffer->Load(asset.file.c_str()))
+			report.error = "cannot load " + asset.file;
+	}
+	for (const SceneZone& z : scene.zones)
+	{
+		ReverbZone* zone = new ReverbZone();
+		zone->Position(z.x, z.y, z.z);
+		zone->Radius(z.radius);
+		zones.push_back(zone);
+	}
+	report.loadSeconds = wallClock() - loadStart;
+
+	CaptureEffect capture(scene.length, xOptions.monitor);
+	if (report.error.empty() && !Listener::Effects().Add(&capture))
+		report.error = "cannot capture the master mix";
+
+	if (report.error.empty())
+	{
+		// the capture is the scene clock, so events land on the audio timeline, not the wall clock
+		const double renderStart = wallClock();
+		size_t next = 0;
+		double lateSum = 0.0;
+		float passSum = 0.0f;
+		int passSamples = 0;
+		AudioStats stats;
+		CommandReplay replay;
+		if (scene.replay && !replay.Open(scene.path.c_str()))
+			report.error = "cannot open " + scene.path;
+		while (report.error.empty() && !capture.IsDone())
+		{
+			const double now = capture.Time();
+			for (; scene.replay && !replay.IsDone() && replay.NextTime() <= now; ++report.numEvents)
+			{
+				const double late = (now - replay.NextTime()) * 1000.0;
+				lateSum += late;
+				if (late > report.lateMaxMs) report.lateMaxMs = late;
+				replay.Step(); // the recorded Update() calls are replayed too
+			}
+			for (; next < scene.events.size() && scene.events[next].time <= now; ++next)
+			{
+				const SceneEvent& e = scene.events[next];
+				SceneSound& s = sounds[e.id];
+				if (e.command == "play")
+				{
+					s.Destroy();
+					SoundBuffer* buffer = buffers[e.asset];
+					if (e.hasPosition)
+					{
+						s.sound3D = new Sound3D(buffer, e.loop);
+						s.sound3D->Position(e.x, e.y, e.z);
+					}
+					else s.sound = new Sound(buffer, e.loop);
+					s.Object()->Play();
+				}
+				else if (e.command == "stop" && s.Object())
+					s.Object()->Stop();
+				else if (e.command == "move" && s.sound3D)
+					s.sound3D->Position(e.x, e.y, e.z);
+				else if (e.command == "volume" && s.Object())
+					s.Object()->Volume(e.x);
+				else if (e.command == "listener")
+					Listener::Position(e.x, e.y, e.z);
+				else if (e.command == "lookat")
+					Listener::LookAt(e.x, e.y, e.z, 0.0f, 1.0f, 0.0f);
+
+				const double late = (now - e.time) * 1000.0;
+				lateSum += late;
+				if (late > report.lateMaxMs) report.lateMaxMs = late;
+				++report.numEvents;
+			}
+
+			if (!scene.replay) Update();
+			GetAudioStats(stats);
+			passSum += stats.passMillis, ++passSamples;
+			if (stats.passMillis > report.passMaxMs) report.passMaxMs = stats.passMillis;
+			report.glitches = stats.glitches;
+			Sleep(5); // a processing pass is 10ms
+		}
+		report.renderSeconds = wallClock() - renderStart;
+		report.lateAvgMs = report.numEvents ? lateSum / report.numEvents : 0.0;
+		report.passAvgMs = passSamples ? passSum / passSamples : 0.0f;
+		Listener::Effects().Remove(&capture);
+		replay.Close(); // the replayed objects belong to this scene's engine
+
+		report.sampleRate = capture.sampleRate;
+		report.channels = capture.channels;
+		report.frames = capture.frames;
+		const int count = capture.frames * capture.channels;
+		for (int i = 0; i < count; ++i)
+			report.peak = std::max(report.peak, fabsf(capture.samples[i]));
+
+		// integer WAVs go through the same saturating, dithered output stage a device path would use
+		std::vector<char> pcm;
+		if (xOptions.bits != 32 && report.error.empty())
+		{
+			OutputStage stage(xOptions.bits, xOptions.dither);
+			pcm.resize(count * xOptions.bits / 8 + 1);
+			const double convertStart = wallClock();
+			if (!stage.Convert(capture.samples, capture.frames, capture.channels, pcm.data()))
+				report.error = "unsupported channel count";
+			const double seconds = wallClock() - convertStart;
+			report.clipped = stage.Clipped();
+			report.samplesPerNs = seconds > 0.0 ? count / (seconds * 1e9) : 0.0;
+		}
+
+		const std::string wav = xOptions.outdir + "\\" + scene.name + ".wav";
+		if (report.error.empty()) // the replay may have failed to open
+		{
+			const void* data = pcm.empty() ? (const void*)capture.samples : pcm.data();
+			if (writeWav(wav, data, capture.frames, capture.channels, capture.sampleRate, xOptions.bits))
+				report.ok = true;
+			else
+				report.error = "cannot write " + wav;
+		}
+	}
+
+	for (auto& it : sounds) it.second.Destroy(); // the engine must outlive its sounds and zones
+	for (ReverbZone* zone : zones) delete zone;
+	for (auto& it : buffers) delete it.second;
+}
+
+
+
+
+static void splitWords(const char* line, std::vector<std::string>& words)
+{
+	words.clear();
+	for (const char* p = line; *p && *p != '#'; )
+	{
+		while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') ++p;
+		const char* start = p;
+		while (*p && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n' && *p != '#') ++p;
+		if (p != start) words.push_back(std::string(start, p));
+	}
+}
+
+static bool isAbsolute(const std::string& path)
+{
+	return path.size() > 1 && (path[0] == '\\' || path[0] == '/' || path[1] == ':');
+}
+
+static bool loadScene(const char* path, Scene& scene, std::string& error)
+{
+	FILE* f = fopen(path, "r");
+	if (!f)
+	{
+		error = "cannot open scene";
+		return false;
+	}
+	scene.path = path;
+	const char* slash = std::max(strrchr(path, '\\'), strrchr(path, '/'));
+	const std::string dir = slash ? std::string(path, slash + 1) : std::string();
+	const char* file = slash ? slash + 1 : path;
+	const char* dot = strrchr(file, '.');
+	scene.name = dot ? std::string(file, dot) : std::string(file);
+	scene.length = 0.0;
+	scene.replay = dot && _stricmp(dot, ".s3dr") == 0;
+	if (scene.replay)
+	{
+		fclose(f);
+		CommandReplay replay; // only reads the recording, no objects are created before Step()
+		if (!replay.Open(path))
+		{
+			error = "not a Sound3D recording";
+			return false;
+		}
+		scene.length = replay.Duration() + 1.0; // let the last sounds ring out
+		return true;
+	}
+
+	char line[1024];
+	char where[32];
+	std::vector<std::string> w;
+	std::map<std::string, bool> assets; // known asset names
+	for (int lineNo = 1; fgets(line, sizeof(line), f); ++lineNo)
+	{
+		splitWords(line, w);
+		if (w.empty()) continue;
+		sprintf(where, "line %d: ", lineNo);
+		const size_t n = w.size();
+		if (w[0] == "length" && n == 2)
+			scene.length = atof(w[1].c_str());
+		else if (w[0] == "asset" && (n == 3 || (n == 4 && w[3] == "stream")))
+		{
+			SceneAsset a = { w[1], isAbsolute(w[2]) ? w[2] : dir + w[2], n == 4 };
+			scene.assets.push_back(a);
+			assets[w[1]] = true;
+		}
+		else if (w[0] == "zone" && n == 5)
+		{
+			SceneZone z = { float(atof(w[1].c_str())), float(atof(w[2].c_str())), 
+							float(atof(w[3].c_str())), float(atof(w[4].c_str())) };
+			scene.zones.push_back(z);
+		}
+		else
+		{
+			char* end;
+			SceneEvent e;
+			e.time = strtod(w[0].c_str(), &end);
+			e.line = lineNo;
+			e.command = n > 1 ? w[1] : "";
+			e.x = e.y = e.z = 0.0f;
+			e.hasPosition = e.loop = false;
+			const bool loop = n > 0 && w[n - 1] == "loop";
+			const size_t args = loop ? n - 1 : n; // words before the loop flag
+			if (*end || e.time < 0.0)
+				error = where + std::string("unknown command ") + w[0];
+			else if (e.command == "play" && (args == 4 || args == 7))
+			{
+				e.id = w[2], e.asset = w[3], e.loop = loop;
+				if (!assets.count(e.asset))
+					error = where + std::string("unknown asset ") + e.asset;
+				if ((e.hasPosition = args == 7))
+					e.x = float(atof(w[4].c_str())), e.y = float(atof(w[5].c_str())), e.z = float(atof(w[6].c_str()));
+			}
+			else if (e.command == "stop" && n == 3)
+				e.id = w[2];
+			else if (e.command == "volume" && n == 4)
+				e.id = w[2], e.x = float(atof(w[3].c_str()));
+			else if (e.command == "move" && n == 6)
+				e.id = w[2], e.x = float(atof(w[3].c_str())), e.y = float(atof(w[4].c_str())), e.z = float(atof(w[5].c_str()));
+			else if ((e.command == "listener" || e.command == "lookat") && n == 5)
+				e.x = float(atof(w[2].c_str())), e.y = float(atof(w[3].c_str())), e.z = float(atof(w[4].c_str()));
+			else if (error.empty())
+				error = where + std::string("invalid event");
+			scene.events.push_back(e);
+		}
+		if (!error.empty())
+			break;
+	}
+	fclose(f);
+	if (error.empty() && scene.length <= 0.0)
+		error = "missing length";
+	if (!error.empty())
+		return false;
+
+	std::stable_sort(scene.events.begin(), scene.events.end(), 
+		[](const SceneEvent& a, const SceneEvent& b) { return a.time < b.time; });
+	return true;
+}
+
+
+
+
+static bool writeWav(const std::string& path, const void* data, int frames, int channels, int sampleRate, int bits)
+{
+	FILE* f = fopen(path.c_str(), "wb");
+	if (!f) return false;
+
+	const unsigned dataBytes = unsigned(frames) * channels * (bits / 8);
+	WAVEFORMATEX wf = { 0 };
+	wf.wFormatTag = bits == 32 ? 3 : 1; // WAVE_FORMAT_IEEE_FLOAT is the raw mix, PCM was dithered
+	wf.nChannels = WORD(channels);
+	wf.nSamplesPerSec = sampleRate;
+	wf.wBitsPerSample = WORD(bits);
+	wf.nBlockAlign = WORD(channels * (bits / 8));
+	wf.nAvgBytesPerSec = sampleRate * wf.nBlockAlign;
+	const unsigned fmtBytes = sizeof(WAVEFORMATEX);
+	const unsigned riffBytes = 4 + (8 + fmtBytes) + (8 + dataBytes);
+
+	bool ok = fwrite("RIFF", 4, 1, f) && fwrite(&riffBytes, 4, 1, f) && fwrite("WAVE", 4, 1, f)
+		&& fwrite("fmt ", 4, 1, f) && fwrite(&fmtBytes, 4, 1, f) && fwrite(&wf, fmtBytes, 1, f)
+		&& fwrite("data", 4, 1, f) && fwrite(&dataBytes, 4, 1, f)
+		&& (!dataBytes || fwrite(data, dataBytes, 1, f));
+	return fclose(f) == 0 && ok;
+}
+
+static bool writeReport(const std::string& path, const Scene& scene, const SceneReport& r)
+{
+	FILE* f = fopen(path.c_str(), "w");
+	if (!f) return false;
+	fprintf(f, "scene      %s\n", scene.path.c_str());
+	fprintf(f, "length     %.3f s, %d frames\n", scene.length, r.frames);
+	static const char* dithers[] = { "no dither", "TPDF dither", "shaped dither" };
+	if (xOptions.bits == 32)
+		fprintf(f, "format     %d Hz, %d channels, 32-bit float\n", r.sampleRate, r.channels);
+	else
+		fprintf(f, "format     %d Hz, %d channels, %d-bit %s, %u clipped, %.2f samples/ns\n", r.sampleRate, r.channels, 
+				xOptions.bits, dithers[xOptions.dither], r.clipped, r.samplesPerNs);
+	fprintf(f, "load       %.3f s\n", r.loadSeconds);
+	fprintf(f, "render     %.3f s (%.2fx realtime)\n", r.renderSeconds, 
+			r.renderSeconds > 0.0 ? scene.length / r.renderSeconds : 0.0);
+	fprintf(f, "events     %d, late avg %.2f ms, max %.2f ms\n", r.numEvents, r.lateAvgMs, r.lateMaxMs);
+	fprintf(f, "pass       avg %.3f ms, max %.3f ms\n", r.passAvgMs, r.passMaxMs);
+	fprintf(f, "glitches   %u\n", r.glitches);
+	fprintf(f, "peak       %.2f dBFS\n", r.peak > 0.0f ? 20.0 * log10(r.peak) : -999.0);
+	return fclose(f) == 0;
+}
+
+static double wallClock()
+{
+	LARGE_INTEGER t, freq;
+	QueryPerformanceCounter(&t);
+	QueryPerformanceFrequency(&freq);
+	return double(t.QuadPart) / double(freq.QuadPart);
+}